@@ -34,6 +34,7 @@
 	#include <arpa/inet.h>
 
 	#include <dirent.h>
+	#include <sys/mman.h>
 
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
@@ -48,6 +49,7 @@
 	#include <fcntl.h>
 	#include <direct.h>
 	#include <errno.h>
+	#include <io.h>
 	#include <wincrypt.h>
 #else
 	#error NOT IMPLEMENTED
@@ -301,6 +303,8 @@ IOHANDLE io_open(const char *filename, int flags)
 	}
 	if(flags == IOFLAG_WRITE)
 		return (IOHANDLE)fopen(filename, "wb");
+	if(flags == IOFLAG_APPEND)
+		return (IOHANDLE)fopen(filename, "ab");
 	return 0x0;
 }
 
@@ -377,6 +381,44 @@ int io_flush(IOHANDLE io)
 	return 0;
 }
 
+void *io_map(IOHANDLE io, unsigned *size)
+{
+	long int length = io_length(io);
+	if(length <= 0)
+		return 0;
+
+#if defined(CONF_FAMILY_UNIX)
+	void *data = mmap(0, length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno((FILE*)io), 0);
+	if(data == MAP_FAILED)
+		return 0;
+#elif defined(CONF_FAMILY_WINDOWS)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)io));
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(!mapping)
+		return 0;
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping); // the view keeps the mapping alive
+	if(!data)
+		return 0;
+#else
+	#error not implemented
+#endif
+
+	*size = length;
+	return data;
+}
+
+void io_unmap(void *data, unsigned size)
+{
+#if defined(CONF_FAMILY_UNIX)
+	munmap(data, size);
+#elif defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	#error not implemented
+#endif
+}
+
 void *thread_init(void (*threadfunc)(void *), void *u)
 {
 #if defined(CONF_FAMILY_UNIX)
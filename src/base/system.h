@@ -190,6 +190,7 @@ enum {
 	IOFLAG_READ = 1,
 	IOFLAG_WRITE = 2,
 	IOFLAG_RANDOM = 4,
+	IOFLAG_APPEND = 8,
 
 	IOSEEK_START = 0,
 	IOSEEK_CUR = 1,
@@ -206,7 +207,7 @@ typedef struct IOINTERNAL *IOHANDLE;
 
 	Parameters:
 		filename - File to open.
-		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM.
+		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM, IOFLAG_APPEND.
 
 	Returns:
 		Returns a handle to the file on success and 0 on failure.
@@ -330,6 +331,35 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps a whole file into memory. The mapping is copy on write,
+		changes never reach the file.
+
+	Parameters:
+		io - Handle to the file.
+		size - Receives the size of the mapping.
+
+	Returns:
+		Returns a pointer to the mapped file, 0 if the file can't be
+		mapped (empty file, pipe, no support on the platform).
+
+	Remarks:
+		The mapping stays valid after the file is closed. Release it
+		with <io_unmap>.
+*/
+void *io_map(IOHANDLE io, unsigned *size);
+
+/*
+	Function: io_unmap
+		Releases a mapping created by <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Size returned by <io_map>.
+*/
+void io_unmap(void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -289,6 +289,34 @@ void CCommandProcessorFragment_OpenGL::Cmd_Texture_Create(const CCommandBuffer::
 	mem_free(pTexData);
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_QuadBuffer_Create(const CCommandBuffer::SCommand_QuadBuffer_Create *pCommand)
+{
+	// add the depth every other draw uses, the rest is stored as it came
+	CQuadBuffer *pBuffer = &m_aQuadBuffers[pCommand->m_Slot];
+	const IGraphics::CQuadVertex *pSrc = static_cast<const IGraphics::CQuadVertex *>(pCommand->m_pData);
+	int NumVertices = pCommand->m_NumQuads*4;
+	pBuffer->m_pVertices = (CQuadBufferVertex *)mem_alloc(NumVertices*sizeof(CQuadBufferVertex), sizeof(void*));
+	pBuffer->m_NumQuads = pCommand->m_NumQuads;
+	for(int i = 0; i < NumVertices; i++)
+	{
+		pBuffer->m_pVertices[i].m_Pos.x = pSrc[i].m_X;
+		pBuffer->m_pVertices[i].m_Pos.y = pSrc[i].m_Y;
+		pBuffer->m_pVertices[i].m_Pos.z = -5.0f;
+		pBuffer->m_pVertices[i].m_Tex.u = pSrc[i].m_U;
+		pBuffer->m_pVertices[i].m_Tex.v = pSrc[i].m_V;
+	}
+	mem_free(pCommand->m_pData);
+}
+
+void CCommandProcessorFragment_OpenGL::Cmd_QuadBuffer_Destroy(const CCommandBuffer::SCommand_QuadBuffer_Destroy *pCommand)
+{
+	CQuadBuffer *pBuffer = &m_aQuadBuffers[pCommand->m_Slot];
+	if(pBuffer->m_pVertices)
+		mem_free(pBuffer->m_pVertices);
+	pBuffer->m_pVertices = 0;
+	pBuffer->m_NumQuads = 0;
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Clear(const CCommandBuffer::SCommand_Clear *pCommand)
 {
 	glClearColor(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, 0.0f);
@@ -319,6 +347,24 @@ void CCommandProcessorFragment_OpenGL::Cmd_Render(const CCommandBuffer::SCommand
 	};
 }
 
+void CCommandProcessorFragment_OpenGL::Cmd_RenderQuadBuffer(const CCommandBuffer::SCommand_RenderQuadBuffer *pCommand)
+{
+	const CQuadBuffer *pBuffer = &m_aQuadBuffers[pCommand->m_Slot];
+	if(!pBuffer->m_pVertices || pCommand->m_FirstQuad+pCommand->m_NumQuads > (unsigned)pBuffer->m_NumQuads)
+		return;
+
+	SetState(pCommand->m_State);
+
+	glVertexPointer(3, GL_FLOAT, sizeof(CQuadBufferVertex), (char*)pBuffer->m_pVertices);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(CQuadBufferVertex), (char*)pBuffer->m_pVertices + sizeof(float)*3);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(pCommand->m_Color.r, pCommand->m_Color.g, pCommand->m_Color.b, pCommand->m_Color.a);
+
+	glDrawArrays(GL_QUADS, pCommand->m_FirstQuad*4, pCommand->m_NumQuads*4);
+}
+
 void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand)
 {
 	// fetch image data
@@ -357,6 +403,7 @@ void CCommandProcessorFragment_OpenGL::Cmd_Screenshot(const CCommandBuffer::SCom
 CCommandProcessorFragment_OpenGL::CCommandProcessorFragment_OpenGL()
 {
 	mem_zero(m_aTextures, sizeof(m_aTextures));
+	mem_zero(m_aQuadBuffers, sizeof(m_aQuadBuffers));
 	m_pTextureMemoryUsage = 0;
 }
 
@@ -370,6 +417,9 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand
 	case CCommandBuffer::CMD_TEXTURE_UPDATE: Cmd_Texture_Update(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_CLEAR: Cmd_Clear(static_cast<const CCommandBuffer::SCommand_Clear *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER: Cmd_Render(static_cast<const CCommandBuffer::SCommand_Render *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_QUADBUFFER_CREATE: Cmd_QuadBuffer_Create(static_cast<const CCommandBuffer::SCommand_QuadBuffer_Create *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_QUADBUFFER_DESTROY: Cmd_QuadBuffer_Destroy(static_cast<const CCommandBuffer::SCommand_QuadBuffer_Destroy *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_RENDER_QUADBUFFER: Cmd_RenderQuadBuffer(static_cast<const CCommandBuffer::SCommand_RenderQuadBuffer *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_SCREENSHOT: Cmd_Screenshot(static_cast<const CCommandBuffer::SCommand_Screenshot *>(pBaseCommand)); break;
 	default: return false;
 	}
@@ -632,5 +682,39 @@ int CGraphicsBackend_SDL_OpenGL::WindowOpen()
 
 }
 
+// ------------ CGraphicsBackend_Null
+
+int CGraphicsBackend_Null::Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags)
+{
+	if(*Width == 0 || *Height == 0)
+	{
+		*Width = 800;
+		*Height = 600;
+	}
+	dbg_msg("gfx", "using the null graphics backend");
+	return 0;
+}
+
+void CGraphicsBackend_Null::RunBuffer(CCommandBuffer *pBuffer)
+{
+	unsigned CmdIndex = 0;
+	while(1)
+	{
+		const CCommandBuffer::SCommand *pBaseCommand = pBuffer->GetCommand(&CmdIndex);
+		if(pBaseCommand == 0x0)
+			break;
+
+		switch(pBaseCommand->m_Cmd)
+		{
+		case CCommandBuffer::CMD_TEXTURE_CREATE: mem_free(static_cast<const CCommandBuffer::SCommand_Texture_Create *>(pBaseCommand)->m_pData); break;
+		case CCommandBuffer::CMD_TEXTURE_UPDATE: mem_free(static_cast<const CCommandBuffer::SCommand_Texture_Update *>(pBaseCommand)->m_pData); break;
+		case CCommandBuffer::CMD_QUADBUFFER_CREATE: mem_free(static_cast<const CCommandBuffer::SCommand_QuadBuffer_Create *>(pBaseCommand)->m_pData); break;
+		case CCommandBuffer::CMD_VIDEOMODES: *static_cast<const CCommandBuffer::SCommand_VideoModes *>(pBaseCommand)->m_pNumModes = 0; break;
+		default: m_General.RunCommand(pBaseCommand);
+		}
+	}
+}
+
 
 IGraphicsBackend *CreateGraphicsBackend() { return new CGraphicsBackend_SDL_OpenGL; }
+IGraphicsBackend *CreateGraphicsBackendNull() { return new CGraphicsBackend_Null; }
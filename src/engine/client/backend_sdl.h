@@ -175,6 +175,19 @@ class CCommandProcessorFragment_OpenGL
 	CTexture m_aTextures[CCommandBuffer::MAX_TEXTURES];
 	volatile int *m_pTextureMemoryUsage;
 
+	// static geometry lives here for as long as the game keeps it
+	struct CQuadBufferVertex
+	{
+		CCommandBuffer::SPoint m_Pos;
+		CCommandBuffer::STexCoord m_Tex;
+	};
+	struct CQuadBuffer
+	{
+		CQuadBufferVertex *m_pVertices;
+		int m_NumQuads;
+	};
+	CQuadBuffer m_aQuadBuffers[CCommandBuffer::MAX_QUADBUFFERS];
+
 public:
 	enum
 	{
@@ -198,8 +211,11 @@ private:
 	void Cmd_Texture_Update(const CCommandBuffer::SCommand_Texture_Update *pCommand);
 	void Cmd_Texture_Destroy(const CCommandBuffer::SCommand_Texture_Destroy *pCommand);
 	void Cmd_Texture_Create(const CCommandBuffer::SCommand_Texture_Create *pCommand);
+	void Cmd_QuadBuffer_Create(const CCommandBuffer::SCommand_QuadBuffer_Create *pCommand);
+	void Cmd_QuadBuffer_Destroy(const CCommandBuffer::SCommand_QuadBuffer_Destroy *pCommand);
 	void Cmd_Clear(const CCommandBuffer::SCommand_Clear *pCommand);
 	void Cmd_Render(const CCommandBuffer::SCommand_Render *pCommand);
+	void Cmd_RenderQuadBuffer(const CCommandBuffer::SCommand_RenderQuadBuffer *pCommand);
 	void Cmd_Screenshot(const CCommandBuffer::SCommand_Screenshot *pCommand);
 
 public:
@@ -270,3 +286,24 @@ public:
 	virtual int WindowActive();
 	virtual int WindowOpen();
 };
+
+// graphics backend without a window, runs the commands on the calling thread and
+// only releases what they own. used for headless runs and timing
+class CGraphicsBackend_Null : public IGraphicsBackend
+{
+	CCommandProcessorFragment_General m_General;
+public:
+	virtual int Init(const char *pName, int *Width, int *Height, int FsaaSamples, int Flags);
+	virtual int Shutdown() { return 0; }
+
+	virtual int MemoryUsage() const { return 0; }
+
+	virtual void Minimize() {}
+	virtual void Maximize() {}
+	virtual int WindowActive() { return 1; }
+	virtual int WindowOpen() { return 1; }
+
+	virtual void RunBuffer(CCommandBuffer *pBuffer);
+	virtual bool IsIdle() const { return true; }
+	virtual void WaitForIdle() {}
+};
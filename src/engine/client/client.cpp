@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <new>
+#include <thread>
 
 #include <stdlib.h> // qsort
 #include <stdarg.h>
@@ -32,10 +33,12 @@
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
 #include <engine/shared/protocol.h>
+#include <engine/shared/protocol_ex.h>
 #include <engine/shared/ringbuffer.h>
 #include <engine/shared/snapshot.h>
 
 #include <game/version.h>
+#include <game/mapgen.h>
 
 #include <mastersrv/mastersrv.h>
 #include <versionsrv/versionsrv.h>
@@ -287,9 +290,13 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta), m_DemoRecorder(&m_SnapshotD
 	m_aMapdownloadName[0] = 0;
 	m_MapdownloadFile = 0;
 	m_MapdownloadChunk = 0;
+	m_MapdownloadChunkNum = 0;
+	m_MapdownloadRequested = 0;
+	m_MapdownloadLastRecv = 0;
 	m_MapdownloadCrc = 0;
 	m_MapdownloadAmount = -1;
 	m_MapdownloadTotalsize = -1;
+	m_MapGenValid = false;
 
 	m_CurrentServerInfoRequestTime = -1;
 
@@ -369,6 +376,112 @@ void CClient::SendReady()
 	SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
 }
 
+void CClient::StartMapDownload()
+{
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "starting to download map to '%s'", m_aMapdownloadFilename);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", aBuf);
+
+	m_MapdownloadChunk = 0;
+	m_MapdownloadChunkNum = maximum((m_MapdownloadTotalsize+MAP_CHUNK_SIZE-1)/MAP_CHUNK_SIZE, 1);
+	m_MapdownloadRequested = 0;
+	mem_zero(m_aMapdownloadReceived, sizeof(m_aMapdownloadReceived));
+	m_MapdownloadLastRecv = time_get();
+	if(m_MapdownloadFile)
+		io_close(m_MapdownloadFile);
+	m_MapdownloadFile = Storage()->OpenFile(m_aMapdownloadFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	m_MapdownloadAmount = 0;
+
+	SendMapRequests();
+}
+
+bool CClient::StartMapGen()
+{
+	// the parameters only hold for the map change that follows them
+	bool Valid = m_MapGenValid;
+	m_MapGenValid = false;
+	if(!Valid || m_MapGenVersion != MAPGEN_VERSION || m_MapGenCrc != m_MapdownloadCrc || m_MapGenSize != m_MapdownloadTotalsize)
+		return false;
+
+	// the template has to be here already, from an earlier download or the maps folder
+	char aTemplate[256];
+	str_format(aTemplate, sizeof(aTemplate), "downloadedmaps/%s_%08x.map", m_aMapGenTemplate, m_MapGenTemplateCrc);
+	IOHANDLE File = Storage()->OpenFile(aTemplate, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		str_format(aTemplate, sizeof(aTemplate), "maps/%s.map", m_aMapGenTemplate);
+		File = Storage()->OpenFile(aTemplate, IOFLAG_READ, IStorage::TYPE_ALL);
+	}
+	if(!File)
+		return false;
+	io_close(File);
+
+	// the generator follows the server's rules, a template with another crc falls back to the download
+	// sv_mapgen_threads is a server setting, the client takes the cores it has up to the server's default
+	int NumThreads = clamp((int)std::thread::hardware_concurrency(), 1, 4);
+	m_pMapGenJob = std::make_shared<CMapGenJob>(Storage(), m_aMapGenTemplate, m_MapGenSeed, m_MapGenLevel, m_aMapGenGameType, m_MapGenSurvivalMode != 0, NumThreads);
+	m_pMapGenJob->SetTemplateFile(aTemplate, m_MapGenTemplateCrc);
+	Engine()->AddJob(m_pMapGenJob);
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "generating map from '%s', seed=%d level=%d", aTemplate, m_MapGenSeed, m_MapGenLevel);
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", aBuf);
+	return true;
+}
+
+void CClient::FinishMapGen()
+{
+	int Size = 0;
+	unsigned char *pData = m_pMapGenJob->ReleaseData(&Size);
+	m_pMapGenJob = nullptr;
+
+	// only a byte exact copy of the server's map will do
+	bool Match = pData && Size == m_MapdownloadTotalsize && sha256(pData, Size) == m_MapGenSha256;
+	if(Match)
+	{
+		IOHANDLE File = Storage()->OpenFile(m_aMapdownloadFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		Match = File && io_write(File, pData, Size) == (unsigned)Size;
+		if(File)
+			io_close(File);
+	}
+	free(pData);
+
+	const char *pError = Match ? LoadMap(m_aMapdownloadName, m_aMapdownloadFilename, m_MapdownloadCrc) : "generated map differs";
+	if(pError)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%s, downloading it instead", pError);
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", aBuf);
+		StartMapDownload();
+		return;
+	}
+
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", "loading done");
+	m_MapdownloadTotalsize = -1;
+	SendReady();
+}
+
+void CClient::SendMapRequests()
+{
+	// keep a window of chunks in flight instead of one per round trip,
+	// old servers simply answer every request on its own
+	int Window = clamp(g_Config.m_ClMapDownloadWindow, 1, (int)MAX_MAPDOWNLOAD_WINDOW);
+	int End = minimum(m_MapdownloadChunk+Window, m_MapdownloadChunkNum);
+	for(; m_MapdownloadRequested < End; m_MapdownloadRequested++)
+	{
+		CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
+		Msg.AddInt(m_MapdownloadRequested);
+		SendMsgEx(&Msg, MSGFLAG_VITAL|(m_MapdownloadRequested == End-1 ? MSGFLAG_FLUSH : 0));
+
+		if(g_Config.m_Debug)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "requested chunk %d", m_MapdownloadRequested);
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client/network", aBuf);
+		}
+	}
+}
+
 void CClient::RconAuth(const char *pName, const char *pPassword)
 {
 	if(RconAuthed())
@@ -566,12 +679,16 @@ void CClient::DisconnectWithReason(const char *pReason)
 
 	// disable all downloads
 	m_MapdownloadChunk = 0;
+	m_MapdownloadChunkNum = 0;
+	m_MapdownloadRequested = 0;
 	if(m_MapdownloadFile)
 		io_close(m_MapdownloadFile);
 	m_MapdownloadFile = 0;
 	m_MapdownloadCrc = 0;
 	m_MapdownloadTotalsize = -1;
 	m_MapdownloadAmount = 0;
+	m_MapGenValid = false;
+	m_pMapGenJob = nullptr; // a running job finishes on its own
 
 	// clear the current server info
 	mem_zero(&m_CurrentServerInfo, sizeof(m_CurrentServerInfo));
@@ -798,6 +915,9 @@ const char *CClient::LoadMap(const char *pName, const char *pFilename, unsigned
 		return aErrorMsg;
 	}
 
+	// inflate the images and layers while the game sets itself up
+	m_pMap->PrefetchData();
+
 	// stop demo recording if we loaded a new map
 	DemoRecorder_Stop();
 
@@ -1023,6 +1143,35 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 	if(Unpacker.Error())
 		return;
 
+	// extended messages carry an uuid instead of an id
+	if(Sys && Msg == NETMSG_EX)
+	{
+		CUuid Uuid;
+		Msg = g_UuidManager.UnpackUuid(&Unpacker, &Uuid);
+		if(Msg == NETMSG_MAP_GEN)
+		{
+			str_copy(m_aMapGenTemplate, Unpacker.GetString(CUnpacker::SANITIZE_CC|CUnpacker::SKIP_START_WHITESPACES), sizeof(m_aMapGenTemplate));
+			m_MapGenTemplateCrc = Unpacker.GetInt();
+			m_MapGenSeed = Unpacker.GetInt();
+			m_MapGenLevel = Unpacker.GetInt();
+			m_MapGenVersion = Unpacker.GetInt();
+			str_copy(m_aMapGenGameType, Unpacker.GetString(CUnpacker::SANITIZE_CC), sizeof(m_aMapGenGameType));
+			m_MapGenSurvivalMode = Unpacker.GetInt();
+			const void *pSha256 = Unpacker.GetRaw(sizeof(m_MapGenSha256.data));
+			m_MapGenCrc = Unpacker.GetInt();
+			m_MapGenSize = Unpacker.GetInt();
+			m_MapGenValid = !Unpacker.Error();
+			for(int i = 0; m_MapGenValid && m_aMapGenTemplate[i]; i++)
+			{
+				if(m_aMapGenTemplate[i] == '/' || m_aMapGenTemplate[i] == '\\')
+					m_MapGenValid = false;
+			}
+			if(m_MapGenValid)
+				mem_copy(m_MapGenSha256.data, pSha256, sizeof(m_MapGenSha256.data));
+		}
+		return;
+	}
+
 	if(Sys)
 	{
 		// system message
@@ -1049,6 +1198,9 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			if(MapSize < 0)
 				pError = "invalid map size";
 
+			// a level that is still being generated is outdated now
+			m_pMapGenJob = nullptr;
+
 			if(pError)
 				DisconnectWithReason(pError);
 			else
@@ -1063,29 +1215,13 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 				else
 				{
 					str_format(m_aMapdownloadFilename, sizeof(m_aMapdownloadFilename), "downloadedmaps/%s_%08x.map", pMap, MapCrc);
-
-					char aBuf[256];
-					str_format(aBuf, sizeof(aBuf), "starting to download map to '%s'", m_aMapdownloadFilename);
-					m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", aBuf);
-
-					m_MapdownloadChunk = 0;
 					str_copy(m_aMapdownloadName, pMap, sizeof(m_aMapdownloadName));
-					if(m_MapdownloadFile)
-						io_close(m_MapdownloadFile);
-					m_MapdownloadFile = Storage()->OpenFile(m_aMapdownloadFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 					m_MapdownloadCrc = MapCrc;
 					m_MapdownloadTotalsize = MapSize;
-					m_MapdownloadAmount = 0;
-
-					CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
-					Msg.AddInt(m_MapdownloadChunk);
-					SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
 
-					if(g_Config.m_Debug)
-					{
-						str_format(aBuf, sizeof(aBuf), "requested chunk %d", m_MapdownloadChunk);
-						m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client/network", aBuf);
-					}
+					// generated levels can be made locally, that saves the download
+					if(!StartMapGen())
+						StartMapDownload();
 				}
 			}
 		}
@@ -1098,14 +1234,31 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			const unsigned char *pData = Unpacker.GetRaw(Size);
 
 			// check fior errors
-			if(Unpacker.Error() || Size <= 0 || MapCRC != m_MapdownloadCrc || Chunk != m_MapdownloadChunk || !m_MapdownloadFile)
+			if(Unpacker.Error() || Size <= 0 || Size > MAP_CHUNK_SIZE || MapCRC != m_MapdownloadCrc || !m_MapdownloadFile)
+				return;
+
+			// chunks arrive out of order when a lost one had to be asked for
+			// again, anything outside of the window or already written is a duplicate
+			if(Chunk < m_MapdownloadChunk || Chunk >= m_MapdownloadRequested || m_aMapdownloadReceived[Chunk%MAX_MAPDOWNLOAD_WINDOW])
 				return;
 
+			io_seek(m_MapdownloadFile, Chunk*MAP_CHUNK_SIZE, IOSEEK_START);
 			io_write(m_MapdownloadFile, pData, Size);
 
 			m_MapdownloadAmount += Size;
-
+			m_MapdownloadLastRecv = time_get();
+			m_aMapdownloadReceived[Chunk%MAX_MAPDOWNLOAD_WINDOW] = true;
 			if(Last)
+				m_MapdownloadChunkNum = Chunk+1;
+
+			// slide the window over everything that is complete
+			while(m_MapdownloadChunk < m_MapdownloadChunkNum && m_aMapdownloadReceived[m_MapdownloadChunk%MAX_MAPDOWNLOAD_WINDOW])
+			{
+				m_aMapdownloadReceived[m_MapdownloadChunk%MAX_MAPDOWNLOAD_WINDOW] = false;
+				m_MapdownloadChunk++;
+			}
+
+			if(m_MapdownloadChunk >= m_MapdownloadChunkNum)
 			{
 				const char *pError;
 				m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "client/network", "download complete, loading map");
@@ -1128,19 +1281,8 @@ void CClient::ProcessServerPacket(CNetChunk *pPacket)
 			}
 			else
 			{
-				// request new chunk
-				m_MapdownloadChunk++;
-
-				CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
-				Msg.AddInt(m_MapdownloadChunk);
-				SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
-
-				if(g_Config.m_Debug)
-				{
-					char aBuf[256];
-					str_format(aBuf, sizeof(aBuf), "requested chunk %d", m_MapdownloadChunk);
-					m_pConsole->Print(IConsole::OUTPUT_LEVEL_DEBUG, "client/network", aBuf);
-				}
+				// top up the chunks in flight
+				SendMapRequests();
 			}
 		}
 		else if(Msg == NETMSG_CON_READY)
@@ -1514,6 +1656,25 @@ void DemoPlayer()->SetPause(int paused)
 
 void CClient::Update()
 {
+	if(m_pMapGenJob && m_pMapGenJob->Status() == IJob::STATE_DONE)
+		FinishMapGen();
+
+	// map download, a request the server dropped is asked for again
+	if(m_MapdownloadFile && time_get() > m_MapdownloadLastRecv+time_freq()*2)
+	{
+		m_MapdownloadLastRecv = time_get();
+		for(int i = m_MapdownloadChunk; i < m_MapdownloadRequested; i++)
+		{
+			if(m_aMapdownloadReceived[i%MAX_MAPDOWNLOAD_WINDOW])
+				continue;
+
+			CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
+			Msg.AddInt(i);
+			SendMsgEx(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH);
+			break;
+		}
+	}
+
 	if(State() == IClient::STATE_DEMOPLAYBACK)
 	{
 		m_DemoPlayer.Update();
@@ -1724,9 +1885,17 @@ void CClient::Run()
 		atexit(SDL_Quit); // ignore_convention
 	}
 
+	// headless startup timing, everything but the window and the audio device
+	if(g_Config.m_DbgStartupTiming)
+	{
+		g_Config.m_GfxThreaded = 1;
+		g_Config.m_GfxNull = 1;
+		g_Config.m_SndNull = 1;
+	}
+
 	// init graphics
 	{
-		if(g_Config.m_GfxThreaded)
+		if(g_Config.m_GfxThreaded || g_Config.m_GfxNull)
 			m_pGraphics = CreateEngineGraphicsThreaded();
 		else
 			m_pGraphics = CreateEngineGraphics();
@@ -1782,12 +1951,22 @@ void CClient::Run()
 	if(!LoadData())
 		return;
 
+	int64 GameInitStart = time_get();
 	GameClient()->OnInit();
+	int64 GameInitEnd = time_get();
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "version %s", GameClient()->NetVersion());
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
 
+	if(g_Config.m_DbgStartupTiming)
+	{
+		str_format(aBuf, sizeof(aBuf), "startup took %.2fms, game assets %.2fms (%s loading)",
+			(GameInitEnd-m_LocalStartTime)*1000.0/time_freq(), (GameInitEnd-GameInitStart)*1000.0/time_freq(),
+			g_Config.m_ClParallelLoading ? "parallel" : "serial");
+		m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
+	}
+
 	// connect to the server if wanted
 	/*
 	if(config.cl_connect[0] != 0)
@@ -1806,7 +1985,7 @@ void CClient::Run()
 	// process pending commands
 	m_pConsole->StoreCommands(false);
 
-	while (1)
+	while (!g_Config.m_DbgStartupTiming)
 	{
 		//
 		VersionUpdate();
@@ -2051,6 +2230,22 @@ void CClient::Con_Screenshot(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Graphics()->TakeScreenshot(0);
 }
 
+void CClient::Con_SndBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	int NumVoices = pResult->NumArguments() > 0 ? clamp(pResult->GetInteger(0), 1, 1024) : 64;
+	int Runs = pResult->NumArguments() > 1 ? clamp(pResult->GetInteger(1), 1, 100000) : 1000;
+	pSelf->m_pSound->Benchmark(NumVoices, Runs, pSelf->m_pConsole);
+}
+
+void CClient::Con_BrBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CClient *pSelf = (CClient *)pUserData;
+	int NumServers = pResult->NumArguments() > 0 ? clamp(pResult->GetInteger(0), 1, 100000) : 10000;
+	int Runs = pResult->NumArguments() > 1 ? clamp(pResult->GetInteger(1), 1, 1000) : 10;
+	pSelf->m_ServerBrowser.Benchmark(NumServers, Runs);
+}
+
 void CClient::Con_Rcon(IConsole::IResult *pResult, void *pUserData)
 {
 	CClient *pSelf = (CClient *)pUserData;
@@ -2235,6 +2430,8 @@ void CClient::RegisterCommands()
 	m_pConsole->Register("disconnect", "", CFGFLAG_CLIENT, Con_Disconnect, this, "Disconnect from the server");
 	m_pConsole->Register("ping", "", CFGFLAG_CLIENT, Con_Ping, this, "Ping the current server");
 	m_pConsole->Register("screenshot", "", CFGFLAG_CLIENT, Con_Screenshot, this, "Take a screenshot");
+	m_pConsole->Register("snd_benchmark", "?i?i", CFGFLAG_CLIENT, Con_SndBenchmark, this, "Time the sound mixer without the audio device (voices, runs)");
+	m_pConsole->Register("br_benchmark", "?i?i", CFGFLAG_CLIENT, Con_BrBenchmark, this, "Time server browser sorting on a synthetic list (servers, runs)");
 	m_pConsole->Register("rcon", "r", CFGFLAG_CLIENT, Con_Rcon, this, "Send specified command to rcon");
 	m_pConsole->Register("rcon_auth", "s", CFGFLAG_CLIENT, Con_RconAuth, this, "Authenticate to rcon");
 	m_pConsole->Register("play", "r", CFGFLAG_CLIENT|CFGFLAG_STORE, Con_Play, this, "Play the file specified");
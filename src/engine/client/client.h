@@ -3,6 +3,8 @@
 #ifndef ENGINE_CLIENT_CLIENT_H
 #define ENGINE_CLIENT_CLIENT_H
 
+#include <memory>
+
 class CGraph
 {
 public:
@@ -69,6 +71,7 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	{
 		NUM_SNAPSHOT_TYPES=2,
 		PREDICTION_MARGIN=1000/50/2, // magic network prediction value
+		MAX_MAPDOWNLOAD_WINDOW=24, // keeps the chunks in flight well inside the resend buffer
 	};
 
 	class CNetClient m_NetClient;
@@ -120,11 +123,30 @@ class CClient : public IClient, public CDemoPlayer::IListner
 	char m_aMapdownloadFilename[256];
 	char m_aMapdownloadName[256];
 	IOHANDLE m_MapdownloadFile;
-	int m_MapdownloadChunk;
+	int m_MapdownloadChunk; // first chunk that didn't arrive yet
+	int m_MapdownloadChunkNum;
+	int m_MapdownloadRequested; // next chunk to ask for
+	bool m_aMapdownloadReceived[MAX_MAPDOWNLOAD_WINDOW];
+	int64 m_MapdownloadLastRecv;
 	int m_MapdownloadCrc;
 	int m_MapdownloadAmount;
 	int m_MapdownloadTotalsize;
 
+	// generated maps, the server tells how the level was made and we try
+	// to make the same one before falling back to downloading it
+	bool m_MapGenValid;
+	char m_aMapGenTemplate[128];
+	unsigned m_MapGenTemplateCrc;
+	int m_MapGenSeed;
+	int m_MapGenLevel;
+	int m_MapGenVersion;
+	char m_aMapGenGameType[32];
+	int m_MapGenSurvivalMode;
+	SHA256_DIGEST m_MapGenSha256;
+	int m_MapGenCrc;
+	int m_MapGenSize;
+	std::shared_ptr<class CMapGenJob> m_pMapGenJob;
+
 	// time
 	CSmoothTime m_GameTime;
 	CSmoothTime m_PredictedTime;
@@ -197,6 +219,10 @@ public:
 	void SendInfo();
 	void SendEnterGame();
 	void SendReady();
+	void SendMapRequests();
+	void StartMapDownload();
+	bool StartMapGen();
+	void FinishMapGen();
 
 	virtual bool RconAuthed() { return m_RconAuthed != 0; }
 	virtual bool UseTempRconCommands() { return m_UseTempRconCommands != 0; }
@@ -280,6 +306,8 @@ public:
 	static void Con_Minimize(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Ping(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Screenshot(IConsole::IResult *pResult, void *pUserData);
+	static void Con_SndBenchmark(IConsole::IResult *pResult, void *pUserData);
+	static void Con_BrBenchmark(IConsole::IResult *pResult, void *pUserData);
 	static void Con_Rcon(IConsole::IResult *pResult, void *pUserData);
 	static void Con_RconAuth(IConsole::IResult *pResult, void *pUserData);
 	static void Con_AddFavorite(IConsole::IResult *pResult, void *pUserData);
@@ -444,9 +444,7 @@ int CGraphics_OpenGL::LoadPNG(CImageInfo *pImg, const char *pFilename, int Stora
 	unsigned char *pBuffer;
 	png_t Png; // ignore_convention
 
-	// open file for reading
-	png_init(0,0); // ignore_convention
-
+	// open file for reading, this only decodes and is safe on worker threads
 	IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType, aCompleteFilename, sizeof(aCompleteFilename));
 	if(File)
 		io_close(File);
@@ -700,6 +698,64 @@ void CGraphics_OpenGL::QuadsDrawFreeform(const CFreeformItem *pArray, int Num)
 	AddVertices(4*Num);
 }
 
+void CGraphics_OpenGL::QuadsDrawBatch(const CBatchQuadItem *pArray, int Num)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawBatch without begin");
+
+	while(Num > 0)
+	{
+		// fill the vertex buffer as far as it goes, then flush
+		int Count = minimum(Num, (MAX_VERTICES-1)/4);
+		if(m_NumVertices + Count*4 >= MAX_VERTICES)
+			Flush();
+
+		CVertex *pVertex = &m_aVertices[m_NumVertices];
+		for(int i = 0; i < Count; ++i, pVertex += 4)
+		{
+			const CBatchQuadItem *pItem = &pArray[i];
+			float x0 = pItem->m_X - pItem->m_Width/2;
+			float y0 = pItem->m_Y - pItem->m_Height/2;
+			float x1 = x0 + pItem->m_Width;
+			float y1 = y0 + pItem->m_Height;
+
+			pVertex[0].m_Pos.x = x0; pVertex[0].m_Pos.y = y0;
+			pVertex[1].m_Pos.x = x1; pVertex[1].m_Pos.y = y0;
+			pVertex[2].m_Pos.x = x1; pVertex[2].m_Pos.y = y1;
+			pVertex[3].m_Pos.x = x0; pVertex[3].m_Pos.y = y1;
+
+			pVertex[0].m_Tex.u = pItem->m_U0; pVertex[0].m_Tex.v = pItem->m_V0;
+			pVertex[1].m_Tex.u = pItem->m_U1; pVertex[1].m_Tex.v = pItem->m_V0;
+			pVertex[2].m_Tex.u = pItem->m_U1; pVertex[2].m_Tex.v = pItem->m_V1;
+			pVertex[3].m_Tex.u = pItem->m_U0; pVertex[3].m_Tex.v = pItem->m_V1;
+
+			for(int v = 0; v < 4; v++)
+			{
+				pVertex[v].m_Color.r = pItem->m_R;
+				pVertex[v].m_Color.g = pItem->m_G;
+				pVertex[v].m_Color.b = pItem->m_B;
+				pVertex[v].m_Color.a = pItem->m_A;
+			}
+
+			if(pItem->m_Rotation != 0)
+			{
+				float c = cosf(pItem->m_Rotation);
+				float s = sinf(pItem->m_Rotation);
+				for(int v = 0; v < 4; v++)
+				{
+					float x = pVertex[v].m_Pos.x - pItem->m_X;
+					float y = pVertex[v].m_Pos.y - pItem->m_Y;
+					pVertex[v].m_Pos.x = x * c - y * s + pItem->m_X;
+					pVertex[v].m_Pos.y = x * s + y * c + pItem->m_Y;
+				}
+			}
+		}
+
+		m_NumVertices += Count*4;
+		pArray += Count;
+		Num -= Count;
+	}
+}
+
 void CGraphics_OpenGL::QuadsText(float x, float y, float Size, const char *pText)
 {
 	float StartX = x;
@@ -729,6 +785,70 @@ void CGraphics_OpenGL::QuadsText(float x, float y, float Size, const char *pText
 	}
 }
 
+int CGraphics_OpenGL::CreateQuadBuffer(const CQuadVertex *pVertices, int NumQuads)
+{
+	if(NumQuads <= 0 || m_FirstFreeQuadBuffer < 0)
+		return -1;
+
+	// grab buffer
+	int Buffer = m_FirstFreeQuadBuffer;
+	CQuadBuffer *pBuffer = &m_aQuadBuffers[Buffer];
+	m_FirstFreeQuadBuffer = pBuffer->m_Next;
+	pBuffer->m_Next = -1;
+
+	int NumVertices = NumQuads*4;
+	pBuffer->m_pVertices = (CQuadBuffer::CBufferVertex *)mem_alloc(NumVertices*sizeof(CQuadBuffer::CBufferVertex), sizeof(void*));
+	pBuffer->m_NumQuads = NumQuads;
+	for(int i = 0; i < NumVertices; i++)
+	{
+		pBuffer->m_pVertices[i].m_Pos.x = pVertices[i].m_X;
+		pBuffer->m_pVertices[i].m_Pos.y = pVertices[i].m_Y;
+		pBuffer->m_pVertices[i].m_Pos.z = -5.0f;
+		pBuffer->m_pVertices[i].m_Tex.u = pVertices[i].m_U;
+		pBuffer->m_pVertices[i].m_Tex.v = pVertices[i].m_V;
+	}
+
+	return Buffer;
+}
+
+void CGraphics_OpenGL::DestroyQuadBuffer(int BufferID)
+{
+	if(BufferID < 0 || BufferID >= MAX_QUADBUFFERS)
+		return;
+
+	CQuadBuffer *pBuffer = &m_aQuadBuffers[BufferID];
+	if(pBuffer->m_pVertices)
+		mem_free(pBuffer->m_pVertices);
+	pBuffer->m_pVertices = 0;
+	pBuffer->m_NumQuads = 0;
+
+	pBuffer->m_Next = m_FirstFreeQuadBuffer;
+	m_FirstFreeQuadBuffer = BufferID;
+}
+
+void CGraphics_OpenGL::RenderQuadBuffer(int BufferID, int FirstQuad, int NumQuads, float r, float g, float b, float a)
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->RenderQuadBuffer within begin");
+	if(BufferID < 0 || BufferID >= MAX_QUADBUFFERS || NumQuads <= 0)
+		return;
+
+	const CQuadBuffer *pBuffer = &m_aQuadBuffers[BufferID];
+	if(!pBuffer->m_pVertices || FirstQuad+NumQuads > pBuffer->m_NumQuads || !m_RenderEnable)
+		return;
+
+	glVertexPointer(3, GL_FLOAT, sizeof(CQuadBuffer::CBufferVertex), (char*)pBuffer->m_pVertices);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(CQuadBuffer::CBufferVertex), (char*)pBuffer->m_pVertices + sizeof(float)*3);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glColor4f(r, g, b, a);
+
+	glDrawArrays(GL_QUADS, FirstQuad*4, NumQuads*4);
+
+	// Flush expects the color array to be on
+	glEnableClientState(GL_COLOR_ARRAY);
+}
+
 int CGraphics_OpenGL::Init()
 {
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
@@ -744,6 +864,19 @@ int CGraphics_OpenGL::Init()
 		m_aTextures[i].m_Next = i+1;
 	m_aTextures[MAX_TEXTURES-1].m_Next = -1;
 
+	// init quad buffers
+	m_FirstFreeQuadBuffer = 0;
+	for(int i = 0; i < MAX_QUADBUFFERS; i++)
+	{
+		m_aQuadBuffers[i].m_pVertices = 0;
+		m_aQuadBuffers[i].m_NumQuads = 0;
+		m_aQuadBuffers[i].m_Next = i+1;
+	}
+	m_aQuadBuffers[MAX_QUADBUFFERS-1].m_Next = -1;
+
+	// png decoding may run on worker threads, set the allocators up once here
+	png_init(0,0); // ignore_convention
+
 	// set some default settings
 	glEnable(GL_BLEND);
 	glDisable(GL_CULL_FACE);
@@ -25,6 +25,7 @@ protected:
 	{
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_QUADBUFFERS = 1024*4,
 
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -62,6 +63,20 @@ protected:
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	struct CQuadBuffer
+	{
+		struct CBufferVertex
+		{
+			CPoint m_Pos;
+			CTexCoord m_Tex;
+		} *m_pVertices;
+		int m_NumQuads;
+		int m_Next;
+	};
+
+	CQuadBuffer m_aQuadBuffers[MAX_QUADBUFFERS];
+	int m_FirstFreeQuadBuffer;
+
 	void Flush();
 	void AddVertices(int Count);
 	void Rotate4(const CPoint &rCenter, CVertex *pPoints);
@@ -119,8 +134,13 @@ public:
 	virtual void QuadsDraw(CQuadItem *pArray, int Num);
 	virtual void QuadsDrawTL(const CQuadItem *pArray, int Num);
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
+	virtual void QuadsDrawBatch(const CBatchQuadItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual int CreateQuadBuffer(const CQuadVertex *pVertices, int NumQuads);
+	virtual void DestroyQuadBuffer(int BufferID);
+	virtual void RenderQuadBuffer(int BufferID, int FirstQuad, int NumQuads, float r, float g, float b, float a);
+
 	virtual int Init();
 };
 
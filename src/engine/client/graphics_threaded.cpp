@@ -394,9 +394,7 @@ int CGraphics_Threaded::LoadPNG(CImageInfo *pImg, const char *pFilename, int Sto
 	unsigned char *pBuffer;
 	png_t Png; // ignore_convention
 
-	// open file for reading
-	png_init(0,0); // ignore_convention
-
+	// open file for reading, this only decodes and is safe on worker threads
 	IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType, aCompleteFilename, sizeof(aCompleteFilename));
 	if(File)
 		io_close(File);
@@ -648,6 +646,64 @@ void CGraphics_Threaded::QuadsDrawFreeform(const CFreeformItem *pArray, int Num)
 	AddVertices(4*Num);
 }
 
+void CGraphics_Threaded::QuadsDrawBatch(const CBatchQuadItem *pArray, int Num)
+{
+	dbg_assert(m_Drawing == DRAWING_QUADS, "called Graphics()->QuadsDrawBatch without begin");
+
+	while(Num > 0)
+	{
+		// fill the vertex buffer as far as it goes, then flush
+		int Count = minimum(Num, (MAX_VERTICES-1)/4);
+		if(m_NumVertices + Count*4 >= MAX_VERTICES)
+			FlushVertices();
+
+		CCommandBuffer::SVertex *pVertex = &m_aVertices[m_NumVertices];
+		for(int i = 0; i < Count; ++i, pVertex += 4)
+		{
+			const CBatchQuadItem *pItem = &pArray[i];
+			float x0 = pItem->m_X - pItem->m_Width/2;
+			float y0 = pItem->m_Y - pItem->m_Height/2;
+			float x1 = x0 + pItem->m_Width;
+			float y1 = y0 + pItem->m_Height;
+
+			pVertex[0].m_Pos.x = x0; pVertex[0].m_Pos.y = y0;
+			pVertex[1].m_Pos.x = x1; pVertex[1].m_Pos.y = y0;
+			pVertex[2].m_Pos.x = x1; pVertex[2].m_Pos.y = y1;
+			pVertex[3].m_Pos.x = x0; pVertex[3].m_Pos.y = y1;
+
+			pVertex[0].m_Tex.u = pItem->m_U0; pVertex[0].m_Tex.v = pItem->m_V0;
+			pVertex[1].m_Tex.u = pItem->m_U1; pVertex[1].m_Tex.v = pItem->m_V0;
+			pVertex[2].m_Tex.u = pItem->m_U1; pVertex[2].m_Tex.v = pItem->m_V1;
+			pVertex[3].m_Tex.u = pItem->m_U0; pVertex[3].m_Tex.v = pItem->m_V1;
+
+			for(int v = 0; v < 4; v++)
+			{
+				pVertex[v].m_Color.r = pItem->m_R;
+				pVertex[v].m_Color.g = pItem->m_G;
+				pVertex[v].m_Color.b = pItem->m_B;
+				pVertex[v].m_Color.a = pItem->m_A;
+			}
+
+			if(pItem->m_Rotation != 0)
+			{
+				float c = cosf(pItem->m_Rotation);
+				float s = sinf(pItem->m_Rotation);
+				for(int v = 0; v < 4; v++)
+				{
+					float x = pVertex[v].m_Pos.x - pItem->m_X;
+					float y = pVertex[v].m_Pos.y - pItem->m_Y;
+					pVertex[v].m_Pos.x = x * c - y * s + pItem->m_X;
+					pVertex[v].m_Pos.y = x * s + y * c + pItem->m_Y;
+				}
+			}
+		}
+
+		m_NumVertices += Count*4;
+		pArray += Count;
+		Num -= Count;
+	}
+}
+
 void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pText)
 {
 	float StartX = x;
@@ -677,6 +733,78 @@ void CGraphics_Threaded::QuadsText(float x, float y, float Size, const char *pTe
 	}
 }
 
+int CGraphics_Threaded::CreateQuadBuffer(const CQuadVertex *pVertices, int NumQuads)
+{
+	if(NumQuads <= 0 || m_FirstFreeQuadBuffer < 0)
+		return -1;
+
+	// grab buffer
+	int Buffer = m_FirstFreeQuadBuffer;
+	m_FirstFreeQuadBuffer = m_aQuadBufferIndices[Buffer];
+	m_aQuadBufferIndices[Buffer] = -1;
+
+	CCommandBuffer::SCommand_QuadBuffer_Create Cmd;
+	Cmd.m_Slot = Buffer;
+	Cmd.m_NumQuads = NumQuads;
+
+	// copy the geometry, the backend keeps it from here on
+	int MemSize = NumQuads*4*sizeof(CQuadVertex);
+	void *pTmpData = mem_alloc(MemSize, sizeof(void*));
+	mem_copy(pTmpData, pVertices, MemSize);
+	Cmd.m_pData = pTmpData;
+
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	return Buffer;
+}
+
+void CGraphics_Threaded::DestroyQuadBuffer(int BufferID)
+{
+	if(BufferID < 0 || BufferID >= MAX_QUADBUFFERS)
+		return;
+
+	CCommandBuffer::SCommand_QuadBuffer_Destroy Cmd;
+	Cmd.m_Slot = BufferID;
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		KickCommandBuffer();
+		m_pCommandBuffer->AddCommand(Cmd);
+	}
+
+	m_aQuadBufferIndices[BufferID] = m_FirstFreeQuadBuffer;
+	m_FirstFreeQuadBuffer = BufferID;
+}
+
+void CGraphics_Threaded::RenderQuadBuffer(int BufferID, int FirstQuad, int NumQuads, float r, float g, float b, float a)
+{
+	dbg_assert(m_Drawing == 0, "called Graphics()->RenderQuadBuffer within begin");
+	if(BufferID < 0 || NumQuads <= 0)
+		return;
+
+	CCommandBuffer::SCommand_RenderQuadBuffer Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_Slot = BufferID;
+	Cmd.m_FirstQuad = FirstQuad;
+	Cmd.m_NumQuads = NumQuads;
+	Cmd.m_Color.r = r;
+	Cmd.m_Color.g = g;
+	Cmd.m_Color.b = b;
+	Cmd.m_Color.a = a;
+
+	// check if we have enough free memory in the commandbuffer
+	if(!m_pCommandBuffer->AddCommand(Cmd))
+	{
+		// kick command buffer and try again
+		KickCommandBuffer();
+		if(!m_pCommandBuffer->AddCommand(Cmd))
+			dbg_msg("graphics", "failed to allocate memory for render command");
+	}
+}
+
 int CGraphics_Threaded::IssueInit()
 {
 	int Flags = 0;
@@ -745,7 +873,16 @@ int CGraphics_Threaded::Init()
 		m_aTextureIndices[i] = i+1;
 	m_aTextureIndices[MAX_TEXTURES-1] = -1;
 
-	m_pBackend = CreateGraphicsBackend();
+	// init quad buffers
+	m_FirstFreeQuadBuffer = 0;
+	for(int i = 0; i < MAX_QUADBUFFERS-1; i++)
+		m_aQuadBufferIndices[i] = i+1;
+	m_aQuadBufferIndices[MAX_QUADBUFFERS-1] = -1;
+
+	// png decoding may run on worker threads, set the allocators up once here
+	png_init(0,0); // ignore_convention
+
+	m_pBackend = g_Config.m_GfxNull ? CreateGraphicsBackendNull() : CreateGraphicsBackend();
 	if(InitWindow() != 0)
 		return -1;
 
@@ -51,6 +51,7 @@ public:
 	enum
 	{
 		MAX_TEXTURES=1024*4,
+		MAX_QUADBUFFERS=1024*4,
 	};
 
 	enum
@@ -74,9 +75,14 @@ public:
 		CMD_TEXTURE_DESTROY,
 		CMD_TEXTURE_UPDATE,
 
+		// static geometry commands
+		CMD_QUADBUFFER_CREATE,
+		CMD_QUADBUFFER_DESTROY,
+
 		// rendering
 		CMD_CLEAR,
 		CMD_RENDER,
+		CMD_RENDER_QUADBUFFER,
 
 		// swap
 		CMD_SWAP,
@@ -182,6 +188,16 @@ public:
 		SVertex *m_pVertices; // you should use the command buffer data to allocate vertices for this command
 	};
 
+	struct SCommand_RenderQuadBuffer : public SCommand
+	{
+		SCommand_RenderQuadBuffer() : SCommand(CMD_RENDER_QUADBUFFER) {}
+		SState m_State;
+		int m_Slot;
+		unsigned m_FirstQuad;
+		unsigned m_NumQuads;
+		SColor m_Color;
+	};
+
 	struct SCommand_Screenshot : public SCommand
 	{
 		SCommand_Screenshot() : SCommand(CMD_SCREENSHOT) {}
@@ -243,6 +259,22 @@ public:
 		// texture information
 		int m_Slot;
 	};
+
+	struct SCommand_QuadBuffer_Create : public SCommand
+	{
+		SCommand_QuadBuffer_Create() : SCommand(CMD_QUADBUFFER_CREATE) {}
+
+		int m_Slot;
+		int m_NumQuads;
+		void *m_pData; // IGraphics::CQuadVertex, four per quad. will be freed by the command processor
+	};
+
+	struct SCommand_QuadBuffer_Destroy : public SCommand
+	{
+		SCommand_QuadBuffer_Destroy() : SCommand(CMD_QUADBUFFER_DESTROY) {}
+
+		int m_Slot;
+	};
 	
 	//
 	CCommandBuffer(unsigned CmdBufferSize, unsigned DataBufferSize)
@@ -325,6 +357,7 @@ class CGraphics_Threaded : public IEngineGraphics
 
 		MAX_VERTICES = 32*1024,
 		MAX_TEXTURES = 1024*4,
+		MAX_QUADBUFFERS = 1024*4,
 		
 		DRAWING_QUADS=1,
 		DRAWING_LINES=2
@@ -360,6 +393,9 @@ class CGraphics_Threaded : public IEngineGraphics
 	int m_FirstFreeTexture;
 	int m_TextureMemoryUsage;
 
+	int m_aQuadBufferIndices[MAX_QUADBUFFERS];
+	int m_FirstFreeQuadBuffer;
+
 	void FlushVertices();
 	void AddVertices(int Count);
 	void Rotate4(const CCommandBuffer::SPoint &rCenter, CCommandBuffer::SVertex *pPoints);
@@ -419,8 +455,13 @@ public:
 	virtual void QuadsDraw(CQuadItem *pArray, int Num);
 	virtual void QuadsDrawTL(const CQuadItem *pArray, int Num);
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num);
+	virtual void QuadsDrawBatch(const CBatchQuadItem *pArray, int Num);
 	virtual void QuadsText(float x, float y, float Size, const char *pText);
 
+	virtual int CreateQuadBuffer(const CQuadVertex *pVertices, int NumQuads);
+	virtual void DestroyQuadBuffer(int BufferID);
+	virtual void RenderQuadBuffer(int BufferID, int FirstQuad, int NumQuads, float r, float g, float b, float a);
+
 	virtual void Minimize();
 	virtual void Maximize();
 
@@ -442,3 +483,4 @@ public:
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
+extern IGraphicsBackend *CreateGraphicsBackendNull();
@@ -26,7 +26,7 @@ class SortWrap
 	CServerBrowser *m_pThis;
 public:
 	SortWrap(CServerBrowser *t, SortFunc f) : m_pfnSort(f), m_pThis(t) {}
-	bool operator()(int a, int b) { return (g_Config.m_BrSortOrder ? (m_pThis->*m_pfnSort)(b, a) : (m_pThis->*m_pfnSort)(a, b)); }
+	bool operator()(int a, int b) { return (m_pThis->*m_pfnSort)(a, b); }
 };
 
 CServerBrowser::CServerBrowser()
@@ -34,6 +34,11 @@ CServerBrowser::CServerBrowser()
 	m_pMasterServer = 0;
 	m_ppServerlist = 0;
 	m_pSortedServerlist = 0;
+	m_pSortScratch = 0;
+
+	m_SortKey = -1;
+	m_pfnSortCompare = 0;
+	m_SortDescending = false;
 
 	m_NumFavoriteServers = 0;
 
@@ -61,6 +66,17 @@ CServerBrowser::CServerBrowser()
 	m_BroadcastTime = 0;
 }
 
+CServerBrowser::~CServerBrowser()
+{
+	if(m_ppServerlist)
+		mem_free(m_ppServerlist);
+	if(m_pSortedServerlist)
+		mem_free(m_pSortedServerlist);
+	if(m_pSortScratch)
+		mem_free(m_pSortScratch);
+	m_ServerlistHeap.Reset();
+}
+
 void CServerBrowser::SetBaseInfo(class CNetClient *pClient, const char *pNetVersion)
 {
 	m_pNetClient = pClient;
@@ -81,181 +97,188 @@ const CServerInfo *CServerBrowser::SortedGet(int Index) const
 }
 
 
-bool CServerBrowser::SortCompareName(int Index1, int Index2) const
+void CServerBrowser::LowerKey(char *pDst, const char *pSrc, int DstSize)
+{
+	// ascii only, utf-8 sequences pass through unchanged
+	int i = 0;
+	for(; i < DstSize-1 && pSrc[i]; i++)
+		pDst[i] = (pSrc[i] >= 'A' && pSrc[i] <= 'Z') ? pSrc[i]-'A'+'a' : pSrc[i];
+	pDst[i] = 0;
+}
+
+int CServerBrowser::SortCompareName(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
 	//	make sure empty entries are listed last
-	return (a->m_GotInfo && b->m_GotInfo) || (!a->m_GotInfo && !b->m_GotInfo) ? str_comp(a->m_Info.m_aName, b->m_Info.m_aName) < 0 :
-			a->m_GotInfo ? true : false;
+	if(a->m_GotInfo != b->m_GotInfo)
+		return a->m_GotInfo ? -1 : 1;
+	int Result = str_comp(a->m_aNameKey, b->m_aNameKey);
+	return Result ? Result : str_comp(a->m_Info.m_aName, b->m_Info.m_aName);
 }
 
-bool CServerBrowser::SortCompareMap(int Index1, int Index2) const
+int CServerBrowser::SortCompareMap(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
-	return str_comp(a->m_Info.m_aMap, b->m_Info.m_aMap) < 0;
+	int Result = str_comp(a->m_aMapKey, b->m_aMapKey);
+	return Result ? Result : str_comp(a->m_Info.m_aMap, b->m_Info.m_aMap);
 }
 
-bool CServerBrowser::SortComparePing(int Index1, int Index2) const
+int CServerBrowser::SortComparePing(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
-	return a->m_Info.m_Latency < b->m_Info.m_Latency;
+	return a->m_Info.m_Latency - b->m_Info.m_Latency;
 }
 
-bool CServerBrowser::SortCompareGametype(int Index1, int Index2) const
+int CServerBrowser::SortCompareGametype(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
-	return str_comp(a->m_Info.m_aGameType, b->m_Info.m_aGameType) < 0;
+	int Result = str_comp(a->m_aGameTypeKey, b->m_aGameTypeKey);
+	return Result ? Result : str_comp(a->m_Info.m_aGameType, b->m_Info.m_aGameType);
 }
 
-bool CServerBrowser::SortCompareNumPlayers(int Index1, int Index2) const
+int CServerBrowser::SortCompareNumPlayers(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
-	return a->m_Info.m_NumPlayers < b->m_Info.m_NumPlayers;
+	return a->m_Info.m_NumPlayers - b->m_Info.m_NumPlayers;
 }
 
-bool CServerBrowser::SortCompareNumClients(int Index1, int Index2) const
+int CServerBrowser::SortCompareNumClients(int Index1, int Index2) const
 {
 	CServerEntry *a = m_ppServerlist[Index1];
 	CServerEntry *b = m_ppServerlist[Index2];
-	return a->m_Info.m_NumClients < b->m_Info.m_NumClients;
+	return a->m_Info.m_NumClients - b->m_Info.m_NumClients;
 }
 
-void CServerBrowser::Filter()
+bool CServerBrowser::SortLess(int Index1, int Index2) const
 {
-	int i = 0, p = 0;
-	m_NumSortedServers = 0;
+	int Result = m_pfnSortCompare ? (this->*m_pfnSortCompare)(Index1, Index2) : 0;
+	if(m_SortDescending)
+		Result = -Result;
+
+	// ties keep the list order, so single inserts land where a full sort would put them
+	return Result ? Result < 0 : Index1 < Index2;
+}
 
-	// allocate the sorted list
-	if(m_NumSortedServersCapacity < m_NumServers)
+bool CServerBrowser::Filtered(CServerEntry *pEntry)
+{
+	int Filtered = 0;
+	int p = 0;
+
+	if(g_Config.m_BrFilterEmpty && ((g_Config.m_BrFilterSpectators && pEntry->m_Info.m_NumPlayers == 0) || pEntry->m_Info.m_NumClients == 0))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterFull && ((g_Config.m_BrFilterSpectators && pEntry->m_Info.m_NumPlayers == pEntry->m_Info.m_MaxPlayers) ||
+			pEntry->m_Info.m_NumClients == pEntry->m_Info.m_MaxClients))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPw && pEntry->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterPure &&
+		(str_comp(pEntry->m_Info.m_aGameType, "CSTT") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "CSBB") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "DM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "TDM") != 0 &&
+		str_comp(pEntry->m_Info.m_aGameType, "CTF") != 0))
 	{
-		if(m_pSortedServerlist)
-			mem_free(m_pSortedServerlist);
-		m_NumSortedServersCapacity = m_NumServers;
-		m_pSortedServerlist = (int *)mem_alloc(m_NumSortedServersCapacity*sizeof(int), 1);
+		Filtered = 1;
 	}
-
-	// filter the servers
-	for(i = 0; i < m_NumServers; i++)
+	else if(g_Config.m_BrFilterPureMap &&
+		!(str_comp(pEntry->m_Info.m_aMap, "dm1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm7") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm8") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "dm9") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf1") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf2") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf3") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf4") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf5") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf6") == 0 ||
+		str_comp(pEntry->m_Info.m_aMap, "ctf7") == 0)
+	)
 	{
-		int Filtered = 0;
-
-		if(g_Config.m_BrFilterEmpty && ((g_Config.m_BrFilterSpectators && m_ppServerlist[i]->m_Info.m_NumPlayers == 0) || m_ppServerlist[i]->m_Info.m_NumClients == 0))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterFull && ((g_Config.m_BrFilterSpectators && m_ppServerlist[i]->m_Info.m_NumPlayers == m_ppServerlist[i]->m_Info.m_MaxPlayers) ||
-				m_ppServerlist[i]->m_Info.m_NumClients == m_ppServerlist[i]->m_Info.m_MaxClients))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPw && m_ppServerlist[i]->m_Info.m_Flags&SERVER_FLAG_PASSWORD)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterPure &&
-			(str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "CSTT") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "CSBB") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "DM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "TDM") != 0 &&
-			str_comp(m_ppServerlist[i]->m_Info.m_aGameType, "CTF") != 0))
-		{
-			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPureMap &&
-			!(str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm7") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm8") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "dm9") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf1") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf2") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf3") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf4") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf5") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf6") == 0 ||
-			str_comp(m_ppServerlist[i]->m_Info.m_aMap, "ctf7") == 0)
-		)
+		Filtered = 1;
+	}
+	else if(g_Config.m_BrFilterPing < pEntry->m_Info.m_Latency)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterCompatversion && str_comp_num(pEntry->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
+		Filtered = 1;
+	else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(pEntry->m_Info.m_aAddress, g_Config.m_BrFilterServerAddress))
+		Filtered = 1;
+	else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(pEntry->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = 1;
+	else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_find_nocase(pEntry->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
+		Filtered = 1;
+	else
+	{
+		if(g_Config.m_BrFilterCountry)
 		{
 			Filtered = 1;
-		}
-		else if(g_Config.m_BrFilterPing < m_ppServerlist[i]->m_Info.m_Latency)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterCompatversion && str_comp_num(m_ppServerlist[i]->m_Info.m_aVersion, m_aNetVersion, 3) != 0)
-			Filtered = 1;
-		else if(g_Config.m_BrFilterServerAddress[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aAddress, g_Config.m_BrFilterServerAddress))
-			Filtered = 1;
-		else if(g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && str_comp_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else if(!g_Config.m_BrFilterGametypeStrict && g_Config.m_BrFilterGametype[0] && !str_find_nocase(m_ppServerlist[i]->m_Info.m_aGameType, g_Config.m_BrFilterGametype))
-			Filtered = 1;
-		else
-		{
-			if(g_Config.m_BrFilterCountry)
+			// match against player country
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
 			{
-				Filtered = 1;
-				// match against player country
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+				if(pEntry->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
 				{
-					if(m_ppServerlist[i]->m_Info.m_aClients[p].m_Country == g_Config.m_BrFilterCountryIndex)
-					{
-						Filtered = 0;
-						break;
-					}
+					Filtered = 0;
+					break;
 				}
 			}
+		}
 
-			if(!Filtered && g_Config.m_BrFilterString[0] != 0)
-			{
-				int MatchFound = 0;
-
-				m_ppServerlist[i]->m_Info.m_QuickSearchHit = 0;
+		if(!Filtered && g_Config.m_BrFilterString[0] != 0)
+		{
+			int MatchFound = 0;
 
-				// match against server name
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aName, g_Config.m_BrFilterString))
-				{
-					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
-				}
+			pEntry->m_Info.m_QuickSearchHit = 0;
 
-				// match against players
-				for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
-				{
-					if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName, g_Config.m_BrFilterString) ||
-						str_find_nocase(m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan, g_Config.m_BrFilterString))
-					{
-						MatchFound = 1;
-						m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
-						break;
-					}
-				}
+			// match against server name
+			if(str_find_nocase(pEntry->m_Info.m_aName, g_Config.m_BrFilterString))
+			{
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_SERVERNAME;
+			}
 
-				// match against map
-				if(str_find_nocase(m_ppServerlist[i]->m_Info.m_aMap, g_Config.m_BrFilterString))
+			// match against players
+			for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+			{
+				if(str_find_nocase(pEntry->m_Info.m_aClients[p].m_aName, g_Config.m_BrFilterString) ||
+					str_find_nocase(pEntry->m_Info.m_aClients[p].m_aClan, g_Config.m_BrFilterString))
 				{
 					MatchFound = 1;
-					m_ppServerlist[i]->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
+					pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_PLAYER;
+					break;
 				}
-
-				if(!MatchFound)
-					Filtered = 1;
 			}
-		}
 
-		if(Filtered == 0)
-		{
-			// check for friend
-			m_ppServerlist[i]->m_Info.m_FriendState = IFriends::FRIEND_NO;
-			for(p = 0; p < m_ppServerlist[i]->m_Info.m_NumClients; p++)
+			// match against map
+			if(str_find_nocase(pEntry->m_Info.m_aMap, g_Config.m_BrFilterString))
 			{
-				m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(m_ppServerlist[i]->m_Info.m_aClients[p].m_aName,
-					m_ppServerlist[i]->m_Info.m_aClients[p].m_aClan);
-				m_ppServerlist[i]->m_Info.m_FriendState = max(m_ppServerlist[i]->m_Info.m_FriendState, m_ppServerlist[i]->m_Info.m_aClients[p].m_FriendState);
+				MatchFound = 1;
+				pEntry->m_Info.m_QuickSearchHit |= IServerBrowser::QUICK_MAPNAME;
 			}
 
-			if(!g_Config.m_BrFilterFriends || m_ppServerlist[i]->m_Info.m_FriendState != IFriends::FRIEND_NO)
-				m_pSortedServerlist[m_NumSortedServers++] = i;
+			if(!MatchFound)
+				Filtered = 1;
 		}
 	}
+
+	if(Filtered)
+		return true;
+
+	// check for friend
+	pEntry->m_Info.m_FriendState = IFriends::FRIEND_NO;
+	for(p = 0; p < pEntry->m_Info.m_NumClients; p++)
+	{
+		pEntry->m_Info.m_aClients[p].m_FriendState = m_pFriends->GetFriendState(pEntry->m_Info.m_aClients[p].m_aName,
+			pEntry->m_Info.m_aClients[p].m_aClan);
+		pEntry->m_Info.m_FriendState = max(pEntry->m_Info.m_FriendState, pEntry->m_Info.m_aClients[p].m_FriendState);
+	}
+
+	return g_Config.m_BrFilterFriends && pEntry->m_Info.m_FriendState == IFriends::FRIEND_NO;
 }
 
 int CServerBrowser::SortHash() const
@@ -276,27 +299,97 @@ int CServerBrowser::SortHash() const
 	return i;
 }
 
+int CServerBrowser::SortKey() const
+{
+	// only what changes the order, the rest is handled by refiltering
+	int i = g_Config.m_BrSort&0xff;
+	i |= g_Config.m_BrSortOrder<<8;
+	i |= g_Config.m_BrFilterSpectators<<9;
+	return i;
+}
+
+bool CServerBrowser::SortUpToDate() const
+{
+	return m_Sorthash == SortHash() && str_comp(m_aFilterString, g_Config.m_BrFilterString) == 0 &&
+		str_comp(m_aFilterGametypeString, g_Config.m_BrFilterGametype) == 0;
+}
+
+void CServerBrowser::AllocSortedList()
+{
+	if(m_NumSortedServersCapacity >= m_NumServers)
+		return;
+
+	int Capacity = max(m_NumServers, m_NumSortedServersCapacity*2);
+	int *pNewList = (int *)mem_alloc(Capacity*sizeof(int), 1);
+	if(m_pSortedServerlist)
+	{
+		mem_copy(pNewList, m_pSortedServerlist, m_NumSortedServers*sizeof(int));
+		mem_free(m_pSortedServerlist);
+	}
+	if(m_pSortScratch)
+		mem_free(m_pSortScratch);
+	m_pSortedServerlist = pNewList;
+	m_pSortScratch = (int *)mem_alloc(Capacity*sizeof(int), 1);
+	m_NumSortedServersCapacity = Capacity;
+}
+
 void CServerBrowser::Sort()
 {
 	int i;
 
-	// create filtered list
-	Filter();
+	AllocSortedList();
+
+	// refilter, the servers that stay visible keep their order
+	int NumKept = 0;
+	for(i = 0; i < m_NumSortedServers; i++)
+	{
+		CServerEntry *pEntry = m_ppServerlist[m_pSortedServerlist[i]];
+		if(Filtered(pEntry))
+			pEntry->m_Info.m_SortedIndex = -2;
+		else
+			m_pSortedServerlist[NumKept++] = m_pSortedServerlist[i];
+	}
+
+	// the ones that were hidden only need to be checked again
+	int NumNew = 0;
+	for(i = 0; i < m_NumServers; i++)
+	{
+		if(m_ppServerlist[i]->m_Info.m_SortedIndex == -1 && !Filtered(m_ppServerlist[i]))
+			m_pSortScratch[NumNew++] = i;
+	}
+	mem_copy(m_pSortedServerlist+NumKept, m_pSortScratch, NumNew*sizeof(int));
+	m_NumSortedServers = NumKept+NumNew;
 
 	// sort
+	int NewSortKey = SortKey();
+	bool Resort = NewSortKey != m_SortKey;
+	m_SortKey = NewSortKey;
+	m_SortDescending = g_Config.m_BrSortOrder != 0;
 	if(g_Config.m_BrSort == IServerBrowser::SORT_NAME)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareName));
+		m_pfnSortCompare = &CServerBrowser::SortCompareName;
 	else if(g_Config.m_BrSort == IServerBrowser::SORT_PING)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortComparePing));
+		m_pfnSortCompare = &CServerBrowser::SortComparePing;
 	else if(g_Config.m_BrSort == IServerBrowser::SORT_MAP)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareMap));
+		m_pfnSortCompare = &CServerBrowser::SortCompareMap;
 	else if(g_Config.m_BrSort == IServerBrowser::SORT_NUMPLAYERS)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this,
-					g_Config.m_BrFilterSpectators ? &CServerBrowser::SortCompareNumPlayers : &CServerBrowser::SortCompareNumClients));
+		m_pfnSortCompare = g_Config.m_BrFilterSpectators ? &CServerBrowser::SortCompareNumPlayers : &CServerBrowser::SortCompareNumClients;
 	else if(g_Config.m_BrSort == IServerBrowser::SORT_GAMETYPE)
-		std::stable_sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortCompareGametype));
+		m_pfnSortCompare = &CServerBrowser::SortCompareGametype;
+	else
+		m_pfnSortCompare = 0;
+
+	if(Resort)
+		std::sort(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortLess));
+	else if(NumNew)
+	{
+		// the kept part is still in order, sort the newcomers and merge them in
+		std::sort(m_pSortedServerlist+NumKept, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortLess));
+		std::inplace_merge(m_pSortedServerlist, m_pSortedServerlist+NumKept, m_pSortedServerlist+m_NumSortedServers, SortWrap(this, &CServerBrowser::SortLess));
+	}
 
 	// set indexes
+	for(i = 0; i < m_NumServers; i++)
+		m_ppServerlist[i]->m_Info.m_SortedIndex = -1;
 	for(i = 0; i < m_NumSortedServers; i++)
 		m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
 
@@ -305,6 +398,40 @@ void CServerBrowser::Sort()
 	m_Sorthash = SortHash();
 }
 
+void CServerBrowser::SortEntry(CServerEntry *pEntry)
+{
+	int Index = pEntry->m_Info.m_ServerIndex;
+	int OldPos = pEntry->m_Info.m_SortedIndex;
+	int NewPos = -1;
+
+	AllocSortedList();
+
+	// take it out
+	if(OldPos >= 0)
+	{
+		mem_move(&m_pSortedServerlist[OldPos], &m_pSortedServerlist[OldPos+1], (m_NumSortedServers-OldPos-1)*sizeof(int));
+		m_NumSortedServers--;
+		pEntry->m_Info.m_SortedIndex = -1;
+	}
+
+	// and put it back where it belongs now
+	if(!Filtered(pEntry))
+	{
+		NewPos = std::upper_bound(m_pSortedServerlist, m_pSortedServerlist+m_NumSortedServers, Index, SortWrap(this, &CServerBrowser::SortLess)) - m_pSortedServerlist;
+		mem_move(&m_pSortedServerlist[NewPos+1], &m_pSortedServerlist[NewPos], (m_NumSortedServers-NewPos)*sizeof(int));
+		m_pSortedServerlist[NewPos] = Index;
+		m_NumSortedServers++;
+	}
+
+	// fix the indexes of the servers in between
+	if(OldPos < 0 && NewPos < 0)
+		return;
+	int First = OldPos < 0 ? NewPos : NewPos < 0 ? OldPos : min(OldPos, NewPos);
+	int Last = (OldPos < 0 || NewPos < 0) ? m_NumSortedServers-1 : max(OldPos, NewPos);
+	for(int i = First; i <= Last; i++)
+		m_ppServerlist[m_pSortedServerlist[i]]->m_Info.m_SortedIndex = i;
+}
+
 void CServerBrowser::RemoveRequest(CServerEntry *pEntry)
 {
 	if(pEntry->m_pPrevReq || pEntry->m_pNextReq || m_pFirstReqServer == pEntry)
@@ -353,8 +480,12 @@ void CServerBrowser::QueueRequest(CServerEntry *pEntry)
 void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 {
 	int Fav = pEntry->m_Info.m_Favorite;
+	int ServerIndex = pEntry->m_Info.m_ServerIndex;
+	int SortedIndex = pEntry->m_Info.m_SortedIndex;
 	pEntry->m_Info = Info;
 	pEntry->m_Info.m_Favorite = Fav;
+	pEntry->m_Info.m_ServerIndex = ServerIndex;
+	pEntry->m_Info.m_SortedIndex = SortedIndex;
 	pEntry->m_Info.m_NetAddr = pEntry->m_Addr;
 
 	// all these are just for nice compability
@@ -365,6 +496,10 @@ void CServerBrowser::SetInfo(CServerEntry *pEntry, const CServerInfo &Info)
 	else if(pEntry->m_Info.m_aGameType[0] == '2' && pEntry->m_Info.m_aGameType[1] == 0)
 		str_copy(pEntry->m_Info.m_aGameType, "CTF", sizeof(pEntry->m_Info.m_aGameType));
 
+	LowerKey(pEntry->m_aNameKey, pEntry->m_Info.m_aName, sizeof(pEntry->m_aNameKey));
+	LowerKey(pEntry->m_aMapKey, pEntry->m_Info.m_aMap, sizeof(pEntry->m_aMapKey));
+	LowerKey(pEntry->m_aGameTypeKey, pEntry->m_Info.m_aGameType, sizeof(pEntry->m_aGameTypeKey));
+
 	/*if(!request)
 	{
 		pEntry->m_Info.latency = (time_get()-pEntry->request_time)*1000/time_freq();
@@ -391,6 +526,8 @@ CServerBrowser::CServerEntry *CServerBrowser::Add(const NETADDR &Addr)
 	pEntry->m_Info.m_Latency = 999;
 	net_addr_str(&Addr, pEntry->m_Info.m_aAddress, sizeof(pEntry->m_Info.m_aAddress), true);
 	str_copy(pEntry->m_Info.m_aName, pEntry->m_Info.m_aAddress, sizeof(pEntry->m_Info.m_aName));
+	LowerKey(pEntry->m_aNameKey, pEntry->m_Info.m_aName, sizeof(pEntry->m_aNameKey));
+	pEntry->m_Info.m_SortedIndex = -1;
 
 	// check if it's a favorite
 	for(i = 0; i < m_NumFavoriteServers; i++)
@@ -465,7 +602,14 @@ void CServerBrowser::Set(const NETADDR &Addr, int Type, int Token, const CServer
 		}
 	}
 
-	Sort();
+	// only the touched server moves, a full pass is left for changed filters or order
+	if(pEntry)
+	{
+		if(m_SortKey == SortKey())
+			SortEntry(pEntry);
+		if(!SortUpToDate())
+			Sort();
+	}
 }
 
 void CServerBrowser::Refresh(int Type)
@@ -733,3 +877,80 @@ void CServerBrowser::ConfigSaveCallback(IConfig *pConfig, void *pUserData)
 		pConfig->WriteLine(aBuffer);
 	}
 }
+
+void CServerBrowser::Benchmark(int NumServers, int Runs)
+{
+	static const char *s_apMaps[] = {"dm1", "dm2", "dm6", "ctf1", "ctf2", "ctf5", "Lobby", "arena"};
+	static const char *s_apGameTypes[] = {"DM", "TDM", "CTF", "iDM", "zCatch", "Race"};
+	static const char *s_apWords[] = {"Teeworlds", "fun", "Pro", "noob", "Insta", "ctf", "DM", "Vanilla"};
+
+	CServerBrowser *pBench = new CServerBrowser();
+	pBench->m_pNetClient = m_pNetClient;
+	pBench->m_pMasterServer = m_pMasterServer;
+	pBench->m_pConsole = m_pConsole;
+	pBench->m_pFriends = m_pFriends;
+	str_copy(pBench->m_aNetVersion, m_aNetVersion, sizeof(pBench->m_aNetVersion));
+	pBench->m_ServerlistType = IServerBrowser::TYPE_LAN;
+	pBench->m_BroadcastTime = time_get();
+
+	// feed the infos one by one, like a refresh does
+	unsigned Seed = 1;
+	CServerInfo Info;
+	mem_zero(&Info, sizeof(Info));
+	int64 Start = time_get();
+	for(int i = 0; i < NumServers; i++)
+	{
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		Addr.type = NETTYPE_IPV4;
+		Addr.ip[0] = i&0xff;
+		Addr.ip[1] = (i>>8)&0xff;
+		Addr.ip[2] = (i>>16)&0xff;
+		Addr.ip[3] = 1;
+		Addr.port = 8303;
+
+		Seed = Seed*1103515245+12345;
+		str_format(Info.m_aName, sizeof(Info.m_aName), "%s %s #%d", s_apWords[(Seed>>8)&7], s_apWords[(Seed>>12)&7], i);
+		str_copy(Info.m_aMap, s_apMaps[(Seed>>16)&7], sizeof(Info.m_aMap));
+		str_copy(Info.m_aGameType, s_apGameTypes[((Seed>>20)&0xff)%6], sizeof(Info.m_aGameType));
+		str_copy(Info.m_aVersion, m_aNetVersion, sizeof(Info.m_aVersion));
+		Info.m_MaxClients = Info.m_MaxPlayers = 16;
+		Info.m_NumClients = Info.m_NumPlayers = (Seed>>24)%17;
+		for(int c = 0; c < Info.m_NumClients; c++)
+			str_format(Info.m_aClients[c].m_aName, sizeof(Info.m_aClients[c].m_aName), "tee%d", (Seed>>c)&0xfff);
+
+		pBench->Set(Addr, IServerBrowser::SET_TOKEN, pBench->m_CurrentToken, &Info);
+	}
+	int64 InsertTime = time_get()-Start;
+
+	// what every single info used to cost
+	Start = time_get();
+	for(int r = 0; r < Runs; r++)
+	{
+		pBench->m_SortKey = -1;
+		pBench->Sort();
+	}
+	int64 FullTime = (time_get()-Start)/Runs;
+
+	// typing into the search box and clearing it again
+	char aOldFilter[sizeof(g_Config.m_BrFilterString)];
+	str_copy(aOldFilter, g_Config.m_BrFilterString, sizeof(aOldFilter));
+	Start = time_get();
+	for(int r = 0; r < Runs; r++)
+	{
+		str_copy(g_Config.m_BrFilterString, "fun", sizeof(g_Config.m_BrFilterString));
+		pBench->Sort();
+		str_copy(g_Config.m_BrFilterString, aOldFilter, sizeof(g_Config.m_BrFilterString));
+		pBench->Sort();
+	}
+	int64 FilterTime = (time_get()-Start)/Runs;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%d servers, %d shown: inserting infos took %.2fms (%.2fus each)", NumServers, pBench->m_NumSortedServers,
+		InsertTime*1000.0/time_freq(), InsertTime*1000000.0/time_freq()/max(NumServers, 1));
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client_srvbrowse", aBuf);
+	str_format(aBuf, sizeof(aBuf), "full refilter and sort %.2fms, filter change and back %.2fms", FullTime*1000.0/time_freq(), FilterTime*1000.0/time_freq());
+	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client_srvbrowse", aBuf);
+
+	delete pBench;
+}
@@ -16,6 +16,11 @@ public:
 		int m_GotInfo;
 		CServerInfo m_Info;
 
+		// lowered copies for sorting
+		char m_aNameKey[64];
+		char m_aMapKey[32];
+		char m_aGameTypeKey[16];
+
 		CServerEntry *m_pNextIp; // ip hashed list
 
 		CServerEntry *m_pPrevReq; // request list
@@ -28,6 +33,7 @@ public:
 	};
 
 	CServerBrowser();
+	~CServerBrowser();
 
 	// interface functions
 	void Refresh(int Type);
@@ -51,6 +57,9 @@ public:
 
 	void SetBaseInfo(class CNetClient *pClient, const char *pNetVersion);
 
+	// fills a private browser with synthetic servers and times sorting and filtering
+	void Benchmark(int NumServers, int Runs);
+
 private:
 	CNetClient *m_pNetClient;
 	IMasterServer *m_pMasterServer;
@@ -61,6 +70,7 @@ private:
 	CHeap m_ServerlistHeap;
 	CServerEntry **m_ppServerlist;
 	int *m_pSortedServerlist;
+	int *m_pSortScratch;
 
 	NETADDR m_aFavoriteServers[MAX_FAVORITES];
 	int m_NumFavoriteServers;
@@ -79,6 +89,7 @@ private:
 	int m_NumServerCapacity;
 
 	int m_Sorthash;
+	int m_SortKey;
 	char m_aFilterString[64];
 	char m_aFilterGametypeString[128];
 
@@ -89,17 +100,28 @@ private:
 	int64 m_BroadcastTime;
 
 	// sorting criterions
-	bool SortCompareName(int Index1, int Index2) const;
-	bool SortCompareMap(int Index1, int Index2) const;
-	bool SortComparePing(int Index1, int Index2) const;
-	bool SortCompareGametype(int Index1, int Index2) const;
-	bool SortCompareNumPlayers(int Index1, int Index2) const;
-	bool SortCompareNumClients(int Index1, int Index2) const;
+	typedef int (CServerBrowser::*FSortCompare)(int Index1, int Index2) const;
+	FSortCompare m_pfnSortCompare;
+	bool m_SortDescending;
+
+	int SortCompareName(int Index1, int Index2) const;
+	int SortCompareMap(int Index1, int Index2) const;
+	int SortComparePing(int Index1, int Index2) const;
+	int SortCompareGametype(int Index1, int Index2) const;
+	int SortCompareNumPlayers(int Index1, int Index2) const;
+	int SortCompareNumClients(int Index1, int Index2) const;
+	bool SortLess(int Index1, int Index2) const;
 
 	//
-	void Filter();
+	bool Filtered(CServerEntry *pEntry);
 	void Sort();
+	void SortEntry(CServerEntry *pEntry);
+	bool SortUpToDate() const;
 	int SortHash() const;
+	int SortKey() const;
+	void AllocSortedList();
+
+	static void LowerKey(char *pDst, const char *pSrc, int DstSize);
 
 	CServerEntry *Find(const NETADDR &Addr);
 	CServerEntry *Add(const NETADDR &Addr);
@@ -3,6 +3,7 @@
 #include <base/math.h>
 #include <base/system.h>
 
+#include <engine/console.h>
 #include <engine/graphics.h>
 #include <engine/storage.h>
 
@@ -16,12 +17,20 @@ extern "C" { // wavpack
 	#include <engine/external/wavpack/wavpack.h>
 }
 #include <math.h>
+#include <stdlib.h> // rand
+
+#include <atomic>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 enum
 {
 	NUM_SAMPLES = 512,
 	NUM_VOICES = 64,
 	NUM_CHANNELS = 16,
+	CMD_QUEUE_SIZE = 256,
 };
 
 struct CSample
@@ -51,32 +60,60 @@ struct CVoice
 	int m_X, m_Y;
 } ;
 
+// the game thread reserves a free voice, the audio thread plays it and frees it again
+enum
+{
+	VOICE_FREE = 0,
+	VOICE_RESERVED,
+	VOICE_PLAYING,
+};
+
+enum
+{
+	CMD_PLAY = 0,
+	CMD_STOP,
+	CMD_STOPALL,
+};
+
+struct CSoundCmd
+{
+	int m_Type;
+	int m_Voice;
+	int m_SampleID;
+	int m_ChannelID;
+	int m_Flags;
+	int m_X, m_Y;
+};
+
 static CSample m_aSamples[NUM_SAMPLES] = { {0} };
+static bool m_aSampleReserved[NUM_SAMPLES] = { 0 }; // only touched by the game thread
 static CVoice m_aVoices[NUM_VOICES] = { {0} };
 static CChannel m_aChannels[NUM_CHANNELS] = { {255, 0} };
+static std::atomic<int> m_aVoiceState[NUM_VOICES];
+
+// commands from the game thread, drained by the audio thread at the start of
+// every mix. one producer and one consumer, so neither side ever waits
+static CSoundCmd m_aCmdQueue[CMD_QUEUE_SIZE];
+static std::atomic<unsigned> m_CmdWrite(0);
+static std::atomic<unsigned> m_CmdRead(0);
 
-static LOCK m_SoundLock = 0;
+// stops that didn't fit into a full queue, they must not get lost like a play can
+static std::atomic<bool> m_aStopPending[NUM_SAMPLES];
+static std::atomic<bool> m_StopAllPending(false);
+static std::atomic<bool> m_StopsPending(false);
 
 static int m_CenterX = 0;
 static int m_CenterY = 0;
 
 static int m_MixingRate = 48000;
-static volatile int m_SoundVolume = 100;
+static std::atomic<int> m_SoundVolume(100);
 
 static int m_NextVoice = 0;
 static int *m_pMixBuffer = 0;	// buffer only used by the thread callback function
+static short *m_pNullOutput = 0;	// discarded output of the null backend
+static int64 m_NullLastMix = 0;
 static unsigned m_MaxFrames = 0;
 
-// TODO: there should be a faster way todo this
-static short Int2Short(int i)
-{
-	if(i > 0x7fff)
-		return 0x7fff;
-	else if(i < -0x7fff)
-		return -0x7fff;
-	return i;
-}
-
 static int IntAbs(int i)
 {
 	if(i<0)
@@ -84,108 +121,246 @@ static int IntAbs(int i)
 	return i;
 }
 
-static void Mix(short *pFinalOut, unsigned Frames)
+static bool PushCmd(const CSoundCmd &Cmd)
 {
-	int MasterVol;
-	mem_zero(m_pMixBuffer, m_MaxFrames*2*sizeof(int));
-	Frames = min(Frames, m_MaxFrames);
-
-	// aquire lock while we are mixing
-	lock_wait(m_SoundLock);
+	unsigned Write = m_CmdWrite.load(std::memory_order_relaxed);
+	if(Write - m_CmdRead.load(std::memory_order_acquire) >= CMD_QUEUE_SIZE)
+		return false;
+	m_aCmdQueue[Write%CMD_QUEUE_SIZE] = Cmd;
+	m_CmdWrite.store(Write+1, std::memory_order_release);
+	return true;
+}
 
-	MasterVol = m_SoundVolume;
+static void StopVoice(int VoiceID)
+{
+	CVoice *v = &m_aVoices[VoiceID];
+	if(v->m_pSample)
+	{
+		if(v->m_Flags & ISound::FLAG_LOOP)
+			v->m_pSample->m_PausedAt = v->m_Tick;
+		else
+			v->m_pSample->m_PausedAt = 0;
+	}
+	v->m_pSample = 0;
+	m_aVoiceState[VoiceID].store(VOICE_FREE, std::memory_order_release);
+}
 
-	for(unsigned i = 0; i < NUM_VOICES; i++)
+static void ProcessCmds()
+{
+	unsigned Read = m_CmdRead.load(std::memory_order_relaxed);
+	unsigned Write = m_CmdWrite.load(std::memory_order_acquire);
+	for(; Read != Write; Read++)
 	{
-		if(m_aVoices[i].m_pSample)
+		const CSoundCmd *pCmd = &m_aCmdQueue[Read%CMD_QUEUE_SIZE];
+		if(pCmd->m_Type == CMD_PLAY)
 		{
-			// mix voice
-			CVoice *v = &m_aVoices[i];
-			int *pOut = m_pMixBuffer;
+			CVoice *v = &m_aVoices[pCmd->m_Voice];
+			v->m_pSample = &m_aSamples[pCmd->m_SampleID];
+			v->m_pChannel = &m_aChannels[pCmd->m_ChannelID];
+			if(pCmd->m_Flags & ISound::FLAG_LOOP)
+				v->m_Tick = v->m_pSample->m_PausedAt;
+			else
+				v->m_Tick = 0;
+			v->m_Vol = 255;
+			v->m_Flags = pCmd->m_Flags;
+			v->m_X = pCmd->m_X;
+			v->m_Y = pCmd->m_Y;
+			m_aVoiceState[pCmd->m_Voice].store(VOICE_PLAYING, std::memory_order_relaxed);
+		}
+		else if(pCmd->m_Type == CMD_STOP)
+		{
+			// TODO: a nice fade out
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample == &m_aSamples[pCmd->m_SampleID])
+					StopVoice(i);
+			}
+		}
+		else if(pCmd->m_Type == CMD_STOPALL)
+		{
+			for(int i = 0; i < NUM_VOICES; i++)
+			{
+				if(m_aVoices[i].m_pSample)
+					StopVoice(i);
+			}
+		}
+	}
+	m_CmdRead.store(Read, std::memory_order_release);
 
-			int Step = v->m_pSample->m_Channels; // setup input sources
-			short *pInL = &v->m_pSample->m_pData[v->m_Tick*Step];
-			short *pInR = &v->m_pSample->m_pData[v->m_Tick*Step+1];
+	// run after the queue, so the stops still come after the plays that filled it
+	if(m_StopsPending.exchange(false, std::memory_order_acquire))
+	{
+		bool StopAll = m_StopAllPending.exchange(false, std::memory_order_relaxed);
+		bool aStop[NUM_SAMPLES];
+		for(int i = 0; i < NUM_SAMPLES; i++)
+			aStop[i] = m_aStopPending[i].exchange(false, std::memory_order_relaxed);
+		for(int i = 0; i < NUM_VOICES; i++)
+		{
+			if(m_aVoices[i].m_pSample && (StopAll || aStop[m_aVoices[i].m_pSample-m_aSamples]))
+				StopVoice(i);
+		}
+	}
+}
 
-			unsigned End = v->m_pSample->m_NumFrames-v->m_Tick;
+static void VoiceVolume(const CVoice *v, int *pLvol, int *pRvol)
+{
+	int Rvol = v->m_pChannel->m_Vol;
+	int Lvol = v->m_pChannel->m_Vol;
 
-			int Rvol = v->m_pChannel->m_Vol;
-			int Lvol = v->m_pChannel->m_Vol;
+	if(v->m_Flags&ISound::FLAG_POS && v->m_pChannel->m_Pan)
+	{
+		// TODO: we should respect the channel panning value
+		const int Range = 1500; // magic value, remove
+		int dx = v->m_X - m_CenterX;
+		int dy = v->m_Y - m_CenterY;
+		int Dist = (int)sqrtf((float)dx*dx+dy*dy); // float here. nasty
+		int p = IntAbs(dx);
+		if(Dist >= 0 && Dist < Range)
+		{
+			// panning
+			if(dx > 0)
+				Lvol = ((Range-p)*Lvol)/Range;
+			else
+				Rvol = ((Range-p)*Rvol)/Range;
 
-			// make sure that we don't go outside the sound data
-			if(Frames < End)
-				End = Frames;
+			// falloff
+			Lvol = (Lvol*(Range-Dist))/Range;
+			Rvol = (Rvol*(Range-Dist))/Range;
+		}
+		else
+		{
+			Lvol = 0;
+			Rvol = 0;
+		}
+	}
 
-			// check if we have a mono sound
-			if(v->m_pSample->m_Channels == 1)
-				pInR = pInL;
+	*pLvol = Lvol;
+	*pRvol = Rvol;
+}
 
-			// volume calculation
-			if(v->m_Flags&ISound::FLAG_POS && v->m_pChannel->m_Pan)
-			{
-				// TODO: we should respect the channel panning value
-				const int Range = 1500; // magic value, remove
-				int dx = v->m_X - m_CenterX;
-				int dy = v->m_Y - m_CenterY;
-				int Dist = (int)sqrtf((float)dx*dx+dy*dy); // float here. nasty
-				int p = IntAbs(dx);
-				if(Dist >= 0 && Dist < Range)
-				{
-					// panning
-					if(dx > 0)
-						Lvol = ((Range-p)*Lvol)/Range;
-					else
-						Rvol = ((Range-p)*Rvol)/Range;
-
-					// falloff
-					Lvol = (Lvol*(Range-Dist))/Range;
-					Rvol = (Rvol*(Range-Dist))/Range;
-				}
-				else
-				{
-					Lvol = 0;
-					Rvol = 0;
-				}
-			}
+static void MixVoiceScalar(const short *pIn, int Step, int *pOut, unsigned Frames, int Lvol, int Rvol)
+{
+	const short *pInL = pIn;
+	const short *pInR = Step == 2 ? pIn+1 : pIn;
+	for(unsigned s = 0; s < Frames; s++)
+	{
+		*pOut++ += (*pInL)*Lvol;
+		*pOut++ += (*pInR)*Rvol;
+		pInL += Step;
+		pInR += Step;
+	}
+}
 
-			// process all frames
-			for(unsigned s = 0; s < End; s++)
-			{
-				*pOut++ += (*pInL)*Lvol;
-				*pOut++ += (*pInR)*Rvol;
-				pInL += Step;
-				pInR += Step;
-				v->m_Tick++;
-			}
+static void FinishMixScalar(const int *pMix, short *pFinalOut, unsigned Frames, float Scale)
+{
+	for(unsigned i = 0; i < Frames*2; i++)
+		pFinalOut[i] = (short)clamp((int)(pMix[i]*Scale), -0x7fff, 0x7fff);
+}
 
-			// free voice if not used any more
-			if(v->m_Tick == v->m_pSample->m_NumFrames)
-			{
-				if(v->m_Flags&ISound::FLAG_LOOP)
-					v->m_Tick = 0;
-				else
-					v->m_pSample = 0;
-			}
+#if defined(__SSE2__)
+static void MixVoiceSSE2(const short *pIn, int Step, int *pOut, unsigned Frames, int Lvol, int Rvol)
+{
+	// four frames at a time, the low and high halves of the 16 bit products
+	// make up the full 32 bit ones
+	__m128i Vol = _mm_set_epi16(Rvol, Lvol, Rvol, Lvol, Rvol, Lvol, Rvol, Lvol);
+	unsigned s = 0;
+	for(; s+4 <= Frames; s += 4)
+	{
+		__m128i In;
+		if(Step == 2)
+			In = _mm_loadu_si128((const __m128i *)(pIn+s*2));
+		else
+		{
+			In = _mm_loadl_epi64((const __m128i *)(pIn+s));
+			In = _mm_unpacklo_epi16(In, In); // mono goes to both ears
 		}
+		__m128i Lo = _mm_mullo_epi16(In, Vol);
+		__m128i Hi = _mm_mulhi_epi16(In, Vol);
+		__m128i *pDst = (__m128i *)(pOut+s*2);
+		_mm_storeu_si128(pDst, _mm_add_epi32(_mm_loadu_si128(pDst), _mm_unpacklo_epi16(Lo, Hi)));
+		_mm_storeu_si128(pDst+1, _mm_add_epi32(_mm_loadu_si128(pDst+1), _mm_unpackhi_epi16(Lo, Hi)));
 	}
+	MixVoiceScalar(pIn+s*Step, Step, pOut+s*2, Frames-s, Lvol, Rvol);
+}
 
+static void FinishMixSSE2(const int *pMix, short *pFinalOut, unsigned Frames, float Scale)
+{
+	__m128 Scale4 = _mm_set1_ps(Scale);
+	__m128i Min = _mm_set1_epi16(-0x7fff);
+	unsigned i = 0;
+	for(; i+8 <= Frames*2; i += 8)
+	{
+		__m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pMix+i))), Scale4));
+		__m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pMix+i+4))), Scale4));
+		_mm_storeu_si128((__m128i *)(pFinalOut+i), _mm_max_epi16(_mm_packs_epi32(a, b), Min));
+	}
+	FinishMixScalar(pMix+i, pFinalOut+i, (Frames*2-i)/2, Scale);
+}
+#endif
 
-	// release the lock
-	lock_release(m_SoundLock);
-
+static void MixVoices(CVoice *pVoices, int NumVoices, int *pMixBuffer, unsigned Frames, bool Simd)
+{
+	for(int i = 0; i < NumVoices; i++)
 	{
-		// clamp accumulated values
-		// TODO: this seams slow
-		for(unsigned i = 0; i < Frames; i++)
-		{
-			int j = i<<1;
-			int vl = ((m_pMixBuffer[j]*MasterVol)/101)>>8;
-			int vr = ((m_pMixBuffer[j+1]*MasterVol)/101)>>8;
+		CVoice *v = &pVoices[i];
+		if(!v->m_pSample)
+			continue;
+
+		// make sure that we don't go outside the sound data
+		int Step = v->m_pSample->m_Channels;
+		unsigned End = minimum((unsigned)(v->m_pSample->m_NumFrames-v->m_Tick), Frames);
+
+		int Lvol, Rvol;
+		VoiceVolume(v, &Lvol, &Rvol);
 
-			pFinalOut[j] = Int2Short(vl);
-			pFinalOut[j+1] = Int2Short(vr);
+		const short *pIn = &v->m_pSample->m_pData[v->m_Tick*Step];
+#if defined(__SSE2__)
+		if(Simd)
+			MixVoiceSSE2(pIn, Step, pMixBuffer, End, Lvol, Rvol);
+		else
+#endif
+			MixVoiceScalar(pIn, Step, pMixBuffer, End, Lvol, Rvol);
+		v->m_Tick += End;
+
+		// free voice if not used any more
+		if(v->m_Tick == v->m_pSample->m_NumFrames)
+		{
+			if(v->m_Flags&ISound::FLAG_LOOP)
+				v->m_Tick = 0;
+			else
+				v->m_pSample = 0;
 		}
 	}
+}
+
+static void FinishMix(const int *pMixBuffer, short *pFinalOut, unsigned Frames, int MasterVol, bool Simd)
+{
+	// clamp accumulated values
+	float Scale = MasterVol/(101.0f*256.0f);
+#if defined(__SSE2__)
+	if(Simd)
+		FinishMixSSE2(pMixBuffer, pFinalOut, Frames, Scale);
+	else
+#endif
+		FinishMixScalar(pMixBuffer, pFinalOut, Frames, Scale);
+}
+
+static void Mix(short *pFinalOut, unsigned Frames)
+{
+	mem_zero(m_pMixBuffer, m_MaxFrames*2*sizeof(int));
+	Frames = minimum(Frames, m_MaxFrames);
+
+	ProcessCmds();
+	MixVoices(m_aVoices, NUM_VOICES, m_pMixBuffer, Frames, true);
+
+	// hand finished voices back to the game thread
+	for(int i = 0; i < NUM_VOICES; i++)
+	{
+		if(!m_aVoices[i].m_pSample && m_aVoiceState[i].load(std::memory_order_relaxed) == VOICE_PLAYING)
+			m_aVoiceState[i].store(VOICE_FREE, std::memory_order_release);
+	}
+
+	FinishMix(m_pMixBuffer, pFinalOut, Frames, m_SoundVolume.load(std::memory_order_relaxed), true);
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(pFinalOut, sizeof(short), Frames * 2);
@@ -202,24 +377,38 @@ static void SdlCallback(void *pUnused, Uint8 *pStream, int Len)
 int CSound::Init()
 {
 	m_SoundEnabled = 0;
+	m_NullBackend = false;
 	m_pGraphics = Kernel()->RequestInterface<IEngineGraphics>();
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
 
 	SDL_AudioSpec Format;
 
-	m_SoundLock = lock_create();
-
 	if(!g_Config.m_SndEnable)
 		return 0;
 
+	m_MixingRate = g_Config.m_SndRate;
+	m_MaxFrames = g_Config.m_SndBufferSize*2;
+
+	// mix from Update() into a scratch buffer instead of an audio device
+	if(g_Config.m_SndNull)
+	{
+		m_pMixBuffer = (int *)mem_alloc(m_MaxFrames*2*sizeof(int), 1);
+		m_pNullOutput = (short *)mem_alloc(m_MaxFrames*2*sizeof(short), 1);
+		m_NullLastMix = time_get();
+		m_NullBackend = true;
+		dbg_msg("client/sound", "using the null sound backend");
+
+		m_SoundEnabled = 1;
+		Update();
+		return 0;
+	}
+
 	if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
 	{
 		dbg_msg("gfx", "unable to init SDL audio: %s", SDL_GetError());
 		return -1;
 	}
 
-	m_MixingRate = g_Config.m_SndRate;
-
 	// Set 16-bit stereo audio at 22Khz
 	Format.freq = g_Config.m_SndRate; // ignore_convention
 	Format.format = AUDIO_S16; // ignore_convention
@@ -237,7 +426,6 @@ int CSound::Init()
 	else
 		dbg_msg("client/sound", "sound init successful");
 
-	m_MaxFrames = g_Config.m_SndBufferSize*2;
 	m_pMixBuffer = (int *)mem_alloc(m_MaxFrames*2*sizeof(int), 1);
 
 	SDL_PauseAudio(0);
@@ -255,11 +443,23 @@ int CSound::Update()
 	if(!m_pGraphics->WindowActive() && g_Config.m_SndNonactiveMute)
 		WantedVolume = 0;
 
-	if(WantedVolume != m_SoundVolume)
+	m_SoundVolume.store(WantedVolume, std::memory_order_relaxed);
+
+	// the null backend consumes as many frames as a device would have
+	if(m_NullBackend)
 	{
-		lock_wait(m_SoundLock);
-		m_SoundVolume = WantedVolume;
-		lock_release(m_SoundLock);
+		int64 Now = time_get();
+		int64 Frames = (Now-m_NullLastMix)*m_MixingRate/time_freq();
+		if(Frames > 0)
+		{
+			m_NullLastMix += Frames*time_freq()/m_MixingRate;
+			while(Frames > 0)
+			{
+				unsigned Chunk = (unsigned)minimum(Frames, (int64)m_MaxFrames);
+				Mix(m_pNullOutput, Chunk);
+				Frames -= Chunk;
+			}
+		}
 	}
 
 	return 0;
@@ -267,9 +467,17 @@ int CSound::Update()
 
 int CSound::Shutdown()
 {
-	SDL_CloseAudio();
-	SDL_QuitSubSystem(SDL_INIT_AUDIO);
-	lock_destroy(m_SoundLock);
+	if(m_NullBackend)
+	{
+		mem_free(m_pNullOutput);
+		m_pNullOutput = 0;
+		m_NullBackend = false;
+	}
+	else
+	{
+		SDL_CloseAudio();
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
 	if(m_pMixBuffer)
 	{
 		mem_free(m_pMixBuffer);
@@ -278,47 +486,64 @@ int CSound::Shutdown()
 	return 0;
 }
 
-int CSound::AllocID()
+int CSound::ReserveSample()
 {
+	// don't waste memory on sound when we are stress testing
+	if(g_Config.m_DbgStress || !m_SoundEnabled)
+		return -1;
+
 	// TODO: linear search, get rid of it
 	for(unsigned SampleID = 0; SampleID < NUM_SAMPLES; SampleID++)
 	{
-		if(m_aSamples[SampleID].m_pData == 0x0)
+		if(!m_aSampleReserved[SampleID])
+		{
+			m_aSampleReserved[SampleID] = true;
 			return SampleID;
+		}
 	}
 
 	return -1;
 }
 
-void CSound::RateConvert(int SampleID)
+void CSound::RateConvert(CSample *pSample, int MixingRate)
 {
-	CSample *pSample = &m_aSamples[SampleID];
 	int NumFrames = 0;
 	short *pNewData = 0;
 
 	// make sure that we need to convert this sound
-	if(!pSample->m_pData || pSample->m_Rate == m_MixingRate)
+	if(!pSample->m_pData || pSample->m_Rate == MixingRate)
 		return;
 
 	// allocate new data
-	NumFrames = (int)((pSample->m_NumFrames/(float)pSample->m_Rate)*m_MixingRate);
+	NumFrames = (int)((pSample->m_NumFrames/(float)pSample->m_Rate)*MixingRate);
+	if(NumFrames <= 0)
+		return; // shorter than one output frame, nothing to step through
 	pNewData = (short *)mem_alloc(NumFrames*pSample->m_Channels*sizeof(short), 1);
 
+	// step through the source with an exact integer fraction instead of
+	// a float division per frame, f = i*OldFrames/NumFrames
+	const short *pSrc = pSample->m_pData;
+	int Whole = pSample->m_NumFrames/NumFrames;
+	int Frac = pSample->m_NumFrames%NumFrames;
+	int Last = pSample->m_NumFrames-1;
+	int f = 0, Rem = 0;
 	for(int i = 0; i < NumFrames; i++)
 	{
-		// resample TODO: this should be done better, like linear atleast
-		float a = i/(float)NumFrames;
-		int f = (int)(a*pSample->m_NumFrames);
-		if(f >= pSample->m_NumFrames)
-			f = pSample->m_NumFrames-1;
-
-		// set new data
+		int Src = minimum(f, Last);
 		if(pSample->m_Channels == 1)
-			pNewData[i] = pSample->m_pData[f];
+			pNewData[i] = pSrc[Src];
 		else if(pSample->m_Channels == 2)
 		{
-			pNewData[i*2] = pSample->m_pData[f*2];
-			pNewData[i*2+1] = pSample->m_pData[f*2+1];
+			pNewData[i*2] = pSrc[Src*2];
+			pNewData[i*2+1] = pSrc[Src*2+1];
+		}
+
+		f += Whole;
+		Rem += Frac;
+		if(Rem >= NumFrames)
+		{
+			f++;
+			Rem -= NumFrames;
 		}
 	}
 
@@ -333,56 +558,31 @@ int CSound::ReadData(void *pBuffer, int Size)
 	return io_read(ms_File, pBuffer, Size);
 }
 
-int CSound::LoadWV(const char *pFilename)
+bool CSound::DecodeWV(int SampleID, const char *pFilename)
 {
-	CSample *pSample;
-	int SampleID = -1;
 	char aError[100];
 	WavpackContext *pContext;
 
-	// don't waste memory on sound when we are stress testing
-	if(g_Config.m_DbgStress)
-		return -1;
-
-	// no need to load sound when we are running with no sound
-	if(!m_SoundEnabled)
-		return 1;
-
-	if(!m_pStorage)
-		return -1;
+	if(SampleID < 0 || SampleID >= NUM_SAMPLES || !m_pStorage)
+		return false;
+	CSample *pSample = &m_aSamples[SampleID];
 
+	// the wavpack context and the file handle are per thread
 	ms_File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
 	if(!ms_File)
 	{
 		dbg_msg("sound/wv", "failed to open file. filename='%s'", pFilename);
-		return -1;
+		return false;
 	}
 
-	SampleID = AllocID();
-	if(SampleID < 0)
-		return -1;
-	pSample = &m_aSamples[SampleID];
-
+	bool Loaded = false;
 	pContext = WavpackOpenFileInput(ReadData, aError);
 	if (pContext)
 	{
-		int m_aSamples = WavpackGetNumSamples(pContext);
+		int NumSamples = WavpackGetNumSamples(pContext);
 		int BitsPerSample = WavpackGetBitsPerSample(pContext);
 		unsigned int SampleRate = WavpackGetSampleRate(pContext);
-		int m_aChannels = WavpackGetNumChannels(pContext);
-		int *pData;
-		int *pSrc;
-		short *pDst;
-		int i;
-
-		pSample->m_Channels = m_aChannels;
-		pSample->m_Rate = SampleRate;
-
-		if(pSample->m_Channels > 2)
-		{
-			dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
-			return -1;
-		}
+		int NumChannels = WavpackGetNumChannels(pContext);
 
 		/*
 		if(snd->rate != 44100)
@@ -391,28 +591,32 @@ int CSound::LoadWV(const char *pFilename)
 			return -1;
 		}*/
 
-		if(BitsPerSample != 16)
-		{
+		if(NumChannels > 2)
+			dbg_msg("sound/wv", "file is not mono or stereo. filename='%s'", pFilename);
+		else if(BitsPerSample != 16)
 			dbg_msg("sound/wv", "bps is %d, not 16, filname='%s'", BitsPerSample, pFilename);
-			return -1;
+		else
+		{
+			int *pData = (int *)mem_alloc(4*NumSamples*NumChannels, 1);
+			WavpackUnpackSamples(pContext, pData, NumSamples); // TODO: check return value
+
+			short *pDst = (short *)mem_alloc(2*NumSamples*NumChannels, 1);
+			for(int i = 0; i < NumSamples*NumChannels; i++)
+				pDst[i] = (short)pData[i];
+			mem_free(pData);
+
+			CSample Sample;
+			Sample.m_pData = pDst;
+			Sample.m_NumFrames = NumSamples;
+			Sample.m_Rate = SampleRate;
+			Sample.m_Channels = NumChannels;
+			Sample.m_LoopStart = -1;
+			Sample.m_LoopEnd = -1;
+			Sample.m_PausedAt = 0;
+			RateConvert(&Sample, m_MixingRate);
+			*pSample = Sample;
+			Loaded = true;
 		}
-
-		pData = (int *)mem_alloc(4*m_aSamples*m_aChannels, 1);
-		WavpackUnpackSamples(pContext, pData, m_aSamples); // TODO: check return value
-		pSrc = pData;
-
-		pSample->m_pData = (short *)mem_alloc(2*m_aSamples*m_aChannels, 1);
-		pDst = pSample->m_pData;
-
-		for (i = 0; i < m_aSamples*m_aChannels; i++)
-			*pDst++ = (short)*pSrc++;
-
-		mem_free(pData);
-
-		pSample->m_NumFrames = m_aSamples;
-		pSample->m_LoopStart = -1;
-		pSample->m_LoopEnd = -1;
-		pSample->m_PausedAt = 0;
 	}
 	else
 	{
@@ -422,10 +626,23 @@ int CSound::LoadWV(const char *pFilename)
 	io_close(ms_File);
 	ms_File = NULL;
 
-	if(g_Config.m_Debug)
+	if(Loaded && g_Config.m_Debug)
 		dbg_msg("sound/wv", "loaded %s", pFilename);
 
-	RateConvert(SampleID);
+	return Loaded;
+}
+
+int CSound::LoadWV(const char *pFilename)
+{
+	int SampleID = ReserveSample();
+	if(SampleID < 0)
+		return -1;
+
+	if(!DecodeWV(SampleID, pFilename))
+	{
+		m_aSampleReserved[SampleID] = false;
+		return -1;
+	}
 	return SampleID;
 }
 
@@ -447,13 +664,12 @@ int CSound::Play(int ChannelID, int SampleID, int Flags, float x, float y)
 	int VoiceID = -1;
 	int i;
 
-	lock_wait(m_SoundLock);
-
 	// search for voice
 	for(i = 0; i < NUM_VOICES; i++)
 	{
 		int id = (m_NextVoice + i) % NUM_VOICES;
-		if(!m_aVoices[id].m_pSample)
+		int Expected = VOICE_FREE;
+		if(m_aVoiceState[id].compare_exchange_strong(Expected, VOICE_RESERVED, std::memory_order_acquire))
 		{
 			VoiceID = id;
 			m_NextVoice = id+1;
@@ -461,22 +677,24 @@ int CSound::Play(int ChannelID, int SampleID, int Flags, float x, float y)
 		}
 	}
 
-	// voice found, use it
+	// voice found, the audio thread sets it up
 	if(VoiceID != -1)
 	{
-		m_aVoices[VoiceID].m_pSample = &m_aSamples[SampleID];
-		m_aVoices[VoiceID].m_pChannel = &m_aChannels[ChannelID];
-		if(Flags & FLAG_LOOP)
-			m_aVoices[VoiceID].m_Tick = m_aSamples[SampleID].m_PausedAt;
-		else
-			m_aVoices[VoiceID].m_Tick = 0;
-		m_aVoices[VoiceID].m_Vol = 255;
-		m_aVoices[VoiceID].m_Flags = Flags;
-		m_aVoices[VoiceID].m_X = (int)x;
-		m_aVoices[VoiceID].m_Y = (int)y;
+		CSoundCmd Cmd;
+		Cmd.m_Type = CMD_PLAY;
+		Cmd.m_Voice = VoiceID;
+		Cmd.m_SampleID = SampleID;
+		Cmd.m_ChannelID = ChannelID;
+		Cmd.m_Flags = Flags;
+		Cmd.m_X = (int)x;
+		Cmd.m_Y = (int)y;
+		if(!PushCmd(Cmd))
+		{
+			m_aVoiceState[VoiceID].store(VOICE_FREE, std::memory_order_relaxed);
+			VoiceID = -1;
+		}
 	}
 
-	lock_release(m_SoundLock);
 	return VoiceID;
 }
 
@@ -492,42 +710,108 @@ int CSound::Play(int ChannelID, int SampleID, int Flags)
 
 void CSound::Stop(int SampleID)
 {
-	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
-	CSample *pSample = &m_aSamples[SampleID];
-	for(int i = 0; i < NUM_VOICES; i++)
+	CSoundCmd Cmd;
+	Cmd.m_Type = CMD_STOP;
+	Cmd.m_SampleID = SampleID;
+	if(!PushCmd(Cmd))
 	{
-		if(m_aVoices[i].m_pSample == pSample)
-		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
-			m_aVoices[i].m_pSample = 0;
-		}
+		m_aStopPending[SampleID].store(true, std::memory_order_relaxed);
+		m_StopsPending.store(true, std::memory_order_release);
 	}
-	lock_release(m_SoundLock);
 }
 
 void CSound::StopAll()
 {
-	// TODO: a nice fade out
-	lock_wait(m_SoundLock);
-	for(int i = 0; i < NUM_VOICES; i++)
+	CSoundCmd Cmd;
+	Cmd.m_Type = CMD_STOPALL;
+	if(!PushCmd(Cmd))
 	{
-		if(m_aVoices[i].m_pSample)
+		m_StopAllPending.store(true, std::memory_order_relaxed);
+		m_StopsPending.store(true, std::memory_order_release);
+	}
+}
+
+void CSound::Benchmark(int NumVoices, int Runs, IConsole *pConsole)
+{
+	// mixes into memory only, the audio device and its voices aren't touched
+	char aBuf[256];
+	unsigned Frames = g_Config.m_SndBufferSize;
+	NumVoices = clamp(NumVoices, 1, 1024);
+
+	// one second of noise, mono and stereo
+	CSample aSamples[2];
+	for(int i = 0; i < 2; i++)
+	{
+		aSamples[i].m_Channels = i+1;
+		aSamples[i].m_NumFrames = m_MixingRate;
+		aSamples[i].m_pData = (short *)mem_alloc(m_MixingRate*(i+1)*sizeof(short), 1);
+		for(int j = 0; j < m_MixingRate*(i+1); j++)
+			aSamples[i].m_pData[j] = (short)(rand()%0x8000-0x4000);
+	}
+	CChannel Channel = {255, 255};
+
+	CVoice *apVoices[2];
+	int *apMix[2];
+	short *apOut[2];
+	for(int k = 0; k < 2; k++)
+	{
+		apVoices[k] = (CVoice *)mem_alloc(NumVoices*sizeof(CVoice), 1);
+		for(int i = 0; i < NumVoices; i++)
 		{
-			if(m_aVoices[i].m_Flags & FLAG_LOOP)
-				m_aVoices[i].m_pSample->m_PausedAt = m_aVoices[i].m_Tick;
-			else
-				m_aVoices[i].m_pSample->m_PausedAt = 0;
+			CVoice *v = &apVoices[k][i];
+			v->m_pSample = &aSamples[i%2];
+			v->m_pChannel = &Channel;
+			v->m_Tick = (i*997)%m_MixingRate;
+			v->m_Vol = 255;
+			v->m_Flags = ISound::FLAG_LOOP|(i%3 ? ISound::FLAG_POS : 0);
+			v->m_X = m_CenterX+(i*131)%2000-1000;
+			v->m_Y = m_CenterY+(i*71)%1000-500;
 		}
-		m_aVoices[i].m_pSample = 0;
+		apMix[k] = (int *)mem_alloc(Frames*2*sizeof(int), 1);
+		apOut[k] = (short *)mem_alloc(Frames*2*sizeof(short), 1);
 	}
-	lock_release(m_SoundLock);
+
+#if defined(__SSE2__)
+	const char *pSimdName = "sse2";
+#else
+	const char *pSimdName = "scalar (no simd)";
+#endif
+	int64 aTime[2] = {0, 0};
+	bool Identical = true;
+	for(int r = 0; r < Runs; r++)
+	{
+		for(int k = 0; k < 2; k++)
+		{
+			int64 Start = time_get();
+			mem_zero(apMix[k], Frames*2*sizeof(int));
+			MixVoices(apVoices[k], NumVoices, apMix[k], Frames, k == 1);
+			FinishMix(apMix[k], apOut[k], Frames, 100, k == 1);
+			aTime[k] += time_get()-Start;
+		}
+		if(Identical && mem_comp(apOut[0], apOut[1], Frames*2*sizeof(short)) != 0)
+		{
+			str_format(aBuf, sizeof(aBuf), "mismatch in run %d", r);
+			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sound", aBuf);
+			Identical = false;
+		}
+	}
+
+	for(int k = 0; k < 2; k++)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s mixer, %d voices, %d frames: %.3fus per callback", k == 0 ? "scalar" : pSimdName, NumVoices, Frames,
+			(double)aTime[k]*1000000.0/time_freq()/maximum(Runs, 1));
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sound", aBuf);
+		mem_free(apVoices[k]);
+		mem_free(apMix[k]);
+		mem_free(apOut[k]);
+	}
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sound", Identical ? "results identical" : "results differ");
+
+	for(int i = 0; i < 2; i++)
+		mem_free(aSamples[i].m_pData);
 }
 
-IOHANDLE CSound::ms_File = 0;
+thread_local IOHANDLE CSound::ms_File = 0;
 
 IEngineSound *CreateEngineSound() { return new CSound; }
 
@@ -5,9 +5,12 @@
 
 #include <engine/sound.h>
 
+struct CSample;
+
 class CSound : public IEngineSound
 {
 	int m_SoundEnabled;
+	bool m_NullBackend;
 
 public:
 	IEngineGraphics *m_pGraphics;
@@ -17,16 +20,17 @@ public:
 
 	int Update();
 	int Shutdown();
-	int AllocID();
 
-	static void RateConvert(int SampleID);
+	static void RateConvert(CSample *pSample, int MixingRate);
 
 	// TODO: Refactor: clean this mess up
-	static IOHANDLE ms_File;
+	static thread_local IOHANDLE ms_File;
 	static int ReadData(void *pBuffer, int Size);
 
 	virtual bool IsSoundEnabled() { return m_SoundEnabled != 0; }
 
+	virtual int ReserveSample();
+	virtual bool DecodeWV(int SampleID, const char *pFilename);
 	virtual int LoadWV(const char *pFilename);
 
 	virtual void SetListenerPos(float x, float y);
@@ -37,6 +41,8 @@ public:
 	virtual int Play(int ChannelID, int SampleID, int Flags);
 	virtual void Stop(int SampleID);
 	virtual void StopAll();
+
+	virtual void Benchmark(int NumVoices, int Runs, class IConsole *pConsole);
 };
 
 #endif
@@ -57,6 +57,9 @@ struct CFontSizeData
 	CFontChar m_aCharacters[MAX_CHARACTERS*MAX_CHARACTERS];
 
 	int m_CurrentCharacter;
+
+	// bumped whenever glyph slots move, cached layouts of older generations are stale
+	int m_Generation;
 };
 
 class CFont
@@ -166,6 +169,7 @@ class CTextRender : public IEngineTextRender
 		pSizeData->m_TextureWidth = Width;
 		pSizeData->m_TextureHeight = Height;
 		pSizeData->m_CurrentCharacter = 0;
+		pSizeData->m_Generation++;
 		
 		dbg_msg("", "pFont memory usage: %d", FontMemoryUsage);
 
@@ -286,6 +290,7 @@ class CTextRender : public IEngineTextRender
 				return GetSlot(pSizeData);
 			}
 
+			pSizeData->m_Generation++;
 			return Oldest;
 		}
 	}
@@ -432,6 +437,354 @@ class CTextRender : public IEngineTextRender
 		return (Kerning.x>>6);
 	}
 
+	// laid out strings, keyed by everything the layout depends on. positions
+	// are relative to the snapped cursor so moving text still hits the cache
+	enum
+	{
+		MAX_TEXT_LAYOUTS=1024,
+		NUM_LAYOUT_BUCKETS=2048,
+		MAX_CACHED_TEXT_LENGTH=4096,
+		DRAW_BATCH_SIZE=128,
+	};
+
+	struct CTextLayout
+	{
+		// key
+		unsigned m_Hash;
+		CFont *m_pFont;
+		int m_ActualSize;
+		float m_FakeToScreenX;
+		float m_FakeToScreenY;
+		int m_Flags;
+		float m_LineWidth;
+		int m_MaxLines;
+		int m_StartLineCount;
+		float m_StartOffset;
+		int m_Length;
+		char *m_pText;
+
+		// result
+		CFontSizeData *m_pSizeData;
+		int m_Generation;
+		float m_EndX;
+		float m_EndY;
+		bool m_GotNewLine;
+		int m_LineCount;
+		int m_CharCount;
+		int m_NumQuads;
+		int m_QuadCapacity;
+		IGraphics::CBatchQuadItem *m_pQuads;
+		int *m_pSlots;
+
+		int m_HashNext;
+		int m_LruPrev;
+		int m_LruNext;
+	};
+
+	CTextLayout m_aLayouts[MAX_TEXT_LAYOUTS];
+	int m_aLayoutBuckets[NUM_LAYOUT_BUCKETS];
+	int m_LruFirst;
+	int m_LruLast;
+	IGraphics::CBatchQuadItem m_aDrawBatch[DRAW_BATCH_SIZE];
+
+	static void FreeLayout(CTextLayout *pLayout)
+	{
+		if(pLayout->m_pText)
+			mem_free(pLayout->m_pText);
+		if(pLayout->m_pQuads)
+			mem_free(pLayout->m_pQuads);
+		if(pLayout->m_pSlots)
+			mem_free(pLayout->m_pSlots);
+		pLayout->m_pText = 0;
+		pLayout->m_pQuads = 0;
+		pLayout->m_pSlots = 0;
+		pLayout->m_QuadCapacity = 0;
+		pLayout->m_NumQuads = 0;
+	}
+
+	static void AddLayoutQuad(CTextLayout *pLayout, float x, float y, float w, float h, const CFontChar *pChr, int Slot)
+	{
+		if(pLayout->m_NumQuads == pLayout->m_QuadCapacity)
+		{
+			int Capacity = maximum(pLayout->m_QuadCapacity*2, 16);
+			IGraphics::CBatchQuadItem *pQuads = (IGraphics::CBatchQuadItem *)mem_alloc(Capacity*sizeof(IGraphics::CBatchQuadItem), 1);
+			int *pSlots = (int *)mem_alloc(Capacity*sizeof(int), 1);
+			if(pLayout->m_NumQuads)
+			{
+				mem_copy(pQuads, pLayout->m_pQuads, pLayout->m_NumQuads*sizeof(IGraphics::CBatchQuadItem));
+				mem_copy(pSlots, pLayout->m_pSlots, pLayout->m_NumQuads*sizeof(int));
+			}
+			if(pLayout->m_pQuads)
+				mem_free(pLayout->m_pQuads);
+			if(pLayout->m_pSlots)
+				mem_free(pLayout->m_pSlots);
+			pLayout->m_pQuads = pQuads;
+			pLayout->m_pSlots = pSlots;
+			pLayout->m_QuadCapacity = Capacity;
+		}
+
+		IGraphics::CBatchQuadItem *pQuad = &pLayout->m_pQuads[pLayout->m_NumQuads];
+		pQuad->m_X = x + w/2;
+		pQuad->m_Y = y + h/2;
+		pQuad->m_Width = w;
+		pQuad->m_Height = h;
+		pQuad->m_Rotation = 0;
+		pQuad->m_U0 = pChr->m_aUvs[0];
+		pQuad->m_V0 = pChr->m_aUvs[1];
+		pQuad->m_U1 = pChr->m_aUvs[2];
+		pQuad->m_V1 = pChr->m_aUvs[3];
+		pLayout->m_pSlots[pLayout->m_NumQuads] = Slot;
+		pLayout->m_NumQuads++;
+	}
+
+	static bool SameLayoutKey(const CTextLayout *pA, const CTextLayout *pB)
+	{
+		return pA->m_Hash == pB->m_Hash && pA->m_pFont == pB->m_pFont && pA->m_ActualSize == pB->m_ActualSize &&
+			pA->m_FakeToScreenX == pB->m_FakeToScreenX && pA->m_FakeToScreenY == pB->m_FakeToScreenY &&
+			pA->m_Flags == pB->m_Flags && pA->m_LineWidth == pB->m_LineWidth && pA->m_MaxLines == pB->m_MaxLines &&
+			pA->m_StartLineCount == pB->m_StartLineCount && pA->m_StartOffset == pB->m_StartOffset &&
+			pA->m_Length == pB->m_Length && mem_comp(pA->m_pText, pB->m_pText, pA->m_Length) == 0;
+	}
+
+	void LruUnlink(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		if(pLayout->m_LruPrev != -1)
+			m_aLayouts[pLayout->m_LruPrev].m_LruNext = pLayout->m_LruNext;
+		else
+			m_LruFirst = pLayout->m_LruNext;
+		if(pLayout->m_LruNext != -1)
+			m_aLayouts[pLayout->m_LruNext].m_LruPrev = pLayout->m_LruPrev;
+		else
+			m_LruLast = pLayout->m_LruPrev;
+	}
+
+	void LruPushFront(int Index)
+	{
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		pLayout->m_LruPrev = -1;
+		pLayout->m_LruNext = m_LruFirst;
+		if(m_LruFirst != -1)
+			m_aLayouts[m_LruFirst].m_LruPrev = Index;
+		else
+			m_LruLast = Index;
+		m_LruFirst = Index;
+	}
+
+	CTextLayout *FindLayout(const CTextLayout *pKey, CFontSizeData *pSizeData)
+	{
+		for(int i = m_aLayoutBuckets[pKey->m_Hash%NUM_LAYOUT_BUCKETS]; i != -1; i = m_aLayouts[i].m_HashNext)
+		{
+			CTextLayout *pLayout = &m_aLayouts[i];
+			if(!SameLayoutKey(pLayout, pKey))
+				continue;
+			if(pLayout->m_pSizeData != pSizeData || pLayout->m_Generation != pSizeData->m_Generation)
+				return 0;
+
+			LruUnlink(i);
+			LruPushFront(i);
+			return pLayout;
+		}
+		return 0;
+	}
+
+	// takes over the buffers of pNew, replacing a stale entry with the same key or the least recently used one
+	CTextLayout *StoreLayout(CTextLayout *pNew)
+	{
+		int Bucket = pNew->m_Hash%NUM_LAYOUT_BUCKETS;
+		int Index = -1;
+		for(int i = m_aLayoutBuckets[Bucket]; i != -1; i = m_aLayouts[i].m_HashNext)
+		{
+			if(SameLayoutKey(&m_aLayouts[i], pNew))
+			{
+				Index = i;
+				break;
+			}
+		}
+
+		if(Index == -1)
+		{
+			Index = m_LruLast;
+			CTextLayout *pOld = &m_aLayouts[Index];
+			if(pOld->m_pFont)
+			{
+				// unhook the evicted one from its bucket
+				int *pLink = &m_aLayoutBuckets[pOld->m_Hash%NUM_LAYOUT_BUCKETS];
+				while(*pLink != Index)
+					pLink = &m_aLayouts[*pLink].m_HashNext;
+				*pLink = pOld->m_HashNext;
+			}
+			m_aLayouts[Index].m_HashNext = m_aLayoutBuckets[Bucket];
+			m_aLayoutBuckets[Bucket] = Index;
+		}
+
+		CTextLayout *pLayout = &m_aLayouts[Index];
+		FreeLayout(pLayout);
+		int HashNext = pLayout->m_HashNext;
+		int LruPrev = pLayout->m_LruPrev;
+		int LruNext = pLayout->m_LruNext;
+		*pLayout = *pNew;
+		pLayout->m_HashNext = HashNext;
+		pLayout->m_LruPrev = LruPrev;
+		pLayout->m_LruNext = LruNext;
+		pNew->m_pText = 0;
+		pNew->m_pQuads = 0;
+		pNew->m_pSlots = 0;
+
+		LruUnlink(Index);
+		LruPushFront(Index);
+		return pLayout;
+	}
+
+	void ClearLayouts()
+	{
+		for(int i = 0; i < NUM_LAYOUT_BUCKETS; i++)
+			m_aLayoutBuckets[i] = -1;
+		for(int i = 0; i < MAX_TEXT_LAYOUTS; i++)
+		{
+			FreeLayout(&m_aLayouts[i]);
+			m_aLayouts[i].m_pFont = 0;
+			m_aLayouts[i].m_HashNext = -1;
+			m_aLayouts[i].m_LruPrev = i-1;
+			m_aLayouts[i].m_LruNext = i+1 < MAX_TEXT_LAYOUTS ? i+1 : -1;
+		}
+		m_LruFirst = 0;
+		m_LruLast = MAX_TEXT_LAYOUTS-1;
+	}
+
+	// the old TextEx body, recording glyph quads into pLayout instead of drawing them
+	void LayoutText(CTextLayout *pLayout, CTextCursor *pCursor, const char *pText, int Length, CFont *pFont, CFontSizeData *pSizeData,
+		float CursorX, float CursorY, float Size, float FakeToScreenX, float FakeToScreenY)
+	{
+		int GotNewLine = 0;
+		float DrawX = CursorX, DrawY = CursorY;
+		int LineCount = pCursor->m_LineCount;
+		int CharCount = 0;
+		float Scale = 1/pSizeData->m_FontSize;
+
+		const char *pCurrent = (char *)pText;
+		const char *pEnd = pCurrent+Length;
+
+		while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
+		{
+			int NewLine = 0;
+			const char *pBatchEnd = pEnd;
+			if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
+			{
+				int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
+				CTextCursor Compare = *pCursor;
+				Compare.m_X = DrawX;
+				Compare.m_Y = DrawY;
+				Compare.m_Flags &= ~TEXTFLAG_RENDER;
+				Compare.m_LineWidth = -1;
+				TextEx(&Compare, pCurrent, Wlen);
+
+				if(Compare.m_X-DrawX > pCursor->m_LineWidth)
+				{
+					// word can't be fitted in one line, cut it
+					CTextCursor Cutter = *pCursor;
+					Cutter.m_CharCount = 0;
+					Cutter.m_X = DrawX;
+					Cutter.m_Y = DrawY;
+					Cutter.m_Flags &= ~TEXTFLAG_RENDER;
+					Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
+
+					TextEx(&Cutter, (const char *)pCurrent, Wlen);
+					Wlen = Cutter.m_CharCount;
+					NewLine = 1;
+
+					if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
+						Wlen = 0;
+				}
+				else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
+				{
+					NewLine = 1;
+					Wlen = 0;
+				}
+
+				pBatchEnd = pCurrent + Wlen;
+
+				// the nested calls may have set up another size
+				RenderSetup(pFont, pSizeData->m_FontSize);
+			}
+
+			const char *pTmp = pCurrent;
+			int NextCharacter = str_utf8_decode(&pTmp);
+			while(pCurrent < pBatchEnd)
+			{
+				int Character = NextCharacter;
+				pCurrent = pTmp;
+				NextCharacter = str_utf8_decode(&pTmp);
+
+				if(Character == '\n')
+				{
+					DrawX = pCursor->m_StartX;
+					DrawY += Size;
+					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+					++LineCount;
+					if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
+						break;
+					continue;
+				}
+
+				CFontChar *pChr = GetChar(pFont, pSizeData, Character);
+				if(pChr)
+				{
+					float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
+					if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
+					{
+						// we hit the end of the line, no more to render or count
+						pCurrent = pEnd;
+						break;
+					}
+
+					AddLayoutQuad(pLayout, DrawX+pChr->m_OffsetX*Size - CursorX, DrawY+pChr->m_OffsetY*Size - CursorY,
+						pChr->m_Width*Size, pChr->m_Height*Size, pChr, pChr-pSizeData->m_aCharacters);
+
+					DrawX += Advance*Size;
+					CharCount++;
+				}
+			}
+
+			if(NewLine)
+			{
+				DrawX = pCursor->m_StartX;
+				DrawY += Size;
+				GotNewLine = 1;
+				DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
+				DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
+				++LineCount;
+			}
+		}
+
+		pLayout->m_EndX = DrawX - CursorX;
+		pLayout->m_EndY = DrawY - CursorY;
+		pLayout->m_GotNewLine = GotNewLine != 0;
+		pLayout->m_LineCount = LineCount;
+		pLayout->m_CharCount = CharCount;
+	}
+
+	void DrawLayout(const CTextLayout *pLayout, float x, float y, float r, float g, float b, float a)
+	{
+		for(int Start = 0; Start < pLayout->m_NumQuads; Start += DRAW_BATCH_SIZE)
+		{
+			int Num = min(pLayout->m_NumQuads-Start, (int)DRAW_BATCH_SIZE);
+			for(int i = 0; i < Num; i++)
+			{
+				IGraphics::CBatchQuadItem *pItem = &m_aDrawBatch[i];
+				*pItem = pLayout->m_pQuads[Start+i];
+				pItem->m_X += x;
+				pItem->m_Y += y;
+				pItem->m_R = r;
+				pItem->m_G = g;
+				pItem->m_B = b;
+				pItem->m_A = a;
+			}
+			Graphics()->QuadsDrawBatch(m_aDrawBatch, Num);
+		}
+	}
+
 
 public:
 	CTextRender()
@@ -449,6 +802,9 @@ public:
 
 		m_pDefaultFont = 0;
 
+		mem_zero(m_aLayouts, sizeof(m_aLayouts));
+		ClearLayouts();
+
 		// GL_LUMINANCE can be good for debugging
 		//m_FontTextureFormat = GL_ALPHA;
 	}
@@ -482,6 +838,8 @@ public:
 
 	virtual void DestroyFont(CFont *pFont)
 	{
+		// the address may come back with another font
+		ClearLayouts();
 		mem_free(pFont);
 	}
 
@@ -560,10 +918,6 @@ public:
 		int ActualX, ActualY;
 
 		int ActualSize;
-		int i;
-		int GotNewLine = 0;
-		float DrawX = 0.0f, DrawY = 0.0f;
-		int LineCount = 0;
 		float CursorX, CursorY;
 
 		float Size = pCursor->m_FontSize;
@@ -591,28 +945,68 @@ public:
 			return;
 
 		pSizeData = GetSize(pFont, ActualSize);
-		RenderSetup(pFont, ActualSize);
-
-		float Scale = 1/pSizeData->m_FontSize;
 
 		// set length
 		if(Length < 0)
 			Length = str_length(pText);
 
-		// if we don't want to render, we can just skip the first outline pass
-		i = 1;
-		if(pCursor->m_Flags&TEXTFLAG_RENDER)
-			i = 0;
-
-		for(;i < 2; i++)
+		// build the key, the line start only matters once the text can wrap or break
+		CTextLayout Key;
+		mem_zero(&Key, sizeof(Key));
+		bool HasNewLine = false;
+		Key.m_Hash = 2166136261u;
+		for(int i = 0; i < Length; i++)
 		{
-			const char *pCurrent = (char *)pText;
-			const char *pEnd = pCurrent+Length;
-			DrawX = CursorX;
-			DrawY = CursorY;
-			LineCount = pCursor->m_LineCount;
+			Key.m_Hash = (Key.m_Hash^(unsigned char)pText[i])*16777619u;
+			if(pText[i] == '\n')
+				HasNewLine = true;
+		}
+		Key.m_pFont = pFont;
+		Key.m_ActualSize = ActualSize;
+		Key.m_FakeToScreenX = FakeToScreenX;
+		Key.m_FakeToScreenY = FakeToScreenY;
+		Key.m_Flags = pCursor->m_Flags&TEXTFLAG_STOP_AT_END;
+		Key.m_LineWidth = pCursor->m_LineWidth;
+		Key.m_MaxLines = pCursor->m_MaxLines;
+		Key.m_StartLineCount = pCursor->m_LineCount;
+		if(pCursor->m_LineWidth > 0)
+			Key.m_StartOffset = pCursor->m_StartX - CursorX;
+		else if(HasNewLine)
+			Key.m_StartOffset = (float)((int)(pCursor->m_StartX * FakeToScreenX) - ActualX);
+		Key.m_Length = Length;
+		Key.m_pText = (char *)pText;
+
+		CTextLayout *pLayout = Length <= MAX_CACHED_TEXT_LENGTH ? FindLayout(&Key, pSizeData) : 0;
+		if(pLayout)
+		{
+			// keep the glyphs in use from being kicked out of the texture
+			int64 Now = time_get();
+			for(int i = 0; i < pLayout->m_NumQuads; i++)
+				pSizeData->m_aCharacters[pLayout->m_pSlots[i]].m_TouchTime = Now;
+		}
+		else
+		{
+			CTextLayout *pNew = &Key;
+			pNew->m_pText = 0;
+			pNew->m_pSizeData = pSizeData;
+			pNew->m_Generation = pSizeData->m_Generation;
+			RenderSetup(pFont, ActualSize);
+			LayoutText(pNew, pCursor, pText, Length, pFont, pSizeData, CursorX, CursorY, Size, FakeToScreenX, FakeToScreenY);
+
+			if(Length <= MAX_CACHED_TEXT_LENGTH)
+			{
+				pNew->m_pText = (char *)mem_alloc(maximum(Length, 1), 1);
+				mem_copy(pNew->m_pText, pText, Length);
+				pLayout = StoreLayout(pNew);
+			}
+			else
+				pLayout = pNew;
+		}
 
-			if(pCursor->m_Flags&TEXTFLAG_RENDER)
+		if(pCursor->m_Flags&TEXTFLAG_RENDER)
+		{
+			// outline first, then the text
+			for(int i = 0; i < 2; i++)
 			{
 				// TODO: Make this better
 				if (i == 0)
@@ -622,114 +1016,22 @@ public:
 
 				Graphics()->QuadsBegin();
 				if (i == 0)
-					Graphics()->SetColor(m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
+					DrawLayout(pLayout, CursorX, CursorY, m_TextOutlineR, m_TextOutlineG, m_TextOutlineB, m_TextOutlineA*m_TextA);
 				else
-					Graphics()->SetColor(m_TextR, m_TextG, m_TextB, m_TextA);
-			}
-
-			while(pCurrent < pEnd && (pCursor->m_MaxLines < 1 || LineCount <= pCursor->m_MaxLines))
-			{
-				int NewLine = 0;
-				const char *pBatchEnd = pEnd;
-				if(pCursor->m_LineWidth > 0 && !(pCursor->m_Flags&TEXTFLAG_STOP_AT_END))
-				{
-					int Wlen = min(WordLength((char *)pCurrent), (int)(pEnd-pCurrent));
-					CTextCursor Compare = *pCursor;
-					Compare.m_X = DrawX;
-					Compare.m_Y = DrawY;
-					Compare.m_Flags &= ~TEXTFLAG_RENDER;
-					Compare.m_LineWidth = -1;
-					TextEx(&Compare, pCurrent, Wlen);
-
-					if(Compare.m_X-DrawX > pCursor->m_LineWidth)
-					{
-						// word can't be fitted in one line, cut it
-						CTextCursor Cutter = *pCursor;
-						Cutter.m_CharCount = 0;
-						Cutter.m_X = DrawX;
-						Cutter.m_Y = DrawY;
-						Cutter.m_Flags &= ~TEXTFLAG_RENDER;
-						Cutter.m_Flags |= TEXTFLAG_STOP_AT_END;
-
-						TextEx(&Cutter, (const char *)pCurrent, Wlen);
-						Wlen = Cutter.m_CharCount;
-						NewLine = 1;
-
-						if(Wlen <= 3) // if we can't place 3 chars of the word on this line, take the next
-							Wlen = 0;
-					}
-					else if(Compare.m_X-pCursor->m_StartX > pCursor->m_LineWidth)
-					{
-						NewLine = 1;
-						Wlen = 0;
-					}
-
-					pBatchEnd = pCurrent + Wlen;
-				}
-
-				const char *pTmp = pCurrent;
-				int NextCharacter = str_utf8_decode(&pTmp);
-				while(pCurrent < pBatchEnd)
-				{
-					int Character = NextCharacter;
-					pCurrent = pTmp;
-					NextCharacter = str_utf8_decode(&pTmp);
-
-					if(Character == '\n')
-					{
-						DrawX = pCursor->m_StartX;
-						DrawY += Size;
-						DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-						DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-						++LineCount;
-						if(pCursor->m_MaxLines > 0 && LineCount > pCursor->m_MaxLines)
-							break;
-						continue;
-					}
-
-					CFontChar *pChr = GetChar(pFont, pSizeData, Character);
-					if(pChr)
-					{
-						float Advance = pChr->m_AdvanceX + Kerning(pFont, Character, NextCharacter)*Scale;
-						if(pCursor->m_Flags&TEXTFLAG_STOP_AT_END && DrawX+Advance*Size-pCursor->m_StartX > pCursor->m_LineWidth)
-						{
-							// we hit the end of the line, no more to render or count
-							pCurrent = pEnd;
-							break;
-						}
-
-						if(pCursor->m_Flags&TEXTFLAG_RENDER)
-						{
-							Graphics()->QuadsSetSubset(pChr->m_aUvs[0], pChr->m_aUvs[1], pChr->m_aUvs[2], pChr->m_aUvs[3]);
-							IGraphics::CQuadItem QuadItem(DrawX+pChr->m_OffsetX*Size, DrawY+pChr->m_OffsetY*Size, pChr->m_Width*Size, pChr->m_Height*Size);
-							Graphics()->QuadsDrawTL(&QuadItem, 1);
-						}
-
-						DrawX += Advance*Size;
-						pCursor->m_CharCount++;
-					}
-				}
-
-				if(NewLine)
-				{
-					DrawX = pCursor->m_StartX;
-					DrawY += Size;
-					GotNewLine = 1;
-					DrawX = (int)(DrawX * FakeToScreenX) / FakeToScreenX; // realign
-					DrawY = (int)(DrawY * FakeToScreenY) / FakeToScreenY;
-					++LineCount;
-				}
-			}
-
-			if(pCursor->m_Flags&TEXTFLAG_RENDER)
+					DrawLayout(pLayout, CursorX, CursorY, m_TextR, m_TextG, m_TextB, m_TextA);
 				Graphics()->QuadsEnd();
+			}
 		}
 
-		pCursor->m_X = DrawX;
-		pCursor->m_LineCount = LineCount;
+		pCursor->m_X = CursorX + pLayout->m_EndX;
+		pCursor->m_LineCount = pLayout->m_LineCount;
+		pCursor->m_CharCount += pLayout->m_CharCount;
+
+		if(pLayout->m_GotNewLine)
+			pCursor->m_Y = CursorY + pLayout->m_EndY;
 
-		if(GotNewLine)
-			pCursor->m_Y = DrawY;
+		if(pLayout == &Key)
+			FreeLayout(&Key);
 	}
 
 };
@@ -43,7 +43,12 @@ static uint32_t read_next_header (read_stream infile, WavpackHeader *wphdr);
 // large integer or floating point files (but always provides at least 24 bits
 // of resolution).
 
-static WavpackContext wpc;
+// one context per thread, so several files can be decoded at the same time
+#if defined(_MSC_VER)
+static __declspec(thread) WavpackContext wpc;
+#else
+static __thread WavpackContext wpc;
+#endif
 
 WavpackContext *WavpackOpenFileInput (read_stream infile, char *error)
 {
@@ -120,6 +120,16 @@ public:
 			: m_X0(x0), m_Y0(y0), m_X1(x1), m_Y1(y1), m_X2(x2), m_Y2(y2), m_X3(x3), m_Y3(y3) {}
 	};
 	virtual void QuadsDrawFreeform(const CFreeformItem *pArray, int Num) = 0;
+
+	// centered quads that each carry their own subset, color and rotation
+	struct CBatchQuadItem
+	{
+		float m_X, m_Y, m_Width, m_Height;
+		float m_Rotation;
+		float m_U0, m_V0, m_U1, m_V1;
+		float m_R, m_G, m_B, m_A;
+	};
+	virtual void QuadsDrawBatch(const CBatchQuadItem *pArray, int Num) = 0;
 	virtual void QuadsText(float x, float y, float Size, const char *pText) = 0;
 
 	struct CColorVertex
@@ -132,6 +142,16 @@ public:
 	virtual void SetColorVertex(const CColorVertex *pArray, int Num) = 0;
 	virtual void SetColor(float r, float g, float b, float a) = 0;
 
+	// static geometry kept by the backend: filled once, then drawn with the
+	// current texture, blend and screen state and a single color
+	struct CQuadVertex
+	{
+		float m_X, m_Y, m_U, m_V;
+	};
+	virtual int CreateQuadBuffer(const CQuadVertex *pVertices, int NumQuads) = 0;
+	virtual void DestroyQuadBuffer(int BufferID) = 0;
+	virtual void RenderQuadBuffer(int BufferID, int FirstQuad, int NumQuads, float r, float g, float b, float a) = 0;
+
 	virtual void TakeScreenshot(const char *pFilename) = 0;
 	virtual int GetVideoModes(CVideoMode *pModes, int MaxModes) = 0;
 
@@ -27,8 +27,12 @@ class IEngineMap : public IMap
 	MACRO_INTERFACE("enginemap", 0)
 public:
 	virtual bool Load(const char *pMapName) = 0;
+	virtual bool LoadMemory(const char *pMapName, const void *pData, unsigned Size) = 0;
 	virtual bool IsLoaded() = 0;
 	virtual void Unload() = 0;
+	// starts inflating all data on the job pool. only worth it for users that
+	// read nearly everything, like the client, the results stay until Unload
+	virtual void PrefetchData() = 0;
 	virtual SHA256_DIGEST Sha256() = 0;
 	virtual unsigned Crc() = 0;
 };
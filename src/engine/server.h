@@ -52,12 +52,18 @@ public:
 	template<class T>
 	int SendPackMsg(T *pMsg, int Flags, int ClientID)
 	{
+		if(ClientID >= 0 && !ClientNeedsMsg(ClientID, Flags))
+			return 0;
+
 		CMsgPacker Packer(pMsg->MsgID());
 		if(pMsg->Pack(&Packer))
 			return -1;
 		return SendMsg(&Packer, Flags, ClientID);
 	}
 
+	// false for bot slots unless a demo records the message
+	virtual bool ClientNeedsMsg(int ClientID, int Flags) = 0;
+
 	virtual void SetClientName(int ClientID, char const *pName) = 0;
 	virtual void SetClientClan(int ClientID, char const *pClan) = 0;
 	virtual void SetClientCountry(int ClientID, int Country) = 0;
@@ -87,7 +93,21 @@ public:
 	virtual char *GetMapName() = 0;
 	bool m_MapGenerated; // MapGen
 
+	// how a generated map came to be, capable clients generate it themselves instead of downloading it
+	struct CMapGenInfo
+	{
+		char m_aTemplate[128];
+		unsigned m_TemplateCrc;
+		int m_Seed;
+		int m_Level;
+		int m_Version;
+		char m_aGameType[32];
+		int m_SurvivalMode;
+	};
+	virtual void SetGeneratedMap(unsigned char *pData, int Size, const CMapGenInfo *pInfo = 0) = 0; // takes ownership, used when "generated" gets loaded
+
 	virtual class CPlayerData *GetPlayerData(int ClientID, const char *TimeoutID) = 0;
+	virtual void SavePlayerData(class CPlayerData *pData) = 0;
 	virtual int GetHighScore() = 0;
 	virtual int GetPlayerCount() = 0;
 };
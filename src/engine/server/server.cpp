@@ -278,6 +278,9 @@ void CServer::CClient::Reset()
 	m_LastAckedSnapshot = -1;
 	m_LastInputTick = -1;
 	m_SnapRate = CClient::SNAPRATE_INIT;
+	m_MapChunkQueueStart = 0;
+	m_MapChunkQueueNum = 0;
+	m_MapDownloadBudget = 0;
 	//m_Score = 0;
 }
 
@@ -292,6 +295,10 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_pGeneratedMapData = 0;
+	m_GeneratedMapSize = 0;
+	m_GeneratedMapInfoValid = false;
+	m_CurrentMapGenInfo = false;
 
 	m_MapReload = 0;
 
@@ -300,7 +307,7 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_MapGenerated = false;
 	
-	m_pPlayerData = NULL;
+	m_pPlayerData = new CPlayerDataStore();
 	
 	m_ServerInfoFirstRequest = 0;
 	m_ServerInfoNumRequests = 0;
@@ -315,6 +322,7 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 CServer::~CServer()
 {
 	delete m_pRegister;
+	delete m_pPlayerData;
 }
 
 int CServer::TrySetClientName(int ClientID, const char *pName)
@@ -593,6 +601,14 @@ static inline bool RepackMsg(const CMsgPacker *pMsg, CPacker &Packer, bool Sixup
 	return false;
 }
 
+bool CServer::ClientNeedsMsg(int ClientID, int Flags)
+{
+	// bots have no connection, only the demo might want their messages
+	if(ClientID < MAX_CLIENTS && m_aClients[ClientID].m_Bot)
+		return !(Flags & MSGFLAG_NORECORD) && m_DemoRecorder.IsRecording();
+	return true;
+}
+
 int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 {
 	CNetChunk Packet;
@@ -618,7 +634,7 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 		{
 			for(int i = 0; i < MAX_CLIENTS; i++)
 				{
-				if(m_aClients[i].m_State == CClient::STATE_INGAME)
+				if(m_aClients[i].m_State == CClient::STATE_INGAME && !m_aClients[i].m_Bot)
 				{
 					CPacker *pPack = &Pack6;
 					Packet.m_pData = pPack->Data();
@@ -631,6 +647,10 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 	}
 		else
 		{
+		if(!ClientNeedsMsg(ClientID, Flags))
+			return 0;
+		bool Bot = ClientID < MAX_CLIENTS && m_aClients[ClientID].m_Bot;
+
 		CPacker Pack;
 		if(RepackMsg(pMsg, Pack, 0))
 			return -1;
@@ -645,7 +665,7 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 			m_DemoRecorder.RecordMessage(Pack.Data(), Pack.Size());
 		}
 
-		if(!(Flags & MSGFLAG_NOSEND))
+		if(!(Flags & MSGFLAG_NOSEND) && !Bot)
 				m_NetServer.Send(&Packet);
 		}
 
@@ -678,6 +698,10 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_State != CClient::STATE_INGAME)
 			continue;
 
+		// nobody receives the bots' snapshots, the AI reads the game state directly
+		if(m_aClients[i].m_Bot)
+			continue;
+
 		// this client is trying to recover, don't spam snapshots
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_RECOVER && (Tick()%50) != 0)
 			continue;
@@ -874,8 +898,30 @@ void CServer::SendCapabilities(int ClientID)
 	SendMsg(&Msg, MSGFLAG_VITAL, ClientID);
 }
 
+void CServer::SendMapGen(int ClientID)
+{
+	// everything a client needs to generate the level on its own. the
+	// hash tells it whether it got the same result, if not it downloads
+	const CMapGenInfo *pInfo = &m_GeneratedMapInfo;
+	CMsgPacker Msg(NETMSG_MAP_GEN, true);
+	Msg.AddString(pInfo->m_aTemplate, 0);
+	Msg.AddInt(pInfo->m_TemplateCrc);
+	Msg.AddInt(pInfo->m_Seed);
+	Msg.AddInt(pInfo->m_Level);
+	Msg.AddInt(pInfo->m_Version);
+	Msg.AddString(pInfo->m_aGameType, 0);
+	Msg.AddInt(pInfo->m_SurvivalMode);
+	Msg.AddRaw(&m_CurrentMapSha256.data, sizeof(m_CurrentMapSha256.data));
+	Msg.AddInt(m_CurrentMapCrc);
+	Msg.AddInt(m_CurrentMapSize);
+	SendMsg(&Msg, MSGFLAG_VITAL, ClientID);
+}
+
 void CServer::SendMap(int ClientID)
 {
+	if(m_CurrentMapGenInfo)
+		SendMapGen(ClientID);
+
 	{
 		CMsgPacker Msg(NETMSG_MAP_DETAILS, true);
 		Msg.AddString(GetMapName(), 0);
@@ -892,6 +938,71 @@ void CServer::SendMap(int ClientID)
 		Msg.AddInt(m_CurrentMapSize);
 		SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
 	}
+
+	// requests for the old map are of no use anymore
+	m_aClients[ClientID].m_MapChunkQueueNum = 0;
+}
+
+void CServer::SendMapData(int ClientID, int Chunk)
+{
+	unsigned int ChunkSize = MAP_CHUNK_SIZE;
+	unsigned int Offset = Chunk * ChunkSize;
+	int Last = 0;
+
+	// drop faulty map data requests
+	if(Chunk < 0 || Offset > (unsigned int) m_CurrentMapSize)
+		return;
+
+	if(Offset+ChunkSize >= (unsigned int) m_CurrentMapSize)
+	{
+		ChunkSize = m_CurrentMapSize-Offset;
+		Last = 1;
+	}
+
+	CMsgPacker Msg(NETMSG_MAP_DATA, true);
+	Msg.AddInt(Last);
+	Msg.AddInt(m_CurrentMapCrc);
+	Msg.AddInt(Chunk);
+	Msg.AddInt(ChunkSize);
+	Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
+	SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
+
+	if(g_Config.m_Debug)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
+		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+	}
+}
+
+void CServer::SendMapChunks(int ClientID)
+{
+	// sends the queued chunks as far as the client's budget goes, a client
+	// that keeps several requests in flight gets a steady stream this way
+	CClient *pClient = &m_aClients[ClientID];
+	while(pClient->m_MapChunkQueueNum > 0 && (!g_Config.m_SvMapDownloadSpeed || pClient->m_MapDownloadBudget > 0))
+	{
+		int Chunk = pClient->m_aMapChunkQueue[pClient->m_MapChunkQueueStart];
+		pClient->m_MapChunkQueueStart = (pClient->m_MapChunkQueueStart+1) % CClient::MAX_MAP_CHUNK_QUEUE;
+		pClient->m_MapChunkQueueNum--;
+		pClient->m_MapDownloadBudget -= MAP_CHUNK_SIZE;
+		SendMapData(ClientID, Chunk);
+	}
+}
+
+void CServer::UpdateMapDownloads()
+{
+	// refill the per client budgets, a client can't save up more than a
+	// couple of ticks worth so bursts stay small
+	int TickBudget = g_Config.m_SvMapDownloadSpeed*1024/SERVER_TICK_SPEED;
+	int MaxBudget = maximum(TickBudget*2, (int)MAP_CHUNK_SIZE);
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_aClients[i].m_State != CClient::STATE_CONNECTING)
+			continue;
+		m_aClients[i].m_MapDownloadBudget = minimum(m_aClients[i].m_MapDownloadBudget+TickBudget, MaxBudget);
+		SendMapChunks(i);
+	}
 }
 
 void CServer::SendConnectionReady(int ClientID)
@@ -1006,36 +1117,18 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				return;
 
 			int Chunk = Unpacker.GetInt();
-			unsigned int ChunkSize = 1024-128;
-			unsigned int Offset = Chunk * ChunkSize;
-			int Last = 0;
-
-			// drop faulty map data requests
-			if(Chunk < 0 || Offset > (unsigned int) m_CurrentMapSize)
+			if(Unpacker.Error() || Chunk < 0 || Chunk > m_CurrentMapSize/MAP_CHUNK_SIZE)
 				return;
 
-			if(Offset+ChunkSize >= (unsigned int) m_CurrentMapSize)
+			// queue it, the chunks go out as the client's budget allows. a
+			// full queue drops the request, the client asks again later
+			CClient *pClient = &m_aClients[ClientID];
+			if(pClient->m_MapChunkQueueNum < CClient::MAX_MAP_CHUNK_QUEUE)
 			{
-				ChunkSize = m_CurrentMapSize-Offset;
-				if(ChunkSize < 0)
-					ChunkSize = 0;
-				Last = 1;
-			}
-
-			CMsgPacker Msg(NETMSG_MAP_DATA, true);
-			Msg.AddInt(Last);
-			Msg.AddInt(m_CurrentMapCrc);
-			Msg.AddInt(Chunk);
-			Msg.AddInt(ChunkSize);
-			Msg.AddRaw(&m_pCurrentMapData[Offset], ChunkSize);
-			SendMsg(&Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, ClientID);
-
-			if(g_Config.m_Debug)
-			{
-				char aBuf[256];
-				str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
-				Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
+				pClient->m_aMapChunkQueue[(pClient->m_MapChunkQueueStart+pClient->m_MapChunkQueueNum) % CClient::MAX_MAP_CHUNK_QUEUE] = Chunk;
+				pClient->m_MapChunkQueueNum++;
 			}
+			SendMapChunks(ClientID);
 		}
 		else if(Msg == NETMSG_READY)
 		{
@@ -1785,11 +1878,22 @@ char *CServer::GetMapName()
 	return pMapShortName;
 }
 
+void CServer::SetGeneratedMap(unsigned char *pData, int Size, const CMapGenInfo *pInfo)
+{
+	free(m_pGeneratedMapData);
+	m_pGeneratedMapData = pData;
+	m_GeneratedMapSize = Size;
+	m_GeneratedMapInfoValid = pData && pInfo;
+	if(m_GeneratedMapInfoValid)
+		m_GeneratedMapInfo = *pInfo;
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
-	if (str_comp(pMapName, "generated") != 0)
+	bool Generated = str_comp(pMapName, "generated") == 0;
+	if (!Generated)
 		m_MapGenerated = false;
-	else if (g_Config.m_SvMapGen)
+	else if (g_Config.m_SvMapGen && str_comp(m_aCurrentMap, "generated") != 0)
 		str_copy(g_Config.m_SvInvMap, m_aCurrentMap, sizeof(g_Config.m_SvInvMap));
 
 	KickBots();
@@ -1798,9 +1902,18 @@ int CServer::LoadMap(const char *pMapName)
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 
-	if(!m_pMap->Load(aBuf))
+	// generated maps are handed over in memory by the game server, the file is only a fallback
+	bool FromMemory = Generated && m_pGeneratedMapData;
+	if(FromMemory)
+	{
+		if(!m_pMap->LoadMemory(aBuf, m_pGeneratedMapData, m_GeneratedMapSize))
+			return 0;
+	}
+	else if(!m_pMap->Load(aBuf))
 		return 0;
 
+	m_CurrentMapGenInfo = FromMemory && m_GeneratedMapInfoValid;
+
 	// stop recording when we change map
 	m_DemoRecorder.Stop();
 
@@ -1823,6 +1936,15 @@ int CServer::LoadMap(const char *pMapName)
 	//map_set(df);
 
 	// load complete map into memory for download
+	if(FromMemory)
+	{
+		m_CurrentMapSize = m_GeneratedMapSize;
+		if(m_pCurrentMapData)
+			mem_free(m_pCurrentMapData);
+		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
+		mem_copy(m_pCurrentMapData, m_pGeneratedMapData, m_CurrentMapSize);
+	}
+	else
 	{
 		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
 		m_CurrentMapSize = (int)io_length(File);
@@ -1840,6 +1962,8 @@ int CServer::Run()
 	//
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
 
+	m_pPlayerData->Init(Storage(), g_Config.m_SvPlayerDataFile);
+
 	// load map
 	if(!LoadMap(g_Config.m_SvMap))
 	{
@@ -1979,6 +2103,7 @@ int CServer::Run()
 					DoSnapshot();
 
 				UpdateClientRconCommands();
+				UpdateMapDownloads();
 			}
 
 			// master server stuff
@@ -2045,9 +2170,11 @@ int CServer::Run()
 
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
+	m_pPlayerData->Shutdown();
 
 	if(m_pCurrentMapData)
 		mem_free(m_pCurrentMapData);
+	free(m_pGeneratedMapData);
 
 	m_pRegister->OnShutdown();
 	return 0;
@@ -2104,7 +2231,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		char aDate[20];
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/%s_%s.demo", "auto/autorecord", aDate);
-		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server");
+		m_DemoRecorder.Start(Storage(), m_pConsole, aFilename, GameServer()->NetVersion(), m_aCurrentMap, m_CurrentMapCrc, "server", m_pCurrentMapData, m_CurrentMapSize);
 		if(g_Config.m_SvAutoDemoMax)
 		{
 			// clean up auto recorded demos
@@ -2132,7 +2259,7 @@ void CServer::ConRecord(IConsole::IResult *pResult, void *pUser)
 		str_timestamp(aDate, sizeof(aDate));
 		str_format(aFilename, sizeof(aFilename), "demos/demo_%s.demo", aDate);
 	}
-	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapCrc, "server");
+	pServer->m_DemoRecorder.Start(pServer->Storage(), pServer->Console(), aFilename, pServer->GameServer()->NetVersion(), pServer->m_aCurrentMap, pServer->m_CurrentMapCrc, "server", pServer->m_pCurrentMapData, pServer->m_CurrentMapSize);
 }
 
 void CServer::ConStopRecord(IConsole::IResult *pResult, void *pUser)
@@ -2506,18 +2633,12 @@ void CServer::AddZombie()
 
 int CServer::GetHighScore()
 {
-	if (m_pPlayerData)
-		return m_pPlayerData->GetHighScore(1);
-	
-	return 1;
+	return m_pPlayerData->HighScore();
 }
 
 int CServer::GetPlayerCount()
 {
-	if (m_pPlayerData)
-		return m_pPlayerData->GetPlayerCount(0);
-	
-	return 1;
+	return max(m_pPlayerData->NumEntries(), 1);
 }
 
 CPlayerData *CServer::GetPlayerData(int ClientID, const char *TimeoutID)
@@ -2525,30 +2646,10 @@ CPlayerData *CServer::GetPlayerData(int ClientID, const char *TimeoutID)
 	if (ClientID < 0 || ClientID >= MAX_CLIENTS)
 		return NULL;
 	
-	/*
-	char aBuf[256];
-	str_format(aBuf, sizeof(aBuf), "GetPlayerData: '%s'", m_aClients[ClientID].m_aName);
-	dbg_msg("server", aBuf);
-	*/
-						
-	if (m_pPlayerData)
-	{
-		CPlayerData *pData = m_pPlayerData->Get(m_aClients[ClientID].m_aName, TimeoutID);
-	
-		if (pData)
-			return pData;
-		else
-		{
-			CPlayerData *pNewData = new CPlayerData(m_aClients[ClientID].m_aName, TimeoutID);
-			m_pPlayerData->Add(pNewData);
-			return pNewData;
-		}
-	}
-	else
-	{
-		m_pPlayerData = new CPlayerData(m_aClients[ClientID].m_aName, TimeoutID);
-		return m_pPlayerData;
-	}
-	
-	return NULL;
+	return m_pPlayerData->FindOrCreate(m_aClients[ClientID].m_aName, TimeoutID);
+}
+
+void CServer::SavePlayerData(CPlayerData *pData)
+{
+	m_pPlayerData->Save(pData);
 }
\ No newline at end of file
@@ -74,13 +74,14 @@ class CServer : public IServer
 	class IStorage *m_pStorage;
 	class IRegister *m_pRegister;
 
-	class CPlayerData *m_pPlayerData;
+	class CPlayerDataStore *m_pPlayerData;
 public:
 	class IGameServer *GameServer() { return m_pGameServer; }
 	class IConsole *Console() { return m_pConsole; }
 	class IStorage *Storage() { return m_pStorage; }
 
 	class CPlayerData *GetPlayerData(int ClientID, const char *TimeoutID);
+	void SavePlayerData(class CPlayerData *pData);
 	int GetHighScore();
 	int GetPlayerCount();
 
@@ -142,6 +143,16 @@ public:
 
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
 
+		// map download, requested chunks waiting for bandwidth
+		enum
+		{
+			MAX_MAP_CHUNK_QUEUE=32,
+		};
+		int m_aMapChunkQueue[MAX_MAP_CHUNK_QUEUE];
+		int m_MapChunkQueueStart;
+		int m_MapChunkQueueNum;
+		int m_MapDownloadBudget;
+
 		void Reset();
 
 		NETADDR m_Addr;
@@ -175,6 +186,11 @@ public:
 	unsigned m_CurrentMapCrc;
 	unsigned char *m_pCurrentMapData;
 	int m_CurrentMapSize;
+	unsigned char *m_pGeneratedMapData;
+	int m_GeneratedMapSize;
+	CMapGenInfo m_GeneratedMapInfo;
+	bool m_GeneratedMapInfoValid;
+	bool m_CurrentMapGenInfo; // the current map is m_pGeneratedMapData
 
 	bool m_ServerInfoHighLoad;
 	int64 m_ServerInfoFirstRequest;
@@ -214,6 +230,7 @@ public:
 	int MaxClients() const;
 
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) override;
+	bool ClientNeedsMsg(int ClientID, int Flags) override;
 
 	void DoSnapshot();
 	
@@ -224,7 +241,11 @@ public:
 
 	void SendRconType(int ClientID, bool UsernameReq);
 	void SendCapabilities(int ClientID);
+	void SendMapGen(int ClientID);
 	void SendMap(int ClientID);
+	void SendMapData(int ClientID, int Chunk);
+	void SendMapChunks(int ClientID);
+	void UpdateMapDownloads();
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser);
@@ -271,6 +292,7 @@ class CCache
 	void PumpNetwork(bool PacketWaiting);
 
 	virtual char *GetMapName();
+	virtual void SetGeneratedMap(unsigned char *pData, int Size, const CMapGenInfo *pInfo = 0);
 	int LoadMap(const char *pMapName);
 
 	int Run();
@@ -265,6 +265,20 @@ bool CConsole::LineIsValid(const char *pStr)
 }
 
 void CConsole::ExecuteLineStroked(int Stroke, const char *pStr, int ClientID)
+{
+	CParsedLine *pLine = ParseLine(pStr);
+	if(!pLine)
+	{
+		ExecuteLineUncached(Stroke, pStr, ClientID);
+		return;
+	}
+
+	pLine->m_Locked++;
+	ExecuteParsedLine(pLine, Stroke, ClientID);
+	pLine->m_Locked--;
+}
+
+void CConsole::ExecuteLineUncached(int Stroke, const char *pStr, int ClientID)
 {
 	int OutputLevel = OUTPUT_LEVEL_STANDARD;
 	
@@ -367,11 +381,62 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 	}
 }
 
-CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
+unsigned CConsole::HashName(const char *pName)
+{
+	// case insensitive, same as the lookups
+	unsigned Hash = 2166136261u;
+	for(; *pName; pName++)
+	{
+		char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a'-'A';
+		Hash = (Hash^(unsigned char)c)*16777619u;
+	}
+	return Hash;
+}
+
+void CConsole::AddCommandHash(CCommand *pCommand)
+{
+	// in front, like AddCommandSorted puts it before commands of the same name
+	CCommand **ppBucket = &m_apCommandHash[HashName(pCommand->m_pName)%COMMAND_HASH_SIZE];
+	pCommand->m_NameHash = HashName(pCommand->m_pName);
+	pCommand->m_pNextHash = *ppBucket;
+	*ppBucket = pCommand;
+}
+
+void CConsole::RemoveCommandHash(CCommand *pCommand)
+{
+	for(CCommand **ppLink = &m_apCommandHash[pCommand->m_NameHash%COMMAND_HASH_SIZE]; *ppLink; ppLink = &(*ppLink)->m_pNextHash)
+	{
+		if(*ppLink == pCommand)
+		{
+			*ppLink = pCommand->m_pNextHash;
+			break;
+		}
+	}
+	pCommand->m_pNextHash = 0;
+}
+
+void CConsole::RebuildCommandHash()
 {
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
 	{
-		if(pCommand->m_Flags&FlagMask)
+		// keep the list order within a bucket
+		CCommand **ppLink = &m_apCommandHash[pCommand->m_NameHash%COMMAND_HASH_SIZE];
+		while(*ppLink)
+			ppLink = &(*ppLink)->m_pNextHash;
+		pCommand->m_pNextHash = 0;
+		*ppLink = pCommand;
+	}
+}
+
+CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
+{
+	unsigned Hash = HashName(pName);
+	for(CCommand *pCommand = m_apCommandHash[Hash%COMMAND_HASH_SIZE]; pCommand; pCommand = pCommand->m_pNextHash)
+	{
+		if(pCommand->m_Flags&FlagMask && pCommand->m_NameHash == Hash)
 		{
 			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
 				return pCommand;
@@ -381,10 +446,218 @@ CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 	return 0x0;
 }
 
+bool CConsole::CompileLine(CParsedLine *pLine, const char *pStr)
+{
+	if(str_length(pStr) > CONSOLE_MAX_STR_LENGTH)
+		return false;
+
+	const char *pStart = pStr;
+	int StorageUsed = 0;
+	int NumArgs = 0;
+	str_copy(pLine->m_aLine, pStr, sizeof(pLine->m_aLine));
+	pLine->m_NumParts = 0;
+
+	while(pStr && *pStr)
+	{
+		CResult Result;
+		const char *pEnd = pStr;
+		const char *pNextPart = 0;
+		int InString = 0;
+
+		while(*pEnd)
+		{
+			if(*pEnd == '"')
+				InString ^= 1;
+			else if(*pEnd == '\\') // escape sequences
+			{
+				if(pEnd[1] == '"')
+					pEnd++;
+			}
+			else if(!InString)
+			{
+				if(*pEnd == ';') // command separator
+				{
+					pNextPart = pEnd+1;
+					break;
+				}
+				else if(*pEnd == '#') // comment, no need to do anything more
+					break;
+			}
+
+			pEnd++;
+		}
+
+		int Size = min((int)(pEnd-pStr) + 1, (int)sizeof(Result.m_aStringStorage));
+		if(ParseStart(&Result, pStr, Size) != 0)
+			break;
+
+		if(!*Result.m_pCommand)
+			break;
+
+		if(pLine->m_NumParts == MAX_LINE_PARTS || StorageUsed+Size > (int)sizeof(pLine->m_aStorage))
+			return false;
+
+		// stroke commands get their direction in front of these when they run
+		CCommand *pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
+		bool ParseError = pCommand && ParseArgs(&Result, pCommand->m_pParams);
+		if(NumArgs+Result.NumArguments() > MAX_PARTS)
+			return false;
+
+		CParsedLine::CPart *pPart = &pLine->m_aParts[pLine->m_NumParts++];
+		pPart->m_pCommand = pCommand;
+		pPart->m_LineOffset = pStr-pStart;
+		pPart->m_Storage = StorageUsed;
+		pPart->m_StorageSize = Size;
+		pPart->m_Command = Result.m_pCommand-Result.m_aStringStorage;
+		pPart->m_FirstArg = NumArgs;
+		pPart->m_NumArgs = Result.NumArguments();
+		pPart->m_ParseError = ParseError;
+
+		mem_copy(pLine->m_aStorage+StorageUsed, Result.m_aStringStorage, Size);
+		StorageUsed += Size;
+		for(int i = 0; i < Result.NumArguments(); i++)
+			pLine->m_aArgs[NumArgs++] = Result.m_apArgs[i]-Result.m_aStringStorage;
+
+		pStr = pNextPart;
+	}
+
+	return true;
+}
+
+CConsole::CParsedLine *CConsole::ParseLine(const char *pStr)
+{
+	unsigned Hash = 2166136261u;
+	int Length = 0;
+	for(; pStr[Length]; Length++)
+	{
+		if(Length == CONSOLE_MAX_STR_LENGTH)
+			return 0;
+		Hash = (Hash^(unsigned char)pStr[Length])*16777619u;
+	}
+
+	CParsedLine *pOldest = 0;
+	unsigned OldestUse = 0;
+	for(int i = 0; i < MAX_PARSED_LINES; i++)
+	{
+		CParsedLine *pLine = &m_aParsedLines[i];
+		bool Valid = pLine->m_Generation == m_Generation;
+		if(Valid && pLine->m_Hash == Hash && pLine->m_FlagMask == m_FlagMask && str_comp(pLine->m_aLine, pStr) == 0)
+		{
+			pLine->m_LastUse = ++m_ParseClock;
+			return pLine;
+		}
+
+		// lines that are still running can't be replaced
+		unsigned Use = Valid ? pLine->m_LastUse : 0;
+		if(!pLine->m_Locked && (!pOldest || Use < OldestUse))
+		{
+			pOldest = pLine;
+			OldestUse = Use;
+		}
+	}
+
+	if(!pOldest)
+		return 0;
+
+	if(!CompileLine(pOldest, pStr))
+	{
+		pOldest->m_Generation = -1;
+		return 0;
+	}
+
+	pOldest->m_Hash = Hash;
+	pOldest->m_FlagMask = m_FlagMask;
+	pOldest->m_Generation = m_Generation;
+	pOldest->m_LastUse = ++m_ParseClock;
+	return pOldest;
+}
+
+void CConsole::ExecuteParsedLine(CParsedLine *pLine, int Stroke, int ClientID)
+{
+	int OutputLevel = OUTPUT_LEVEL_STANDARD;
+
+	for(int i = 0; i < pLine->m_NumParts; i++)
+	{
+		const CParsedLine::CPart *pPart = &pLine->m_aParts[i];
+		if(pLine->m_Generation != m_Generation)
+		{
+			// a command on this line changed the command list, run the rest the old way
+			ExecuteLineUncached(Stroke, pLine->m_aLine+pPart->m_LineOffset, ClientID);
+			return;
+		}
+
+		CCommand *pCommand = pPart->m_pCommand;
+		const char *pName = pLine->m_aStorage+pPart->m_Storage+pPart->m_Command;
+
+		if(pCommand)
+		{
+			if(pCommand->GetAccessLevel() >= m_AccessLevel)
+			{
+				int IsStrokeCommand = pName[0] == '+';
+				if(Stroke || IsStrokeCommand)
+				{
+					if(pPart->m_ParseError)
+					{
+						char aBuf[256];
+						str_format(aBuf, sizeof(aBuf), "Invalid arguments... Usage: %s %s", pCommand->m_pName, pCommand->m_pParams);
+						Print(OutputLevel, "Console", aBuf);
+						continue;
+					}
+
+					CResult Result;
+					mem_copy(Result.m_aStringStorage, pLine->m_aStorage+pPart->m_Storage, pPart->m_StorageSize);
+					Result.m_pCommand = Result.m_aStringStorage+pPart->m_Command;
+					Result.m_pArgsStart = Result.m_aStringStorage;
+					if(IsStrokeCommand)
+					{
+						// insert the stroke direction token
+						Result.AddArgument(m_paStrokeStr[Stroke]);
+					}
+					for(int a = 0; a < pPart->m_NumArgs; a++)
+						Result.AddArgument(Result.m_aStringStorage+pLine->m_aArgs[pPart->m_FirstArg+a]);
+
+					if(m_StoreCommands && pCommand->m_Flags&CFGFLAG_STORE)
+					{
+						m_ExecutionQueue.AddEntry();
+						m_ExecutionQueue.m_pLast->m_pfnCommandCallback = pCommand->m_pfnCallback;
+						m_ExecutionQueue.m_pLast->m_pCommandUserData = pCommand->m_pUserData;
+						m_ExecutionQueue.m_pLast->m_Result = Result;
+					}
+					else
+						pCommand->m_pfnCallback(&Result, pCommand->m_pUserData);
+				}
+			}
+			else if(Stroke)
+			{
+				char aBuf[256];
+				str_format(aBuf, sizeof(aBuf), "Access for command %s denied.", pName);
+				Print(OutputLevel, "Console", aBuf);
+			}
+		}
+		else if(Stroke)
+		{
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "No such command: %s.", pName);
+			Print(OutputLevel, "Console", aBuf);
+		}
+	}
+}
+
 void CConsole::ExecuteLine(const char *pStr, int ClientID)
 {
-	CConsole::ExecuteLineStroked(1, pStr, ClientID); // press it
-	CConsole::ExecuteLineStroked(0, pStr, ClientID); // then release it
+	CParsedLine *pLine = ParseLine(pStr);
+	if(!pLine)
+	{
+		ExecuteLineUncached(1, pStr, ClientID); // press it
+		ExecuteLineUncached(0, pStr, ClientID); // then release it
+		return;
+	}
+
+	// the commands may execute lines of their own, keep this one from being replaced meanwhile
+	pLine->m_Locked++;
+	ExecuteParsedLine(pLine, 1, ClientID); // press it
+	ExecuteParsedLine(pLine, 0, ClientID); // then release it
+	pLine->m_Locked--;
 }
 
 void CConsole::ExecuteLineFlag(const char *pStr, int ClientID, int FlagMask)
@@ -521,6 +794,88 @@ void CConsole::ConModCommandStatus(IResult *pResult, void *pUser)
 		pConsole->Print(OUTPUT_LEVEL_STANDARD, "Console", aBuf);
 }
 
+void CConsole::ConBenchmark(IResult *pResult, void *pUser)
+{
+	CConsole* pConsole = static_cast<CConsole *>(pUser);
+	int Runs = pResult->NumArguments() ? clamp(pResult->GetInteger(0), 1, 100) : 20;
+
+	// one line per command, like a generated config
+	int NumLines = 0;
+	for(CCommand *pCommand = pConsole->m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+		if(pCommand->m_Flags&pConsole->m_FlagMask)
+			NumLines++;
+	if(!NumLines)
+		return;
+
+	char (*paLines)[64] = (char (*)[64])mem_alloc(NumLines*64, 1);
+	const char **ppNames = (const char **)mem_alloc(NumLines*sizeof(const char *), 1);
+	int Line = 0;
+	for(CCommand *pCommand = pConsole->m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	{
+		if(pCommand->m_Flags&pConsole->m_FlagMask)
+		{
+			ppNames[Line] = pCommand->m_pName;
+			str_format(paLines[Line++], 64, "%s 1", pCommand->m_pName);
+		}
+	}
+
+	// the old list walk against the index
+	int Found = 0;
+	int64 Start = time_get();
+	for(int r = 0; r < Runs; r++)
+		for(int i = 0; i < NumLines; i++)
+			for(CCommand *pCommand = pConsole->m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+				if(pCommand->m_Flags&pConsole->m_FlagMask && str_comp_nocase(pCommand->m_pName, ppNames[i]) == 0)
+				{
+					Found++;
+					break;
+				}
+	int64 WalkTime = time_get()-Start;
+
+	Start = time_get();
+	for(int r = 0; r < Runs; r++)
+		for(int i = 0; i < NumLines; i++)
+			if(pConsole->FindCommand(ppNames[i], pConsole->m_FlagMask))
+				Found++;
+	int64 HashTime = time_get()-Start;
+
+	// splitting and parsing every line, then the same for a handful of lines that are run again and again
+	CParsedLine *pScratch = (CParsedLine *)mem_alloc(sizeof(CParsedLine), 1);
+	Start = time_get();
+	for(int r = 0; r < Runs; r++)
+		for(int i = 0; i < NumLines; i++)
+			pConsole->CompileLine(pScratch, paLines[i]);
+	int64 ParseTime = time_get()-Start;
+	mem_free(pScratch);
+
+	// the cached run goes through the real cache, put the lines that were in it back afterwards
+	CParsedLine *pSavedLines = (CParsedLine *)mem_alloc(sizeof(pConsole->m_aParsedLines), 1);
+	mem_copy(pSavedLines, pConsole->m_aParsedLines, sizeof(pConsole->m_aParsedLines));
+	unsigned SavedClock = pConsole->m_ParseClock;
+
+	int NumRepeated = min(NumLines, (int)MAX_PARSED_LINES/2);
+	Start = time_get();
+	for(int r = 0; r < Runs; r++)
+		for(int i = 0; i < NumRepeated; i++)
+			pConsole->ParseLine(paLines[i]);
+	int64 CachedTime = time_get()-Start;
+
+	mem_copy(pConsole->m_aParsedLines, pSavedLines, sizeof(pConsole->m_aParsedLines));
+	pConsole->m_ParseClock = SavedClock;
+	mem_free(pSavedLines);
+
+	char aBuf[256];
+	double ToNs = 1000000000.0/time_freq();
+	str_format(aBuf, sizeof(aBuf), "%d commands: lookup %.0fns hashed, %.0fns walking the list", NumLines,
+		HashTime*ToNs/(Runs*NumLines), WalkTime*ToNs/(Runs*NumLines));
+	pConsole->Print(OUTPUT_LEVEL_STANDARD, "Console", aBuf);
+	str_format(aBuf, sizeof(aBuf), "parsing %.0fns per line, %.0fns for a line parsed before", ParseTime*ToNs/(Runs*NumLines), CachedTime*ToNs/(Runs*NumRepeated));
+	pConsole->Print(OUTPUT_LEVEL_STANDARD, "Console", aBuf);
+
+	mem_free(paLines);
+	mem_free(ppNames);
+}
+
 struct CIntVariableData
 {
 	IConsole *m_pConsole;
@@ -684,6 +1039,16 @@ CConsole::CConsole(int FlagMask)
 
 	m_pStorage = 0;
 
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
+	m_Generation = 0;
+	m_ParseClock = 0;
+	for(int i = 0; i < MAX_PARSED_LINES; i++)
+	{
+		m_aParsedLines[i].m_Generation = -1;
+		m_aParsedLines[i].m_LastUse = 0;
+		m_aParsedLines[i].m_Locked = 0;
+	}
+
 	// register some basic commands
 	Register("echo", "r", CFGFLAG_SERVER|CFGFLAG_CLIENT, Con_Echo, this, "Echo the text");
 	Register("exec", "r", CFGFLAG_SERVER|CFGFLAG_CLIENT, Con_Exec, this, "Execute the specified file");
@@ -693,6 +1058,7 @@ CConsole::CConsole(int FlagMask)
 
 	Register("mod_command", "s?i", CFGFLAG_SERVER, ConModCommandAccess, this, "Specify command accessibility for moderators");
 	Register("mod_status", "", CFGFLAG_SERVER, ConModCommandStatus, this, "List all commands which are accessible for moderators");
+	Register("console_benchmark", "?i", CFGFLAG_CLIENT, ConBenchmark, this, "Time command lookup and line parsing (runs)");
 
 	// TODO: this should disappear
 	#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Flags,Desc) \
@@ -782,7 +1148,11 @@ void CConsole::Register(const char *pName, const char *pParams,
 	pCommand->m_Temp = false;
 
 	if(DoAdd)
+	{
 		AddCommandSorted(pCommand);
+		AddCommandHash(pCommand);
+	}
+	m_Generation++;
 }
 
 void CConsole::RegisterTemp(const char *pName, const char *pParams,	int Flags, const char *pHelp)
@@ -817,6 +1187,8 @@ void CConsole::RegisterTemp(const char *pName, const char *pParams,	int Flags, c
 	pCommand->m_Temp = true;
 
 	AddCommandSorted(pCommand);
+	AddCommandHash(pCommand);
+	m_Generation++;
 }
 
 void CConsole::DeregisterTemp(const char *pName)
@@ -846,6 +1218,8 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHash(pRemoved);
+		m_Generation++;
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -869,6 +1243,9 @@ void CConsole::DeregisterTempAll()
 
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
+
+	RebuildCommandHash();
+	m_Generation++;
 }
 
 void CConsole::Con_Chain(IResult *pResult, void *pUserData)
@@ -916,9 +1293,10 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	unsigned Hash = HashName(pName);
+	for(CCommand *pCommand = m_apCommandHash[Hash%COMMAND_HASH_SIZE]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
-		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
+		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp && pCommand->m_NameHash == Hash)
 		{
 			if(str_comp_nocase(pCommand->m_pName, pName) == 0)
 				return pCommand;
@@ -12,6 +12,8 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
+		unsigned m_NameHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -58,6 +60,7 @@ class CConsole : public IConsole
 	static void ConToggleStroke(IResult *pResult, void *pUser);
 	static void ConModCommandAccess(IResult *pResult, void *pUser);
 	static void ConModCommandStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConBenchmark(IConsole::IResult *pResult, void *pUser);
 
 	void ExecuteFileRecurse(const char *pFilename);
 	void ExecuteLineStroked(int Stroke, const char *pStr, int ClientID);
@@ -151,6 +154,66 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	// lines executed before, already split, looked up and parsed. binds,
+	// votes and tune commands go through the same few lines over and over
+	enum
+	{
+		MAX_PARSED_LINES=64,
+		MAX_LINE_PARTS=8,
+	};
+
+	class CParsedLine
+	{
+	public:
+		class CPart
+		{
+		public:
+			CCommand *m_pCommand;
+			int m_LineOffset;
+			int m_Storage;
+			int m_StorageSize;
+			int m_Command;
+			int m_FirstArg;
+			int m_NumArgs;
+			bool m_ParseError;
+		};
+
+		unsigned m_Hash;
+		int m_FlagMask;
+		int m_Generation;
+		unsigned m_LastUse;
+		int m_Locked;
+
+		char m_aLine[CONSOLE_MAX_STR_LENGTH+1];
+		char m_aStorage[CONSOLE_MAX_STR_LENGTH+1+MAX_LINE_PARTS];
+		short m_aArgs[MAX_PARTS];
+		CPart m_aParts[MAX_LINE_PARTS];
+		int m_NumParts;
+	};
+
+	CParsedLine m_aParsedLines[MAX_PARSED_LINES];
+	unsigned m_ParseClock;
+
+	// bumped whenever commands come or go, parsed lines of older generations are dropped
+	int m_Generation;
+
+	bool CompileLine(CParsedLine *pLine, const char *pStr);
+	CParsedLine *ParseLine(const char *pStr);
+	void ExecuteLineUncached(int Stroke, const char *pStr, int ClientID);
+	void ExecuteParsedLine(CParsedLine *pLine, int Stroke, int ClientID);
+
+	enum
+	{
+		COMMAND_HASH_SIZE=1024,
+	};
+
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
+	static unsigned HashName(const char *pName);
+	void AddCommandHash(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
+	void RebuildCommandHash();
+
 	void AddCommandSorted(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
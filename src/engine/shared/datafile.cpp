@@ -5,7 +5,9 @@
 
 #include <base/hash_ctxt.h>
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/storage.h>
+#include <engine/shared/jobs.h>
 
 // MapGen
 #include <game/mapitems.h>
@@ -13,7 +15,9 @@
 
 #include "uuid_manager.h"
 
+#include <atomic>
 #include <cstdlib>
+#include <thread>
 
 static const int DEBUG = 0;
 
@@ -92,16 +96,106 @@ struct CDatafileInfo
 
 struct CDatafile
 {
-	IOHANDLE m_File;
+	const unsigned char *m_pMemory; // whole file, owned by the reader's CDatafileSource
+	unsigned m_MemorySize;
 	SHA256_DIGEST m_Sha256;
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
+	bool *m_pDataBorrowed; // points into m_pMemory instead of being allocated
 	char *m_pData;
 };
 
+class CDatafileSource
+{
+public:
+	unsigned char *m_pData;
+	unsigned m_Size;
+	bool m_Mapped;
+
+	CDatafileSource() :
+		m_pData(0), m_Size(0), m_Mapped(false) {}
+	~CDatafileSource()
+	{
+		if (m_Mapped)
+			io_unmap(m_pData, m_Size);
+		else
+			free(m_pData);
+	}
+};
+
+static char *DatafileInflate(const unsigned char *pCompressed, int CompressedSize, unsigned long UncompressedSize)
+{
+	char *pData = (char *)malloc(UncompressedSize);
+	unsigned long s = UncompressedSize;
+	if (uncompress((Bytef *)pData, &s, (const Bytef *)pCompressed, CompressedSize) != Z_OK)
+		dbg_msg("datafile", "failed to uncompress data");
+	return pData;
+}
+
+// inflates one compressed data item on the job pool. whoever claims the
+// job first does the work, the reader only waits for it when a worker
+// is already on it
+class CDatafileInflateJob : public IJob
+{
+	enum
+	{
+		PENDING = 0,
+		CLAIMED,
+		DONE,
+	};
+
+	std::shared_ptr<CDatafileSource> m_pSource;
+	const unsigned char *m_pCompressed;
+	int m_CompressedSize;
+	unsigned long m_UncompressedSize;
+	std::atomic<int> m_State;
+	char *m_pOutput;
+
+	bool Claim()
+	{
+		int Expected = PENDING;
+		return m_State.compare_exchange_strong(Expected, CLAIMED);
+	}
+
+	virtual void Run()
+	{
+		if (!Claim())
+			return;
+		m_pOutput = DatafileInflate(m_pCompressed, m_CompressedSize, m_UncompressedSize);
+		m_State.store(DONE);
+	}
+
+public:
+	CDatafileInflateJob(std::shared_ptr<CDatafileSource> pSource, const unsigned char *pCompressed, int CompressedSize, unsigned long UncompressedSize) :
+		m_pSource(pSource), m_pCompressed(pCompressed), m_CompressedSize(CompressedSize), m_UncompressedSize(UncompressedSize), m_State(PENDING), m_pOutput(0) {}
+	~CDatafileInflateJob() { free(m_pOutput); }
+
+	// returns the inflated data, or 0 if no worker started yet and the
+	// caller has to inflate it itself
+	char *Take()
+	{
+		if (Claim())
+			return 0;
+		while (m_State.load() != DONE)
+			thread_yield();
+		char *pOutput = m_pOutput;
+		m_pOutput = 0;
+		return pOutput;
+	}
+
+	// makes a job that didn't start yet skip the work
+	void Cancel() { Claim(); }
+};
+
+static void DatafileHash(const unsigned char *pData, unsigned Size, unsigned *pCrc, SHA256_CTX *pSha256Ctxt)
+{
+	*pCrc = crc32(*pCrc, pData, Size);
+	sha256_update(pSha256Ctxt, pData, Size);
+}
+
 bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
@@ -113,39 +207,93 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
-	// take the CRC of the file and store it
+	enum
+	{
+		BUFFER_SIZE = 64 * 1024
+	};
+
+	// map the file if we can, read it whole otherwise. either way it's
+	// touched once and the CRC and SHA256 are taken in the same pass
+	std::shared_ptr<CDatafileSource> pSource = std::make_shared<CDatafileSource>();
+	unsigned Crc = 0;
+	SHA256_CTX Sha256Ctxt;
+	sha256_init(&Sha256Ctxt);
+
+	pSource->m_pData = (unsigned char *)io_map(File, &pSource->m_Size);
+	if (pSource->m_pData)
+	{
+		pSource->m_Mapped = true;
+		for (unsigned Pos = 0; Pos < pSource->m_Size; Pos += BUFFER_SIZE)
+			DatafileHash(pSource->m_pData + Pos, minimum(pSource->m_Size - Pos, (unsigned)BUFFER_SIZE), &Crc, &Sha256Ctxt);
+	}
+	else
+	{
+		long int Length = io_length(File);
+		if (Length > 0)
+		{
+			pSource->m_pData = (unsigned char *)malloc(Length);
+			while (pSource->m_Size < (unsigned)Length)
+			{
+				unsigned Bytes = io_read(File, pSource->m_pData + pSource->m_Size, minimum((unsigned)Length - pSource->m_Size, (unsigned)BUFFER_SIZE));
+				if (Bytes <= 0)
+					break;
+				DatafileHash(pSource->m_pData + pSource->m_Size, Bytes, &Crc, &Sha256Ctxt);
+				pSource->m_Size += Bytes;
+			}
+		}
+	}
+	io_close(File);
+
+	return OpenImpl(pSource, sha256_finish(&Sha256Ctxt), Crc, pFilename);
+}
+
+bool CDataFileReader::OpenMemory(const void *pData, unsigned Size, const char *pName)
+{
+	dbg_msg("datafile", "loading from memory. name='%s' size=%u", pName, Size);
+
+	if (!pData || Size < sizeof(CDatafileHeader))
+	{
+		dbg_msg("datafile", "no data for '%s'", pName);
+		return false;
+	}
+
+	// keep a private copy so the caller can drop its buffer, checksums are taken in the same pass
+	std::shared_ptr<CDatafileSource> pSource = std::make_shared<CDatafileSource>();
+	pSource->m_pData = (unsigned char *)malloc(Size);
+	pSource->m_Size = Size;
 	unsigned Crc = 0;
-	SHA256_DIGEST Sha256;
+	SHA256_CTX Sha256Ctxt;
+	sha256_init(&Sha256Ctxt);
 	{
 		enum
 		{
 			BUFFER_SIZE = 64 * 1024
 		};
 
-		SHA256_CTX Sha256Ctxt;
-		sha256_init(&Sha256Ctxt);
-		unsigned char aBuffer[BUFFER_SIZE];
-
-		while (true)
+		for (unsigned Pos = 0; Pos < Size; Pos += BUFFER_SIZE)
 		{
-			unsigned Bytes = io_read(File, aBuffer, BUFFER_SIZE);
-			if (Bytes <= 0)
-				break;
-			Crc = crc32(Crc, aBuffer, Bytes);
-			sha256_update(&Sha256Ctxt, aBuffer, Bytes);
+			unsigned Bytes = minimum(Size - Pos, (unsigned)BUFFER_SIZE);
+			mem_copy(pSource->m_pData + Pos, (const unsigned char *)pData + Pos, Bytes);
+			DatafileHash(pSource->m_pData + Pos, Bytes, &Crc, &Sha256Ctxt);
 		}
-		Sha256 = sha256_finish(&Sha256Ctxt);
-
-		io_seek(File, 0, IOSEEK_START);
 	}
 
+	return OpenImpl(pSource, sha256_finish(&Sha256Ctxt), Crc, pName);
+}
+
+bool CDataFileReader::OpenImpl(std::shared_ptr<CDatafileSource> pSource, SHA256_DIGEST Sha256, unsigned Crc, const char *pFilename)
+{
+	const unsigned char *pMemory = pSource->m_pData;
+	unsigned MemorySize = pSource->m_Size;
+
 	// TODO: change this header
 	CDatafileHeader Header;
-	if (sizeof(Header) != io_read(File, &Header, sizeof(Header)))
+	if (MemorySize < sizeof(Header))
 	{
 		dbg_msg("datafile", "couldn't load header");
 		return false;
 	}
+	mem_copy(&Header, pMemory, sizeof(Header));
 	if (Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
 	{
 		if (Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
@@ -175,32 +323,35 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	unsigned AllocSize = Size;
 	AllocSize += sizeof(CDatafile);					   // add space for info structure
 	AllocSize += Header.m_NumRawData * sizeof(void *); // add space for data pointers
+	AllocSize += Header.m_NumRawData * sizeof(bool);   // add space for the borrowed flags
+
+	// types, offsets, sizes and item data are copied, they get swapped on big endian
+	unsigned ReadSize = minimum(Size, MemorySize - (unsigned)sizeof(CDatafileHeader));
+	if (ReadSize != Size)
+	{
+		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
+		return false;
+	}
 
 	CDatafile *pTmpDataFile = (CDatafile *)malloc(AllocSize);
 	pTmpDataFile->m_Header = Header;
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile + 1) + Header.m_NumRawData * sizeof(char *);
-	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pDataBorrowed = (bool *)(pTmpDataFile->m_pData + Size);
+	pTmpDataFile->m_pMemory = pMemory;
+	pTmpDataFile->m_MemorySize = MemorySize;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
-
-	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
-	if (ReadSize != Size)
-	{
-		io_close(pTmpDataFile->m_File);
-		free(pTmpDataFile);
-		pTmpDataFile = 0;
-		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
-		return false;
-	}
+	mem_zero(pTmpDataFile->m_pDataBorrowed, Header.m_NumRawData * sizeof(bool));
+	mem_copy(pTmpDataFile->m_pData, pMemory + sizeof(CDatafileHeader), Size);
 
 	Close();
 	m_pDataFile = pTmpDataFile;
+	m_pSource = pSource;
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(m_pDataFile->m_pData, sizeof(int), minimum(static_cast<unsigned>(Header.m_Swaplen), Size) / sizeof(int));
@@ -230,6 +381,27 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	return true;
 }
 
+void CDataFileReader::PrefetchData(IEngine *pEngine)
+{
+	if (!m_pDataFile || !pEngine || m_pDataFile->m_Header.m_Version != 4)
+		return;
+
+	m_vpInflateJobs.resize(m_pDataFile->m_Header.m_NumRawData);
+	for (int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+	{
+		if (m_pDataFile->m_ppDataPtrs[i] || m_vpInflateJobs[i])
+			continue;
+
+		int DataSize = GetFileDataSize(i);
+		const unsigned char *pCompressed = FileData(i, DataSize);
+		if (!pCompressed)
+			continue;
+
+		m_vpInflateJobs[i] = std::make_shared<CDatafileInflateJob>(m_pSource, pCompressed, DataSize, m_pDataFile->m_Info.m_pDataSizes[i]);
+		pEngine->AddJob(m_vpInflateJobs[i]);
+	}
+}
+
 int CDataFileReader::NumData() const
 {
 	if (!m_pDataFile)
@@ -266,6 +438,17 @@ int CDataFileReader::GetDataSize(int Index)
 		return GetFileDataSize(Index);
 }
 
+const unsigned char *CDataFileReader::FileData(int Index, int Size)
+{
+	unsigned Pos = m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
+	if (Size < 0 || Pos > m_pDataFile->m_MemorySize || (unsigned)Size > m_pDataFile->m_MemorySize - Pos)
+	{
+		dbg_msg("datafile", "data index=%d is out of the file", Index);
+		return 0;
+	}
+	return m_pDataFile->m_pMemory + Pos;
+}
+
 void *CDataFileReader::GetDataImpl(int Index, int Swap)
 {
 	if (!m_pDataFile)
@@ -281,41 +464,45 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	{
 		// fetch the data size
 		int DataSize = GetFileDataSize(Index);
+		const unsigned char *pFileData = FileData(Index, DataSize);
+		if (!pFileData)
+			return 0;
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		int SwapSize = DataSize;
 #endif
 
 		if (m_pDataFile->m_Header.m_Version == 4)
 		{
-			// v4 has compressed data
-			void *pTemp = malloc(DataSize);
+			// v4 has compressed data, a prefetch job may have done it already
 			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long s;
-
-			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
-
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			char *pData = 0;
+			if (Index < (int)m_vpInflateJobs.size() && m_vpInflateJobs[Index])
+			{
+				pData = m_vpInflateJobs[Index]->Take();
+				m_vpInflateJobs[Index] = nullptr;
+			}
 
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef *)pTemp, DataSize);
+			if (!pData)
+			{
+				dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
+				pData = DatafileInflate(pFileData, DataSize, UncompressedSize);
+			}
+			m_pDataFile->m_ppDataPtrs[Index] = pData;
 #if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = s;
+			SwapSize = UncompressedSize;
 #endif
-
-			// clean up the temporary buffers
-			free(pTemp);
 		}
 		else
 		{
-			// load the data
+			// uncompressed data is used right out of the file, the mapping is copy on write
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+#if defined(CONF_ARCH_ENDIAN_BIG)
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			mem_copy(m_pDataFile->m_ppDataPtrs[Index], pFileData, DataSize);
+#else
+			m_pDataFile->m_ppDataPtrs[Index] = (char *)pFileData;
+			m_pDataFile->m_pDataBorrowed[Index] = true;
+#endif
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -343,8 +530,10 @@ void CDataFileReader::UnloadData(int Index)
 		return;
 
 	//
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	if (!m_pDataFile->m_pDataBorrowed[Index])
+		free(m_pDataFile->m_ppDataPtrs[Index]);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
+	m_pDataFile->m_pDataBorrowed[Index] = false;
 }
 
 int CDataFileReader::GetItemSize(int Index) const
@@ -486,9 +675,16 @@ bool CDataFileReader::Close()
 	// free the data that is loaded
 	int i;
 	for (i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		free(m_pDataFile->m_ppDataPtrs[i]);
+		if (!m_pDataFile->m_pDataBorrowed[i])
+			free(m_pDataFile->m_ppDataPtrs[i]);
+
+	// jobs that are already running finish on their own, they keep the source alive
+	for (unsigned j = 0; j < m_vpInflateJobs.size(); j++)
+		if (m_vpInflateJobs[j])
+			m_vpInflateJobs[j]->Cancel();
+	m_vpInflateJobs.clear();
 
-	io_close(m_pDataFile->m_File);
+	m_pSource = nullptr;
 	free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
@@ -524,14 +720,17 @@ int CDataFileReader::MapSize() const
 
 IOHANDLE CDataFileReader::File()
 {
-	if (!m_pDataFile)
-		return 0;
-	return m_pDataFile->m_File;
+	// the file is closed as soon as it's mapped or read
+	return 0;
 }
 
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_ToMemory = false;
+	m_pMemory = 0;
+	m_MemorySize = 0;
+	m_MemoryCapacity = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(calloc(MAX_ITEM_TYPES, sizeof(CItemTypeInfo)));
 	m_pItems = static_cast<CItemInfo *>(calloc(MAX_ITEMS, sizeof(CItemInfo)));
 	m_pDatas = static_cast<CDataInfo *>(calloc(MAX_DATAS, sizeof(CDataInfo)));
@@ -544,11 +743,16 @@ CDataFileWriter::~CDataFileWriter()
 	for (int i = 0; i < m_NumItems; i++)
 		free(m_pItems[i].m_pData);
 	for (int i = 0; i < m_NumDatas; ++i)
+	{
 		free(m_pDatas[i].m_pCompressedData);
+		free(m_pDatas[i].m_pUncompressedData);
+	}
 	free(m_pItems);
 	m_pItems = 0;
 	free(m_pDatas);
 	m_pDatas = 0;
+	free(m_pMemory);
+	m_pMemory = 0;
 }
 
 bool CDataFileWriter::OpenFile(class IStorage *pStorage, const char *pFilename, int StorageType)
@@ -563,6 +767,8 @@ void CDataFileWriter::Init()
 	dbg_assert(!m_File, "a file already exists");
 	m_NumItems = 0;
 	m_NumDatas = 0;
+	m_NumCompressedDatas = 0;
+	m_PendingDataSize = 0;
 	m_NumItemTypes = 0;
 	m_NumExtendedItemTypes = 0;
 	mem_zero(m_pItemTypes, sizeof(CItemTypeInfo) * MAX_ITEM_TYPES);
@@ -581,6 +787,44 @@ bool CDataFileWriter::Open(class IStorage *pStorage, const char *pFilename, int
 	return OpenFile(pStorage, pFilename, StorageType);
 }
 
+void CDataFileWriter::OpenMemory()
+{
+	Init();
+	dbg_assert(!m_ToMemory, "a memory file already exists");
+	free(m_pMemory);
+	m_pMemory = 0;
+	m_MemorySize = 0;
+	m_MemoryCapacity = 0;
+	m_ToMemory = true;
+}
+
+unsigned char *CDataFileWriter::ReleaseMemory(int *pSize)
+{
+	unsigned char *pMemory = m_pMemory;
+	*pSize = m_MemorySize;
+	m_pMemory = 0;
+	m_MemorySize = 0;
+	m_MemoryCapacity = 0;
+	return pMemory;
+}
+
+void CDataFileWriter::Write(const void *pData, int Size)
+{
+	if (!m_ToMemory)
+	{
+		io_write(m_File, pData, Size);
+		return;
+	}
+
+	if (m_MemorySize + Size > m_MemoryCapacity)
+	{
+		m_MemoryCapacity = maximum(m_MemoryCapacity * 2, m_MemorySize + Size);
+		m_pMemory = (unsigned char *)realloc(m_pMemory, m_MemoryCapacity);
+	}
+	mem_copy(m_pMemory + m_MemorySize, pData, Size);
+	m_MemorySize += Size;
+}
+
 int CDataFileWriter::GetTypeFromIndex(int Index)
 {
 	return ITEMTYPE_EX - Index - 1;
@@ -645,26 +889,91 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems - 1;
 }
 
-int CDataFileWriter::AddData(int Size, void *pData, int CompressionLevel)
+static void CompressDataInfo(int Index, int UncompressedSize, const void *pData, int CompressionLevel, int *pCompressedSize, void **ppCompressedData)
 {
-	dbg_assert(m_NumDatas < 1024, "too much data");
-
-	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
-	void *pCompData = malloc(s); // temporary buffer that we use during compression
+	unsigned long s = compressBound(UncompressedSize);
+	void *pCompData = malloc(s);
 
-	int Result = compress2((Bytef *)pCompData, &s, (Bytef *)pData, Size, CompressionLevel);
+	int Result = compress2((Bytef *)pCompData, &s, (const Bytef *)pData, UncompressedSize, CompressionLevel);
 	if (Result != Z_OK)
 	{
-		dbg_msg("datafile", "compression error %d", Result);
+		dbg_msg("datafile", "compression error %d, data=%d", Result, Index);
 		dbg_assert(0, "zlib error");
 	}
 
+	*pCompressedSize = (int)s;
+	*ppCompressedData = realloc(pCompData, maximum((int)s, 1));
+}
+
+struct CCompressWork
+{
+	std::atomic<int> m_Next;
+	int m_End;
+	void *m_pDatas;
+	void (*m_pfnCompress)(void *pDatas, int Index);
+};
+
+static void CompressWorker(void *pUser)
+{
+	CCompressWork *pWork = (CCompressWork *)pUser;
+	for (int i = pWork->m_Next++; i < pWork->m_End; i = pWork->m_Next++)
+		pWork->m_pfnCompress(pWork->m_pDatas, i);
+}
+
+void CDataFileWriter::CompressPendingData()
+{
+	struct CCompress
+	{
+		static void Run(void *pDatas, int Index)
+		{
+			CDataInfo *pInfo = &((CDataInfo *)pDatas)[Index];
+			CompressDataInfo(Index, pInfo->m_UncompressedSize, pInfo->m_pUncompressedData, pInfo->m_CompressionLevel, &pInfo->m_CompressedSize, &pInfo->m_pCompressedData);
+			free(pInfo->m_pUncompressedData);
+			pInfo->m_pUncompressedData = 0;
+		}
+	};
+
+	int NumPending = m_NumDatas - m_NumCompressedDatas;
+	if (NumPending <= 0)
+		return;
+
+	// every item is compressed on its own with the same settings as before,
+	// so the output doesn't depend on which thread got which item
+	CCompressWork Work;
+	Work.m_Next = m_NumCompressedDatas;
+	Work.m_End = m_NumDatas;
+	Work.m_pDatas = m_pDatas;
+	Work.m_pfnCompress = CCompress::Run;
+
+	int NumThreads = minimum(minimum((int)std::thread::hardware_concurrency(), (int)MAX_COMPRESS_THREADS), NumPending) - 1;
+	void *apThreads[MAX_COMPRESS_THREADS];
+	for (int i = 0; i < NumThreads; i++)
+		apThreads[i] = thread_init(CompressWorker, &Work);
+	CompressWorker(&Work);
+	for (int i = 0; i < NumThreads; i++)
+		if (apThreads[i])
+			thread_wait(apThreads[i]);
+
+	m_NumCompressedDatas = m_NumDatas;
+	m_PendingDataSize = 0;
+}
+
+int CDataFileWriter::AddData(int Size, void *pData, int CompressionLevel)
+{
+	dbg_assert(m_NumDatas < 1024, "too much data");
+
+	// compression is deferred to Finish, or until the pending data gets over budget
+	if (m_PendingDataSize > 0 && m_PendingDataSize + Size > COMPRESS_BUDGET)
+		CompressPendingData();
+
+	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
 	pInfo->m_UncompressedSize = Size;
-	pInfo->m_CompressedSize = (int)s;
-	pInfo->m_pCompressedData = malloc(pInfo->m_CompressedSize);
-	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
-	free(pCompData);
+	pInfo->m_CompressedSize = 0;
+	pInfo->m_pCompressedData = 0;
+	pInfo->m_pUncompressedData = malloc(maximum(Size, 1));
+	pInfo->m_CompressionLevel = CompressionLevel;
+	mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	m_PendingDataSize += Size;
 
 	m_NumDatas++;
 	return m_NumDatas - 1;
@@ -688,7 +997,7 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 
 int CDataFileWriter::Finish()
 {
-	if (!m_File)
+	if (!m_File && !m_ToMemory)
 		return 1;
 
 	int ItemSize = 0;
@@ -696,6 +1005,8 @@ int CDataFileWriter::Finish()
 	int DataSize = 0;
 	CDatafileHeader Header;
 
+	CompressPendingData();
+
 	// we should now write this file!
 	if (DEBUG)
 		dbg_msg("datafile", "writing");
@@ -744,7 +1055,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&Header, sizeof(int), sizeof(Header) / sizeof(int));
 #endif
-		io_write(m_File, &Header, sizeof(Header));
+		Write(&Header, sizeof(Header));
 	}
 
 	// write types
@@ -762,7 +1073,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			swap_endian(&Info, sizeof(int), sizeof(CDatafileItemType) / sizeof(int));
 #endif
-			io_write(m_File, &Info, sizeof(Info));
+			Write(&Info, sizeof(Info));
 			Count += m_pItemTypes[i].m_Num;
 		}
 	}
@@ -782,7 +1093,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 				swap_endian(&Temp, sizeof(int), sizeof(Temp) / sizeof(int));
 #endif
-				io_write(m_File, &Temp, sizeof(Temp));
+				Write(&Temp, sizeof(Temp));
 				Offset += m_pItems[k].m_Size + sizeof(CDatafileItem);
 
 				// next
@@ -800,7 +1111,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&Temp, sizeof(int), sizeof(Temp) / sizeof(int));
 #endif
-		io_write(m_File, &Temp, sizeof(Temp));
+		Write(&Temp, sizeof(Temp));
 		Offset += m_pDatas[i].m_CompressedSize;
 	}
 
@@ -813,7 +1124,7 @@ int CDataFileWriter::Finish()
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		swap_endian(&UncompressedSize, sizeof(int), sizeof(UncompressedSize) / sizeof(int));
 #endif
-		io_write(m_File, &UncompressedSize, sizeof(UncompressedSize));
+		Write(&UncompressedSize, sizeof(UncompressedSize));
 	}
 
 	// write m_pItems
@@ -835,8 +1146,8 @@ int CDataFileWriter::Finish()
 				swap_endian(&Item, sizeof(int), sizeof(Item) / sizeof(int));
 				swap_endian(m_pItems[k].m_pData, sizeof(int), m_pItems[k].m_Size / sizeof(int));
 #endif
-				io_write(m_File, &Item, sizeof(Item));
-				io_write(m_File, m_pItems[k].m_pData, m_pItems[k].m_Size);
+				Write(&Item, sizeof(Item));
+				Write(m_pItems[k].m_pData, m_pItems[k].m_Size);
 
 				// next
 				k = m_pItems[k].m_Next;
@@ -849,7 +1160,7 @@ int CDataFileWriter::Finish()
 	{
 		if (DEBUG)
 			dbg_msg("datafile", "writing data id=%d size=%d", i, m_pDatas[i].m_CompressedSize);
-		io_write(m_File, m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
+		Write(m_pDatas[i].m_pCompressedData, m_pDatas[i].m_CompressedSize);
 	}
 
 	// free data
@@ -864,8 +1175,10 @@ int CDataFileWriter::Finish()
 		m_pDatas[i].m_pCompressedData = 0;
 	}
 
-	io_close(m_File);
+	if (m_File)
+		io_close(m_File);
 	m_File = 0;
+	m_ToMemory = false;
 
 	if (DEBUG)
 		dbg_msg("datafile", "done");
@@ -876,7 +1189,6 @@ int CDataFileWriter::Finish()
 bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMap, const char *pFileName, char *pBlocksData, int BlocksDataSize)
 {
 	dbg_msg("CDataFileWriter", "saving to '%s'...", pFileName);
-	char aBuf[128];
 
 	if(!Open(pStorage, pFileName))
 	{
@@ -884,6 +1196,31 @@ bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMa
 		return 0;
 	}
 
+	AddMapItems(pFileMap);
+
+	// finish the data file
+	Finish();
+	dbg_msg("CDataFileWriter", "saving done");
+
+	return true;
+}
+
+bool CDataFileWriter::SaveMapToMemory(CDataFileReader *pFileMap, unsigned char **ppData, int *pSize)
+{
+	dbg_msg("CDataFileWriter", "saving to memory...");
+
+	OpenMemory();
+	AddMapItems(pFileMap);
+	Finish();
+	*ppData = ReleaseMemory(pSize);
+	dbg_msg("CDataFileWriter", "saving done. size=%d", *pSize);
+
+	return *ppData != 0;
+}
+
+void CDataFileWriter::AddMapItems(CDataFileReader *pFileMap)
+{
+	char aBuf[128];
 
 	// save version
 	{
@@ -1049,12 +1386,6 @@ bool CDataFileWriter::SaveMap(class IStorage *pStorage, CDataFileReader *pFileMa
 		int TotalSizePoints = sizeof(CEnvPoint)*Count;
 		AddItem(MAPITEMTYPE_ENVPOINTS, 0, TotalSizePoints, pPoints);
 	}
-
-	// finish the data file
-	Finish();
-	dbg_msg("CDataFileWriter", "saving done");
-
-	return true;
 }
 
 bool CDataFileWriter::CreateEmptyMap(class IStorage *pStorage, const char *pFileName, int w, int h, CImageInfoFile *pTileset)
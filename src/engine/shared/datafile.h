@@ -10,6 +10,9 @@
 
 #include <zlib.h>
 
+#include <memory>
+#include <vector>
+
 enum
 {
 	ITEMTYPE_EX = 0xffff,
@@ -48,6 +51,13 @@ public:
 class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
+	// the file contents, mapped or in memory. inflate jobs hold on to it
+	// too so they can outlive Close
+	std::shared_ptr<class CDatafileSource> m_pSource;
+	std::vector<std::shared_ptr<class CDatafileInflateJob>> m_vpInflateJobs;
+
+	bool OpenImpl(std::shared_ptr<CDatafileSource> pSource, SHA256_DIGEST Sha256, unsigned Crc, const char *pFilename);
+	const unsigned char *FileData(int Index, int Size);
 	void *GetDataImpl(int Index, int Swap);
 	int GetFileDataSize(int Index);
 
@@ -62,8 +72,13 @@ public:
 	bool IsOpen() const { return m_pDataFile != nullptr; }
 
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	bool OpenMemory(const void *pData, unsigned Size, const char *pName); // copies the data
 	bool Close();
 
+	// inflates all compressed data on the engine's job pool, GetData picks
+	// the results up or waits for the item it asks for
+	void PrefetchData(class IEngine *pEngine);
+
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index);
@@ -91,6 +106,8 @@ class CDataFileWriter
 		int m_UncompressedSize;
 		int m_CompressedSize;
 		void *m_pCompressedData;
+		void *m_pUncompressedData; // waiting for CompressPendingData
+		int m_CompressionLevel;
 	};
 
 	struct CItemInfo
@@ -116,11 +133,21 @@ class CDataFileWriter
 		MAX_ITEMS = 1024,
 		MAX_DATAS = 1024,
 		MAX_EXTENDED_ITEM_TYPES = 64,
+
+		// uncompressed data kept around before it gets compressed in one parallel batch
+		COMPRESS_BUDGET = 64 * 1024 * 1024,
+		MAX_COMPRESS_THREADS = 16,
 	};
 
 	IOHANDLE m_File;
+	bool m_ToMemory;
+	unsigned char *m_pMemory;
+	int m_MemorySize;
+	int m_MemoryCapacity;
 	int m_NumItems;
 	int m_NumDatas;
+	int m_NumCompressedDatas;
+	int m_PendingDataSize;
 	int m_NumItemTypes;
 	int m_NumExtendedItemTypes;
 	CItemTypeInfo *m_pItemTypes;
@@ -130,6 +157,9 @@ class CDataFileWriter
 
 	int GetExtendedItemTypeIndex(int Type);
 	int GetTypeFromIndex(int Index);
+	void Write(const void *pData, int Size);
+	void CompressPendingData();
+	void AddMapItems(CDataFileReader *pFileMap);
 
 public:
 	CDataFileWriter();
@@ -137,6 +167,8 @@ public:
 	void Init();
 	bool OpenFile(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
+	void OpenMemory();
+	unsigned char *ReleaseMemory(int *pSize); // hands the written file over to the caller, free() it
 	int AddData(int Size, void *pData, int CompressionLevel = Z_DEFAULT_COMPRESSION);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
@@ -145,6 +177,7 @@ public:
 	// MapGen
 	bool CreateEmptyMap(class IStorage *pStorage, const char *pFileName, int w, int h, CImageInfoFile *pTileset = 0x0);
 	bool SaveMap(class IStorage *pStorage, CDataFileReader *pFileMap, const char *pFileName, char *pBlocksData = 0x0, int BlocksDataSize = 0);
+	bool SaveMapToMemory(CDataFileReader *pFileMap, unsigned char **ppData, int *pSize);
 };
 
 
@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/lock_scope.h>
 #include <base/math.h>
 #include <base/system.h>
 
@@ -17,6 +18,7 @@ static const unsigned char gs_ActVersion = 4;
 static const unsigned char gs_OldVersion = 3;
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const unsigned char gs_aKeyFrameIndexMarker[4] = {'T', 'W', 'K', 'I'};
 
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
@@ -24,10 +26,26 @@ CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta)
 	m_File = 0;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+
+	m_pWriterThread = 0;
+	m_QueueLock = lock_create();
+	semaphore_init(&m_QueuedSem);
+	semaphore_init(&m_FreeSlotSem);
+	for(int i = 0; i < MAX_QUEUED_CHUNKS; i++)
+		semaphore_signal(&m_FreeSlotSem);
+	m_QueueStart = 0;
+	m_QueueNum = 0;
+}
+
+CDemoRecorder::~CDemoRecorder()
+{
+	lock_destroy(m_QueueLock);
+	semaphore_destroy(&m_QueuedSem);
+	semaphore_destroy(&m_FreeSlotSem);
 }
 
 // Record
-int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType)
+int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetVersion, const char *pMap, unsigned Crc, const char *pType, const void *pMapData, unsigned MapDataSize)
 {
 	CDemoHeader Header;
 	CTimelineMarkers TimelineMarkers;
@@ -36,18 +54,22 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 	m_pConsole = pConsole;
 
-	// open mapfile
+	// open mapfile, unless the caller already has it in memory
 	char aMapFilename[128];
-	// try the normal maps folder
-	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
-	IOHANDLE MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
-	if(!MapFile)
+	IOHANDLE MapFile = 0;
+	if(!pMapData)
+	{
+		// try the normal maps folder
+		str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pMap);
+		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	}
+	if(!MapFile && !pMapData)
 	{
 		// try the downloaded maps
 		str_format(aMapFilename, sizeof(aMapFilename), "downloadedmaps/%s_%08x.map", pMap, Crc);
 		MapFile = pStorage->OpenFile(aMapFilename, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
-	if(!MapFile)
+	if(!MapFile && !pMapData)
 	{
 		// search for the map within subfolders
 		char aBuf[512];
@@ -55,7 +77,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 		if(pStorage->FindFile(aMapFilename, "maps", IStorage::TYPE_ALL, aBuf, sizeof(aBuf)))
 			MapFile = pStorage->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
 	}
-	if(!MapFile)
+	if(!MapFile && !pMapData)
 	{
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "Unable to open mapfile '%s'", pMap);
@@ -66,7 +88,8 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	IOHANDLE DemoFile = pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 	if(!DemoFile)
 	{
-		io_close(MapFile);
+		if(MapFile)
+			io_close(MapFile);
 		MapFile = 0;
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "Unable to open '%s' for recording", pFilename);
@@ -80,7 +103,7 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	Header.m_Version = gs_ActVersion;
 	str_copy(Header.m_aNetversion, pNetVersion, sizeof(Header.m_aNetversion));
 	str_copy(Header.m_aMapName, pMap, sizeof(Header.m_aMapName));
-	unsigned MapSize = io_length(MapFile);
+	unsigned MapSize = MapFile ? io_length(MapFile) : MapDataSize;
 	Header.m_aMapSize[0] = (MapSize>>24)&0xff;
 	Header.m_aMapSize[1] = (MapSize>>16)&0xff;
 	Header.m_aMapSize[2] = (MapSize>>8)&0xff;
@@ -96,26 +119,36 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	io_write(DemoFile, &TimelineMarkers, sizeof(TimelineMarkers)); // fill this on stop
 
 	// write map data
-	while(1)
+	if(MapFile)
 	{
-		unsigned char aChunk[1024*64];
-		int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
-		if(Bytes <= 0)
-			break;
-		io_write(DemoFile, &aChunk, Bytes);
+		while(1)
+		{
+			unsigned char aChunk[1024*64];
+			int Bytes = io_read(MapFile, &aChunk, sizeof(aChunk));
+			if(Bytes <= 0)
+				break;
+			io_write(DemoFile, &aChunk, Bytes);
+		}
+		io_close(MapFile);
 	}
-	io_close(MapFile);
+	else
+		io_write(DemoFile, pMapData, MapDataSize);
 
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_WriterLastTickMarker = -1;
+	m_lKeyFrames.clear();
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", aBuf);
 	m_File = DemoFile;
 
+	// encoding and file io happen on the writer thread from here on
+	m_pWriterThread = thread_init(WriterThread, this);
+
 	return 0;
 }
 
@@ -140,6 +173,7 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_KEYFRAMEINDEX = 0,
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
@@ -147,16 +181,144 @@ enum
 	CHUNKFLAG_BIGSIZE = 0x10
 };
 
+/*
+	Keyframe index trailer
+
+	Written as the last chunk of the file. It uses the otherwise unused
+	chunk type 0, so readers that do not know about it skip it like any
+	other chunk. All integers are big endian.
+
+		4	= Number of keyframes
+		4	= First tick
+		4	= Last tick
+		8*n	= Filepos, tick of each keyframe
+		4	= Filepos of the chunk header
+		4	= Marker 'TWKI'
+*/
+
+enum
+{
+	QUEUEDTYPE_SNAPSHOT=0,
+	QUEUEDTYPE_MESSAGE,
+	QUEUEDTYPE_STOP,
+
+	KEYFRAMEINDEX_HEADERSIZE = 12,
+	KEYFRAMEINDEX_FOOTERSIZE = 8,
+	KEYFRAMEINDEX_MAXSIZE = 0xffff,
+};
+
+static void IntToBytes(unsigned char *pBytes, int Value)
+{
+	pBytes[0] = (Value>>24)&0xff;
+	pBytes[1] = (Value>>16)&0xff;
+	pBytes[2] = (Value>>8)&0xff;
+	pBytes[3] = (Value)&0xff;
+}
+
+static int BytesToInt(const unsigned char *pBytes)
+{
+	return (pBytes[0]<<24) | (pBytes[1]<<16) | (pBytes[2]<<8) | pBytes[3];
+}
+
+void CDemoRecorder::Enqueue(int Type, int Tick, int Keyframe, const void *pData, int Size)
+{
+	CQueuedChunk *pChunk = (CQueuedChunk *)mem_alloc(sizeof(CQueuedChunk)+Size, 1);
+	pChunk->m_Type = Type;
+	pChunk->m_Tick = Tick;
+	pChunk->m_Keyframe = Keyframe;
+	pChunk->m_Size = Size;
+	if(Size)
+		mem_copy(pChunk+1, pData, Size);
+
+	// blocks if the writer falls too far behind
+	semaphore_wait(&m_FreeSlotSem);
+	{
+		CLockScope ls(m_QueueLock);
+		m_apQueue[(m_QueueStart+m_QueueNum)%MAX_QUEUED_CHUNKS] = pChunk;
+		m_QueueNum++;
+	}
+	semaphore_signal(&m_QueuedSem);
+}
+
+CDemoRecorder::CQueuedChunk *CDemoRecorder::Dequeue()
+{
+	CQueuedChunk *pChunk;
+	semaphore_wait(&m_QueuedSem);
+	{
+		CLockScope ls(m_QueueLock);
+		pChunk = m_apQueue[m_QueueStart];
+		m_QueueStart = (m_QueueStart+1)%MAX_QUEUED_CHUNKS;
+		m_QueueNum--;
+	}
+	semaphore_signal(&m_FreeSlotSem);
+	return pChunk;
+}
+
+void CDemoRecorder::WriterThread(void *pUser)
+{
+	CDemoRecorder *pSelf = (CDemoRecorder *)pUser;
+
+	while(1)
+	{
+		CQueuedChunk *pChunk = pSelf->Dequeue();
+		bool Stop = pChunk->m_Type == QUEUEDTYPE_STOP;
+		if(!Stop)
+			pSelf->WriteChunk(pChunk);
+		mem_free(pChunk);
+		if(Stop)
+			break;
+	}
+}
+
+void CDemoRecorder::WriteChunk(const CQueuedChunk *pChunk)
+{
+	const void *pData = pChunk+1;
+
+	if(pChunk->m_Type == QUEUEDTYPE_MESSAGE)
+	{
+		Write(CHUNKTYPE_MESSAGE, pData, pChunk->m_Size);
+		return;
+	}
+
+	if(pChunk->m_Keyframe)
+	{
+		// remember where the keyframe starts for the index
+		CKeyFrameEntry Entry;
+		Entry.m_Filepos = io_tell(m_File);
+		Entry.m_Tick = pChunk->m_Tick;
+		m_lKeyFrames.add(Entry);
+
+		// write full tickmarker
+		WriteTickMarker(pChunk->m_Tick, 1);
+
+		// write snapshot
+		Write(CHUNKTYPE_SNAPSHOT, pData, pChunk->m_Size);
+
+		mem_copy(m_aLastSnapshotData, pData, pChunk->m_Size);
+	}
+	else
+	{
+		// write tickmarker
+		WriteTickMarker(pChunk->m_Tick, 0);
+
+		// create delta
+		int DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, m_aDeltaData);
+		if(DeltaSize)
+		{
+			// record delta
+			Write(CHUNKTYPE_DELTA, m_aDeltaData, DeltaSize);
+			mem_copy(m_aLastSnapshotData, pData, pChunk->m_Size);
+		}
+	}
+}
+
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 {
-	if(m_LastTickMarker == -1 || Tick-m_LastTickMarker > 63 || Keyframe)
+	if(m_WriterLastTickMarker == -1 || Tick-m_WriterLastTickMarker > 63 || Keyframe)
 	{
 		unsigned char aChunk[5];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER;
-		aChunk[1] = (Tick>>24)&0xff;
-		aChunk[2] = (Tick>>16)&0xff;
-		aChunk[3] = (Tick>>8)&0xff;
-		aChunk[4] = (Tick)&0xff;
+		IntToBytes(&aChunk[1], Tick);
 
 		if(Keyframe)
 			aChunk[0] |= CHUNKTICKFLAG_KEYFRAME;
@@ -166,19 +328,15 @@ void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
 	else
 	{
 		unsigned char aChunk[1];
-		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_LastTickMarker);
+		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | (Tick-m_WriterLastTickMarker);
 		io_write(m_File, aChunk, sizeof(aChunk));
 	}
 
-	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
+	m_WriterLastTickMarker = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
 {
-	char aBuffer[64*1024];
-	char aBuffer2[64*1024];
 	unsigned char aChunk[3];
 
 	if(!m_File)
@@ -186,13 +344,13 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 
 	/* pad the data with 0 so we get an alignment of 4,
 	else the compression won't work and miss some bytes */
-	mem_copy(aBuffer2, pData, Size);
+	mem_copy(m_aCompressBuffer2, pData, Size);
 	while(Size&3)
-		aBuffer2[Size++] = 0;
-	Size = CVariableInt::Compress(aBuffer2, Size, aBuffer, sizeof(aBuffer)); // buffer2 -> buffer
+		m_aCompressBuffer2[Size++] = 0;
+	Size = CVariableInt::Compress(m_aCompressBuffer2, Size, m_aCompressBuffer, sizeof(m_aCompressBuffer)); // buffer2 -> buffer
 	if(Size < 0)
 		return;
-	Size = CNetBase::Compress(aBuffer, Size, aBuffer2, sizeof(aBuffer2)); // buffer -> buffer2
+	Size = CNetBase::Compress(m_aCompressBuffer, Size, m_aCompressBuffer2, sizeof(m_aCompressBuffer2)); // buffer -> buffer2
 
 
 	aChunk[0] = ((Type&0x3)<<5);
@@ -218,44 +376,65 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 		}
 	}
 
-	io_write(m_File, aBuffer2, Size);
+	io_write(m_File, m_aCompressBuffer2, Size);
 }
 
-void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+void CDemoRecorder::WriteKeyFrameIndex()
 {
-	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
+	int NumKeyFrames = m_lKeyFrames.size();
+	int Size = KEYFRAMEINDEX_HEADERSIZE + NumKeyFrames*8 + KEYFRAMEINDEX_FOOTERSIZE;
+	if(NumKeyFrames == 0 || Size > KEYFRAMEINDEX_MAXSIZE)
+		return; // players fall back to scanning the file
+
+	unsigned char *pIndex = (unsigned char *)mem_alloc(Size, 1);
+	unsigned char *pData = pIndex;
+	IntToBytes(pData, NumKeyFrames); pData += 4;
+	IntToBytes(pData, m_FirstTick); pData += 4;
+	IntToBytes(pData, m_LastTickMarker); pData += 4;
+	for(int i = 0; i < NumKeyFrames; i++)
 	{
-		// write full tickmarker
-		WriteTickMarker(Tick, 1);
+		IntToBytes(pData, m_lKeyFrames[i].m_Filepos); pData += 4;
+		IntToBytes(pData, m_lKeyFrames[i].m_Tick); pData += 4;
+	}
 
-		// write snapshot
-		Write(CHUNKTYPE_SNAPSHOT, pData, Size);
+	io_seek(m_File, 0, IOSEEK_END);
+	int ChunkPos = io_tell(m_File);
+	IntToBytes(pData, ChunkPos); pData += 4;
+	mem_copy(pData, gs_aKeyFrameIndexMarker, sizeof(gs_aKeyFrameIndexMarker));
+
+	// stored raw, chunk type 0
+	unsigned char aChunk[3];
+	aChunk[0] = ((CHUNKTYPE_KEYFRAMEINDEX&0x3)<<5) | 31;
+	aChunk[1] = Size&0xff;
+	aChunk[2] = Size>>8;
+	io_write(m_File, aChunk, sizeof(aChunk));
+	io_write(m_File, pIndex, Size);
+	mem_free(pIndex);
+	m_lKeyFrames.clear();
+}
+
+void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+{
+	if(!m_File)
+		return;
 
+	int Keyframe = m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5;
+	if(Keyframe)
 		m_LastKeyFrame = Tick;
-		mem_copy(m_aLastSnapshotData, pData, Size);
-	}
-	else
-	{
-		// create delta, prepend tick
-		char aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
-		int DeltaSize;
 
-		// write tickmarker
-		WriteTickMarker(Tick, 0);
+	m_LastTickMarker = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
 
-		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
-		if(DeltaSize)
-		{
-			// record delta
-			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
-			mem_copy(m_aLastSnapshotData, pData, Size);
-		}
-	}
+	Enqueue(QUEUEDTYPE_SNAPSHOT, Tick, Keyframe, pData, Size);
 }
 
 void CDemoRecorder::RecordMessage(const void *pData, int Size)
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(!m_File)
+		return;
+
+	Enqueue(QUEUEDTYPE_MESSAGE, m_LastTickMarker, 0, pData, Size);
 }
 
 int CDemoRecorder::Stop()
@@ -263,6 +442,13 @@ int CDemoRecorder::Stop()
 	if(!m_File)
 		return -1;
 
+	// let the writer drain the queue
+	Enqueue(QUEUEDTYPE_STOP, m_LastTickMarker, 0, 0, 0);
+	thread_wait(m_pWriterThread);
+	m_pWriterThread = 0;
+
+	WriteKeyFrameIndex();
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -389,6 +575,58 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+bool CDemoPlayer::ReadKeyFrameIndex()
+{
+	long StartPos = io_tell(m_File);
+	long FileLength = io_length(m_File);
+	if(FileLength < StartPos + 3 + KEYFRAMEINDEX_HEADERSIZE + KEYFRAMEINDEX_FOOTERSIZE)
+		return false;
+
+	// the footer tells where the index chunk starts
+	unsigned char aFooter[KEYFRAMEINDEX_FOOTERSIZE];
+	io_seek(m_File, FileLength - KEYFRAMEINDEX_FOOTERSIZE, IOSEEK_START);
+	if(io_read(m_File, aFooter, sizeof(aFooter)) != sizeof(aFooter) ||
+		mem_comp(&aFooter[4], gs_aKeyFrameIndexMarker, sizeof(gs_aKeyFrameIndexMarker)) != 0)
+		return false;
+
+	int ChunkPos = BytesToInt(aFooter);
+	if(ChunkPos < StartPos || ChunkPos >= FileLength)
+		return false;
+
+	int ChunkType, ChunkSize, ChunkTick = 0;
+	io_seek(m_File, ChunkPos, IOSEEK_START);
+	if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick) || ChunkType != CHUNKTYPE_KEYFRAMEINDEX ||
+		io_tell(m_File) + ChunkSize != FileLength || ChunkSize < KEYFRAMEINDEX_HEADERSIZE + KEYFRAMEINDEX_FOOTERSIZE)
+		return false;
+
+	unsigned char *pIndex = (unsigned char *)mem_alloc(ChunkSize, 1);
+	if(io_read(m_File, pIndex, ChunkSize) != (unsigned)ChunkSize)
+	{
+		mem_free(pIndex);
+		return false;
+	}
+
+	int NumKeyFrames = BytesToInt(pIndex);
+	if(NumKeyFrames <= 0 || KEYFRAMEINDEX_HEADERSIZE + NumKeyFrames*8 + KEYFRAMEINDEX_FOOTERSIZE != ChunkSize)
+	{
+		mem_free(pIndex);
+		return false;
+	}
+
+	m_Info.m_Info.m_FirstTick = BytesToInt(pIndex+4);
+	m_Info.m_Info.m_LastTick = BytesToInt(pIndex+8);
+	m_Info.m_SeekablePoints = NumKeyFrames;
+	m_pKeyFrames = (CKeyFrame*)mem_alloc(NumKeyFrames*sizeof(CKeyFrame), 1);
+	const unsigned char *pEntry = pIndex + KEYFRAMEINDEX_HEADERSIZE;
+	for(int i = 0; i < NumKeyFrames; i++, pEntry += 8)
+	{
+		m_pKeyFrames[i].m_Filepos = BytesToInt(pEntry);
+		m_pKeyFrames[i].m_Tick = BytesToInt(pEntry+4);
+	}
+	mem_free(pIndex);
+	return true;
+}
+
 void CDemoPlayer::ScanFile()
 {
 	long StartPos;
@@ -402,6 +640,12 @@ void CDemoPlayer::ScanFile()
 	StartPos = io_tell(m_File);
 	m_Info.m_SeekablePoints = 0;
 
+	// newer demos carry a keyframe index at the end of the file
+	bool HasIndex = ReadKeyFrameIndex();
+	io_seek(m_File, StartPos, IOSEEK_START);
+	if(HasIndex)
+		return;
+
 	while(1)
 	{
 		long CurrentPos = io_tell(m_File);
@@ -477,6 +721,14 @@ void CDemoPlayer::DoTick()
 			break;
 		}
 
+		if(ChunkType == CHUNKTYPE_KEYFRAMEINDEX)
+		{
+			// the index trailer is always the last chunk
+			m_pConsole->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "demo_player", "end of file");
+			Pause();
+			break;
+		}
+
 		// read the chunk
 		if(ChunkSize)
 		{
@@ -719,18 +971,21 @@ int CDemoPlayer::SetPos(float Percent)
 	// -5 because we have to have a current tick and previous tick when we do the playback
 	WantedTick = m_Info.m_Info.m_FirstTick + (int)((m_Info.m_Info.m_LastTick-m_Info.m_Info.m_FirstTick)*Percent) - 5;
 
-	Keyframe = (int)(m_Info.m_SeekablePoints*Percent);
-
-	if(Keyframe < 0 || Keyframe >= m_Info.m_SeekablePoints)
+	if(m_Info.m_SeekablePoints <= 0)
 		return -1;
 
-	// get correct key frame
-	if(m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-		while(Keyframe < m_Info.m_SeekablePoints-1 && m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-			Keyframe++;
-
-	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
-		Keyframe--;
+	// get the last key frame at or before the wanted tick
+	int Low = 0;
+	int High = m_Info.m_SeekablePoints-1;
+	while(Low < High)
+	{
+		int Mid = (Low+High+1)/2;
+		if(m_pKeyFrames[Mid].m_Tick > WantedTick)
+			High = Mid-1;
+		else
+			Low = Mid;
+	}
+	Keyframe = Low;
 
 	// seek to the correct keyframe
 	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
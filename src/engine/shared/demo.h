@@ -3,6 +3,9 @@
 #ifndef ENGINE_SHARED_DEMO_H
 #define ENGINE_SHARED_DEMO_H
 
+#include <base/system.h>
+#include <base/tl/array.h>
+
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
@@ -10,22 +13,67 @@
 
 class CDemoRecorder : public IDemoRecorder
 {
+	enum
+	{
+		// number of chunks the tick thread may queue before it has to wait for the writer
+		MAX_QUEUED_CHUNKS=64,
+	};
+
+	// a chunk handed over from the tick thread, the payload follows the struct
+	struct CQueuedChunk
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Keyframe;
+		int m_Size;
+	};
+
+	struct CKeyFrameEntry
+	{
+		int m_Filepos;
+		int m_Tick;
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
+	class CSnapshotDelta *m_pSnapshotDelta;
+
+	// tick thread state
 	int m_LastTickMarker;
 	int m_LastKeyFrame;
 	int m_FirstTick;
-	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
-	class CSnapshotDelta *m_pSnapshotDelta;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 
+	// chunk queue between the tick thread and the writer thread
+	void *m_pWriterThread;
+	LOCK m_QueueLock;
+	SEMAPHORE m_QueuedSem;
+	SEMAPHORE m_FreeSlotSem;
+	CQueuedChunk *m_apQueue[MAX_QUEUED_CHUNKS];
+	int m_QueueStart;
+	int m_QueueNum;
+
+	// writer thread state
+	int m_WriterLastTickMarker;
+	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+	char m_aDeltaData[CSnapshot::MAX_SIZE+sizeof(int)];
+	char m_aCompressBuffer[CSnapshot::MAX_SIZE];
+	char m_aCompressBuffer2[CSnapshot::MAX_SIZE];
+	array<CKeyFrameEntry> m_lKeyFrames;
+
+	void Enqueue(int Type, int Tick, int Keyframe, const void *pData, int Size);
+	CQueuedChunk *Dequeue();
+	static void WriterThread(void *pUser);
+	void WriteChunk(const CQueuedChunk *pChunk);
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
+	void WriteKeyFrameIndex();
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta);
+	~CDemoRecorder();
 
-	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType);
+	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType, const void *pMapData = 0, unsigned MapDataSize = 0);
 	int Stop();
 	void AddDemoMarker();
 
@@ -97,6 +145,7 @@ private:
 
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
+	bool ReadKeyFrameIndex();
 	void ScanFile();
 	int NextFrame();
 
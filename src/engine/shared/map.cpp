@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/map.h>
 #include <engine/storage.h>
 #include "datafile.h"
@@ -32,6 +33,18 @@ public:
 		return m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL);
 	}
 
+	virtual bool LoadMemory(const char *pMapName, const void *pData, unsigned Size)
+	{
+		return m_DataFile.OpenMemory(pData, Size, pMapName);
+	}
+
+	virtual void PrefetchData()
+	{
+		// maps created outside of the kernel, like the map generator's, load inline
+		if(Kernel())
+			m_DataFile.PrefetchData(Kernel()->RequestInterface<IEngine>());
+	}
+
 	virtual bool IsLoaded()
 	{
 		return m_DataFile.IsOpen();
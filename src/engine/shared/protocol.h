@@ -85,6 +85,9 @@ enum
 	MAX_INPUT_SIZE=128,
 	MAX_SNAPSHOT_PACKSIZE=900,
 
+	// map download, every NETMSG_MAP_DATA but the last carries this much
+	MAP_CHUNK_SIZE=1024-128,
+
 	MAX_NAME_LENGTH=16,
 	MAX_CLAN_LENGTH=12,
 
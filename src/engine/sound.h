@@ -18,6 +18,11 @@ public:
 
 	virtual bool IsSoundEnabled() = 0;
 
+	// hands out sample ids in call order, game thread only. -1 when sound is off or full
+	virtual int ReserveSample() = 0;
+	// decodes a wavpack file into a reserved sample at the mixing rate, safe on worker threads
+	virtual bool DecodeWV(int SampleID, const char *pFilename) = 0;
+	// reserves and decodes in one go on the calling thread
 	virtual int LoadWV(const char *pFilename) = 0;
 
 	virtual void SetChannel(int ChannelID, float Volume, float Panning) = 0;
@@ -37,6 +42,9 @@ public:
 	virtual int Init() = 0;
 	virtual int Update() = 0;
 	virtual int Shutdown() = 0;
+
+	// mixes NumVoices voices into memory Runs times, scalar and vectorised, and prints the cost per callback
+	virtual void Benchmark(int NumVoices, int Runs, class IConsole *pConsole) = 0;
 };
 
 extern IEngineSound *CreateEngineSound();
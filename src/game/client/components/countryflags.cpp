@@ -10,8 +10,14 @@
 #include <engine/shared/config.h>
 #include <engine/shared/linereader.h>
 
+#include <game/client/gameclient.h>
+#include <game/client/loadjobs.h>
+
 #include "countryflags.h"
 
+#include <memory>
+#include <vector>
+
 
 void CCountryFlags::LoadCountryflagsIndexfile()
 {
@@ -22,6 +28,13 @@ void CCountryFlags::LoadCountryflagsIndexfile()
 		return;
 	}
 
+	struct CPendingFlag
+	{
+		CCountryFlag m_Flag;
+		std::shared_ptr<CPngLoadJob> m_pJob;
+	};
+	std::vector<CPendingFlag> aPending;
+
 	char aOrigin[128];
 	CLineReader LineReader;
 	LineReader.Init(File);
@@ -56,40 +69,47 @@ void CCountryFlags::LoadCountryflagsIndexfile()
 			continue;
 		}
 
-		// load the graphic file
-		char aBuf[128];
-		CImageInfo Info;
+		// add entry, the graphic file decodes on the job pool
+		CPendingFlag Pending;
+		Pending.m_Flag.m_CountryCode = CountryCode;
+		str_copy(Pending.m_Flag.m_aCountryCodeString, aOrigin, sizeof(Pending.m_Flag.m_aCountryCodeString));
+		Pending.m_Flag.m_Texture = -1;
 		if(g_Config.m_ClLoadCountryFlags)
 		{
+			char aBuf[128];
 			str_format(aBuf, sizeof(aBuf), "countryflags/%s.png", aOrigin);
-			if(!Graphics()->LoadPNG(&Info, aBuf, IStorage::TYPE_ALL))
+			Pending.m_pJob = std::make_shared<CPngLoadJob>(Graphics(), aBuf, IStorage::TYPE_ALL);
+			m_pClient->StartLoadJob(Pending.m_pJob);
+		}
+		aPending.push_back(Pending);
+	}
+	io_close(File);
+
+	// upload in index order
+	for(unsigned i = 0; i < aPending.size(); i++)
+	{
+		CCountryFlag CountryFlag = aPending[i].m_Flag;
+		CPngLoadJob *pJob = aPending[i].m_pJob.get();
+		if(pJob)
+		{
+			pJob->Wait();
+			if(!pJob->m_Loaded)
 			{
 				char aMsg[128];
-				str_format(aMsg, sizeof(aMsg), "failed to load '%s'", aBuf);
+				str_format(aMsg, sizeof(aMsg), "failed to load '%s'", pJob->m_aFilename);
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "countryflags", aMsg);
 				continue;
 			}
+			CountryFlag.m_Texture = Graphics()->LoadTextureRaw(pJob->m_Image.m_Width, pJob->m_Image.m_Height, pJob->m_Image.m_Format, pJob->m_Image.m_pData, pJob->m_Image.m_Format, 0);
 		}
-
-		// add entry
-		CCountryFlag CountryFlag;
-		CountryFlag.m_CountryCode = CountryCode;
-		str_copy(CountryFlag.m_aCountryCodeString, aOrigin, sizeof(CountryFlag.m_aCountryCodeString));
-		if(g_Config.m_ClLoadCountryFlags)
-		{
-			CountryFlag.m_Texture = Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-			mem_free(Info.m_pData);
-		}
-		else
-			CountryFlag.m_Texture = -1;
 		if(g_Config.m_Debug)
 		{
-			str_format(aBuf, sizeof(aBuf), "loaded country flag '%s'", aOrigin);
+			char aBuf[128];
+			str_format(aBuf, sizeof(aBuf), "loaded country flag '%s'", CountryFlag.m_aCountryCodeString);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "countryflags", aBuf);
 		}
 		m_aCountryFlags.add_unsorted(CountryFlag);
 	}
-	io_close(File);
 	m_aCountryFlags.sort_range();
 
 	// find index of default item
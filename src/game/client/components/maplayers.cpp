@@ -27,11 +27,79 @@ CMapLayers::CMapLayers(int t)
 	m_EnvelopeUpdate = false;
 }
 
+void CMapLayers::OnConsoleInit()
+{
+	// one command drives both instances
+	if(m_Type == TYPE_BACKGROUND)
+		Console()->Register("map_benchmark", "?i", CFGFLAG_CLIENT, ConMapBenchmark, this, "Time map layer rendering with and without the tile cache (frames)");
+}
+
 void CMapLayers::OnInit()
 {
 	m_pLayers = Layers();
 }
 
+void CMapLayers::ClearTileCaches()
+{
+	for(int i = 0; i < m_lTileCaches.size(); i++)
+		RenderTools()->RenderTilemapFree(&m_lTileCaches[i]);
+	m_lTileCaches.clear();
+}
+
+void CMapLayers::OnStateChange(int NewState, int OldState)
+{
+	if(NewState == IClient::STATE_OFFLINE)
+		ClearTileCaches();
+}
+
+void CMapLayers::OnMapLoad()
+{
+	ClearTileCaches();
+	m_lTileCaches.set_size(m_pLayers->NumLayers());
+}
+
+void CMapLayers::ConMapBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CMapLayers *pSelf = (CMapLayers *)pUserData;
+	CMapLayers *pForeGround = pSelf->m_pClient->m_pMapLayersForeGround;
+	if((pSelf->Client()->State() != IClient::STATE_ONLINE && pSelf->Client()->State() != IClient::STATE_DEMOPLAYBACK) || !pSelf->m_pLayers->GameLayer())
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "maplayers", "no map loaded");
+		return;
+	}
+
+	// sweep the camera over the game layer, with gfx_null this only measures the game side
+	int Frames = pResult->NumArguments() ? maximum(pResult->GetInteger(0), 1) : 500;
+	CMapItemLayerTilemap *pGameLayer = pSelf->m_pLayers->GameLayer();
+	vec2 SavedCenter = pSelf->m_pClient->m_pCamera->m_Center;
+	int SavedCache = g_Config.m_GfxTileCache;
+	char aBuf[256];
+
+	for(int Cached = 0; Cached < 2; Cached++)
+	{
+		g_Config.m_GfxTileCache = Cached;
+		pSelf->Graphics()->WaitForIdle();
+		int64 Start = time_get();
+		for(int f = 0; f < Frames; f++)
+		{
+			float t = f/(float)Frames;
+			pSelf->m_pClient->m_pCamera->m_Center = vec2(t*pGameLayer->m_Width*32.0f, (0.5f+0.4f*sinf(t*2*pi))*pGameLayer->m_Height*32.0f);
+			pSelf->OnRender();
+			pForeGround->OnRender();
+			pSelf->Graphics()->Swap();
+		}
+		pSelf->Graphics()->WaitForIdle();
+		int64 Time = time_get()-Start;
+
+		str_format(aBuf, sizeof(aBuf), "%s: %d frames, %.3fms per frame", Cached ? "tile cache" : "immediate", Frames,
+			(double)Time*1000.0/time_freq()/Frames);
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "maplayers", aBuf);
+	}
+
+	g_Config.m_GfxTileCache = SavedCache;
+	pSelf->m_pClient->m_pCamera->m_Center = SavedCenter;
+}
+
 void CMapLayers::EnvelopeUpdate()
 {
 	if(Client()->State() == IClient::STATE_DEMOPLAYBACK)
@@ -215,13 +283,27 @@ void CMapLayers::OnRender()
 						Graphics()->TextureSet(m_pClient->m_pMapimages->Get(pTMap->m_Image));
 
 					CTile *pTiles = (CTile *)m_pLayers->Map()->GetData(pTMap->m_Data);
-					Graphics()->BlendNone();
 					vec4 Color = vec4(pTMap->m_Color.r/255.0f, pTMap->m_Color.g/255.0f, pTMap->m_Color.b/255.0f, pTMap->m_Color.a/255.0f);
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
-					Graphics()->BlendNormal();
-					RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
-													EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					int LayerIndex = pGroup->m_StartLayer+l;
+					if(g_Config.m_GfxTileCache && LayerIndex < m_lTileCaches.size())
+					{
+						CTilemapCache *pCache = &m_lTileCaches[LayerIndex];
+						Graphics()->BlendNone();
+						RenderTools()->RenderTilemapCached(pCache, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemapCached(pCache, pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
+					else
+					{
+						Graphics()->BlendNone();
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_OPAQUE,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+						Graphics()->BlendNormal();
+						RenderTools()->RenderTilemap(pTiles, pTMap->m_Width, pTMap->m_Height, 32.0f, Color, TILERENDERFLAG_EXTEND|LAYERRENDERFLAG_TRANSPARENT,
+														EnvelopeEval, this, pTMap->m_ColorEnv, pTMap->m_ColorEnvOffset);
+					}
 				}
 				else if(pLayer->m_Type == LAYERTYPE_QUADS)
 				{
@@ -2,7 +2,9 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef GAME_CLIENT_COMPONENTS_MAPLAYERS_H
 #define GAME_CLIENT_COMPONENTS_MAPLAYERS_H
+#include <base/tl/array.h>
 #include <game/client/component.h>
+#include <game/client/render.h>
 
 class CMapLayers : public CComponent
 {
@@ -12,8 +14,13 @@ class CMapLayers : public CComponent
 	int m_LastLocalTick;
 	bool m_EnvelopeUpdate;
 
+	// one per map layer, baked the first time the layer is drawn
+	array<CTilemapCache> m_lTileCaches;
+
 	void MapScreenToGroup(float CenterX, float CenterY, CMapItemGroup *pGroup);
+	void ClearTileCaches();
 	static void EnvelopeEval(float TimeOffset, int Env, float *pChannels, void *pUser);
+	static void ConMapBenchmark(IConsole::IResult *pResult, void *pUserData);
 public:
 	enum
 	{
@@ -22,7 +29,10 @@ public:
 	};
 
 	CMapLayers(int Type);
+	virtual void OnConsoleInit();
 	virtual void OnInit();
+	virtual void OnStateChange(int NewState, int OldState);
+	virtual void OnMapLoad();
 	virtual void OnRender();
 
 	void EnvelopeUpdate();
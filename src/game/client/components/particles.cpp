@@ -3,6 +3,7 @@
 #include <base/math.h>
 #include <engine/graphics.h>
 #include <engine/demo.h>
+#include <engine/shared/config.h>
 
 #include <game/generated/client_data.h>
 #include <game/client/render.h>
@@ -11,28 +12,113 @@
 
 CParticles::CParticles()
 {
-	OnReset();
+	mem_zero(m_aGroups, sizeof(m_aGroups));
+	m_NumParticles = 0;
+	m_pSpriteUVs = 0;
+	m_NumSprites = 0;
 	m_RenderTrail.m_pParts = this;
 	m_RenderExplosions.m_pParts = this;
 	m_RenderGeneral.m_pParts = this;
 }
 
+CParticles::~CParticles()
+{
+	for(int g = 0; g < NUM_GROUPS; g++)
+		FreeGroup(&m_aGroups[g]);
+	delete [] m_pSpriteUVs;
+}
 
 void CParticles::OnReset()
 {
-	// reset particles
-	for(int i = 0; i < MAX_PARTICLES; i++)
+	// keep the memory, only drop the particles
+	for(int g = 0; g < NUM_GROUPS; g++)
+		m_aGroups[g].m_Num = 0;
+	m_NumParticles = 0;
+}
+
+void CParticles::OnConsoleInit()
+{
+	Console()->Register("particles_benchmark", "?i?i", CFGFLAG_CLIENT, ConParticlesBenchmark, this, "Time particle update and rendering on the current map (particles, frames), clears all particles");
+}
+
+void CParticles::OnInit()
+{
+	// same subsets SelectSprite would set, looked up once
+	m_NumSprites = g_pData->m_NumSprites;
+	m_pSpriteUVs = new vec4[m_NumSprites];
+	for(int i = 0; i < m_NumSprites; i++)
+	{
+		const CDataSprite *pSpr = &g_pData->m_aSprites[i];
+		float cx = (float)pSpr->m_pSet->m_Gridx;
+		float cy = (float)pSpr->m_pSet->m_Gridy;
+		m_pSpriteUVs[i] = vec4(pSpr->m_X/cx, pSpr->m_Y/cy, (pSpr->m_X+pSpr->m_W)/cx, (pSpr->m_Y+pSpr->m_H)/cy);
+	}
+}
+
+bool CParticles::GrowGroup(CGroup *pGroup)
+{
+	int Capacity = minimum(maximum(pGroup->m_Capacity*2, (int)MIN_GROUP_CAPACITY), (int)MAX_PARTICLES);
+	if(Capacity <= pGroup->m_Capacity)
+		return false;
+
+	CGroup New = *pGroup;
+	New.m_Capacity = Capacity;
+	New.m_pPosX = new float[Capacity];
+	New.m_pPosY = new float[Capacity];
+	New.m_pVelX = new float[Capacity];
+	New.m_pVelY = new float[Capacity];
+	New.m_pLife = new float[Capacity];
+	New.m_pLifeSpan = new float[Capacity];
+	New.m_pRot = new float[Capacity];
+	New.m_pRotspeed = new float[Capacity];
+	New.m_pGravity = new float[Capacity];
+	New.m_pFriction = new float[Capacity];
+	New.m_pStartSize = new float[Capacity];
+	New.m_pEndSize = new float[Capacity];
+	New.m_pColor = new vec4[Capacity];
+	New.m_pSpr = new int[Capacity];
+
+	int Num = pGroup->m_Num;
+	if(Num)
 	{
-		m_aParticles[i].m_PrevPart = i-1;
-		m_aParticles[i].m_NextPart = i+1;
+		mem_copy(New.m_pPosX, pGroup->m_pPosX, Num*sizeof(float));
+		mem_copy(New.m_pPosY, pGroup->m_pPosY, Num*sizeof(float));
+		mem_copy(New.m_pVelX, pGroup->m_pVelX, Num*sizeof(float));
+		mem_copy(New.m_pVelY, pGroup->m_pVelY, Num*sizeof(float));
+		mem_copy(New.m_pLife, pGroup->m_pLife, Num*sizeof(float));
+		mem_copy(New.m_pLifeSpan, pGroup->m_pLifeSpan, Num*sizeof(float));
+		mem_copy(New.m_pRot, pGroup->m_pRot, Num*sizeof(float));
+		mem_copy(New.m_pRotspeed, pGroup->m_pRotspeed, Num*sizeof(float));
+		mem_copy(New.m_pGravity, pGroup->m_pGravity, Num*sizeof(float));
+		mem_copy(New.m_pFriction, pGroup->m_pFriction, Num*sizeof(float));
+		mem_copy(New.m_pStartSize, pGroup->m_pStartSize, Num*sizeof(float));
+		mem_copy(New.m_pEndSize, pGroup->m_pEndSize, Num*sizeof(float));
+		mem_copy(New.m_pColor, pGroup->m_pColor, Num*sizeof(vec4));
+		mem_copy(New.m_pSpr, pGroup->m_pSpr, Num*sizeof(int));
 	}
 
-	m_aParticles[0].m_PrevPart = 0;
-	m_aParticles[MAX_PARTICLES-1].m_NextPart = -1;
-	m_FirstFree = 0;
+	FreeGroup(pGroup);
+	*pGroup = New;
+	return true;
+}
 
-	for(int i = 0; i < NUM_GROUPS; i++)
-		m_aFirstPart[i] = -1;
+void CParticles::FreeGroup(CGroup *pGroup)
+{
+	delete [] pGroup->m_pPosX;
+	delete [] pGroup->m_pPosY;
+	delete [] pGroup->m_pVelX;
+	delete [] pGroup->m_pVelY;
+	delete [] pGroup->m_pLife;
+	delete [] pGroup->m_pLifeSpan;
+	delete [] pGroup->m_pRot;
+	delete [] pGroup->m_pRotspeed;
+	delete [] pGroup->m_pGravity;
+	delete [] pGroup->m_pFriction;
+	delete [] pGroup->m_pStartSize;
+	delete [] pGroup->m_pEndSize;
+	delete [] pGroup->m_pColor;
+	delete [] pGroup->m_pSpr;
+	mem_zero(pGroup, sizeof(*pGroup));
 }
 
 void CParticles::Add(int Group, CParticle *pPart)
@@ -49,31 +135,125 @@ void CParticles::Add(int Group, CParticle *pPart)
 			return;
 	}
 
-	if (m_FirstFree == -1)
+	AddParticle(Group, pPart);
+}
+
+void CParticles::AddParticle(int Group, const CParticle *pPart)
+{
+	if(m_NumParticles >= MAX_PARTICLES)
+		return;
+
+	CGroup *pGroup = &m_aGroups[Group];
+	if(pGroup->m_Num == pGroup->m_Capacity && !GrowGroup(pGroup))
 		return;
 
-	// remove from the free list
-	int Id = m_FirstFree;
-	m_FirstFree = m_aParticles[Id].m_NextPart;
-	if(m_FirstFree != -1)
-		m_aParticles[m_FirstFree].m_PrevPart = -1;
+	int i = pGroup->m_Num++;
+	m_NumParticles++;
+	pGroup->m_pPosX[i] = pPart->m_Pos.x;
+	pGroup->m_pPosY[i] = pPart->m_Pos.y;
+	pGroup->m_pVelX[i] = pPart->m_Vel.x;
+	pGroup->m_pVelY[i] = pPart->m_Vel.y;
+	pGroup->m_pLife[i] = 0;
+	pGroup->m_pLifeSpan[i] = pPart->m_LifeSpan;
+	pGroup->m_pRot[i] = pPart->m_Rot;
+	pGroup->m_pRotspeed[i] = pPart->m_Rotspeed;
+	pGroup->m_pGravity[i] = pPart->m_Gravity;
+	pGroup->m_pFriction[i] = pPart->m_Friction;
+	pGroup->m_pStartSize[i] = pPart->m_StartSize;
+	pGroup->m_pEndSize[i] = pPart->m_EndSize;
+	pGroup->m_pColor[i] = pPart->m_Color;
+	pGroup->m_pSpr[i] = pPart->m_Spr;
+}
+
+void CParticles::UpdateGroup(CGroup *pGroup, float TimePassed, int FrictionCount)
+{
+	int Num = pGroup->m_Num;
+	float *pPosX = pGroup->m_pPosX;
+	float *pPosY = pGroup->m_pPosY;
+	float *pVelX = pGroup->m_pVelX;
+	float *pVelY = pGroup->m_pVelY;
+
+	// integrate, these loops are plain enough for the compiler to vectorise
+	for(int i = 0; i < Num; i++)
+		pVelY[i] += pGroup->m_pGravity[i]*TimePassed;
+
+	for(int f = 0; f < FrictionCount; f++) // apply friction
+		for(int i = 0; i < Num; i++)
+		{
+			pVelX[i] *= pGroup->m_pFriction[i];
+			pVelY[i] *= pGroup->m_pFriction[i];
+		}
+
+	for(int i = 0; i < Num; i++)
+	{
+		pVelX[i] *= TimePassed;
+		pVelY[i] *= TimePassed;
+		m_aNewPosX[i] = pPosX[i]+pVelX[i];
+		m_aNewPosY[i] = pPosY[i]+pVelY[i];
+		pGroup->m_pLife[i] += TimePassed;
+		pGroup->m_pRot[i] += TimePassed * pGroup->m_pRotspeed[i];
+	}
+
+	// move the points, only the ones that hit something need the full MovePoint
+	Collision()->CheckPoints(m_aNewPosX, m_aNewPosY, Num, m_aHits);
+	float InvTime = 1.0f/TimePassed;
+	for(int i = 0; i < Num; i++)
+	{
+		if(m_aHits[i])
+		{
+			vec2 Pos(pPosX[i], pPosY[i]);
+			vec2 Vel(pVelX[i], pVelY[i]);
+			Collision()->MovePoint(&Pos, &Vel, 0.1f+0.9f*frandom(), NULL);
+			pPosX[i] = Pos.x;
+			pPosY[i] = Pos.y;
+			pVelX[i] = Vel.x;
+			pVelY[i] = Vel.y;
+		}
+		else
+		{
+			pPosX[i] = m_aNewPosX[i];
+			pPosY[i] = m_aNewPosY[i];
+		}
+		pVelX[i] *= InvTime;
+		pVelY[i] *= InvTime;
+	}
 
-	// copy data
-	m_aParticles[Id] = *pPart;
+	// drop the dead ones, keeping the order of the rest
+	int Alive = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pGroup->m_pLife[i] > pGroup->m_pLifeSpan[i])
+			continue;
 
-	// insert to the group list
-	m_aParticles[Id].m_PrevPart = -1;
-	m_aParticles[Id].m_NextPart = m_aFirstPart[Group];
-	if(m_aFirstPart[Group] != -1)
-		m_aParticles[m_aFirstPart[Group]].m_PrevPart = Id;
-	m_aFirstPart[Group] = Id;
+		if(Alive != i)
+		{
+			pPosX[Alive] = pPosX[i];
+			pPosY[Alive] = pPosY[i];
+			pVelX[Alive] = pVelX[i];
+			pVelY[Alive] = pVelY[i];
+			pGroup->m_pLife[Alive] = pGroup->m_pLife[i];
+			pGroup->m_pLifeSpan[Alive] = pGroup->m_pLifeSpan[i];
+			pGroup->m_pRot[Alive] = pGroup->m_pRot[i];
+			pGroup->m_pRotspeed[Alive] = pGroup->m_pRotspeed[i];
+			pGroup->m_pGravity[Alive] = pGroup->m_pGravity[i];
+			pGroup->m_pFriction[Alive] = pGroup->m_pFriction[i];
+			pGroup->m_pStartSize[Alive] = pGroup->m_pStartSize[i];
+			pGroup->m_pEndSize[Alive] = pGroup->m_pEndSize[i];
+			pGroup->m_pColor[Alive] = pGroup->m_pColor[i];
+			pGroup->m_pSpr[Alive] = pGroup->m_pSpr[i];
+		}
+		Alive++;
+	}
 
-	// set some parameters
-	m_aParticles[Id].m_Life = 0;
+	m_NumParticles -= Num-Alive;
+	pGroup->m_Num = Alive;
 }
 
 void CParticles::Update(float TimePassed)
 {
+	if(TimePassed <= 0.0f)
+		return;
+
 	static float FrictionFraction = 0;
 	FrictionFraction += TimePassed;
 
@@ -88,48 +268,7 @@ void CParticles::Update(float TimePassed)
 	}
 
 	for(int g = 0; g < NUM_GROUPS; g++)
-	{
-		int i = m_aFirstPart[g];
-		while(i != -1)
-		{
-			int Next = m_aParticles[i].m_NextPart;
-			//m_aParticles[i].vel += flow_get(m_aParticles[i].pos)*time_passed * m_aParticles[i].flow_affected;
-			m_aParticles[i].m_Vel.y += m_aParticles[i].m_Gravity*TimePassed;
-
-			for(int f = 0; f < FrictionCount; f++) // apply friction
-				m_aParticles[i].m_Vel *= m_aParticles[i].m_Friction;
-
-			// move the point
-			vec2 Vel = m_aParticles[i].m_Vel*TimePassed;
-			Collision()->MovePoint(&m_aParticles[i].m_Pos, &Vel, 0.1f+0.9f*frandom(), NULL);
-			m_aParticles[i].m_Vel = Vel* (1.0f/TimePassed);
-
-			m_aParticles[i].m_Life += TimePassed;
-			m_aParticles[i].m_Rot += TimePassed * m_aParticles[i].m_Rotspeed;
-
-			// check particle death
-			if(m_aParticles[i].m_Life > m_aParticles[i].m_LifeSpan)
-			{
-				// remove it from the group list
-				if(m_aParticles[i].m_PrevPart != -1)
-					m_aParticles[m_aParticles[i].m_PrevPart].m_NextPart = m_aParticles[i].m_NextPart;
-				else
-					m_aFirstPart[g] = m_aParticles[i].m_NextPart;
-
-				if(m_aParticles[i].m_NextPart != -1)
-					m_aParticles[m_aParticles[i].m_NextPart].m_PrevPart = m_aParticles[i].m_PrevPart;
-
-				// insert to the free list
-				if(m_FirstFree != -1)
-					m_aParticles[m_FirstFree].m_PrevPart = i;
-				m_aParticles[i].m_PrevPart = -1;
-				m_aParticles[i].m_NextPart = m_FirstFree;
-				m_FirstFree = i;
-			}
-
-			i = Next;
-		}
-	}
+		UpdateGroup(&m_aGroups[g], TimePassed, FrictionCount);
 }
 
 void CParticles::OnRender()
@@ -157,32 +296,102 @@ void CParticles::OnRender()
 
 void CParticles::RenderGroup(int Group)
 {
+	const CGroup *pGroup = &m_aGroups[Group];
+	if(!pGroup->m_Num)
+		return;
+
 	Graphics()->BlendNormal();
 	//gfx_blend_additive();
 	Graphics()->TextureSet(g_pData->m_aImages[IMAGE_PARTICLES].m_Id);
 	Graphics()->QuadsBegin();
 
-	int i = m_aFirstPart[Group];
-	while(i != -1)
+	// newest first, like the old linked lists did
+	IGraphics::CBatchQuadItem aItems[RENDER_BATCH_SIZE];
+	int NumItems = 0;
+	for(int i = pGroup->m_Num-1; i >= 0; i--)
 	{
-		RenderTools()->SelectSprite(m_aParticles[i].m_Spr);
-		float a = m_aParticles[i].m_Life / m_aParticles[i].m_LifeSpan;
-		vec2 p = m_aParticles[i].m_Pos;
-		float Size = mix(m_aParticles[i].m_StartSize, m_aParticles[i].m_EndSize, a);
+		IGraphics::CBatchQuadItem *pItem = &aItems[NumItems++];
+		float a = pGroup->m_pLife[i] / pGroup->m_pLifeSpan[i];
+		float Size = mix(pGroup->m_pStartSize[i], pGroup->m_pEndSize[i], a);
+		int Spr = pGroup->m_pSpr[i];
+		vec4 UVs = Spr >= 0 && Spr < m_NumSprites ? m_pSpriteUVs[Spr] : vec4(0, 0, 1, 1);
+		const vec4 &Color = pGroup->m_pColor[i]; // pow(a, 0.75f) *
+
+		pItem->m_X = pGroup->m_pPosX[i];
+		pItem->m_Y = pGroup->m_pPosY[i];
+		pItem->m_Width = Size;
+		pItem->m_Height = Size;
+		pItem->m_Rotation = pGroup->m_pRot[i];
+		pItem->m_U0 = UVs.x;
+		pItem->m_V0 = UVs.y;
+		pItem->m_U1 = UVs.z;
+		pItem->m_V1 = UVs.w;
+		pItem->m_R = Color.r;
+		pItem->m_G = Color.g;
+		pItem->m_B = Color.b;
+		pItem->m_A = Color.a;
+
+		if(NumItems == RENDER_BATCH_SIZE)
+		{
+			Graphics()->QuadsDrawBatch(aItems, NumItems);
+			NumItems = 0;
+		}
+	}
+	if(NumItems)
+		Graphics()->QuadsDrawBatch(aItems, NumItems);
+
+	Graphics()->QuadsEnd();
+	Graphics()->BlendNormal();
+}
 
-		Graphics()->QuadsSetRotation(m_aParticles[i].m_Rot);
+void CParticles::ConParticlesBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CParticles *pSelf = (CParticles *)pUserData;
+	if(pSelf->Client()->State() != IClient::STATE_ONLINE && pSelf->Client()->State() != IClient::STATE_DEMOPLAYBACK)
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "particles", "no map loaded");
+		return;
+	}
 
-		Graphics()->SetColor(
-			m_aParticles[i].m_Color.r,
-			m_aParticles[i].m_Color.g,
-			m_aParticles[i].m_Color.b,
-			m_aParticles[i].m_Color.a); // pow(a, 0.75f) *
+	int NumParticles = clamp(pResult->NumArguments() > 0 ? pResult->GetInteger(0) : (int)MAX_PARTICLES, 1, (int)MAX_PARTICLES);
+	int Frames = maximum(pResult->NumArguments() > 1 ? pResult->GetInteger(1) : 500, 1);
 
-		IGraphics::CQuadItem QuadItem(p.x, p.y, Size, Size);
-		Graphics()->QuadsDraw(&QuadItem, 1);
+	// debris spread over the whole map so some of it is always colliding
+	pSelf->OnReset();
+	float MapWidth = pSelf->Collision()->GetWidth()*32.0f;
+	float MapHeight = pSelf->Collision()->GetHeight()*32.0f;
+	for(int i = 0; i < NumParticles; i++)
+	{
+		CParticle p;
+		p.SetDefault();
+		p.m_Spr = SPRITE_PART_SPLAT01 + i%3;
+		p.m_Pos = vec2(frandom()*MapWidth, frandom()*MapHeight);
+		p.m_Vel = GetDir(frandom()*2*pi) * (frandom()*900.0f);
+		p.m_LifeSpan = 1000000.0f;
+		p.m_StartSize = 16.0f;
+		p.m_EndSize = 8.0f;
+		p.m_Rotspeed = frandom()*4.0f;
+		p.m_Gravity = 800.0f;
+		p.m_Friction = 0.8f;
+		pSelf->AddParticle(GROUP_GENERAL, &p);
+	}
 
-		i = m_aParticles[i].m_NextPart;
+	int64 UpdateTime = 0;
+	int64 RenderTime = 0;
+	for(int f = 0; f < Frames; f++)
+	{
+		int64 Start = time_get();
+		pSelf->Update(1.0f/50.0f);
+		int64 Mid = time_get();
+		pSelf->RenderGroup(GROUP_GENERAL);
+		pSelf->Graphics()->Swap();
+		UpdateTime += Mid-Start;
+		RenderTime += time_get()-Mid;
 	}
-	Graphics()->QuadsEnd();
-	Graphics()->BlendNormal();
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "%d particles, %d frames: update %.3fms, render %.3fms per frame", NumParticles, Frames,
+		(double)UpdateTime*1000.0/time_freq()/Frames, (double)RenderTime*1000.0/time_freq()/Frames);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "particles", aBuf);
+	pSelf->OnReset();
 }
@@ -41,11 +41,6 @@ struct CParticle
 	float m_Friction;
 
 	vec4 m_Color;
-
-	// set by the particle system
-	float m_Life;
-	int m_PrevPart;
-	int m_NextPart;
 };
 
 class CParticles : public CComponent
@@ -61,26 +56,68 @@ public:
 	};
 
 	CParticles();
+	virtual ~CParticles();
 
 	void Add(int Group, CParticle *pPart);
 
 	virtual void OnReset();
+	virtual void OnConsoleInit();
+	virtual void OnInit();
 	virtual void OnRender();
 
 private:
 
 	enum
 	{
-		MAX_PARTICLES=1024*8,
+		MAX_PARTICLES=1024*32,
+		MIN_GROUP_CAPACITY=256,
+		RENDER_BATCH_SIZE=512,
+	};
+
+	// the particles of a group are kept packed, one array per field,
+	// newest last
+	struct CGroup
+	{
+		int m_Num;
+		int m_Capacity;
+		float *m_pPosX;
+		float *m_pPosY;
+		float *m_pVelX;
+		float *m_pVelY;
+		float *m_pLife;
+		float *m_pLifeSpan;
+		float *m_pRot;
+		float *m_pRotspeed;
+		float *m_pGravity;
+		float *m_pFriction;
+		float *m_pStartSize;
+		float *m_pEndSize;
+		vec4 *m_pColor;
+		int *m_pSpr;
 	};
 
-	CParticle m_aParticles[MAX_PARTICLES];
-	int m_FirstFree;
-	int m_aFirstPart[NUM_GROUPS];
+	CGroup m_aGroups[NUM_GROUPS];
+	int m_NumParticles;
+
+	// per update scratch space, indexed like the group being moved
+	float m_aNewPosX[MAX_PARTICLES];
+	float m_aNewPosY[MAX_PARTICLES];
+	bool m_aHits[MAX_PARTICLES];
+
+	// texture subset of every sprite, x0 y0 x1 y1
+	vec4 *m_pSpriteUVs;
+	int m_NumSprites;
+
+	bool GrowGroup(CGroup *pGroup);
+	void FreeGroup(CGroup *pGroup);
+	void AddParticle(int Group, const CParticle *pPart);
+	void UpdateGroup(CGroup *pGroup, float TimePassed, int FrictionCount);
 
 	void RenderGroup(int Group);
 	void Update(float TimePassed);
 
+	static void ConParticlesBenchmark(IConsole::IResult *pResult, void *pUserData);
+
 	template<int TGROUP>
 	class CRenderGroup : public CComponent
 	{
@@ -9,31 +9,42 @@
 #include <engine/storage.h>
 #include <engine/shared/config.h>
 
+#include <game/client/gameclient.h>
+#include <game/client/loadjobs.h>
+
 #include "skins.h"
 
-int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
+#include <memory>
+#include <vector>
+
+// decodes a skin and builds its colorless version off the main thread
+class CSkinLoadJob : public CPngLoadJob
 {
-	CSkins *pSelf = (CSkins *)pUser;
-	int l = str_length(pName);
-	if(l < 4 || IsDir || str_comp(pName+l-4, ".png") != 0)
-		return 0;
+protected:
+	virtual void Process();
 
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf), "skins/%s", pName);
-	CImageInfo Info;
-	if(!pSelf->Graphics()->LoadPNG(&Info, aBuf, DirType))
+public:
+	CSkinLoadJob(IGraphics *pGraphics, const char *pFilename, int StorageType, const char *pName) :
+		CPngLoadJob(pGraphics, pFilename, StorageType), m_pColorData(0)
 	{
-		str_format(aBuf, sizeof(aBuf), "failed to load skin from %s", pName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "game", aBuf);
-		return 0;
+		str_copy(m_aName, pName, sizeof(m_aName));
+	}
+	virtual ~CSkinLoadJob()
+	{
+		if(m_pColorData)
+			mem_free(m_pColorData);
 	}
 
-	CSkin Skin;
-	Skin.m_OrgTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
+	char m_aName[128];
+	vec3 m_BloodColor;
+	unsigned char *m_pColorData;
+};
 
+void CSkinLoadJob::Process()
+{
 	int BodySize = 96; // body size
-	unsigned char *d = (unsigned char *)Info.m_pData;
-	int Pitch = Info.m_Width*4;
+	unsigned char *d = (unsigned char *)m_Image.m_pData;
+	int Pitch = m_Image.m_Width*4;
 
 	// dig out blood color
 	{
@@ -49,14 +60,18 @@ int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
 				}
 			}
 
-		Skin.m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
+		m_BloodColor = normalize(vec3(aColors[0], aColors[1], aColors[2]));
 	}
 
 	// create colorless version
-	int Step = Info.m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+	int Step = m_Image.m_Format == CImageInfo::FORMAT_RGBA ? 4 : 3;
+	int Size = m_Image.m_Width*m_Image.m_Height*Step;
+	m_pColorData = (unsigned char *)mem_alloc(Size, 1);
+	mem_copy(m_pColorData, d, Size);
+	d = m_pColorData;
 
 	// make the texture gray scale
-	for(int i = 0; i < Info.m_Width*Info.m_Height; i++)
+	for(int i = 0; i < m_Image.m_Width*m_Image.m_Height; i++)
 	{
 		int v = (d[i*Step]+d[i*Step+1]+d[i*Step+2])/3;
 		d[i*Step] = v;
@@ -98,28 +113,67 @@ int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
 			d[y*Pitch+x*4+1] = v;
 			d[y*Pitch+x*4+2] = v;
 		}
+}
 
-	Skin.m_ColorTexture = pSelf->Graphics()->LoadTextureRaw(Info.m_Width, Info.m_Height, Info.m_Format, Info.m_pData, Info.m_Format, 0);
-	mem_free(Info.m_pData);
+struct CSkinScanContext
+{
+	CSkins *m_pSelf;
+	std::vector<std::shared_ptr<CSkinLoadJob> > m_apJobs;
+};
 
-	// set skin data
-	str_copy(Skin.m_aName, pName, min((int)sizeof(Skin.m_aName),l-3));
-	if(g_Config.m_Debug)
-	{
-		str_format(aBuf, sizeof(aBuf), "load skin %s", Skin.m_aName);
-		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "game", aBuf);
-	}
-	pSelf->m_aSkins.add(Skin);
+int CSkins::SkinScan(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	CSkinScanContext *pContext = (CSkinScanContext *)pUser;
+	CSkins *pSelf = pContext->m_pSelf;
+	int l = str_length(pName);
+	if(l < 4 || IsDir || str_comp(pName+l-4, ".png") != 0)
+		return 0;
 
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "skins/%s", pName);
+	std::shared_ptr<CSkinLoadJob> pJob = std::make_shared<CSkinLoadJob>(pSelf->Graphics(), aBuf, DirType, pName);
+	pSelf->m_pClient->StartLoadJob(pJob);
+	pContext->m_apJobs.push_back(pJob);
 	return 0;
 }
 
 
 void CSkins::OnInit()
 {
-	// load skins
+	// load skins, they decode on the job pool and get uploaded in listing order
 	m_aSkins.clear();
-	Storage()->ListDirectory(IStorage::TYPE_ALL, "skins", SkinScan, this);
+	CSkinScanContext Context;
+	Context.m_pSelf = this;
+	Storage()->ListDirectory(IStorage::TYPE_ALL, "skins", SkinScan, &Context);
+	for(unsigned i = 0; i < Context.m_apJobs.size(); i++)
+	{
+		CSkinLoadJob *pJob = Context.m_apJobs[i].get();
+		pJob->Wait();
+
+		char aBuf[512];
+		if(!pJob->m_Loaded)
+		{
+			str_format(aBuf, sizeof(aBuf), "failed to load skin from %s", pJob->m_aName);
+			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "game", aBuf);
+			continue;
+		}
+
+		const CImageInfo *pInfo = &pJob->m_Image;
+		CSkin Skin;
+		Skin.m_OrgTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pInfo->m_pData, pInfo->m_Format, 0);
+		Skin.m_ColorTexture = Graphics()->LoadTextureRaw(pInfo->m_Width, pInfo->m_Height, pInfo->m_Format, pJob->m_pColorData, pInfo->m_Format, 0);
+		Skin.m_BloodColor = pJob->m_BloodColor;
+
+		// set skin data
+		str_copy(Skin.m_aName, pJob->m_aName, min((int)sizeof(Skin.m_aName), str_length(pJob->m_aName)-3));
+		if(g_Config.m_Debug)
+		{
+			str_format(aBuf, sizeof(aBuf), "load skin %s", Skin.m_aName);
+			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "game", aBuf);
+		}
+		m_aSkins.add(Skin);
+	}
+
 	if(!m_aSkins.size())
 	{
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "gameclient", "failed to load skins. folder='skins/'");
@@ -5,36 +5,11 @@
 #include <engine/shared/config.h>
 #include <game/generated/client_data.h>
 #include <game/client/gameclient.h>
+#include <game/client/loadjobs.h>
 #include <game/client/components/camera.h>
 #include <game/client/components/menus.h>
 #include "sounds.h"
 
-
-struct CUserData
-{
-	CGameClient *m_pGameClient;
-	bool m_Render;
-} g_UserData;
-
-static int LoadSoundsThread(void *pUser)
-{
-	CUserData *pData = static_cast<CUserData *>(pUser);
-
-	for(int s = 0; s < g_pData->m_NumSounds; s++)
-	{
-		for(int i = 0; i < g_pData->m_aSounds[s].m_NumSounds; i++)
-		{
-			int Id = pData->m_pGameClient->Sound()->LoadWV(g_pData->m_aSounds[s].m_aSounds[i].m_pFilename);
-			g_pData->m_aSounds[s].m_aSounds[i].m_Id = Id;
-		}
-
-		if(pData->m_Render)
-			pData->m_pGameClient->m_pMenus->RenderLoading();
-	}
-
-	return 0;
-}
-
 int CSounds::GetSampleId(int SetId)
 {
 	if(!g_Config.m_SndEnable || !Sound()->IsSoundEnabled() || m_WaitForSoundJob || SetId < 0 || SetId >= g_pData->m_NumSounds)
@@ -70,21 +45,54 @@ void CSounds::OnInit()
 
 	ClearQueue();
 
-	// load sounds
-	if(g_Config.m_ClThreadsoundloading)
+	// reserve the sample ids in order, the decoding runs on the job pool
+	m_aSoundLoads.clear();
+	m_NumSoundLoadsDone = 0;
+	for(int s = 0; s < g_pData->m_NumSounds; s++)
 	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = false;
-		m_pClient->Engine()->AddJob(&m_SoundJob, LoadSoundsThread, &g_UserData);
-		m_WaitForSoundJob = true;
+		for(int i = 0; i < g_pData->m_aSounds[s].m_NumSounds; i++)
+		{
+			CDataSound *pSound = &g_pData->m_aSounds[s].m_aSounds[i];
+			pSound->m_Id = Sound()->ReserveSample();
+			if(pSound->m_Id < 0)
+				continue;
+
+			CSoundLoad Load;
+			Load.m_Set = s;
+			Load.m_pSound = pSound;
+			Load.m_pJob = std::make_shared<CSoundLoadJob>(Sound(), pSound->m_Id, pSound->m_pFilename);
+			if(g_Config.m_ClThreadsoundloading)
+				m_pClient->Engine()->AddJob(Load.m_pJob);
+			else
+				m_pClient->StartLoadJob(Load.m_pJob);
+			m_aSoundLoads.push_back(Load);
+		}
 	}
-	else
+	m_WaitForSoundJob = true;
+}
+
+bool CSounds::UpdateLoading(bool Block)
+{
+	while(m_NumSoundLoadsDone < m_aSoundLoads.size())
 	{
-		g_UserData.m_pGameClient = m_pClient;
-		g_UserData.m_Render = true;
-		LoadSoundsThread(&g_UserData);
-		m_WaitForSoundJob = false;
+		CSoundLoad *pLoad = &m_aSoundLoads[m_NumSoundLoadsDone];
+		if(!Block && !pLoad->m_pJob->Done())
+			return false;
+
+		pLoad->m_pJob->Wait();
+		if(!pLoad->m_pJob->m_Loaded)
+			pLoad->m_pSound->m_Id = -1;
+		m_NumSoundLoadsDone++;
+
+		// the loading screen counts whole sets
+		if(Block && (m_NumSoundLoadsDone == m_aSoundLoads.size() || m_aSoundLoads[m_NumSoundLoadsDone].m_Set != pLoad->m_Set))
+			m_pClient->m_pMenus->RenderLoading();
 	}
+
+	m_aSoundLoads.clear();
+	m_NumSoundLoadsDone = 0;
+	m_WaitForSoundJob = false;
+	return true;
 }
 
 void CSounds::OnReset()
@@ -105,13 +113,8 @@ void CSounds::OnStateChange(int NewState, int OldState)
 void CSounds::OnRender()
 {
 	// check for sound initialisation
-	if(m_WaitForSoundJob)
-	{
-		if(m_SoundJob.Status() == CJob::STATE_DONE)
-			m_WaitForSoundJob = false;
-		else
-			return;
-	}
+	if(m_WaitForSoundJob && !UpdateLoading(false))
+		return;
 
 	// set listner pos
 	Sound()->SetListenerPos(m_pClient->m_pCamera->m_Center.x, m_pClient->m_pCamera->m_Center.y);
@@ -4,6 +4,9 @@
 #define GAME_CLIENT_COMPONENTS_SOUNDS_H
 #include <game/client/component.h>
 
+#include <memory>
+#include <vector>
+
 class CSounds : public CComponent
 {
 	enum
@@ -17,7 +20,16 @@ class CSounds : public CComponent
 	} m_aQueue[QUEUE_SIZE];
 	int m_QueuePos;
 	int64 m_QueueWaitTime;
-	class CJob m_SoundJob;
+
+	// samples still decoding on the job pool, taken over in order
+	struct CSoundLoad
+	{
+		int m_Set;
+		struct CDataSound *m_pSound;
+		std::shared_ptr<class CSoundLoadJob> m_pJob;
+	};
+	std::vector<CSoundLoad> m_aSoundLoads;
+	unsigned m_NumSoundLoadsDone;
 	bool m_WaitForSoundJob;
 	
 	int GetSampleId(int SetId);
@@ -37,6 +49,9 @@ public:
 	virtual void OnStateChange(int NewState, int OldState);
 	virtual void OnRender();
 
+	// takes over finished samples, returns true once all of them are in
+	bool UpdateLoading(bool Block);
+
 	void ClearQueue();
 	void Enqueue(int Channel, int SetId);
 	void Play(int Channel, int SetId, float Vol);
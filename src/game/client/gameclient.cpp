@@ -21,6 +21,7 @@
 #include "render.h"
 
 #include "gameclient.h"
+#include "loadjobs.h"
 
 #include "components/binds.h"
 #include "components/broadcast.h"
@@ -50,6 +51,8 @@
 #include "components/spectator.h"
 #include "components/voting.h"
 
+#include <vector>
+
 CGameClient g_GameClient;
 
 // instanciate all systems
@@ -177,6 +180,7 @@ void CGameClient::OnConsoleInit()
 	// add the some console commands
 	Console()->Register("team", "i", CFGFLAG_CLIENT, ConTeam, this, "Switch team");
 	Console()->Register("kill", "", CFGFLAG_CLIENT, ConKill, this, "Kill yourself");
+	Console()->Register("prediction_stats", "", CFGFLAG_CLIENT, ConPredictionStats, this, "Show how many ticks the prediction simulated and had to simulate again");
 
 	// register server dummy commands for tab completion
 	Console()->Register("tune", "si", CFGFLAG_SERVER, 0, 0, "Tune variable to value");
@@ -226,6 +230,11 @@ void CGameClient::OnInit()
 	m_UI.SetGraphics(Graphics(), TextRender());
 	m_RenderTools.m_pGraphics = Graphics();
 	m_RenderTools.m_pUI = UI();
+
+	m_PredictedWorldTick = -1;
+	m_NumPredictedTicks = 0;
+	m_NumRepredictedTicks = 0;
+	m_NumRepredictions = 0;
 	
 	int64 Start = time_get();
 
@@ -237,6 +246,16 @@ void CGameClient::OnInit()
 	for(int i = 0; i < NUM_NETOBJTYPES; i++)
 		Client()->SnapSetStaticsize(i, m_NetObjHandler.GetObjSize(i));
 
+	// decode the game images on the job pool while the components load,
+	// the uploads follow in order below
+	std::vector<std::shared_ptr<CPngLoadJob> > apImageJobs;
+	for(int i = 0; i < g_pData->m_NumImages; i++)
+	{
+		std::shared_ptr<CPngLoadJob> pJob = std::make_shared<CPngLoadJob>(Graphics(), g_pData->m_aImages[i].m_pFilename, IStorage::TYPE_ALL);
+		StartLoadJob(pJob);
+		apImageJobs.push_back(pJob);
+	}
+
 	// load default font
 	static CFont *pDefaultFont = 0;
 	char aFilename[512];
@@ -257,9 +276,19 @@ void CGameClient::OnInit()
 	// setup load amount// load textures
 	for(int i = 0; i < g_pData->m_NumImages; i++)
 	{
-		g_pData->m_aImages[i].m_Id = Graphics()->LoadTexture(g_pData->m_aImages[i].m_pFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, 0);
+		CPngLoadJob *pJob = apImageJobs[i].get();
+		pJob->Wait();
+		if(pJob->m_Loaded)
+			g_pData->m_aImages[i].m_Id = Graphics()->LoadTextureRaw(pJob->m_Image.m_Width, pJob->m_Image.m_Height, pJob->m_Image.m_Format, pJob->m_Image.m_pData, pJob->m_Image.m_Format, 0);
+		else // reports the error and hands out the invalid texture
+			g_pData->m_aImages[i].m_Id = Graphics()->LoadTexture(g_pData->m_aImages[i].m_pFilename, IStorage::TYPE_ALL, CImageInfo::FORMAT_AUTO, 0);
 		g_GameClient.m_pMenus->RenderLoading();
 	}
+	apImageJobs.clear();
+
+	// sounds may keep loading in the background, but not when timing the startup
+	if(!g_Config.m_ClThreadsoundloading || g_Config.m_DbgStartupTiming)
+		m_pSounds->UpdateLoading(true);
 
 	for(int i = 0; i < m_All.m_Num; i++)
 		m_All.m_paComponents[i]->OnReset();
@@ -272,6 +301,12 @@ void CGameClient::OnInit()
 	m_ServerMode = SERVERMODE_PURE;
 }
 
+void CGameClient::StartLoadJob(std::shared_ptr<CLoadJob> pJob)
+{
+	if(g_Config.m_ClParallelLoading)
+		Engine()->AddJob(pJob);
+}
+
 void CGameClient::DispatchInput()
 {
 	// handle mouse movement
@@ -338,6 +373,7 @@ void CGameClient::OnReset()
 {
 	// clear out the invalid pointers
 	m_LastNewPredictedTick = -1;
+	m_PredictedWorldTick = -1;
 	mem_zero(&g_GameClient.m_Snap, sizeof(g_GameClient.m_Snap));
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -904,29 +940,67 @@ void CGameClient::OnNewSnapshot()
 	}
 }
 
-void CGameClient::OnPredict()
+void CGameClient::StorePredictionState(int Tick, const int *pInput)
 {
-	// store the previous values so we can detect prediction errors
-	CCharacterCore BeforePrevChar = m_PredictedPrevChar;
-	CCharacterCore BeforeChar = m_PredictedChar;
+	CPredictionState *pState = &m_aPredictionHistory[Tick%PREDICTION_HISTORY];
+	pState->m_Tick = Tick;
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		pState->m_aActive[c] = m_PredictedWorld.m_apCharacters[c] != 0;
+		mem_zero(&pState->m_aCores[c], sizeof(pState->m_aCores[c]));
+		if(pState->m_aActive[c])
+			m_PredictedWorld.m_apCharacters[c]->Write(&pState->m_aCores[c]);
+	}
+	pState->m_HasInput = pInput != 0;
+	if(pInput)
+		mem_copy(&pState->m_Input, pInput, sizeof(pState->m_Input));
+	else
+		mem_zero(&pState->m_Input, sizeof(pState->m_Input));
+}
 
-	// we can't predict without our own id or own character
-	if(m_Snap.m_LocalClientID == -1 || !m_Snap.m_aCharacters[m_Snap.m_LocalClientID].m_Active)
-		return;
+bool CGameClient::PredictionMatchesSnapshot()
+{
+	int GameTick = Client()->GameTick();
+	if(m_PredictedWorldTick < 0 || m_PredictedLocalID != m_Snap.m_LocalClientID ||
+		GameTick > m_PredictedWorldTick || m_PredictedWorldTick > Client()->PredGameTick() ||
+		m_PredictedWorldTick-GameTick >= PREDICTION_HISTORY ||
+		mem_comp(&m_PredictedWorld.m_Tuning, &m_Tuning, sizeof(m_Tuning)) != 0)
+		return false;
+
+	// the world we predicted for the snapshot tick has to be the one the server sent
+	const CPredictionState *pState = &m_aPredictionHistory[GameTick%PREDICTION_HISTORY];
+	if(pState->m_Tick != GameTick)
+		return false;
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(pState->m_aActive[c] != (m_Snap.m_aCharacters[c].m_Active != 0))
+			return false;
+		if(!pState->m_aActive[c])
+			continue;
 
-	// don't predict anything if we are paused
-	if(m_Snap.m_pGameInfoObj && m_Snap.m_pGameInfoObj->m_GameStateFlags&GAMESTATEFLAG_PAUSED)
+		CNetObj_CharacterCore Core = m_Snap.m_aCharacters[c].m_Cur;
+		Core.m_Tick = 0;
+		if(mem_comp(&Core, &pState->m_aCores[c], sizeof(Core)) != 0)
+			return false;
+	}
+
+	// and the ticks after it must have used the input we have now
+	for(int Tick = GameTick+1; Tick <= m_PredictedWorldTick; Tick++)
 	{
-		if(m_Snap.m_pLocalCharacter)
-			m_PredictedChar.Read(m_Snap.m_pLocalCharacter);
-		if(m_Snap.m_pLocalPrevCharacter)
-			m_PredictedPrevChar.Read(m_Snap.m_pLocalPrevCharacter);
-		return;
+		pState = &m_aPredictionHistory[Tick%PREDICTION_HISTORY];
+		const int *pInput = Client()->GetInput(Tick);
+		if(pState->m_Tick != Tick || pState->m_HasInput != (pInput != 0) ||
+			(pInput && mem_comp(pInput, &pState->m_Input, sizeof(pState->m_Input)) != 0))
+			return false;
 	}
 
-	// repredict character
-	CWorldCore World;
-	World.m_Tuning = m_Tuning;
+	return true;
+}
+
+void CGameClient::RebuildPrediction()
+{
+	m_PredictedWorld.m_Tuning = m_Tuning;
+	mem_zero(m_PredictedWorld.m_apCharacters, sizeof(m_PredictedWorld.m_apCharacters));
 
 	// search for players
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -934,76 +1008,124 @@ void CGameClient::OnPredict()
 		if(!m_Snap.m_aCharacters[i].m_Active)
 			continue;
 
-		g_GameClient.m_aClients[i].m_Predicted.Init(&World, Collision());
-		World.m_apCharacters[i] = &g_GameClient.m_aClients[i].m_Predicted;
+		g_GameClient.m_aClients[i].m_Predicted.Init(&m_PredictedWorld, Collision());
+		m_PredictedWorld.m_apCharacters[i] = &g_GameClient.m_aClients[i].m_Predicted;
 		g_GameClient.m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
 	}
 
-	// predict
-	for(int Tick = Client()->GameTick()+1; Tick <= Client()->PredGameTick(); Tick++)
+	m_PredictedWorldTick = Client()->GameTick();
+	m_PredictedLocalID = m_Snap.m_LocalClientID;
+	StorePredictionState(m_PredictedWorldTick, 0);
+}
+
+void CGameClient::PredictTick(int Tick)
+{
+	CWorldCore *pWorld = &m_PredictedWorld;
+	int *pInput = Client()->GetInput(Tick);
+
+	// fetch the local
+	if(Tick == Client()->PredGameTick() && pWorld->m_apCharacters[m_Snap.m_LocalClientID])
+		m_PredictedPrevChar = *pWorld->m_apCharacters[m_Snap.m_LocalClientID];
+
+	// first calculate where everyone should move
+	for(int c = 0; c < MAX_CLIENTS; c++)
 	{
-		// fetch the local
-		if(Tick == Client()->PredGameTick() && World.m_apCharacters[m_Snap.m_LocalClientID])
-			m_PredictedPrevChar = *World.m_apCharacters[m_Snap.m_LocalClientID];
+		if(!pWorld->m_apCharacters[c])
+			continue;
 
-		// first calculate where everyone should move
-		for(int c = 0; c < MAX_CLIENTS; c++)
+		mem_zero(&pWorld->m_apCharacters[c]->m_Input, sizeof(pWorld->m_apCharacters[c]->m_Input));
+		if(m_Snap.m_LocalClientID == c)
 		{
-			if(!World.m_apCharacters[c])
-				continue;
+			// apply player input
+			if(pInput)
+				pWorld->m_apCharacters[c]->m_Input = *((CNetObj_PlayerInput*)pInput);
+			pWorld->m_apCharacters[c]->Tick(true);
+		}
+		else
+			pWorld->m_apCharacters[c]->Tick(false);
 
-			mem_zero(&World.m_apCharacters[c]->m_Input, sizeof(World.m_apCharacters[c]->m_Input));
-			if(m_Snap.m_LocalClientID == c)
-			{
-				// apply player input
-				int *pInput = Client()->GetInput(Tick);
-				if(pInput)
-					World.m_apCharacters[c]->m_Input = *((CNetObj_PlayerInput*)pInput);
-				World.m_apCharacters[c]->Tick(true);
-			}
-			else
-				World.m_apCharacters[c]->Tick(false);
+	}
 
-		}
+	// move all players and quantize their data
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		if(!pWorld->m_apCharacters[c])
+			continue;
 
-		// move all players and quantize their data
-		for(int c = 0; c < MAX_CLIENTS; c++)
-		{
-			if(!World.m_apCharacters[c])
-				continue;
+		pWorld->m_apCharacters[c]->Move();
+		pWorld->m_apCharacters[c]->Quantize();
+	}
 
-			World.m_apCharacters[c]->Move();
-			World.m_apCharacters[c]->Quantize();
-		}
+	// check if we want to trigger effects
+	if(Tick > m_LastNewPredictedTick)
+	{
+		m_LastNewPredictedTick = Tick;
+		m_NewPredictedTick = true;
 
-		// check if we want to trigger effects
-		if(Tick > m_LastNewPredictedTick)
+		if(m_Snap.m_LocalClientID != -1 && pWorld->m_apCharacters[m_Snap.m_LocalClientID])
 		{
-			m_LastNewPredictedTick = Tick;
-			m_NewPredictedTick = true;
+			vec2 Pos = pWorld->m_apCharacters[m_Snap.m_LocalClientID]->m_Pos;
+			int Events = pWorld->m_apCharacters[m_Snap.m_LocalClientID]->m_TriggeredEvents;
+			if(Events&COREEVENT_GROUND_JUMP) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_PLAYER_JUMP, 1.0f, Pos);
 
-			if(m_Snap.m_LocalClientID != -1 && World.m_apCharacters[m_Snap.m_LocalClientID])
+			/*if(events&COREEVENT_AIR_JUMP)
 			{
-				vec2 Pos = World.m_apCharacters[m_Snap.m_LocalClientID]->m_Pos;
-				int Events = World.m_apCharacters[m_Snap.m_LocalClientID]->m_TriggeredEvents;
-				if(Events&COREEVENT_GROUND_JUMP) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_PLAYER_JUMP, 1.0f, Pos);
-
-				/*if(events&COREEVENT_AIR_JUMP)
-				{
-					GameClient.effects->air_jump(pos);
-					GameClient.sounds->play_and_record(SOUNDS::CHN_WORLD, SOUND_PLAYER_AIRJUMP, 1.0f, pos);
-				}*/
-
-				//if(events&COREEVENT_HOOK_LAUNCH) snd_play_random(CHN_WORLD, SOUND_HOOK_LOOP, 1.0f, pos);
-				//if(events&COREEVENT_HOOK_ATTACH_PLAYER) snd_play_random(CHN_WORLD, SOUND_HOOK_ATTACH_PLAYER, 1.0f, pos);
-				if(Events&COREEVENT_HOOK_ATTACH_GROUND) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_HOOK_ATTACH_GROUND, 1.0f, Pos);
-				if(Events&COREEVENT_HOOK_HIT_NOHOOK) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_HOOK_NOATTACH, 1.0f, Pos);
-				//if(events&COREEVENT_HOOK_RETRACT) snd_play_random(CHN_WORLD, SOUND_PLAYER_JUMP, 1.0f, pos);
-			}
+				GameClient.effects->air_jump(pos);
+				GameClient.sounds->play_and_record(SOUNDS::CHN_WORLD, SOUND_PLAYER_AIRJUMP, 1.0f, pos);
+			}*/
+
+			//if(events&COREEVENT_HOOK_LAUNCH) snd_play_random(CHN_WORLD, SOUND_HOOK_LOOP, 1.0f, pos);
+			//if(events&COREEVENT_HOOK_ATTACH_PLAYER) snd_play_random(CHN_WORLD, SOUND_HOOK_ATTACH_PLAYER, 1.0f, pos);
+			if(Events&COREEVENT_HOOK_ATTACH_GROUND) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_HOOK_ATTACH_GROUND, 1.0f, Pos);
+			if(Events&COREEVENT_HOOK_HIT_NOHOOK) g_GameClient.m_pSounds->PlayAndRecord(CSounds::CHN_WORLD, SOUND_HOOK_NOATTACH, 1.0f, Pos);
+			//if(events&COREEVENT_HOOK_RETRACT) snd_play_random(CHN_WORLD, SOUND_PLAYER_JUMP, 1.0f, pos);
 		}
+	}
+
+	if(Tick == Client()->PredGameTick() && pWorld->m_apCharacters[m_Snap.m_LocalClientID])
+		m_PredictedChar = *pWorld->m_apCharacters[m_Snap.m_LocalClientID];
+
+	m_PredictedWorldTick = Tick;
+	StorePredictionState(Tick, pInput);
+}
+
+void CGameClient::OnPredict()
+{
+	// store the previous values so we can detect prediction errors
+	CCharacterCore BeforePrevChar = m_PredictedPrevChar;
+	CCharacterCore BeforeChar = m_PredictedChar;
 
-		if(Tick == Client()->PredGameTick() && World.m_apCharacters[m_Snap.m_LocalClientID])
-			m_PredictedChar = *World.m_apCharacters[m_Snap.m_LocalClientID];
+	// we can't predict without our own id or own character
+	if(m_Snap.m_LocalClientID == -1 || !m_Snap.m_aCharacters[m_Snap.m_LocalClientID].m_Active)
+		return;
+
+	// don't predict anything if we are paused
+	if(m_Snap.m_pGameInfoObj && m_Snap.m_pGameInfoObj->m_GameStateFlags&GAMESTATEFLAG_PAUSED)
+	{
+		if(m_Snap.m_pLocalCharacter)
+			m_PredictedChar.Read(m_Snap.m_pLocalCharacter);
+		if(m_Snap.m_pLocalPrevCharacter)
+			m_PredictedPrevChar.Read(m_Snap.m_pLocalPrevCharacter);
+		m_PredictedWorldTick = -1;
+		return;
+	}
+
+	// only go back to the snapshot when it disagrees with what we predicted for its tick,
+	// otherwise simulate just the ticks that passed since the last call
+	if(!PredictionMatchesSnapshot())
+	{
+		int LastTick = m_PredictedWorldTick;
+		RebuildPrediction();
+		m_NumRepredictions++;
+		if(LastTick > m_PredictedWorldTick)
+			m_NumRepredictedTicks += minimum(LastTick, Client()->PredGameTick())-m_PredictedWorldTick;
+	}
+
+	// predict
+	for(int Tick = m_PredictedWorldTick+1; Tick <= Client()->PredGameTick(); Tick++)
+	{
+		PredictTick(Tick);
+		m_NumPredictedTicks++;
 	}
 
 	if(g_Config.m_Debug && g_Config.m_ClPredict && m_PredictedTick == Client()->PredGameTick())
@@ -1030,6 +1152,15 @@ void CGameClient::OnPredict()
 	m_PredictedTick = Client()->PredGameTick();
 }
 
+void CGameClient::ConPredictionStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameClient *pSelf = (CGameClient *)pUserData;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "predicted ticks: %d, rebuilt from snapshot: %d times, ticks simulated again: %d",
+		pSelf->m_NumPredictedTicks, pSelf->m_NumRepredictions, pSelf->m_NumRepredictedTicks);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "client", aBuf);
+}
+
 void CGameClient::OnActivateEditor()
 {
 	OnRelease();
@@ -10,6 +10,8 @@
 #include <game/gamecore.h>
 #include "render.h"
 
+#include <memory>
+
 class CGameClient : public IGameClient
 {
 	class CStack
@@ -56,10 +58,40 @@ class CGameClient : public IGameClient
 	int m_PredictedTick;
 	int m_LastNewPredictedTick;
 
+	// the predicted world is kept between frames and only rolled forward by
+	// new ticks, the history lets a new snapshot be checked against it
+	enum
+	{
+		PREDICTION_HISTORY=64,
+	};
+	struct CPredictionState
+	{
+		int m_Tick;
+		bool m_aActive[MAX_CLIENTS];
+		CNetObj_CharacterCore m_aCores[MAX_CLIENTS];
+		bool m_HasInput;
+		CNetObj_PlayerInput m_Input; // local input the tick was simulated with
+	};
+	CWorldCore m_PredictedWorld;
+	int m_PredictedWorldTick; // -1 when it has to be rebuilt from the snapshot
+	int m_PredictedLocalID;
+	CPredictionState m_aPredictionHistory[PREDICTION_HISTORY];
+
+	// debug counters, see prediction_stats
+	int m_NumPredictedTicks;
+	int m_NumRepredictedTicks;
+	int m_NumRepredictions;
+
+	bool PredictionMatchesSnapshot();
+	void RebuildPrediction();
+	void PredictTick(int Tick);
+	void StorePredictionState(int Tick, const int *pInput);
+
 	int64 m_LastSendInfo;
 
 	static void ConTeam(IConsole::IResult *pResult, void *pUserData);
 	static void ConKill(IConsole::IResult *pResult, void *pUserData);
+	static void ConPredictionStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
@@ -83,6 +115,9 @@ public:
 	class IEditor *Editor() { return m_pEditor; }
 	class IFriends *Friends() { return m_pFriends; }
 
+	// hands startup decoding to the job pool, or leaves it for Wait() on the main thread with cl_parallel_loading 0
+	void StartLoadJob(std::shared_ptr<class CLoadJob> pJob);
+
 	int NetobjNumCorrections() { return m_NetObjHandler.NumObjCorrections(); }
 	const char *NetobjCorrectedOn() { return m_NetObjHandler.CorrectedObjOn(); }
 
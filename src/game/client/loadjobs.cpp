@@ -0,0 +1,68 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+
+#include <engine/sound.h>
+
+#include "loadjobs.h"
+
+CLoadJob::CLoadJob() :
+	m_State(PENDING)
+{
+}
+
+bool CLoadJob::Claim()
+{
+	int Expected = PENDING;
+	return m_State.compare_exchange_strong(Expected, CLAIMED);
+}
+
+void CLoadJob::Run()
+{
+	if(!Claim())
+		return;
+	Load();
+	m_State.store(DONE);
+}
+
+void CLoadJob::Wait()
+{
+	if(Claim())
+	{
+		Load();
+		m_State.store(DONE);
+		return;
+	}
+	while(m_State.load() != DONE)
+		thread_yield();
+}
+
+CPngLoadJob::CPngLoadJob(IGraphics *pGraphics, const char *pFilename, int StorageType) :
+	m_pGraphics(pGraphics), m_StorageType(StorageType), m_Loaded(false)
+{
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+	mem_zero(&m_Image, sizeof(m_Image));
+}
+
+CPngLoadJob::~CPngLoadJob()
+{
+	if(m_Image.m_pData)
+		mem_free(m_Image.m_pData);
+}
+
+void CPngLoadJob::Load()
+{
+	m_Loaded = m_pGraphics->LoadPNG(&m_Image, m_aFilename, m_StorageType) != 0;
+	if(m_Loaded)
+		Process();
+}
+
+CSoundLoadJob::CSoundLoadJob(ISound *pSound, int SampleID, const char *pFilename) :
+	m_pSound(pSound), m_pFilename(pFilename), m_SampleID(SampleID), m_Loaded(false)
+{
+}
+
+void CSoundLoadJob::Load()
+{
+	m_Loaded = m_pSound->DecodeWV(m_SampleID, m_pFilename);
+}
@@ -0,0 +1,73 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef GAME_CLIENT_LOADJOBS_H
+#define GAME_CLIENT_LOADJOBS_H
+
+#include <engine/graphics.h>
+#include <engine/shared/jobs.h>
+
+#include <atomic>
+
+// startup decoding that runs on the engine's job pool. the main thread calls
+// Wait() before it touches the result, and does the work itself if no worker
+// picked the job up yet. nothing in here may talk to the gpu
+class CLoadJob : public IJob
+{
+	enum
+	{
+		PENDING = 0,
+		CLAIMED,
+		DONE,
+	};
+
+	std::atomic<int> m_State;
+
+	bool Claim();
+	virtual void Run();
+
+protected:
+	virtual void Load() = 0;
+
+public:
+	CLoadJob();
+	bool Done() { return m_State.load() == DONE; }
+	void Wait();
+};
+
+// decodes a png, Process() may work on the pixels afterwards on the same thread
+class CPngLoadJob : public CLoadJob
+{
+	class IGraphics *m_pGraphics;
+
+protected:
+	virtual void Load();
+	virtual void Process() {}
+
+public:
+	CPngLoadJob(class IGraphics *pGraphics, const char *pFilename, int StorageType);
+	virtual ~CPngLoadJob();
+
+	char m_aFilename[512];
+	int m_StorageType;
+
+	bool m_Loaded;
+	CImageInfo m_Image;
+};
+
+// decodes a wavpack file into a sample id reserved on the main thread
+class CSoundLoadJob : public CLoadJob
+{
+	class ISound *m_pSound;
+
+protected:
+	virtual void Load();
+
+public:
+	CSoundLoadJob(class ISound *pSound, int SampleID, const char *pFilename);
+
+	const char *m_pFilename;
+	int m_SampleID;
+	bool m_Loaded;
+};
+
+#endif
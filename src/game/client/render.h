@@ -37,10 +37,36 @@ enum
 	LAYERRENDERFLAG_TRANSPARENT=2,
 
 	TILERENDERFLAG_EXTEND=4,
+	TILERENDERFLAG_BORDER=8, // only the extended tiles outside of the layer
 };
 
 typedef void (*ENVELOPE_EVAL)(float TimeOffset, int Env, float *pChannels, void *pUser);
 
+// tile layer geometry baked into a quad buffer, grouped in chunks for culling
+class CTilemapCache
+{
+public:
+	enum
+	{
+		CHUNK_SIZE=32,
+	};
+
+	struct CChunk
+	{
+		int m_FirstQuad;
+		int m_NumOpaque; // opaque tiles come first, then the transparent ones
+		int m_NumTransparent;
+	};
+
+	int m_Buffer;
+	int m_NumChunksX;
+	int m_NumChunksY;
+	CChunk *m_pChunks;
+	float m_TilesetScale;
+
+	CTilemapCache() : m_Buffer(-1), m_NumChunksX(0), m_NumChunksY(0), m_pChunks(0), m_TilesetScale(-1.0f) {}
+};
+
 class CRenderTools
 {
 public:
@@ -73,6 +99,9 @@ public:
 	static void RenderEvalEnvelope(CEnvPoint *pPoints, int NumPoints, int Channels, float Time, float *pResult);
 	void RenderQuads(CQuad *pQuads, int NumQuads, int Flags, ENVELOPE_EVAL pfnEval, void *pUser);
 	void RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	void RenderTilemapCached(CTilemapCache *pCache, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags, ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset);
+	void RenderTilemapBake(CTilemapCache *pCache, CTile *pTiles, int w, int h, float Scale, float TilesetScale);
+	void RenderTilemapFree(CTilemapCache *pCache);
 
 	// helpers
 	void MapscreenToWorld(float CenterX, float CenterY, float ParallaxX, float ParallaxY,
@@ -163,6 +163,66 @@ void CRenderTools::RenderQuads(CQuad *pQuads, int NumQuads, int RenderFlags, ENV
 	Graphics()->QuadsEnd();
 }
 
+// texture coordinates of a tile in the 16x16 tileset, in QuadsSetSubsetFree order
+static void GetTileUVs(unsigned char Index, unsigned char Flags, float TilesetScale, float *pUVs)
+{
+	// adjust the texture shift according to mipmap level
+	float TexSize = 1024.0f;
+	float Frac = (1.25f/TexSize) * (1/TilesetScale);
+	float Nudge = (0.5f/TexSize) * (1/TilesetScale);
+
+	int tx = Index%16;
+	int ty = Index/16;
+	int Px0 = tx*(1024/16);
+	int Py0 = ty*(1024/16);
+	int Px1 = Px0+(1024/16)-1;
+	int Py1 = Py0+(1024/16)-1;
+
+	float x0 = Nudge + Px0/TexSize+Frac;
+	float y0 = Nudge + Py0/TexSize+Frac;
+	float x1 = Nudge + Px1/TexSize-Frac;
+	float y1 = Nudge + Py0/TexSize+Frac;
+	float x2 = Nudge + Px1/TexSize-Frac;
+	float y2 = Nudge + Py1/TexSize-Frac;
+	float x3 = Nudge + Px0/TexSize+Frac;
+	float y3 = Nudge + Py1/TexSize-Frac;
+
+	if(Flags&TILEFLAG_VFLIP)
+	{
+		x0 = x2;
+		x1 = x3;
+		x2 = x3;
+		x3 = x0;
+	}
+
+	if(Flags&TILEFLAG_HFLIP)
+	{
+		y0 = y3;
+		y2 = y1;
+		y3 = y1;
+		y1 = y0;
+	}
+
+	if(Flags&TILEFLAG_ROTATE)
+	{
+		float Tmp = x0;
+		x0 = x3;
+		x3 = x2;
+		x2 = x1;
+		x1 = Tmp;
+		Tmp = y0;
+		y0 = y3;
+		y3 = y2;
+		y2 = y1;
+		y1 = Tmp;
+	}
+
+	pUVs[0] = x0; pUVs[1] = y0;
+	pUVs[2] = x1; pUVs[3] = y1;
+	pUVs[4] = x2; pUVs[5] = y2;
+	pUVs[6] = x3; pUVs[7] = y3;
+}
+
 void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
 									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
 {
@@ -195,17 +255,19 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 	int EndY = (int)(ScreenY1/Scale)+1;
 	int EndX = (int)(ScreenX1/Scale)+1;
 
-	// adjust the texture shift according to mipmap level
-	float TexSize = 1024.0f;
-	float Frac = (1.25f/TexSize) * (1/FinalTilesetScale);
-	float Nudge = (0.5f/TexSize) * (1/FinalTilesetScale);
-
 	for(int y = StartY; y < EndY; y++)
 		for(int x = StartX; x < EndX; x++)
 		{
 			int mx = x;
 			int my = y;
 
+			if(RenderFlags&TILERENDERFLAG_BORDER && x >= 0 && x < w && y >= 0 && y < h)
+			{
+				// the inside of the layer is drawn from the cache
+				x = w-1;
+				continue;
+			}
+
 			if(RenderFlags&TILERENDERFLAG_EXTEND)
 			{
 				if(mx<0)
@@ -250,61 +312,171 @@ void CRenderTools::RenderTilemap(CTile *pTiles, int w, int h, float Scale, vec4
 
 				if(Render)
 				{
+					float aUVs[8];
+					GetTileUVs(Index, Flags, FinalTilesetScale, aUVs);
+					Graphics()->QuadsSetSubsetFree(aUVs[0], aUVs[1], aUVs[2], aUVs[3], aUVs[4], aUVs[5], aUVs[6], aUVs[7]);
+					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
+					Graphics()->QuadsDrawTL(&QuadItem, 1);
+				}
+			}
+			x += pTiles[c].m_Skip;
+		}
 
-					int tx = Index%16;
-					int ty = Index/16;
-					int Px0 = tx*(1024/16);
-					int Py0 = ty*(1024/16);
-					int Px1 = Px0+(1024/16)-1;
-					int Py1 = Py0+(1024/16)-1;
-
-					float x0 = Nudge + Px0/TexSize+Frac;
-					float y0 = Nudge + Py0/TexSize+Frac;
-					float x1 = Nudge + Px1/TexSize-Frac;
-					float y1 = Nudge + Py0/TexSize+Frac;
-					float x2 = Nudge + Px1/TexSize-Frac;
-					float y2 = Nudge + Py1/TexSize-Frac;
-					float x3 = Nudge + Px0/TexSize+Frac;
-					float y3 = Nudge + Py1/TexSize-Frac;
-
-					if(Flags&TILEFLAG_VFLIP)
+	Graphics()->QuadsEnd();
+	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
+}
+
+void CRenderTools::RenderTilemapBake(CTilemapCache *pCache, CTile *pTiles, int w, int h, float Scale, float TilesetScale)
+{
+	RenderTilemapFree(pCache);
+
+	pCache->m_NumChunksX = (w+CTilemapCache::CHUNK_SIZE-1)/CTilemapCache::CHUNK_SIZE;
+	pCache->m_NumChunksY = (h+CTilemapCache::CHUNK_SIZE-1)/CTilemapCache::CHUNK_SIZE;
+	pCache->m_pChunks = new CTilemapCache::CChunk[pCache->m_NumChunksX*pCache->m_NumChunksY];
+	pCache->m_TilesetScale = TilesetScale;
+
+	int NumTiles = 0;
+	for(int i = 0; i < w*h; i++)
+		if(pTiles[i].m_Index)
+			NumTiles++;
+
+	IGraphics::CQuadVertex *pVertices = NumTiles ? new IGraphics::CQuadVertex[NumTiles*4] : 0;
+	int NumQuads = 0;
+	for(int cy = 0; cy < pCache->m_NumChunksY; cy++)
+		for(int cx = 0; cx < pCache->m_NumChunksX; cx++)
+		{
+			CTilemapCache::CChunk *pChunk = &pCache->m_pChunks[cy*pCache->m_NumChunksX+cx];
+			pChunk->m_FirstQuad = NumQuads;
+			int StartX = cx*CTilemapCache::CHUNK_SIZE;
+			int StartY = cy*CTilemapCache::CHUNK_SIZE;
+			int EndX = minimum(StartX+(int)CTilemapCache::CHUNK_SIZE, w);
+			int EndY = minimum(StartY+(int)CTilemapCache::CHUNK_SIZE, h);
+
+			// two passes so each chunk holds its opaque tiles in front of the transparent ones
+			for(int Pass = 0; Pass < 2; Pass++)
+			{
+				int PassStart = NumQuads;
+				for(int y = StartY; y < EndY; y++)
+					for(int x = StartX; x < EndX; x++)
 					{
-						x0 = x2;
-						x1 = x3;
-						x2 = x3;
-						x3 = x0;
+						const CTile *pTile = &pTiles[y*w+x];
+						if(!pTile->m_Index || (Pass == 0) != ((pTile->m_Flags&TILEFLAG_OPAQUE) != 0))
+							continue;
+
+						float aUVs[8];
+						GetTileUVs(pTile->m_Index, pTile->m_Flags, TilesetScale, aUVs);
+						IGraphics::CQuadVertex *pQuad = &pVertices[NumQuads*4];
+						pQuad[0].m_X = x*Scale; pQuad[0].m_Y = y*Scale;
+						pQuad[1].m_X = (x+1)*Scale; pQuad[1].m_Y = y*Scale;
+						pQuad[2].m_X = (x+1)*Scale; pQuad[2].m_Y = (y+1)*Scale;
+						pQuad[3].m_X = x*Scale; pQuad[3].m_Y = (y+1)*Scale;
+						for(int v = 0; v < 4; v++)
+						{
+							pQuad[v].m_U = aUVs[v*2];
+							pQuad[v].m_V = aUVs[v*2+1];
+						}
+						NumQuads++;
 					}
+				if(Pass == 0)
+					pChunk->m_NumOpaque = NumQuads-PassStart;
+				else
+					pChunk->m_NumTransparent = NumQuads-PassStart;
+			}
+		}
+
+	pCache->m_Buffer = NumQuads ? Graphics()->CreateQuadBuffer(pVertices, NumQuads) : -1;
+	delete [] pVertices;
+}
+
+void CRenderTools::RenderTilemapFree(CTilemapCache *pCache)
+{
+	if(pCache->m_Buffer >= 0)
+		Graphics()->DestroyQuadBuffer(pCache->m_Buffer);
+	delete [] pCache->m_pChunks;
+	pCache->m_Buffer = -1;
+	pCache->m_pChunks = 0;
+	pCache->m_NumChunksX = 0;
+	pCache->m_NumChunksY = 0;
+	pCache->m_TilesetScale = -1.0f;
+}
 
-					if(Flags&TILEFLAG_HFLIP)
+void CRenderTools::RenderTilemapCached(CTilemapCache *pCache, CTile *pTiles, int w, int h, float Scale, vec4 Color, int RenderFlags,
+									ENVELOPE_EVAL pfnEval, void *pUser, int ColorEnv, int ColorEnvOffset)
+{
+	float ScreenX0, ScreenY0, ScreenX1, ScreenY1;
+	Graphics()->GetScreen(&ScreenX0, &ScreenY0, &ScreenX1, &ScreenY1);
+
+	// the texture shift depends on the mipmap level, rebake when the zoom changes it
+	float TilePixelSize = 1024/32.0f;
+	float FinalTileSize = Scale/(ScreenX1-ScreenX0) * Graphics()->ScreenWidth();
+	float FinalTilesetScale = FinalTileSize/TilePixelSize;
+	if(!pCache->m_pChunks || pCache->m_TilesetScale != FinalTilesetScale)
+		RenderTilemapBake(pCache, pTiles, w, h, Scale, FinalTilesetScale);
+
+	float r=1, g=1, b=1, a=1;
+	if(ColorEnv >= 0)
+	{
+		float aChannels[4];
+		pfnEval(ColorEnvOffset/1000.0f, ColorEnv, aChannels, pUser);
+		r = aChannels[0];
+		g = aChannels[1];
+		b = aChannels[2];
+		a = aChannels[3];
+	}
+
+	int StartY = (int)(ScreenY0/Scale)-1;
+	int StartX = (int)(ScreenX0/Scale)-1;
+	int EndY = (int)(ScreenY1/Scale)+1;
+	int EndX = (int)(ScreenX1/Scale)+1;
+
+	if(pCache->m_Buffer >= 0)
+	{
+		// tiles only count as opaque while the layer is
+		bool Opaque = Color.a*a > 254.0f/255.0f;
+		int ChunkX0 = maximum(StartX, 0)/CTilemapCache::CHUNK_SIZE;
+		int ChunkY0 = maximum(StartY, 0)/CTilemapCache::CHUNK_SIZE;
+		int ChunkX1 = minimum((EndX-1)/CTilemapCache::CHUNK_SIZE, pCache->m_NumChunksX-1);
+		int ChunkY1 = minimum((EndY-1)/CTilemapCache::CHUNK_SIZE, pCache->m_NumChunksY-1);
+
+		// neighbouring ranges are merged into one draw
+		int First = 0, Num = 0;
+		for(int cy = ChunkY0; cy <= ChunkY1 && EndY > 0; cy++)
+			for(int cx = ChunkX0; cx <= ChunkX1 && EndX > 0; cx++)
+			{
+				const CTilemapCache::CChunk *pChunk = &pCache->m_pChunks[cy*pCache->m_NumChunksX+cx];
+				int ChunkFirst = pChunk->m_FirstQuad;
+				int ChunkNum = 0;
+				if(Opaque)
+				{
+					if(RenderFlags&LAYERRENDERFLAG_OPAQUE)
+						ChunkNum += pChunk->m_NumOpaque;
+					if(RenderFlags&LAYERRENDERFLAG_TRANSPARENT)
 					{
-						y0 = y3;
-						y2 = y1;
-						y3 = y1;
-						y1 = y0;
+						if(!ChunkNum)
+							ChunkFirst += pChunk->m_NumOpaque;
+						ChunkNum += pChunk->m_NumTransparent;
 					}
+				}
+				else if(RenderFlags&LAYERRENDERFLAG_TRANSPARENT)
+					ChunkNum = pChunk->m_NumOpaque+pChunk->m_NumTransparent;
 
-					if(Flags&TILEFLAG_ROTATE)
-					{
-						float Tmp = x0;
-						x0 = x3;
-						x3 = x2;
-						x2 = x1;
-						x1 = Tmp;
-						Tmp = y0;
-						y0 = y3;
-						y3 = y2;
-						y2 = y1;
-						y1 = Tmp;
- 					}
-
-					Graphics()->QuadsSetSubsetFree(x0, y0, x1, y1, x2, y2, x3, y3);
-					IGraphics::CQuadItem QuadItem(x*Scale, y*Scale, Scale, Scale);
-					Graphics()->QuadsDrawTL(&QuadItem, 1);
+				if(!ChunkNum)
+					continue;
+				if(Num && First+Num == ChunkFirst)
+					Num += ChunkNum;
+				else
+				{
+					if(Num)
+						Graphics()->RenderQuadBuffer(pCache->m_Buffer, First, Num, Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+					First = ChunkFirst;
+					Num = ChunkNum;
 				}
 			}
-			x += pTiles[c].m_Skip;
-		}
+		if(Num)
+			Graphics()->RenderQuadBuffer(pCache->m_Buffer, First, Num, Color.r*r, Color.g*g, Color.b*b, Color.a*a);
+	}
 
-	Graphics()->QuadsEnd();
-	Graphics()->MapScreen(ScreenX0, ScreenY0, ScreenX1, ScreenY1);
+	// whatever shows outside of the layer still goes the old way
+	if(RenderFlags&TILERENDERFLAG_EXTEND && (StartX < 0 || StartY < 0 || EndX > w || EndY > h))
+		RenderTilemap(pTiles, w, h, Scale, Color, RenderFlags|TILERENDERFLAG_BORDER, pfnEval, pUser, ColorEnv, ColorEnvOffset);
 }
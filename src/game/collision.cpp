@@ -8,6 +8,7 @@
 #include <math.h>
 #include <engine/map.h>
 #include <engine/kernel.h>
+#include <engine/storage.h>
 
 #include <game/mapitems.h>
 #include <game/layers.h>
@@ -24,6 +25,8 @@ CCollision::CCollision()
 
 	m_pPath = 0;
 	m_pCenterWaypoint = 0;
+	m_GraphVersion = 0;
+	m_NumDirtyRects = 0;
 
 	for (int i = 0; i < MAX_WAYPOINTS; i++)
 		m_apWaypoint[i] = 0;
@@ -68,6 +71,7 @@ void CCollision::Init(class CLayers *pLayers)
 void CCollision::ClearWaypoints()
 {
 	m_WaypointCount = 0;
+	m_GraphVersion = 0;
 
 	for (int i = 0; i < MAX_WAYPOINTS; i++)
 	{
@@ -89,6 +93,23 @@ void CCollision::AddWaypoint(vec2 Position, bool InnerCorner)
 	m_WaypointCount++;
 }
 
+bool CCollision::IsWaypointTile(int x, int y)
+{
+	if (m_pTiles[y * m_Width + x].m_Index && m_pTiles[y * m_Width + x].m_Index < 128)
+		return false;
+
+	// find all outer corners
+	if ((IsTileSolid((x - 1) * 32, (y - 1) * 32) && !IsTileSolid((x - 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y - 1) * 32)) ||
+		(IsTileSolid((x - 1) * 32, (y + 1) * 32) && !IsTileSolid((x - 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y + 1) * 32)) ||
+		(IsTileSolid((x + 1) * 32, (y + 1) * 32) && !IsTileSolid((x + 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y + 1) * 32)) ||
+		(IsTileSolid((x + 1) * 32, (y - 1) * 32) && !IsTileSolid((x + 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y - 1) * 32)))
+		return true;
+
+	// find all inner corners
+	// (inner corner waypoints used to be flagged, AddWaypoint(vec2(x, y), true))
+	return (IsTileSolid((x + 1) * 32, y * 32) || IsTileSolid((x - 1) * 32, y * 32)) && (IsTileSolid(x * 32, (y + 1) * 32) || IsTileSolid(x * 32, (y + 1) * 32));
+}
+
 void CCollision::GenerateWaypoints()
 {
 	ClearWaypoints();
@@ -96,26 +117,8 @@ void CCollision::GenerateWaypoints()
 	{
 		for (int y = 2; y < m_Height - 2; y++)
 		{
-			if (m_pTiles[y * m_Width + x].m_Index && m_pTiles[y * m_Width + x].m_Index < 128)
-				continue;
-
-			// find all outer corners
-			if ((IsTileSolid((x - 1) * 32, (y - 1) * 32) && !IsTileSolid((x - 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y - 1) * 32)) ||
-				(IsTileSolid((x - 1) * 32, (y + 1) * 32) && !IsTileSolid((x - 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y + 1) * 32)) ||
-				(IsTileSolid((x + 1) * 32, (y + 1) * 32) && !IsTileSolid((x + 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y + 1) * 32)) ||
-				(IsTileSolid((x + 1) * 32, (y - 1) * 32) && !IsTileSolid((x + 1) * 32, (y - 0) * 32) && !IsTileSolid((x - 0) * 32, (y - 1) * 32)))
-			{
-				// outer corner found -> create a waypoint
+			if (IsWaypointTile(x, y))
 				AddWaypoint(vec2(x, y));
-			}
-			else
-				// find all inner corners
-				if ((IsTileSolid((x + 1) * 32, y * 32) || IsTileSolid((x - 1) * 32, y * 32)) && (IsTileSolid(x * 32, (y + 1) * 32) || IsTileSolid(x * 32, (y + 1) * 32)))
-				{
-					// inner corner found -> create a waypoint
-					// AddWaypoint(vec2(x, y), true);
-					AddWaypoint(vec2(x, y));
-				}
 		}
 	}
 
@@ -128,6 +131,146 @@ void CCollision::GenerateWaypoints()
 		KeepGoing = GenerateSomeMoreWaypoints();
 	}
 	ConnectWaypoints();
+
+	// the graph now covers every tile
+	ClearDirtyRects();
+}
+
+// waypoint graph cache
+enum
+{
+	WAYPOINTCACHE_VERSION = 1,
+};
+
+struct CWaypointCacheHeader
+{
+	char m_aID[4];
+	int m_Version;
+	SHA256_DIGEST m_MapSha256;
+	int m_WaypointCount;
+	int m_ConnectionCount;
+};
+
+struct CWaypointCacheItem
+{
+	int m_X;
+	int m_Y;
+	int m_InnerCorner;
+	int m_ConnectionCount;
+	int m_aConnection[MAX_WAYPOINTCONNECTIONS]; // waypoint index or -1
+};
+
+static void WaypointCachePath(SHA256_DIGEST MapSha256, char *pBuf, int BufSize)
+{
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(MapSha256, aSha256, sizeof(aSha256));
+	str_format(pBuf, BufSize, "waypoints/%s.wpc", aSha256);
+}
+
+bool CCollision::LoadWaypoints(IStorage *pStorage, SHA256_DIGEST MapSha256)
+{
+	char aPath[128];
+	WaypointCachePath(MapSha256, aPath, sizeof(aPath));
+	IOHANDLE File = pStorage->OpenFile(aPath, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if (!File)
+		return false;
+
+	// map the graph and build the waypoints straight from it
+	unsigned Size = 0;
+	unsigned char *pData = (unsigned char *)io_map(File, &Size);
+	io_close(File);
+	if (!pData)
+		return false;
+
+	CWaypointCacheHeader Header;
+	bool Valid = Size >= sizeof(Header);
+	if (Valid)
+	{
+		mem_copy(&Header, pData, sizeof(Header));
+		Valid = mem_comp(Header.m_aID, "WPGC", 4) == 0 && Header.m_Version == WAYPOINTCACHE_VERSION &&
+			Header.m_MapSha256 == MapSha256 && Header.m_WaypointCount >= 0 && Header.m_WaypointCount <= MAX_WAYPOINTS &&
+			Size == sizeof(Header) + Header.m_WaypointCount * sizeof(CWaypointCacheItem);
+	}
+	const CWaypointCacheItem *pItems = (const CWaypointCacheItem *)(pData + sizeof(Header));
+
+	for (int i = 0; Valid && i < Header.m_WaypointCount; i++)
+	{
+		Valid = pItems[i].m_ConnectionCount >= 0 && pItems[i].m_ConnectionCount <= MAX_WAYPOINTCONNECTIONS;
+		for (int c = 0; Valid && c < MAX_WAYPOINTCONNECTIONS; c++)
+			Valid = pItems[i].m_aConnection[c] >= -1 && pItems[i].m_aConnection[c] < Header.m_WaypointCount;
+	}
+
+	if (!Valid)
+	{
+		io_unmap(pData, Size);
+		return false;
+	}
+
+	ClearWaypoints();
+	for (int i = 0; i < Header.m_WaypointCount; i++)
+		AddWaypoint(vec2(pItems[i].m_X, pItems[i].m_Y), pItems[i].m_InnerCorner);
+
+	for (int i = 0; i < Header.m_WaypointCount; i++)
+	{
+		for (int c = 0; c < MAX_WAYPOINTCONNECTIONS; c++)
+		{
+			int Index = pItems[i].m_aConnection[c];
+			m_apWaypoint[i]->SetConnection(c, Index >= 0 ? m_apWaypoint[Index] : 0);
+		}
+		m_apWaypoint[i]->m_ConnectionCount = pItems[i].m_ConnectionCount;
+	}
+	m_ConnectionCount = Header.m_ConnectionCount;
+
+	io_unmap(pData, Size);
+	return true;
+}
+
+bool CCollision::SaveWaypoints(IStorage *pStorage, SHA256_DIGEST MapSha256)
+{
+	char aPath[128];
+	char aTmpPath[128];
+	WaypointCachePath(MapSha256, aPath, sizeof(aPath));
+	str_format(aTmpPath, sizeof(aTmpPath), "%s.tmp", aPath);
+
+	pStorage->CreateFolder("waypoints", IStorage::TYPE_SAVE);
+	IOHANDLE File = pStorage->OpenFile(aTmpPath, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if (!File)
+		return false;
+
+	CWaypointCacheHeader Header;
+	mem_copy(Header.m_aID, "WPGC", 4);
+	Header.m_Version = WAYPOINTCACHE_VERSION;
+	Header.m_MapSha256 = MapSha256;
+	Header.m_WaypointCount = m_WaypointCount;
+	Header.m_ConnectionCount = m_ConnectionCount;
+	io_write(File, &Header, sizeof(Header));
+
+	for (int i = 0; i < m_WaypointCount; i++)
+	{
+		CWaypoint *pWaypoint = m_apWaypoint[i];
+		CWaypointCacheItem Item;
+		Item.m_X = pWaypoint->m_X;
+		Item.m_Y = pWaypoint->m_Y;
+		Item.m_InnerCorner = pWaypoint->m_InnerCorner;
+		Item.m_ConnectionCount = pWaypoint->m_ConnectionCount;
+		for (int c = 0; c < MAX_WAYPOINTCONNECTIONS; c++)
+		{
+			// waypoints are never removed, so the slot is the index
+			Item.m_aConnection[c] = -1;
+			for (int j = 0; pWaypoint->m_apConnection[c] && j < m_WaypointCount; j++)
+				if (m_apWaypoint[j] == pWaypoint->m_apConnection[c])
+				{
+					Item.m_aConnection[c] = j;
+					break;
+				}
+		}
+		io_write(File, &Item, sizeof(Item));
+	}
+	io_close(File);
+
+	// moved into place at the end, a crash never leaves half a graph behind
+	pStorage->RemoveFile(aPath, IStorage::TYPE_SAVE);
+	return pStorage->RenameFile(aTmpPath, aPath, IStorage::TYPE_SAVE);
 }
 
 // create a new waypoints between connected, far apart ones
@@ -184,6 +327,81 @@ CWaypoint *CCollision::GetWaypointAt(int x, int y)
 	return NULL;
 }
 
+void CCollision::ScanWaypointConnections(CWaypoint *pWaypoint)
+{
+	int x, y;
+
+	x = pWaypoint->m_X - 1;
+	y = pWaypoint->m_Y;
+
+	// find waypoints at left
+	while (!m_pTiles[y * m_Width + x].m_Index || m_pTiles[y * m_Width + x].m_Index >= 128)
+	{
+		CWaypoint *W = GetWaypointAt(x, y);
+
+		if (W)
+		{
+			if (pWaypoint->Connect(W))
+				m_ConnectionCount++;
+			break;
+		}
+
+		// if (!IsTileSolid(x*32, (y-1)*32) && !IsTileSolid(x*32, (y+1)*32))
+		if (!IsTileSolid(x * 32, (y + 1) * 32))
+			break;
+
+		x--;
+	}
+
+	x = pWaypoint->m_X;
+	y = pWaypoint->m_Y - 1;
+
+	int n = 0;
+
+	// find waypoints at up
+	// bool SolidFound = false;
+	while ((!m_pTiles[y * m_Width + x].m_Index || m_pTiles[y * m_Width + x].m_Index >= 128) && n++ < 10)
+	{
+		CWaypoint *W = GetWaypointAt(x, y);
+
+		// if (IsTileSolid((x+1)*32, y*32) || IsTileSolid((x+1)*32, y*32))
+		//	SolidFound = true;
+
+		// if (W && SolidFound)
+		if (W)
+		{
+			if (pWaypoint->Connect(W))
+				m_ConnectionCount++;
+			break;
+		}
+
+		y--;
+	}
+}
+
+void CCollision::ConnectVisibleWaypoints(CWaypoint *pWaypoint)
+{
+	if (pWaypoint->m_InnerCorner)
+		return;
+
+	for (int j = 0; j < m_WaypointCount; j++)
+	{
+		if (m_apWaypoint[j] && m_apWaypoint[j]->m_InnerCorner)
+			continue;
+
+		if (m_apWaypoint[j] && !pWaypoint->Connected(m_apWaypoint[j]))
+		{
+			float Dist = distance(pWaypoint->m_Pos, m_apWaypoint[j]->m_Pos);
+
+			if (Dist < 600 && !IntersectLine(pWaypoint->m_Pos, m_apWaypoint[j]->m_Pos, NULL, NULL, true))
+			{
+				if (pWaypoint->Connect(m_apWaypoint[j]))
+					m_ConnectionCount++;
+			}
+		}
+	}
+}
+
 void CCollision::ConnectWaypoints()
 {
 	m_ConnectionCount = 0;
@@ -199,82 +417,196 @@ void CCollision::ConnectWaypoints()
 
 	for (int i = 0; i < m_WaypointCount; i++)
 	{
-		if (!m_apWaypoint[i])
-			continue;
+		if (m_apWaypoint[i])
+			ScanWaypointConnections(m_apWaypoint[i]);
+	}
 
-		int x, y;
+	// connect to near, visible waypoints
+	for (int i = 0; i < m_WaypointCount; i++)
+	{
+		if (m_apWaypoint[i])
+			ConnectVisibleWaypoints(m_apWaypoint[i]);
+	}
+}
 
-		x = m_apWaypoint[i]->m_X - 1;
-		y = m_apWaypoint[i]->m_Y;
+static bool SegmentInRect(vec2 Pos0, vec2 Pos1, vec2 Min, vec2 Max)
+{
+	// slab test
+	float t0 = 0.0f, t1 = 1.0f;
+	vec2 Dir = Pos1 - Pos0;
+	for (int a = 0; a < 2; a++)
+	{
+		float p = a == 0 ? Pos0.x : Pos0.y;
+		float d = a == 0 ? Dir.x : Dir.y;
+		float Lo = a == 0 ? Min.x : Min.y;
+		float Hi = a == 0 ? Max.x : Max.y;
+		if (d == 0.0f)
+		{
+			if (p < Lo || p > Hi)
+				return false;
+			continue;
+		}
 
-		// find waypoints at left
-		while (!m_pTiles[y * m_Width + x].m_Index || m_pTiles[y * m_Width + x].m_Index >= 128)
+		float ta = (Lo - p) / d;
+		float tb = (Hi - p) / d;
+		if (ta > tb)
 		{
-			CWaypoint *W = GetWaypointAt(x, y);
+			float t = ta;
+			ta = tb;
+			tb = t;
+		}
+		t0 = maximum(t0, ta);
+		t1 = minimum(t1, tb);
+		if (t0 > t1)
+			return false;
+	}
+	return true;
+}
 
-			if (W)
-			{
-				if (m_apWaypoint[i]->Connect(W))
-					m_ConnectionCount++;
-				break;
-			}
+static void AddAffected(std::vector<ivec2> *paAffected, int x, int y)
+{
+	for (unsigned i = 0; i < paAffected->size(); i++)
+		if ((*paAffected)[i].x == x && (*paAffected)[i].y == y)
+			return;
+	paAffected->push_back(ivec2(x, y));
+}
 
-			// if (!IsTileSolid(x*32, (y-1)*32) && !IsTileSolid(x*32, (y+1)*32))
-			if (!IsTileSolid(x * 32, (y + 1) * 32))
-				break;
+void CCollision::RemoveWaypoint(int Index)
+{
+	CWaypoint *pWaypoint = m_apWaypoint[Index];
+	while (pWaypoint->m_ConnectionCount > 0)
+	{
+		if (!pWaypoint->m_apConnection[pWaypoint->m_ConnectionCount - 1])
+			pWaypoint->m_ConnectionCount--;
+		else if (pWaypoint->Disconnect(pWaypoint->m_apConnection[pWaypoint->m_ConnectionCount - 1]))
+			m_ConnectionCount--;
+	}
+	delete pWaypoint;
 
-			x--;
-		}
+	m_WaypointCount--;
+	m_apWaypoint[Index] = m_apWaypoint[m_WaypointCount];
+	m_apWaypoint[m_WaypointCount] = 0;
+}
 
-		x = m_apWaypoint[i]->m_X;
-		y = m_apWaypoint[i]->m_Y - 1;
+void CCollision::RepairWaypoints(int TileX, int TileY)
+{
+	if (!m_WaypointCount)
+		return;
 
-		int n = 0;
+	// a tile decides about the waypoints and floors around it
+	vec2 Min((TileX - 1) * 32.0f, (TileY - 1) * 32.0f);
+	vec2 Max((TileX + 2) * 32.0f, (TileY + 2) * 32.0f);
+	std::vector<ivec2> aAffected;
 
-		// find waypoints at up
-		// bool SolidFound = false;
-		while ((!m_pTiles[y * m_Width + x].m_Index || m_pTiles[y * m_Width + x].m_Index >= 128) && n++ < 10)
+	// waypoints of the area that went away or showed up
+	for (int y = maximum(TileY - 1, 2); y <= minimum(TileY + 1, m_Height - 3); y++)
+	{
+		for (int x = maximum(TileX - 1, 2); x <= minimum(TileX + 1, m_Width - 3); x++)
 		{
-			CWaypoint *W = GetWaypointAt(x, y);
+			bool Wanted = IsWaypointTile(x, y);
+			int Index = -1;
+			for (int i = 0; i < m_WaypointCount && Index < 0; i++)
+				if (m_apWaypoint[i]->m_X == x && m_apWaypoint[i]->m_Y == y)
+					Index = i;
 
-			// if (IsTileSolid((x+1)*32, y*32) || IsTileSolid((x+1)*32, y*32))
-			//	SolidFound = true;
-
-			// if (W && SolidFound)
-			if (W)
+			if (Index >= 0 && !Wanted)
 			{
-				if (m_apWaypoint[i]->Connect(W))
-					m_ConnectionCount++;
-				break;
+				CWaypoint *pWaypoint = m_apWaypoint[Index];
+				for (int c = 0; c < pWaypoint->m_ConnectionCount; c++)
+					if (pWaypoint->m_apConnection[c])
+						AddAffected(&aAffected, pWaypoint->m_apConnection[c]->m_X, pWaypoint->m_apConnection[c]->m_Y);
+				RemoveWaypoint(Index);
+			}
+			else if (Index < 0 && Wanted && m_WaypointCount < MAX_WAYPOINTS)
+			{
+				AddWaypoint(vec2(x, y));
+				AddAffected(&aAffected, x, y);
 			}
+		}
+	}
 
-			y--;
+	// drop the connections crossing the area, and find the waypoints whose
+	// left and up scans could run through it
+	for (int i = 0; i < m_WaypointCount; i++)
+	{
+		CWaypoint *pWaypoint = m_apWaypoint[i];
+		for (int c = 0; c < pWaypoint->m_ConnectionCount;)
+		{
+			CWaypoint *pOther = pWaypoint->m_apConnection[c];
+			if (pOther && SegmentInRect(pWaypoint->m_Pos, pOther->m_Pos, Min, Max) && pWaypoint->Disconnect(pOther))
+			{
+				m_ConnectionCount--;
+				AddAffected(&aAffected, pWaypoint->m_X, pWaypoint->m_Y);
+				AddAffected(&aAffected, pOther->m_X, pOther->m_Y);
+			}
+			else
+				c++;
 		}
+
+		if ((abs(pWaypoint->m_Y - TileY) <= 1 && pWaypoint->m_X >= TileX - 1) ||
+			(abs(pWaypoint->m_X - TileX) <= 1 && pWaypoint->m_Y >= TileY - 1 && pWaypoint->m_Y <= TileY + 12))
+			AddAffected(&aAffected, pWaypoint->m_X, pWaypoint->m_Y);
 	}
 
-	// connect to near, visible waypoints
+	// reconnect, the visibility pass only needs the lines through the area
+	for (unsigned a = 0; a < aAffected.size(); a++)
+	{
+		CWaypoint *pWaypoint = GetWaypointAt(aAffected[a].x, aAffected[a].y);
+		if (pWaypoint)
+			ScanWaypointConnections(pWaypoint);
+	}
+
+	vec2 Center = (Min + Max) * 0.5f;
 	for (int i = 0; i < m_WaypointCount; i++)
 	{
-		if (m_apWaypoint[i] && m_apWaypoint[i]->m_InnerCorner)
+		CWaypoint *pWaypoint = m_apWaypoint[i];
+		if (pWaypoint->m_InnerCorner || distance(pWaypoint->m_Pos, Center) > 600 + 48)
 			continue;
 
-		for (int j = 0; j < m_WaypointCount; j++)
+		for (int j = i + 1; j < m_WaypointCount; j++)
 		{
-			if (m_apWaypoint[j] && m_apWaypoint[j]->m_InnerCorner)
+			CWaypoint *pOther = m_apWaypoint[j];
+			if (pOther->m_InnerCorner || pWaypoint->Connected(pOther) || !SegmentInRect(pWaypoint->m_Pos, pOther->m_Pos, Min, Max))
 				continue;
 
-			if (m_apWaypoint[i] && m_apWaypoint[j] && !m_apWaypoint[i]->Connected(m_apWaypoint[j]))
+			if (distance(pWaypoint->m_Pos, pOther->m_Pos) < 600 && !IntersectLine(pWaypoint->m_Pos, pOther->m_Pos, NULL, NULL, true))
 			{
-				float Dist = distance(m_apWaypoint[i]->m_Pos, m_apWaypoint[j]->m_Pos);
-
-				if (Dist < 600 && !IntersectLine(m_apWaypoint[i]->m_Pos, m_apWaypoint[j]->m_Pos, NULL, NULL, true))
-				{
-					if (m_apWaypoint[i]->Connect(m_apWaypoint[j]))
-						m_ConnectionCount++;
-				}
+				if (pWaypoint->Connect(pOther))
+					m_ConnectionCount++;
 			}
 		}
 	}
+
+	// new waypoints also connect to everything they see
+	for (unsigned a = 0; a < aAffected.size(); a++)
+	{
+		CWaypoint *pWaypoint = GetWaypointAt(aAffected[a].x, aAffected[a].y);
+		if (pWaypoint && pWaypoint->m_ConnectionCount == 0)
+			ConnectVisibleWaypoints(pWaypoint);
+	}
+
+	m_pCenterWaypoint = 0;
+	m_aGraphChanges[m_GraphVersion % MAX_GRAPH_CHANGES] = ivec2(TileX, TileY);
+	m_GraphVersion++;
+}
+
+bool CCollision::PathAffected(const CWaypointPath *pPath, int SinceVersion)
+{
+	if (SinceVersion == m_GraphVersion)
+		return false;
+	if (m_GraphVersion - SinceVersion > MAX_GRAPH_CHANGES || SinceVersion > m_GraphVersion)
+		return true;
+
+	for (int v = SinceVersion; v < m_GraphVersion; v++)
+	{
+		ivec2 Tile = m_aGraphChanges[v % MAX_GRAPH_CHANGES];
+		vec2 Min((Tile.x - 1) * 32.0f, (Tile.y - 1) * 32.0f);
+		vec2 Max((Tile.x + 2) * 32.0f, (Tile.y + 2) * 32.0f);
+		for (const CWaypointPath *p = pPath; p && p->m_pNext; p = p->m_pNext)
+			if (SegmentInRect(p->m_Pos, p->m_pNext->m_Pos, Min, Max))
+				return true;
+	}
+	return false;
 }
 
 CWaypoint *CCollision::GetClosestWaypoint(vec2 Pos)
@@ -478,6 +810,26 @@ void CCollision::MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, i
 	}
 }
 
+void CCollision::CheckPoints(const float *pX, const float *pY, int Num, bool *pHits)
+{
+	// placed blocks have to be searched for every point
+	if (!m_pBlockSolid.empty())
+	{
+		for (int i = 0; i < Num; i++)
+			pHits[i] = CheckPoint(pX[i], pY[i]);
+		return;
+	}
+
+	// otherwise it's only the tile grid, same lookup as GetTile
+	for (int i = 0; i < Num; i++)
+	{
+		int Nx = clamp((int)round(pX[i]) / 32, 0, m_Width - 1);
+		int Ny = clamp((int)round(pY[i]) / 32, 0, m_Height - 1);
+		int Index = m_pTiles[Ny * m_Width + Nx].m_Index;
+		pHits[i] = Index <= 128 && (Index & COLFLAG_SOLID);
+	}
+}
+
 bool CCollision::TestBox(vec2 Pos, vec2 Size)
 {
 	Size *= 0.5f;
@@ -550,61 +902,154 @@ void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elas
 	*pInoutVel = Vel;
 }
 
+bool CCollision::GetTileSpan(int Group, int Layer, CTileSpan *pSpan)
+{
+	CMapItemLayerTilemap *pTilemap = m_pLayers->GetTileLayer(Group, Layer);
+	if (!pTilemap)
+		return false;
+
+	pSpan->m_GameLayer = pTilemap == m_pLayers->GameLayer();
+	pSpan->m_pTiles = pSpan->m_GameLayer ? m_pTiles : static_cast<CTile *>(m_pLayers->Map()->GetData(pTilemap->m_Data));
+	pSpan->m_Width = pTilemap->m_Width;
+	pSpan->m_Height = pTilemap->m_Height;
+	return true;
+}
+
+int CCollision::TileToColFlag(int Tile)
+{
+	switch (Tile)
+	{
+	case TILE_DEATH:
+		return COLFLAG_DEATH;
+	case TILE_SOLID:
+		return COLFLAG_SOLID;
+	case TILE_DAMAGEFLUID:
+		return COLFLAG_DAMAGEFLUID;
+	case TILE_RAMP_LEFT:
+	case TILE_RAMP_RIGHT:
+	case TILE_ROOFSLOPE_LEFT:
+	case TILE_ROOFSLOPE_RIGHT:
+		return TILE_SOLID;
+	default:
+		return Tile <= 128 ? 0 : Tile;
+	}
+}
+
 bool CCollision::ModifTile(ivec2 pos, int group, int layer, int tile, int flags, int reserved)
 {
-	CMapItemGroup *pGroup = m_pLayers->GetGroup(group);
-	CMapItemLayer *pLayer = m_pLayers->GetLayer(pGroup->m_StartLayer + layer);
-	if (pLayer->m_Type != LAYERTYPE_TILES)
+	CTileSpan Span;
+	if (!GetTileSpan(group, layer, &Span))
 		return false;
 
-	CMapItemLayerTilemap *pTilemap = reinterpret_cast<CMapItemLayerTilemap *>(pLayer);
-	int TotalTiles = pTilemap->m_Width * pTilemap->m_Height;
-	int tpos = (int)pos.y * pTilemap->m_Width + (int)pos.x;
-	if (tpos < 0 || tpos >= TotalTiles)
+	int tpos = (int)pos.y * Span.m_Width + (int)pos.x;
+	if (tpos < 0 || tpos >= Span.m_Width * Span.m_Height)
 		return false;
 
-	if (pTilemap != m_pLayers->GameLayer())
+	WriteTile(&Span, tpos, tile, flags, reserved);
+	if (Span.m_GameLayer)
+		MarkDirty(tpos % Span.m_Width, tpos / Span.m_Width, 1, 1);
+
+	return true;
+}
+
+void CCollision::FillTiles(const CTileSpan *pSpan, int x, int y, int w, int h, int Tile, int Flags)
+{
+	int x0 = maximum(x, 0);
+	int y0 = maximum(y, 0);
+	int x1 = minimum(x + w, pSpan->m_Width);
+	int y1 = minimum(y + h, pSpan->m_Height);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	CTile Fill;
+	Fill.m_Index = pSpan->m_GameLayer ? TileToColFlag(Tile) : Tile;
+	Fill.m_Flags = Flags;
+	Fill.m_Reserved = 0;
+	for (int ty = y0; ty < y1; ty++)
 	{
-		CTile *pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(pTilemap->m_Data));
-		pTiles[tpos].m_Flags = flags;
-		pTiles[tpos].m_Index = tile;
-		pTiles[tpos].m_Reserved = reserved;
+		CTile *pRow = &pSpan->m_pTiles[ty * pSpan->m_Width];
+		for (int tx = x0; tx < x1; tx++)
+		{
+			Fill.m_Skip = pRow[tx].m_Skip;
+			pRow[tx] = Fill;
+		}
 	}
-	else
+
+	if (pSpan->m_GameLayer)
+		MarkDirty(x0, y0, x1 - x0, y1 - y0);
+}
+
+void CCollision::MarkDirty(int x, int y, int w, int h)
+{
+	CDirtyRect Rect = {x, y, x + w, y + h};
+
+	// grow the last rect when the new one touches it, single tile writes are mostly in order
+	if (m_NumDirtyRects)
 	{
-		m_pTiles[tpos].m_Index = tile;
-		m_pTiles[tpos].m_Flags = flags;
-		m_pTiles[tpos].m_Reserved = reserved;
+		CDirtyRect *pLast = &m_aDirtyRects[m_NumDirtyRects - 1];
+		if (Rect.m_X0 <= pLast->m_X1 && Rect.m_X1 >= pLast->m_X0 && Rect.m_Y0 <= pLast->m_Y1 && Rect.m_Y1 >= pLast->m_Y0)
+		{
+			pLast->m_X0 = minimum(pLast->m_X0, Rect.m_X0);
+			pLast->m_Y0 = minimum(pLast->m_Y0, Rect.m_Y0);
+			pLast->m_X1 = maximum(pLast->m_X1, Rect.m_X1);
+			pLast->m_Y1 = maximum(pLast->m_Y1, Rect.m_Y1);
+			return;
+		}
+	}
 
-		switch (tile)
+	// out of room, collapse everything into one bounding rect
+	if (m_NumDirtyRects == MAX_DIRTY_RECTS)
+	{
+		for (int i = 1; i < m_NumDirtyRects; i++)
 		{
-		case TILE_DEATH:
-			m_pTiles[tpos].m_Index = COLFLAG_DEATH;
-			break;
-		case TILE_SOLID:
-			m_pTiles[tpos].m_Index = COLFLAG_SOLID;
-			break;
-		case TILE_DAMAGEFLUID:
-			m_pTiles[tpos].m_Index = COLFLAG_DAMAGEFLUID;
-			break;
-		case TILE_RAMP_LEFT:
-		case TILE_RAMP_RIGHT:
-		case TILE_ROOFSLOPE_LEFT:
-		case TILE_ROOFSLOPE_RIGHT:
-			m_pTiles[tpos].m_Index = TILE_SOLID;
-			break;
-		default:
-			if (tile <= 128)
-				m_pTiles[tpos].m_Index = 0;
+			m_aDirtyRects[0].m_X0 = minimum(m_aDirtyRects[0].m_X0, m_aDirtyRects[i].m_X0);
+			m_aDirtyRects[0].m_Y0 = minimum(m_aDirtyRects[0].m_Y0, m_aDirtyRects[i].m_Y0);
+			m_aDirtyRects[0].m_X1 = maximum(m_aDirtyRects[0].m_X1, m_aDirtyRects[i].m_X1);
+			m_aDirtyRects[0].m_Y1 = maximum(m_aDirtyRects[0].m_Y1, m_aDirtyRects[i].m_Y1);
 		}
+		m_NumDirtyRects = 1;
+		MarkDirty(x, y, w, h);
+		return;
 	}
 
-	return true;
+	m_aDirtyRects[m_NumDirtyRects++] = Rect;
+}
+
+void CCollision::RefreshDirtyWaypoints()
+{
+	if (!m_NumDirtyRects)
+		return;
+
+	// no graph yet, the next GenerateWaypoints sees the new tiles anyway
+	if (!m_WaypointCount)
+	{
+		ClearDirtyRects();
+		return;
+	}
+
+	// each repair scans the whole graph, past a few hundred tiles a rebuild is cheaper
+	int Area = 0;
+	for (int i = 0; i < m_NumDirtyRects; i++)
+		Area += (m_aDirtyRects[i].m_X1 - m_aDirtyRects[i].m_X0) * (m_aDirtyRects[i].m_Y1 - m_aDirtyRects[i].m_Y0);
+
+	if (Area > 256)
+	{
+		GenerateWaypoints();
+		return;
+	}
+
+	for (int i = 0; i < m_NumDirtyRects; i++)
+		for (int y = m_aDirtyRects[i].m_Y0; y < m_aDirtyRects[i].m_Y1; y++)
+			for (int x = m_aDirtyRects[i].m_X0; x < m_aDirtyRects[i].m_X1; x++)
+				RepairWaypoints(x, y);
+
+	ClearDirtyRects();
 }
 
 void CCollision::CreateBlock(vec2 Pos, int Type)
 {
 	m_pTiles[((int)Pos.y/32) * m_Width + ((int)Pos.x/32)].m_Index = TILE_SOLID;
+	RepairWaypoints((int)Pos.x/32, (int)Pos.y/32);
 	return;
 	CBlockSolid Tmp;
 	Tmp.m_Pos = Pos;
@@ -613,6 +1058,12 @@ void CCollision::CreateBlock(vec2 Pos, int Type)
 	m_pBlockSolid.push_back(Tmp);
 }
 
+void CCollision::DestroyBlock(vec2 Pos)
+{
+	m_pTiles[((int)Pos.y/32) * m_Width + ((int)Pos.x/32)].m_Index = 0;
+	RepairWaypoints((int)Pos.x/32, (int)Pos.y/32);
+}
+
 CBlockSolid *CCollision::FindBlock(vec2 Pos)
 {
 	for (int i = 0; i < m_pBlockSolid.size(); i++)
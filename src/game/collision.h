@@ -4,7 +4,9 @@
 #define GAME_COLLISION_H
 
 #include <vector>
+#include <base/hash.h>
 #include <base/vmath.h>
+#include <game/mapitems.h>
 #include "pathfinding.h"
 
 enum BlockType
@@ -45,8 +47,34 @@ class CCollision
 
 	CWaypoint *m_apWaypoint[MAX_WAYPOINTS];
 	CWaypoint *m_pCenterWaypoint;
+
+	bool IsWaypointTile(int x, int y);
+	void RemoveWaypoint(int Index);
+	void ScanWaypointConnections(CWaypoint *pWaypoint);
+	void ConnectVisibleWaypoints(CWaypoint *pWaypoint);
+	void RepairWaypoints(int TileX, int TileY);
+
+	// tiles changed since the graph was built, newest at m_GraphVersion-1
+	enum
+	{
+		MAX_GRAPH_CHANGES=16,
+	};
+	ivec2 m_aGraphChanges[MAX_GRAPH_CHANGES];
+	int m_GraphVersion;
 	
 	CWaypointPath *m_pPath;
+
+	// MapGen: game layer areas changed since the waypoint graph was last refreshed
+	enum
+	{
+		MAX_DIRTY_RECTS=64,
+	};
+	struct CDirtyRect
+	{
+		int m_X0, m_Y0, m_X1, m_Y1; // m_X1/m_Y1 exclusive
+	};
+	CDirtyRect m_aDirtyRects[MAX_DIRTY_RECTS];
+	int m_NumDirtyRects;
 	
 public:
 	enum
@@ -63,13 +91,24 @@ public:
 	};
 
 	void CreateBlock(vec2 Pos, int Type);
+	void DestroyBlock(vec2 Pos);
 
 	bool IsTileSolid(int x, int y, bool IncludeDeath = false);
 	
 	void GenerateWaypoints();
 	bool GenerateSomeMoreWaypoints();
+
+	// finished graphs are cached per map sha256 in the save directory,
+	// so static maps only pay for the generation once
+	bool LoadWaypoints(class IStorage *pStorage, SHA256_DIGEST MapSha256);
+	bool SaveWaypoints(class IStorage *pStorage, SHA256_DIGEST MapSha256);
 	int WaypointCount() { return m_WaypointCount; }
 	int ConnectionCount() { return m_ConnectionCount; }
+
+	// bumped whenever blocks repair the graph, paths built on an older
+	// version are stale if PathAffected says one of their legs crosses a change
+	int GraphVersion() const { return m_GraphVersion; }
+	bool PathAffected(const CWaypointPath *pPath, int SinceVersion);
 	
 	void SetWaypointCenter(vec2 Position);
 	void AddWeight(vec2 Pos, int Weight);
@@ -95,12 +134,41 @@ public:
 	int FastIntersectLine(vec2 Pos0, vec2 Pos1);
 	int IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, bool IncludeDeath = false);
 	void MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces);
+	// CheckPoint for many points, one result per point in pHits
+	void CheckPoints(const float *pX, const float *pY, int Num, bool *pHits);
 	void MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity);
 	bool TestBox(vec2 Pos, vec2 Size);
 
 	// MapGen
 	bool ModifTile(ivec2 pos, int group, int layer, int tile, int flags, int reserved);
 
+	// MapGen: batch writes, the layer is looked up once and written through the span
+	struct CTileSpan
+	{
+		CTile *m_pTiles;
+		int m_Width;
+		int m_Height;
+		bool m_GameLayer; // writes are translated to collision flags
+	};
+	bool GetTileSpan(int Group, int Layer, CTileSpan *pSpan);
+	static int TileToColFlag(int Tile);
+	// no bounds check and no dirty tracking, use MarkDirty for the written area
+	void WriteTile(const CTileSpan *pSpan, int Index, int Tile, int Flags = 0, int Reserved = 0)
+	{
+		CTile *pTile = &pSpan->m_pTiles[Index];
+		pTile->m_Index = pSpan->m_GameLayer ? TileToColFlag(Tile) : Tile;
+		pTile->m_Flags = Flags;
+		pTile->m_Reserved = Reserved;
+	}
+	void FillTiles(const CTileSpan *pSpan, int x, int y, int w, int h, int Tile, int Flags = 0);
+
+	void MarkDirty(int x, int y, int w, int h);
+	int NumDirtyRects() const { return m_NumDirtyRects; }
+	void ClearDirtyRects() { m_NumDirtyRects = 0; }
+	// bring the waypoint graph up to date with the dirty rects and clear them,
+	// small areas are repaired tile by tile, large ones rebuild the graph
+	void RefreshDirtyWaypoints();
+
 	vec2 RoundPos(vec2 Pos)
 	{
 		Pos.x -= (int)Pos.x % 32 - 16;
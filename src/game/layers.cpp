@@ -13,11 +13,30 @@ CLayers::CLayers()
 	m_pGameGroup = 0;
 	m_pGameLayer = 0;
 	m_pMap = 0;
+
+	m_GameGroupIndex = 0;
+	m_GameLayerIndex = 0;
+	m_BackgrounLayerIndex = 0;
+	m_DoodadsLayerIndex = 0;
+	m_ForegroundLayerIndex = 0;
+	m_Base1LayerIndex = 0;
+	m_Base2LayerIndex = 0;
+	m_pBackgrounLayer = 0;
+	m_pDoodadsLayer = 0;
+	m_pForegroundLayer = 0;
+	m_pBase1Layer = 0;
+	m_pBase2Layer = 0;
+	m_pTiles = 0;
 }
 
 void CLayers::Init(class IKernel *pKernel)
 {
-	m_pMap = pKernel->RequestInterface<IMap>();
+	Init(pKernel->RequestInterface<IMap>());
+}
+
+void CLayers::Init(class IMap *pMap)
+{
+	m_pMap = pMap;
 	m_pMap->GetType(MAPITEMTYPE_GROUP, &m_GroupsStart, &m_GroupsNum);
 	m_pMap->GetType(MAPITEMTYPE_LAYER, &m_LayersStart, &m_LayersNum);
 
@@ -100,3 +119,15 @@ CMapItemLayer *CLayers::GetLayer(int Index) const
 {
 	return static_cast<CMapItemLayer *>(m_pMap->GetItem(m_LayersStart+Index, 0, 0));
 }
+
+CMapItemLayerTilemap *CLayers::GetTileLayer(int Group, int Layer) const
+{
+	CMapItemGroup *pGroup = GetGroup(Group);
+	if(!pGroup || Layer < 0 || Layer >= pGroup->m_NumLayers)
+		return 0;
+
+	CMapItemLayer *pLayer = GetLayer(pGroup->m_StartLayer+Layer);
+	if(!pLayer || pLayer->m_Type != LAYERTYPE_TILES)
+		return 0;
+	return reinterpret_cast<CMapItemLayerTilemap *>(pLayer);
+}
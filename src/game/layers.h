@@ -36,12 +36,15 @@ class CLayers
 public:
 	CLayers();
 	void Init(class IKernel *pKernel);
+	void Init(class IMap *pMap); // MapGen: layers of a map that isn't the loaded one
 	int NumGroups() const { return m_GroupsNum; };
+	int NumLayers() const { return m_LayersNum; };
 	class IMap *Map() const { return m_pMap; };
 	CMapItemGroup *GameGroup() const { return m_pGameGroup; };
 	CMapItemLayerTilemap *GameLayer() const { return m_pGameLayer; };
 	CMapItemGroup *GetGroup(int Index) const;
 	CMapItemLayer *GetLayer(int Index) const;
+	CMapItemLayerTilemap *GetTileLayer(int Group, int Layer) const; // MapGen: 0 if it isn't a tile layer
 
 	// MapGen: Direct layer access
 	int GetGameGroupIndex() const { return m_GameGroupIndex; }
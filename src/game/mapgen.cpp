@@ -5,23 +5,32 @@
 #include <base/system.h>
 #include <base/math.h>
 #include <base/vmath.h>
-#include <engine/shared/config.h>
 #include <engine/shared/linereader.h>
 
 #include "mapgen.h"
-#include <game/server/mapgen/gen_layer.h>
-#include <game/server/mapgen/room.h>
-#include <game/server/mapgen/maze.h>
-#include <game/server/gamecontext.h>
+#include <game/mapgen/gen_layer.h>
+#include <game/mapgen/gen_random.h>
+#include <game/mapgen/room.h>
+#include <game/mapgen/maze.h>
 #include <game/layers.h>
 #include <game/mapitems.h>
 
+#include <engine/console.h>
+#include <engine/map.h>
+#include <engine/shared/datafile.h>
+
 CMapGen::CMapGen()
 {
 	m_pLayers = 0x0;
 	m_pCollision = 0x0;
 	m_pStorage = 0x0;
 	m_FileLoaded = false;
+	m_Seed = 0;
+	m_Level = 1;
+	m_aGameType[0] = 0;
+	m_SurvivalMode = false;
+	m_AutoMapPass = 0;
+	m_NumThreads = 1;
 }
 CMapGen::~CMapGen()
 {
@@ -33,6 +42,8 @@ void CMapGen::Init(CLayers *pLayers, CCollision *pCollision, IStorage *pStorage)
 	m_pLayers = pLayers;
 	m_pCollision = pCollision;
 	m_pStorage = pStorage;
+	for(int i = 0; i < MAX_LAYER_SPANS; i++)
+		m_aLayerSpanState[i] = SPAN_UNKNOWN;
 	
 	Load("metal_main");
 }
@@ -149,9 +160,51 @@ void CMapGen::Load(const char* pTileName)
 
 	io_close(RulesFile);
 
+	CompileRules();
 	m_FileLoaded = true;
 }
 
+void CMapGen::CompileRules()
+{
+	for(int c = 0; c < m_lConfigs.size(); c++)
+	{
+		CConfiguration *pConf = &m_lConfigs[c];
+		pConf->m_BaseTile = 1;
+		pConf->m_HasIndexRules = false;
+
+		for(int i = pConf->m_aIndexRules.size()-1; i >= 0; i--)
+		{
+			CIndexRule *pIndexRule = &pConf->m_aIndexRules[i];
+			pIndexRule->m_FullMask = 0;
+			pIndexRule->m_EmptyMask = 0;
+			pIndexRule->m_Compiled = true;
+
+			// the first base tile wins
+			if(pIndexRule->m_BaseTile)
+				pConf->m_BaseTile = pIndexRule->m_ID;
+
+			for(int j = 0; j < pIndexRule->m_aRules.size(); j++)
+			{
+				CPosRule *pRule = &pIndexRule->m_aRules[j];
+				if(pRule->m_IndexValue)
+					pConf->m_HasIndexRules = true;
+
+				if(pRule->m_IndexValue || absolute(pRule->m_X) > AUTOMAP_RANGE || absolute(pRule->m_Y) > AUTOMAP_RANGE)
+				{
+					pIndexRule->m_Compiled = false;
+					continue;
+				}
+
+				unsigned Bit = 1u<<((pRule->m_Y+AUTOMAP_RANGE)*AUTOMAP_SIZE + pRule->m_X+AUTOMAP_RANGE);
+				if(pRule->m_Value == CPosRule::FULL)
+					pIndexRule->m_FullMask |= Bit;
+				else
+					pIndexRule->m_EmptyMask |= Bit;
+			}
+		}
+	}
+}
+
 const char* CMapGen::GetConfigName(int Index)
 {
 	if(Index < 0 || Index >= m_lConfigs.size())
@@ -162,37 +215,36 @@ const char* CMapGen::GetConfigName(int Index)
 
 
 
-void CMapGen::FillMap()
+void CMapGen::FillMap(int Seed, int Level, const char *pGameType, bool SurvivalMode)
 {
-	dbg_msg("mapgen", "started map generation");
+	dbg_msg("mapgen", "started map generation. seed=%d level=%d", Seed, Level);
 
-	for (int i = 0; i < g_Config.m_SvMapGenLevel; i++)
-		rand();
+	// same seed and level always give the same map, no matter which thread generates it
+	m_Seed = Seed;
+	m_Level = Level;
+	str_copy(m_aGameType, pGameType, sizeof(m_aGameType));
+	m_SurvivalMode = SurvivalMode;
+	m_AutoMapPass = 0;
+	gen_srand((unsigned)Seed * 10007u + (unsigned)Level);
 	
 	int64 ProcessTime = 0;
 	int64 TotalTime = time_get();
 
-	int MineTeeLayerSize = m_pLayers->GameLayer()->m_Width*m_pLayers->GameLayer()->m_Height;
-
 	// clear map, but keep background, envelopes etc
 	ProcessTime = time_get();
-	for(int i = 0; i < MineTeeLayerSize; i++)
+	int aClearLayers[4] = {m_pLayers->GetGameLayerIndex(), m_pLayers->GetBackgroundLayerIndex(), m_pLayers->GetDoodadsLayerIndex(), m_pLayers->GetForegroundLayerIndex()};
+	for(int i = 0; i < 4; i++)
 	{
-		int x = i%m_pLayers->GameLayer()->m_Width;
-		ivec2 TilePos(x, (i-x)/m_pLayers->GameLayer()->m_Width);
-		
-		// clear the different layers
-		ModifTile(TilePos, m_pLayers->GetGameLayerIndex(), 0);
-		ModifTile(TilePos, m_pLayers->GetBackgroundLayerIndex(), 0);
-		ModifTile(TilePos, m_pLayers->GetDoodadsLayerIndex(), 0);
-		ModifTile(TilePos, m_pLayers->GetForegroundLayerIndex(), 0);
+		CCollision::CTileSpan *pSpan = LayerSpan(aClearLayers[i]);
+		if(pSpan)
+			m_pCollision->FillTiles(pSpan, 0, 0, m_pLayers->GameLayer()->m_Width, m_pLayers->GameLayer()->m_Height, 0);
 	}
 	dbg_msg("mapgen", "map normalized in %.5fs", (float)(time_get()-ProcessTime)/time_freq());
 
 
 	ProcessTime = time_get();
 	
-	if (str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (str_comp(m_aGameType, "coop") == 0)
 		GenerateLevel();
 	else
 		GeneratePVPLevel();
@@ -208,7 +260,7 @@ void CMapGen::GenerateEnd(CGenLayer *pTiles)
 	int h = pTiles->Height();
 	
 	// find a platform
-	if (g_Config.m_SvMapGenLevel%10 == 9)
+	if (m_Level%10 == 9)
 	{
 		for(int y = 3; y < h-3; y++)
 			for(int x = w-3; x > 3; x--)
@@ -281,14 +333,14 @@ void CMapGen::GenerateSawblade(CGenLayer *pTiles)
 {
 	ivec2 p = ivec2(0, 0);
 	
-	if (frandom() < 0.4f)
+	if (gen_frandom() < 0.4f)
 		p = pTiles->GetSharpCorner();
-	else if (frandom() < 0.4f)
+	else if (gen_frandom() < 0.4f)
 	{
 		p = pTiles->GetCeiling();
 		p.y -= 1;
 	}
-	else if (frandom() < 0.4f)
+	else if (gen_frandom() < 0.4f)
 	{
 		p = pTiles->GetWall();
 		
@@ -376,7 +428,7 @@ void CMapGen::GenerateBarrel(CGenLayer *pTiles)
 	
 	if (Dublos)
 	{
-		if (frandom() < 0.3f)
+		if (gen_frandom() < 0.3f)
 			ModifTile(p+ivec2(-1, 0), m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_POWERBARREL);
 		else
 			ModifTile(p+ivec2(-1, 0), m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_BARREL);
@@ -385,15 +437,15 @@ void CMapGen::GenerateBarrel(CGenLayer *pTiles)
 	}
 	else
 	{
-		if (frandom() < 0.3f)
+		if (gen_frandom() < 0.3f)
 			ModifTile(p, m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_POWERBARREL);
 		else
 			ModifTile(p, m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_BARREL);
 	}
 	
-	if (str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (str_comp(m_aGameType, "coop") == 0)
 	{
-		if (frandom() < 0.3f && g_Config.m_SvMapGenLevel > 5)
+		if (gen_frandom() < 0.3f && m_Level > 5)
 			ModifTile(p, m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_POWERBARREL);
 		else
 			ModifTile(p, m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_BARREL);
@@ -426,7 +478,7 @@ void CMapGen::GenerateConveyorBelt(CGenLayer *pTiles)
 	
 	int i = TILE_AILEFT;
 	
-	if (frandom() < 0.5f)
+	if (gen_frandom() < 0.5f)
 		i = TILE_AIRIGHT;
 	
 	for (int x = p.x; x <= p.z; x++)
@@ -445,7 +497,7 @@ void CMapGen::GenerateHangables(CGenLayer *pTiles)
 	for (int x = p.x; x <= p.z; x++)
 	{
 		ModifTile(ivec2(x, p.y), m_pLayers->GetGameLayerIndex(), TILE_AIUP);
-		if (frandom() < 0.11f)
+		if (gen_frandom() < 0.11f)
 			ModifTile(ivec2(x, p.y), m_pLayers->GetForegroundLayerIndex(), 91, 0);
 		else
 			ModifTile(ivec2(x, p.y), m_pLayers->GetForegroundLayerIndex(), 90, 0);
@@ -536,7 +588,7 @@ void CMapGen::GenerateSwitch(CGenLayer *pTiles)
 {
 	ivec2 p = ivec2(0, 0);
 	
-	if (g_Config.m_SvMapGenLevel%10 == 9)
+	if (m_Level%10 == 9)
 		p = pTiles->GetBotPlatform();
 	else
 		p = pTiles->GetPlatform();
@@ -551,11 +603,11 @@ void CMapGen::GenerateSwitch(CGenLayer *pTiles)
 void CMapGen::GenerateTurretStand(CGenLayer *pTiles)
 {
 	
-	if (frandom() < 0.4f)
+	if (gen_frandom() < 0.4f)
 	{
 		ivec2 p = ivec2(0, 0);
 		
-		if (frandom() < 0.6f)
+		if (gen_frandom() < 0.6f)
 			p = pTiles->GetLeftCeiling();
 		else
 			p = pTiles->GetCeiling();
@@ -580,7 +632,7 @@ void CMapGen::GenerateTurretStand(CGenLayer *pTiles)
 void CMapGen::GenerateTurret(CGenLayer *pTiles)
 {
 	
-	if (frandom() < 0.4f)
+	if (gen_frandom() < 0.4f)
 	{
 		ivec2 p = pTiles->GetRightCeiling();
 		
@@ -604,7 +656,7 @@ void CMapGen::GenerateTurret(CGenLayer *pTiles)
 void CMapGen::GenerateTeslacoil(CGenLayer *pTiles)
 {
 	
-	if (frandom() < 0.4f)
+	if (gen_frandom() < 0.4f)
 	{
 		ivec2 p = pTiles->GetRightCeiling();
 		
@@ -730,7 +782,7 @@ void CMapGen::GenerateScreen(CGenLayer *pTiles)
 	if (p.x == 0)
 		return;
 	
-	if (frandom() < 0.7f)
+	if (gen_frandom() < 0.7f)
 		ModifTile(ivec2(p.x, p.y), m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_SCREEN);
 	else
 		ModifTile(ivec2(p.x, p.y), m_pLayers->GetGameLayerIndex(), ENTITY_OFFSET+ENTITY_REACTOR);
@@ -939,9 +991,9 @@ void CMapGen::GenerateLevel()
 	
 	// generate room structure
 	CRoom *pRoom = new CRoom(3, 3, w-6, h-6);
-	CMaze *pMaze = new CMaze(w, h);
+	CMaze *pMaze = new CMaze(w, h, m_Level, m_aGameType, m_SurvivalMode);
 	
-	int Level = g_Config.m_SvMapGenLevel;
+	int Level = m_Level;
 
 	pMaze->OpenRooms(pRoom);
 
@@ -974,7 +1026,7 @@ void CMapGen::GenerateLevel()
 	pTiles->GenerateMoreBackground();
 	
 	if (n > 1)
-		pTiles->GenerateAirPlatforms(n/2 + rand()%(n/2));
+		pTiles->GenerateAirPlatforms(n/2 + gen_rand()%(n/2));
 	else
 		pTiles->GenerateAirPlatforms(n);
 
@@ -1052,7 +1104,7 @@ void CMapGen::GenerateLevel()
 	
 	// find platforms, corners etc.
 	dbg_msg("mapgen", "Scanning level");
-	pTiles->Scan();
+	pTiles->Scan(m_Level, m_aGameType);
 	
 	// start pos
 	for (int i = 0; i < 4; i++)
@@ -1069,7 +1121,7 @@ void CMapGen::GenerateLevel()
 	// conveyor belts
 	//if (Level > 10)
 	{
-		int c = rand()%(min(6, 1+Level/2));
+		int c = gen_rand()%(min(6, 1+Level/2));
 		for (int i = 0; i < c; i++)
 			GenerateConveyorBelt(pTiles);
 	}
@@ -1077,7 +1129,7 @@ void CMapGen::GenerateLevel()
 	// hangables
 	//if (Level > 5)
 	{
-		int c = 1+rand()%(min(11, 1+Level/4));
+		int c = 1+gen_rand()%(min(11, 1+Level/4));
 		for (int i = 0; i < c; i++)
 			GenerateHangables(pTiles);
 	}
@@ -1130,7 +1182,7 @@ void CMapGen::GenerateLevel()
 	// lightning walls
 	if (Level > 1)
 	{
-		int l = 1 + rand()%min(10, 1 + Level/2);
+		int l = 1 + gen_rand()%min(10, 1 + Level/2);
 		for (int i = 0; i < l; i++)
 			GenerateLightningWall(pTiles);
 	}
@@ -1174,18 +1226,18 @@ void CMapGen::GenerateLevel()
 	
 	if (Level%5 == 4 || Level%7 == 6 || Level%11 == 9)
 	{
-		for (int i = 0; i < 2 + (0.3f + frandom())*min(10.0f, Level * 0.8f); i++)
+		for (int i = 0; i < 2 + (0.3f + gen_frandom())*min(10.0f, Level * 0.8f); i++)
 			GenerateTurret(pTiles);
 		
-		if (Level > 10 && frandom() < 0.7f)
+		if (Level > 10 && gen_frandom() < 0.7f)
 			GenerateTeslacoil(pTiles);
 	}
 	else
 	{
-		if (frandom() < 0.5f && Level > 2)
+		if (gen_frandom() < 0.5f && Level > 2)
 			GenerateTurret(pTiles);
 		
-		if (frandom() < 0.5f && Level > 4)
+		if (gen_frandom() < 0.5f && Level > 4)
 			GenerateTurret(pTiles);
 	}
 	
@@ -1230,7 +1282,7 @@ void CMapGen::GenerateLevel()
 		GenerateStarDroid(pTiles);
 	
 	// barrels
-	int b = max(4, 15 - Level/3)+rand()%3;
+	int b = max(4, 15 - Level/3)+gen_rand()%3;
 	
 	for (int i = 0; i < (pTiles->NumPlatforms() + pTiles->NumMedPlatforms()) / b; i++)
 		GenerateBarrel(pTiles);
@@ -1324,7 +1376,7 @@ void CMapGen::GeneratePVPLevel()
 	
 	// generate room structure
 	CRoom *pRoom = new CRoom(3, 3, w-6, h-6);
-	CMaze *pMaze = new CMaze(w, h);
+	CMaze *pMaze = new CMaze(w, h, m_Level, m_aGameType, m_SurvivalMode);
 	
 	pMaze->OpenRooms(pRoom);
 
@@ -1349,9 +1401,9 @@ void CMapGen::GeneratePVPLevel()
 	
 	bool BR = false;
 	
-	if (str_comp(g_Config.m_SvGametype, "dm") == 0)
+	if (str_comp(m_aGameType, "dm") == 0)
 	{
-		if (g_Config.m_SvSurvivalMode)
+		if (m_SurvivalMode)
 			BR = true; // battle royale
 	}
 	else
@@ -1367,7 +1419,7 @@ void CMapGen::GeneratePVPLevel()
 	pTiles->GenerateMoreBackground();
 	
 	if (n > 1)
-		pTiles->GenerateAirPlatforms(n/2 + rand()%(n/2));
+		pTiles->GenerateAirPlatforms(n/2 + gen_rand()%(n/2));
 	else
 		pTiles->GenerateAirPlatforms(n);
 
@@ -1384,10 +1436,10 @@ void CMapGen::GeneratePVPLevel()
 	
 	// find platforms, corners etc.
 	dbg_msg("mapgen", "Scanning level");
-	pTiles->Scan();
+	pTiles->Scan(m_Level, m_aGameType);
 	
 	// flags to ctf
-	if (str_comp(g_Config.m_SvGametype, "ctf") == 0)
+	if (str_comp(m_aGameType, "ctf") == 0)
 	{
 		// left & rightmost tiles as spawns
 		
@@ -1444,7 +1496,7 @@ void CMapGen::GeneratePVPLevel()
 	}
 	
 	// dm spawn pos
-	if (str_comp(g_Config.m_SvGametype, "dm") == 0)
+	if (str_comp(m_aGameType, "dm") == 0)
 	{
 		for (int i = 0; i < 16; i++)
 		{
@@ -1497,13 +1549,13 @@ void CMapGen::GeneratePVPLevel()
 
 	// conveyor belts
 	{
-		int c = 2 + rand()%8;
+		int c = 2 + gen_rand()%8;
 		for (int i = 0; i < c; i++)
 			GenerateConveyorBelt(pTiles);
 	}
 	
 	// hangables
-	int c = 2+rand()%4;
+	int c = 2+gen_rand()%4;
 	for (int i = 0; i < c; i++)
 		GenerateHangables(pTiles);
 		
@@ -1519,7 +1571,7 @@ void CMapGen::GeneratePVPLevel()
 		GeneratePowerupper(pTiles);
 	
 	// barrels
-	int b = 5 + rand()%3;
+	int b = 5 + gen_rand()%3;
 	
 	for (int i = 0; i < (pTiles->NumPlatforms() + pTiles->NumMedPlatforms()) / b; i++)
 		GenerateBarrel(pTiles);
@@ -1546,7 +1598,7 @@ void CMapGen::GeneratePVPLevel()
 	
 	while (Obs-- > 0)
 	{
-		switch (rand()%6)
+		switch (gen_rand()%6)
 		{
 		case 0:
 		case 1:
@@ -1598,18 +1650,7 @@ void CMapGen::WriteBase(class CGenLayer *pTiles, int BaseNum, ivec2 Pos, float S
 	else if (BaseNum == 1)
 		LayerIndex = m_pLayers->GetBase2LayerIndex();
 	
-	
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
-		{
-			int i = pBaseTiles->Get(x, y);
-			
-			if (i > 0)
-			{
-				int f = pBaseTiles->GetFlags(x, y);
-				ModifTile(ivec2(x, y), LayerIndex, i, f);
-			}
-		}
+	BlitLayer(pBaseTiles, CGenLayer::FOREGROUND, LayerIndex);
 		
 	delete pBaseTiles;
 }
@@ -1617,102 +1658,261 @@ void CMapGen::WriteBase(class CGenLayer *pTiles, int BaseNum, ivec2 Pos, float S
 
 void CMapGen::WriteLayers(CGenLayer *pTiles)
 {
-	int w = m_pLayers->GameLayer()->m_Width;
-	int h = m_pLayers->GameLayer()->m_Height;
+	CCollision::CTileSpan *pGame = LayerSpan(m_pLayers->GetGameLayerIndex());
+	CCollision::CTileSpan *pForeground = LayerSpan(m_pLayers->GetForegroundLayerIndex());
+	if (!pGame || !pForeground)
+		return;
+
+	int w = min(pTiles->Width(), min(pGame->m_Width, pForeground->m_Width));
+	int h = min(pTiles->Height(), min(pGame->m_Height, pForeground->m_Height));
 	
 	// write to layers; foreground
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++)
 		{
 			int i = pTiles->Get(x, y);
 			
 			if (i > 0)
 			{
 				int f = pTiles->GetFlags(x, y);
-				ModifTile(ivec2(x, y), m_pLayers->GetForegroundLayerIndex(), i, f);
+				m_pCollision->WriteTile(pForeground, y*pForeground->m_Width+x, i, f);
 				
 				// slopes
+				int Game = 1;
 				if (i == 20 && f == TILEFLAG_VFLIP)
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), TILE_RAMP_RIGHT);
+					Game = TILE_RAMP_RIGHT;
 				else if (i == 20 && f == 0)
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), TILE_RAMP_LEFT);
+					Game = TILE_RAMP_LEFT;
 				else if (i == 20 && f == TILEFLAG_HFLIP+TILEFLAG_VFLIP)
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), TILE_ROOFSLOPE_RIGHT);
+					Game = TILE_ROOFSLOPE_RIGHT;
 				else if (i == 20 && f == TILEFLAG_HFLIP)
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), TILE_ROOFSLOPE_LEFT);
-				else
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), 1);
+					Game = TILE_ROOFSLOPE_LEFT;
+				m_pCollision->WriteTile(pGame, y*pGame->m_Width+x, Game);
 			}
 		}
 		
 	// write to layers; FGOBJECTS to foreground
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++)
 		{
 			int i = pTiles->Get(x, y, CGenLayer::FGOBJECTS);
 			
 			if (i > 0)
 			{
 				int f = pTiles->GetFlags(x, y, CGenLayer::FGOBJECTS);
-				ModifTile(ivec2(x, y), m_pLayers->GetForegroundLayerIndex(), i, f);
+				m_pCollision->WriteTile(pForeground, y*pForeground->m_Width+x, i, f);
 				
 				if (i >= 14*16+1 && i <= 14*16+3)
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), TILE_AIR);
+					m_pCollision->WriteTile(pGame, y*pGame->m_Width+x, TILE_AIR);
 				else
-					ModifTile(ivec2(x, y), m_pLayers->GetGameLayerIndex(), 1);
+					m_pCollision->WriteTile(pGame, y*pGame->m_Width+x, 1);
 			}
 		}
+	m_pCollision->MarkDirty(0, 0, w, h);
 		
 	/*
 	// background
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
-		{
-			int i = pTiles->Get(x, y, CGenLayer::BACKGROUND);
-			
-			if (i > 0)
-				ModifTile(ivec2(x, y), m_pLayers->GetBackgroundLayerIndex(), i, pTiles->GetFlags(x, y, CGenLayer::BACKGROUND));
-		}
+	BlitLayer(pTiles, CGenLayer::BACKGROUND, m_pLayers->GetBackgroundLayerIndex());
 	*/
 	
 	// doodads
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
-		{
-			int i = pTiles->Get(x, y, CGenLayer::DOODADS);
-			
-			if (i > 0)
-				ModifTile(ivec2(x, y), m_pLayers->GetDoodadsLayerIndex(), i, pTiles->GetFlags(x, y, CGenLayer::DOODADS));
-		}
+	BlitLayer(pTiles, CGenLayer::DOODADS, m_pLayers->GetDoodadsLayerIndex());
 }
 
 void CMapGen::WriteBackground(CGenLayer *pTiles)
 {
-	int w = m_pLayers->GameLayer()->m_Width;
-	int h = m_pLayers->GameLayer()->m_Height;
-	
 	// background
-	for(int x = 0; x < w; x++)
-		for(int y = 0; y < h; y++)
+	BlitLayer(pTiles, CGenLayer::BACKGROUND, m_pLayers->GetBackgroundLayerIndex());
+}
+
+void CMapGen::BlitLayer(CGenLayer *pTiles, int GenLayer, int Layer)
+{
+	CCollision::CTileSpan *pSpan = LayerSpan(Layer);
+	if (!pSpan)
+		return;
+
+	int w = min(pTiles->Width(), pSpan->m_Width);
+	int h = min(pTiles->Height(), pSpan->m_Height);
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++)
 		{
-			int i = pTiles->Get(x, y, CGenLayer::BACKGROUND);
+			int i = pTiles->Get(x, y, GenLayer);
 			
 			if (i > 0)
-				ModifTile(ivec2(x, y), m_pLayers->GetBackgroundLayerIndex(), i, pTiles->GetFlags(x, y, CGenLayer::BACKGROUND));
+				m_pCollision->WriteTile(pSpan, y*pSpan->m_Width+x, i, pTiles->GetFlags(x, y, GenLayer));
 		}
+
+	if (pSpan->m_GameLayer)
+		m_pCollision->MarkDirty(0, 0, w, h);
+}
+
+CCollision::CTileSpan *CMapGen::LayerSpan(int Layer)
+{
+	if (Layer < 0 || Layer >= MAX_LAYER_SPANS)
+		return 0x0;
+
+	// layers of the game group don't move while generating, look each one up once
+	if (m_aLayerSpanState[Layer] == SPAN_UNKNOWN)
+		m_aLayerSpanState[Layer] = m_pCollision->GetTileSpan(m_pLayers->GetGameGroupIndex(), Layer, &m_aLayerSpans[Layer]) ? SPAN_VALID : SPAN_INVALID;
+
+	return m_aLayerSpanState[Layer] == SPAN_VALID ? &m_aLayerSpans[Layer] : 0x0;
+}
+
+void CMapGen::ModifTile(ivec2 Pos, int Layer, int Tile, int Flags)
+{
+	CCollision::CTileSpan *pSpan = LayerSpan(Layer);
+	if (!pSpan)
+		return;
+
+	int Index = Pos.y*pSpan->m_Width+Pos.x;
+	if (Index < 0 || Index >= pSpan->m_Width*pSpan->m_Height)
+		return;
+
+	m_pCollision->WriteTile(pSpan, Index, Tile, Flags);
+	if (pSpan->m_GameLayer)
+		m_pCollision->MarkDirty(Index%pSpan->m_Width, Index/pSpan->m_Width, 1, 1);
 }
 
 
 
-inline void CMapGen::ModifTile(ivec2 Pos, int Layer, int Tile, int Flags)
+
+// the auto-mapper works on a snapshot of each layer: one bit per tile telling whether it's
+// used, laid out like the tile array so a row of neighbours is a run of consecutive bits
+struct CAutoMapStripe
+{
+	CMapGen *m_pMapGen;
+	CGenLayer *m_pTiles;
+	CMapGen::CConfiguration *m_pConf;
+	const unsigned long long *m_pUsed;
+	const int *m_pIndices;
+	int m_Padding; // bits in front of the first tile so reads before it stay in the buffer
+	int m_Layer;
+	int m_StartY;
+	int m_EndY;
+};
+
+static inline bool AutoMapUsed(const unsigned long long *pUsed, int Bit)
+{
+	return (pUsed[Bit>>6]>>(Bit&63))&1;
+}
+
+static inline unsigned AutoMapRowBits(const unsigned long long *pUsed, int Bit, int Num)
 {
-	m_pCollision->ModifTile(Pos, m_pLayers->GetGameGroupIndex(), Layer, Tile, Flags, 0);
+	int Word = Bit>>6;
+	int Offset = Bit&63;
+	unsigned long long Value = pUsed[Word]>>Offset;
+	if(Offset+Num > 64)
+		Value |= pUsed[Word+1]<<(64-Offset);
+	return (unsigned)(Value&((1ull<<Num)-1));
 }
 
+// replaces rand() so every tile gets the same roll no matter which thread handles it
+static inline unsigned AutoMapHash(unsigned Seed, int Pass, int Layer, int Index, int Rule)
+{
+	unsigned h = Seed*0x9e3779b1u ^ (unsigned)Pass*0x85ebca6bu ^ (unsigned)Layer*0xc2b2ae35u;
+	h ^= (unsigned)Index*0x27d4eb2fu;
+	h = (h^(h>>15))*0x2c1b3c6du;
+	h ^= (unsigned)Rule*0x165667b1u;
+	h = (h^(h>>12))*0x297a2d39u;
+	return h^(h>>15);
+}
+
+void CMapGen::ProceedRows(CAutoMapStripe *pStripe)
+{
+	CGenLayer *pTiles = pStripe->m_pTiles;
+	CConfiguration *pConf = pStripe->m_pConf;
+	const unsigned long long *pUsed = pStripe->m_pUsed;
+	int Padding = pStripe->m_Padding;
+	int l = pStripe->m_Layer;
+	int Width = pTiles->Width();
+	int Height = pTiles->Height();
+	int MaxIndex = Width*Height;
+
+	for (int y = pStripe->m_StartY; y < pStripe->m_EndY; y++)
+		for (int x = 0; x < Width; x++)
+		{
+			int Index = y*Width+x;
+			if (!AutoMapUsed(pUsed, Padding+Index))
+				continue;
+
+			if (y == 0 || y == Height-1 || x == 0 || x == Width-1)
+			{
+				pTiles->Set(pConf->m_BaseTile, x, y, 0, l);
+				continue;
+			}
+
+			// gather the neighbourhood, bits outside the map are marked invalid
+			unsigned Near = 0;
+			unsigned Valid = AUTOMAP_ALL;
+			int First = Index-AUTOMAP_RANGE*Width-AUTOMAP_RANGE;
+			int Last = Index+AUTOMAP_RANGE*Width+AUTOMAP_RANGE;
+			for (int dy = 0; dy < AUTOMAP_SIZE; dy++)
+				Near |= AutoMapRowBits(pUsed, Padding+First+dy*Width, AUTOMAP_SIZE)<<(dy*AUTOMAP_SIZE);
+			if (First < 0 || Last >= MaxIndex)
+			{
+				for (int dy = 0; dy < AUTOMAP_SIZE; dy++)
+					for (int dx = 0; dx < AUTOMAP_SIZE; dx++)
+					{
+						int CheckIndex = First+dy*Width+dx;
+						if (CheckIndex < 0 || CheckIndex >= MaxIndex)
+							Valid &= ~(1u<<(dy*AUTOMAP_SIZE+dx));
+					}
+				Near &= Valid;
+			}
+
+			int Tile = pConf->m_BaseTile;
+			int Flags = 0;
+			for (int i = 0; i < pConf->m_aIndexRules.size(); ++i)
+			{
+				CIndexRule *pIndexRule = &pConf->m_aIndexRules[i];
+				if (pIndexRule->m_BaseTile)
+					continue;
+
+				bool RespectRules;
+				if (pIndexRule->m_Compiled)
+				{
+					unsigned Mask = pIndexRule->m_FullMask|pIndexRule->m_EmptyMask;
+					RespectRules = (Mask&~Valid) == 0 && (Near&pIndexRule->m_FullMask) == pIndexRule->m_FullMask && (Near&pIndexRule->m_EmptyMask) == 0;
+				}
+				else
+				{
+					RespectRules = true;
+					for (int j = 0; j < pIndexRule->m_aRules.size() && RespectRules; ++j)
+					{
+						CPosRule *pRule = &pIndexRule->m_aRules[j];
+						int CheckIndex = (y+pRule->m_Y)*Width+(x+pRule->m_X);
+
+						if (CheckIndex < 0 || CheckIndex >= MaxIndex)
+							RespectRules = false;
+						else if (pRule->m_IndexValue)
+							RespectRules = pStripe->m_pIndices[CheckIndex] == pRule->m_Value;
+						else if (pRule->m_Value == CPosRule::EMPTY)
+							RespectRules = !AutoMapUsed(pUsed, Padding+CheckIndex);
+						else
+							RespectRules = AutoMapUsed(pUsed, Padding+CheckIndex);
+					}
+				}
 
+				if (RespectRules &&
+					(pIndexRule->m_YDivisor < 2 || y%pIndexRule->m_YDivisor == pIndexRule->m_YRemainder) &&
+					(pIndexRule->m_RandomValue <= 1 || AutoMapHash(m_Seed, m_AutoMapPass, l, Index, i)%pIndexRule->m_RandomValue == 1))
+				{
+					Tile = pIndexRule->m_ID;
+					Flags = pIndexRule->m_Flag;
+				}
+			}
 
+			pTiles->Set(Tile, x, y, Flags, l);
+		}
+}
+
+void CMapGen::AutoMapThread(void *pUser)
+{
+	CAutoMapStripe *pStripe = (CAutoMapStripe *)pUser;
+	pStripe->m_pMapGen->ProceedRows(pStripe);
+}
 
-void CMapGen::Proceed(CGenLayer *pTiles, int ConfigID)
+void CMapGen::Proceed(CGenLayer *pTiles, int ConfigID, int NumThreads)
 {
 	if(!m_FileLoaded || ConfigID < 0 || ConfigID >= m_lConfigs.size())
 		return;
@@ -1722,72 +1922,281 @@ void CMapGen::Proceed(CGenLayer *pTiles, int ConfigID)
 	if(!pConf->m_aIndexRules.size())
 		return;
 
-	int BaseTile = 1;
+	if(NumThreads < 1)
+		NumThreads = m_NumThreads;
+
+	int Width = pTiles->Width();
+	int Height = pTiles->Height();
+	int MaxIndex = Width*Height;
+	int Padding = AUTOMAP_RANGE*Width+AUTOMAP_RANGE;
+	int NumWords = (MaxIndex+Padding*2)/64+2;
+	unsigned long long *pUsed = (unsigned long long *)mem_alloc(NumWords*sizeof(unsigned long long), 1);
+	int *pIndices = pConf->m_HasIndexRules ? (int *)mem_alloc(MaxIndex*sizeof(int), 1) : 0x0;
+
+	// each pass rolls different dice
+	m_AutoMapPass++;
 
-	// find base tile if there is one
-	for(int i = 0; i < pConf->m_aIndexRules.size(); ++i)
+	NumThreads = clamp(NumThreads, 1, min(max(1, Height/AUTOMAP_MIN_ROWS), (int)MAX_AUTOMAP_THREADS));
+
+	// auto map !
+	for (int l = 0; l < 3; l++)
 	{
-		if(pConf->m_aIndexRules[i].m_BaseTile)
+		mem_zero(pUsed, NumWords*sizeof(unsigned long long));
+		for (int i = 0; i < MaxIndex; i++)
 		{
-			BaseTile = pConf->m_aIndexRules[i].m_ID;
-			break;
+			int Value = pTiles->GetByIndex(i, l);
+			if (Value > 0)
+				pUsed[(Padding+i)>>6] |= 1ull<<((Padding+i)&63);
+			if (pIndices)
+				pIndices[i] = Value;
+		}
+
+		// stripes only read the snapshot and write their own rows, so the result doesn't depend on the split
+		CAutoMapStripe aStripes[MAX_AUTOMAP_THREADS];
+		void *apThreads[MAX_AUTOMAP_THREADS] = {0};
+
+		for (int t = 0; t < NumThreads; t++)
+		{
+			CAutoMapStripe *pStripe = &aStripes[t];
+			pStripe->m_pMapGen = this;
+			pStripe->m_pTiles = pTiles;
+			pStripe->m_pConf = pConf;
+			pStripe->m_pUsed = pUsed;
+			pStripe->m_pIndices = pIndices;
+			pStripe->m_Padding = Padding;
+			pStripe->m_Layer = l;
+			pStripe->m_StartY = Height*t/NumThreads;
+			pStripe->m_EndY = Height*(t+1)/NumThreads;
+
+			if (t > 0)
+				apThreads[t] = thread_init(AutoMapThread, pStripe);
+		}
+
+		ProceedRows(&aStripes[0]);
+		for (int t = 1; t < NumThreads; t++)
+		{
+			if (apThreads[t])
+				thread_wait(apThreads[t]);
+			else
+				ProceedRows(&aStripes[t]);
 		}
 	}
-	
-	int Width = m_pLayers->GameLayer()->m_Width;
-	int Height = m_pLayers->GameLayer()->m_Height;
-	
-	// auto map !
-	int MaxIndex = Width*Height;
-	for (int l = 0; l < 3; l++)
-		for (int y = 0; y < Height; y++)
-			for (int x = 0; x < Width; x++)
-			{
-				if (pTiles->Get(x, y, l) == 0)
-					continue;
-				
-				pTiles->Set(BaseTile, x, y, 0, l);
 
-				if (y == 0 || y == Height-1 || x == 0 || x == Width-1)
-					continue;
+	mem_free(pIndices);
+	mem_free(pUsed);
+}
+
+
+
+static CGenLayer *CreateBenchmarkLayer(int Size, int Seed)
+{
+	CGenLayer *pTiles = new CGenLayer(Size, Size);
+	gen_srand(Seed);
+
+	// cave-like noise, smoothed a bit so the rules see walls, floors and corners
+	int aLayers[3] = {CGenLayer::FOREGROUND, CGenLayer::BACKGROUND, CGenLayer::DOODADS};
+	for (int l = 0; l < 3; l++)
+	{
+		for (int y = 0; y < Size; y++)
+			for (int x = 0; x < Size; x++)
+				pTiles->Set(gen_frandom() < 0.45f ? 1 : 0, x, y, 0, aLayers[l]);
 
-				for (int i = 0; i < pConf->m_aIndexRules.size(); ++i)
+		for (int Pass = 0; Pass < 2; Pass++)
+			for (int y = 1; y < Size-1; y++)
+				for (int x = 1; x < Size-1; x++)
 				{
-					if (pConf->m_aIndexRules[i].m_BaseTile)
-						continue;
+					int Num = 0;
+					for (int dy = -1; dy <= 1; dy++)
+						for (int dx = -1; dx <= 1; dx++)
+							Num += pTiles->Get(x+dx, y+dy, aLayers[l]) > 0;
+					pTiles->Set(Num >= 5 ? 1 : 0, x, y, 0, aLayers[l]);
+				}
+	}
+	return pTiles;
+}
 
-					bool RespectRules = true;
-					for (int j = 0; j < pConf->m_aIndexRules[i].m_aRules.size() && RespectRules; ++j)
-					{
-						CPosRule *pRule = &pConf->m_aIndexRules[i].m_aRules[j];
-						int CheckIndex = (y+pRule->m_Y)*Width+(x+pRule->m_X);
+bool CMapGen::BenchmarkAutoMap(int Size, int Runs, IConsole *pConsole)
+{
+	char aBuf[256];
+	if (!m_FileLoaded || !m_lConfigs.size())
+	{
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapgen", "no auto-mapper rules loaded");
+		return false;
+	}
 
-						if (CheckIndex < 0 || CheckIndex >= MaxIndex)
-							RespectRules = false;
-						else
-						{
-							if (pRule->m_IndexValue)
-							{
-								if (pTiles->GetByIndex(CheckIndex, l) != pRule->m_Value)
-									RespectRules = false;
-							}
-							else
-							{
-								if(pTiles->GetByIndex(CheckIndex, l) > 0 && pRule->m_Value == CPosRule::EMPTY)
-									RespectRules = false;
-
-								if(pTiles->GetByIndex(CheckIndex, l) == 0 && pRule->m_Value == CPosRule::FULL)
-									RespectRules = false;
-							}
-						}
-					}
+	int NumThreads = m_NumThreads;
+	int64 aTime[2] = {0, 0};
+	bool Identical = true;
+	int Pass = m_AutoMapPass;
+
+	for (int r = 0; r < Runs; r++)
+	{
+		CGenLayer *apTiles[2];
+		for (int i = 0; i < 2; i++)
+		{
+			apTiles[i] = CreateBenchmarkLayer(Size, r);
+
+			// same pass for both so the rolls match
+			m_AutoMapPass = Pass+r;
+			int64 Start = time_get();
+			Proceed(apTiles[i], 0, i == 0 ? 1 : NumThreads);
+			aTime[i] += time_get()-Start;
+		}
 
-					if (RespectRules &&
-						(pConf->m_aIndexRules[i].m_YDivisor < 2 || y%pConf->m_aIndexRules[i].m_YDivisor == pConf->m_aIndexRules[i].m_YRemainder) &&
-						(pConf->m_aIndexRules[i].m_RandomValue <= 1 || (int)((float)rand() / ((float)RAND_MAX + 1) * pConf->m_aIndexRules[i].m_RandomValue) == 1))
+		for (int l = 0; l < 3 && Identical; l++)
+			for (int y = 0; y < Size && Identical; y++)
+				for (int x = 0; x < Size; x++)
+				{
+					if (apTiles[0]->Get(x, y, l) != apTiles[1]->Get(x, y, l) || apTiles[0]->GetFlags(x, y, l) != apTiles[1]->GetFlags(x, y, l))
 					{
-						pTiles->Set(pConf->m_aIndexRules[i].m_ID, x, y, pConf->m_aIndexRules[i].m_Flag, l);
+						str_format(aBuf, sizeof(aBuf), "mismatch at %d,%d layer %d in run %d", x, y, l, r);
+						pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapgen", aBuf);
+						Identical = false;
+						break;
 					}
 				}
-			}
+
+		delete apTiles[0];
+		delete apTiles[1];
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		str_format(aBuf, sizeof(aBuf), "auto-mapper %dx%d, %d threads: %.3fms per level", Size, Size, i == 0 ? 1 : NumThreads,
+			(double)aTime[i]*1000.0/time_freq()/max(Runs, 1));
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapgen", aBuf);
+	}
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapgen", Identical ? "results identical" : "results differ");
+
+	// leave the generator as it was
+	m_AutoMapPass = Pass;
+	return Identical;
+}
+
+
+
+CMapGenJob::CMapGenJob(IStorage *pStorage, const char *pTemplate, int Seed, int Level, const char *pGameType, bool SurvivalMode, int NumThreads) :
+	m_State(PENDING)
+{
+	m_pStorage = pStorage;
+	str_copy(m_aTemplate, pTemplate, sizeof(m_aTemplate));
+	str_format(m_aTemplateFile, sizeof(m_aTemplateFile), "maps/%s.map", pTemplate);
+	m_TemplateCrc = 0;
+	m_WantedTemplateCrc = 0;
+	m_CheckTemplateCrc = false;
+	m_Seed = Seed;
+	m_Level = Level;
+	str_copy(m_aGameType, pGameType, sizeof(m_aGameType));
+	m_SurvivalMode = SurvivalMode;
+	m_NumThreads = NumThreads;
+	m_pData = 0x0;
+	m_DataSize = 0;
+	semaphore_init(&m_DoneSem);
+}
+
+CMapGenJob::~CMapGenJob()
+{
+	free(m_pData);
+	semaphore_destroy(&m_DoneSem);
+}
+
+void CMapGenJob::SetTemplateFile(const char *pFilename, unsigned WantedCrc)
+{
+	str_copy(m_aTemplateFile, pFilename, sizeof(m_aTemplateFile));
+	m_WantedTemplateCrc = WantedCrc;
+	m_CheckTemplateCrc = true;
+}
+
+bool CMapGenJob::Matches(const char *pTemplate, int Seed, int Level, const char *pGameType, bool SurvivalMode) const
+{
+	return str_comp(m_aTemplate, pTemplate) == 0 && m_Seed == Seed && m_Level == Level &&
+		str_comp(m_aGameType, pGameType) == 0 && m_SurvivalMode == SurvivalMode;
+}
+
+unsigned char *CMapGenJob::ReleaseData(int *pSize)
+{
+	unsigned char *pData = m_pData;
+	*pSize = m_DataSize;
+	m_pData = 0x0;
+	m_DataSize = 0;
+	return pData;
+}
+
+bool CMapGenJob::Claim()
+{
+	int Expected = PENDING;
+	return m_State.compare_exchange_strong(Expected, CLAIMED);
+}
+
+void CMapGenJob::Run()
+{
+	if(!Claim())
+		return;
+	Generate();
+	m_State.store(DONE);
+	semaphore_signal(&m_DoneSem);
+}
+
+void CMapGenJob::Wait()
+{
+	if(Claim())
+	{
+		Generate();
+		m_State.store(DONE);
+		return;
+	}
+	if(m_State.load() != DONE)
+		semaphore_wait(&m_DoneSem);
+}
+
+void CMapGenJob::Generate()
+{
+	int64 StartTime = time_get();
+
+	// read the template, it stays untouched on disk
+	IOHANDLE File = m_pStorage->OpenFile(m_aTemplateFile, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+	{
+		dbg_msg("mapgen", "could not open template '%s'", m_aTemplateFile);
+		return;
+	}
+	unsigned FileSize = (unsigned)io_length(File);
+	unsigned char *pFileData = (unsigned char *)mem_alloc(FileSize, 1);
+	unsigned ReadSize = io_read(File, pFileData, FileSize);
+	io_close(File);
+
+	// everything below is private to this job, the running game isn't touched
+	IEngineMap *pMap = CreateEngineMap();
+	bool Loaded = ReadSize == FileSize && pMap->LoadMemory(m_aTemplateFile, pFileData, FileSize);
+	if(Loaded && m_CheckTemplateCrc && pMap->Crc() != m_WantedTemplateCrc)
+	{
+		// a different version of the template can't give the same level
+		dbg_msg("mapgen", "template '%s' differs, %08x != %08x", m_aTemplateFile, pMap->Crc(), m_WantedTemplateCrc);
+		Loaded = false;
+	}
+	if(Loaded)
+	{
+		m_TemplateCrc = pMap->Crc();
+
+		CLayers *pLayers = new CLayers();
+		CCollision *pCollision = new CCollision();
+		CMapGen *pMapGen = new CMapGen();
+
+		pLayers->Init(pMap);
+		pCollision->Init(pLayers);
+		pMapGen->Init(pLayers, pCollision, m_pStorage);
+		pMapGen->SetNumThreads(m_NumThreads);
+		pMapGen->FillMap(m_Seed, m_Level, m_aGameType, m_SurvivalMode);
+
+		CDataFileWriter Writer;
+		Writer.SaveMapToMemory(pMap->GetFileReader(), &m_pData, &m_DataSize);
+
+		delete pMapGen;
+		delete pCollision;
+		delete pLayers;
+	}
+	mem_free(pFileData);
+	delete pMap;
+
+	dbg_msg("mapgen", "level %d ready in %.5fs, size=%d", m_Level, (float)(time_get()-StartTime)/time_freq(), m_DataSize);
 }
@@ -0,0 +1,222 @@
+// Ninslash
+#ifndef GAME_MAPGEN_H
+#define GAME_MAPGEN_H
+
+#include <engine/storage.h>
+#include <engine/shared/jobs.h>
+#include <game/layers.h>
+#include <game/collision.h>
+
+#include <base/tl/array.h>
+
+#include <atomic>
+
+// bump this whenever the same seed and template produce a different level,
+// clients only generate levels themselves when their version matches
+enum
+{
+	MAPGEN_VERSION=1,
+};
+
+class CMapGen
+{
+	friend struct CAutoMapStripe;
+
+	IStorage *m_pStorage;
+	IStorage *Storage() const { return m_pStorage; }
+	
+	class CLayers *m_pLayers;
+	CCollision *m_pCollision;
+	int m_Seed;
+	int m_Level;
+	char m_aGameType[32];
+	bool m_SurvivalMode;
+	int m_AutoMapPass;
+	int m_NumThreads;
+
+	void GenerateLevel();
+	void GeneratePVPLevel();
+	
+	void WriteLayers(class CGenLayer *pTiles);
+	void WriteBackground(class CGenLayer *pTiles);
+	void BlitLayer(class CGenLayer *pTiles, int GenLayer, int Layer);
+	void WriteBase(class CGenLayer *pTiles, int BaseNum, ivec2 Pos, float Size);
+	
+	void Mirror(class CGenLayer *pTiles);
+	
+	void GenerateEnd(class CGenLayer *pTiles);
+	
+	void GenerateShop(class CGenLayer *pTiles);
+	void GenerateScreen(class CGenLayer *pTiles);
+	void GeneratePowerupper(class CGenLayer *pTiles);
+	void GenerateSwitch(class CGenLayer *pTiles);
+	void GenerateTurretStand(class CGenLayer *pTiles);
+	void GenerateTurret(class CGenLayer *pTiles);
+	void GenerateTeslacoil(class CGenLayer *pTiles);
+	void GenerateBarrel(class CGenLayer *pTiles);
+	void GenerateLightningWall(class CGenLayer *pTiles);
+	void GenerateMine(class CGenLayer *pTiles);
+	void GenerateWalker(class CGenLayer *pTiles);
+	void GenerateStarDroid(class CGenLayer *pTiles);
+	void GenerateCrawlerDroid(class CGenLayer *pTiles);
+	void GenerateBossCrawlerDroid(class CGenLayer *pTiles);
+	void GenerateEnemySpawn(class CGenLayer *pTiles);
+	void GenerateHearts(class CGenLayer *pTiles);
+	void GenerateAmmo(class CGenLayer *pTiles);
+	void GenerateArmor(class CGenLayer *pTiles);
+	void GenerateAcid(class CGenLayer *pTiles);
+	
+	void GenerateConveyorBelt(class CGenLayer *pTiles);
+	void GenerateHangables(class CGenLayer *pTiles);
+	
+	void GenerateSawblade(class CGenLayer *pTiles);
+	void GenerateFiretrap(class CGenLayer *pTiles);
+	void GenerateDeathray(class CGenLayer *pTiles);
+	
+	void GenerateWeapon(class CGenLayer *pTiles, int Weapon);
+
+	void ModifTile(ivec2 Pos, int Layer, int Tile, int Flags = 0);
+
+	// tile spans of the game group, resolved on first use
+	enum
+	{
+		MAX_LAYER_SPANS=32,
+		SPAN_UNKNOWN=0,
+		SPAN_VALID,
+		SPAN_INVALID,
+	};
+	CCollision::CTileSpan m_aLayerSpans[MAX_LAYER_SPANS];
+	int m_aLayerSpanState[MAX_LAYER_SPANS];
+	CCollision::CTileSpan *LayerSpan(int Layer);
+
+	// auto mapper
+	struct CPosRule
+	{
+		int m_X;
+		int m_Y;
+		int m_Value;
+		bool m_IndexValue;
+
+		enum
+		{
+			EMPTY=0,
+			FULL
+		};
+	};
+
+	struct CIndexRule
+	{
+		int m_ID;
+		array<CPosRule> m_aRules;
+		int m_Flag;
+		int m_RandomValue;
+		int m_YDivisor;
+		int m_YRemainder;
+		bool m_BaseTile;
+
+		// filled by CompileRules: neighbours within 2 tiles become bits (dy+2)*5+(dx+2),
+		// anything else (INDEX values, farther offsets) goes through the rule list
+		unsigned m_FullMask;
+		unsigned m_EmptyMask;
+		bool m_Compiled;
+	};
+
+	struct CConfiguration
+	{
+		array<CIndexRule> m_aIndexRules;
+		char m_aName[128];
+		int m_BaseTile;
+		bool m_HasIndexRules;
+	};
+
+	enum
+	{
+		AUTOMAP_RANGE=2,
+		AUTOMAP_SIZE=AUTOMAP_RANGE*2+1,
+		AUTOMAP_ALL=(1<<(AUTOMAP_SIZE*AUTOMAP_SIZE))-1,
+		AUTOMAP_MIN_ROWS=32,
+		MAX_AUTOMAP_THREADS=16,
+	};
+	
+	array<CConfiguration> m_lConfigs;
+	bool m_FileLoaded;
+	
+	void Load(const char* pTileName);
+	void CompileRules();
+	void Proceed(class CGenLayer *pTiles, int ConfigID, int NumThreads = -1);
+	void ProceedRows(struct CAutoMapStripe *pStripe);
+	static void AutoMapThread(void *pUser);
+
+	int ConfigNamesNum() { return m_lConfigs.size(); }
+	const char* GetConfigName(int Index);
+
+	
+	const bool IsLoaded() { return m_FileLoaded; }
+	
+public:
+	CMapGen();
+	~CMapGen();
+
+	void FillMap(int Seed, int Level, const char *pGameType, bool SurvivalMode);
+	void Init(CLayers *pLayers, CCollision *pCollision, IStorage *pStorage);
+	void SetNumThreads(int NumThreads) { m_NumThreads = NumThreads; } // used by the auto-mapper
+
+	// runs the auto-mapper on a random Size x Size level, serial and threaded, and checks both agree
+	bool BenchmarkAutoMap(int Size, int Runs, class IConsole *pConsole);
+};
+
+// generates a level from a template map on a worker thread and keeps the result in memory
+class CMapGenJob : public IJob
+{
+	enum
+	{
+		PENDING = 0,
+		CLAIMED,
+		DONE,
+	};
+
+	IStorage *m_pStorage;
+	char m_aTemplate[128];
+	char m_aTemplateFile[256];
+	unsigned m_TemplateCrc;
+	unsigned m_WantedTemplateCrc;
+	bool m_CheckTemplateCrc;
+	int m_Seed;
+	int m_Level;
+	char m_aGameType[32];
+	bool m_SurvivalMode;
+	int m_NumThreads;
+
+	unsigned char *m_pData;
+	int m_DataSize;
+
+	std::atomic<int> m_State;
+	SEMAPHORE m_DoneSem;
+
+	bool Claim();
+	void Generate();
+	void Run() override;
+
+public:
+	// the game type, survival mode and thread count are passed in so the job doesn't read the config
+	CMapGenJob(IStorage *pStorage, const char *pTemplate, int Seed, int Level, const char *pGameType, bool SurvivalMode, int NumThreads);
+	~CMapGenJob();
+
+	// blocks until the level is done, generates it on this thread if no worker started yet
+	void Wait();
+
+	// reads the template from somewhere else than maps/<template>.map, set before the job runs.
+	// nothing is generated if the file's crc differs from WantedCrc
+	void SetTemplateFile(const char *pFilename, unsigned WantedCrc);
+
+	bool Matches(const char *pTemplate, int Seed, int Level, const char *pGameType, bool SurvivalMode) const;
+	const char *Template() const { return m_aTemplate; }
+	unsigned TemplateCrc() const { return m_TemplateCrc; } // only valid once the job is done
+	int Seed() const { return m_Seed; }
+	int Level() const { return m_Level; }
+	const char *GameType() const { return m_aGameType; }
+	bool SurvivalMode() const { return m_SurvivalMode; }
+	unsigned char *ReleaseData(int *pSize); // only valid once the job is done, free() the result
+};
+
+#endif
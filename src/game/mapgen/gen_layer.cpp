@@ -3,6 +3,7 @@
 #include <engine/shared/config.h>
 
 #include "gen_layer.h"
+#include "gen_random.h"
 
 CGenLayer::CGenLayer(int w, int h)
 {
@@ -129,12 +130,12 @@ void CGenLayer::CleanTiles()
 
 void CGenLayer::GenerateBoxes()
 {
-	int n = 3 + rand()%12;
+	int n = 3 + gen_rand()%12;
 		
 	for (int k = 0; k < 5000; k++)
 	{
-		int wx = 10 + rand()%(m_Width - 20);
-		int wy = 10 + rand()%(m_Height - 20);
+		int wx = 10 + gen_rand()%(m_Width - 20);
+		int wy = 10 + gen_rand()%(m_Height - 20);
 		
 		int i = 100;
 		
@@ -148,8 +149,8 @@ void CGenLayer::GenerateBoxes()
 		
 		while (i-- > 0 && n > 0)
 		{
-			int x = wx + rand()%20 - rand()%20;
-			int y = wy + rand()%20 - rand()%20;
+			int x = wx + gen_rand()%20 - gen_rand()%20;
+			int y = wy + gen_rand()%20 - gen_rand()%20;
 			
 			int l = 5;
 			// to the floor
@@ -161,7 +162,7 @@ void CGenLayer::GenerateBoxes()
 			int s = 2;
 			int p = 44;
 			
-			if (b < n+3 || frandom() < 0.5f)
+			if (b < n+3 || gen_frandom() < 0.5f)
 			{
 				s = 3;
 				p = 25;
@@ -202,7 +203,7 @@ void CGenLayer::GenerateBoxes()
 				
 				bool Flip = false;
 				
-				if (frandom() < 0.5f)
+				if (gen_frandom() < 0.5f)
 					Flip = !Flip;
 				
 				//for (int xx = 0; xx < ts.x; xx++)
@@ -229,18 +230,18 @@ void CGenLayer::GeneratePlatforms()
 	// Dont do it.
 	return;
 
-	int n = 3 + rand()%12;
+	int n = 3 + gen_rand()%12;
 		
 	for (int k = 0; k < Size()/16; k++)
 	{
-		int x = 10 + rand()%(m_Width - 20);
-		int y = 10 + rand()%(m_Height - 20);
+		int x = 10 + gen_rand()%(m_Width - 20);
+		int y = 10 + gen_rand()%(m_Height - 20);
 		
 		if (Used(x, y))
 			continue;
 	
 		int Dir = 1;
-		if (frandom() < 0.5f)
+		if (gen_frandom() < 0.5f)
 			Dir = -1;
 			
 			while (!Get(x-Dir, y))
@@ -288,7 +289,7 @@ void CGenLayer::GeneratePlatforms()
 				break;
 				*/
 				
-				if ((Create && l > 1) || l > 3+rand()%25)
+				if ((Create && l > 1) || l > 3+gen_rand()%25)
 				{
 					Set(14*16+1, x, y, Dir == 1 ? 0 : 1, FGOBJECTS); // TILEFLAG_VFLIP
 						
@@ -327,8 +328,8 @@ bool CGenLayer::AddBackgroundTile(int x, int y)
  
 void CGenLayer::GenerateMoreForeground()
 {
-	float a1 = 0.02f + frandom()*0.01f;
-	float a2 = 0.02f + frandom()*0.01f;
+	float a1 = 0.02f + gen_frandom()*0.01f;
+	float a2 = 0.02f + gen_frandom()*0.01f;
 	
 	for (int i = 0; i < 10; i++)
 	{
@@ -383,7 +384,7 @@ void CGenLayer::GenerateFences()
 {
 	for (int x = 4; x < m_Width-4; x++)
 	{
-		if (frandom() < 0.75f)
+		if (gen_frandom() < 0.75f)
 			continue;
 		
 		for (int y = 4; y < m_Height-4; y++)
@@ -415,7 +416,7 @@ void CGenLayer::GenerateFences()
 							if (Get(x+xx, y+yy, DOODADS) || Get(x+xx, y+yy, FGOBJECTS))
 								Valid = false;
 
-					if (frandom() < 0.75f)
+					if (gen_frandom() < 0.75f)
 						Valid = false;
 					
 					// avoid door
@@ -432,7 +433,7 @@ void CGenLayer::GenerateFences()
 						{
 							int t = 10*16+11;
 							
-							if (xx == x+(-x1+x2)/2 && frandom() < 0.25f)
+							if (xx == x+(-x1+x2)/2 && gen_frandom() < 0.25f)
 								t--;
 							
 							Set(t-16, xx, y-1, 0, DOODADS);
@@ -464,8 +465,8 @@ void CGenLayer::GenerateAirPlatforms(int Num)
 	
 	while (Num > 0 && i++ < 10000)
 	{
-		x = b+rand()%(m_Width-b*2);
-		y = b+rand()%(m_Height-b*2);
+		x = b+gen_rand()%(m_Width-b*2);
+		y = b+gen_rand()%(m_Height-b*2);
 		
 		if (!Used(x, y) && (fabs(m_EndPos.x - x) > 10 || x+10 < m_EndPos.y))
 		{
@@ -483,7 +484,7 @@ void CGenLayer::GenerateAirPlatforms(int Num)
 			if (Valid)
 			{
 				Num--;
-				int s = 3+rand()%3;
+				int s = 3+gen_rand()%3;
 				for (int xx = -s; xx < s-1; xx++)
 				{
 					Set(-1, x+xx, y-1);
@@ -576,10 +577,10 @@ void CGenLayer::GenerateSlopes()
 			bool Valid = true;
 			bool Found = false;
 			
-			if (Get(x, y) && frandom() < 0.5f)
+			if (Get(x, y) && gen_frandom() < 0.5f)
 			{
 				int s = 0;
-				int MaxSize = 70 + rand()%8;
+				int MaxSize = 70 + gen_rand()%8;
 
 				for (int i = 0; i < MaxSize-1; i++)
 				{
@@ -622,10 +623,10 @@ void CGenLayer::GenerateSlopes()
 					Found = true;
 			}
 			
-			if (!Found && Get(x, y) && frandom() < 0.75f)
+			if (!Found && Get(x, y) && gen_frandom() < 0.75f)
 			{
 				int s = 0;
-				int MaxSize = 7 + rand()%8;
+				int MaxSize = 7 + gen_rand()%8;
 
 				for (int i = 0; i < MaxSize-1; i++)
 				{
@@ -675,10 +676,10 @@ void CGenLayer::GenerateSlopes()
 		{
 			bool Found = false;
 			bool Valid = true;
-			if (Get(x, y) && frandom() < 0.75f)
+			if (Get(x, y) && gen_frandom() < 0.75f)
 			{
 				int s = 0;
-				int MaxSize = 7 + rand()%8;
+				int MaxSize = 7 + gen_rand()%8;
 
 				for (int i = 0; i < MaxSize-1; i++)
 				{
@@ -721,10 +722,10 @@ void CGenLayer::GenerateSlopes()
 					Found = true;
 			}
 			
-			if (!Found && Get(x, y) && frandom() < 0.75f)
+			if (!Found && Get(x, y) && gen_frandom() < 0.75f)
 			{
 				int s = 0;
-				int MaxSize = 7 + rand()%8;
+				int MaxSize = 7 + gen_rand()%8;
 
 				for (int i = 0; i < MaxSize-1; i++)
 				{
@@ -778,7 +779,7 @@ void CGenLayer::GenerateSlopes()
 }
 
 
-void CGenLayer::Scan()
+void CGenLayer::Scan(int Level, const char *pGameType)
 {
 	// find long ceilings (hangables)
 	for (int x = 2; x < m_Width-2; x++)
@@ -878,9 +879,9 @@ void CGenLayer::Scan()
 		}
 	
 	// find player spawn spots
-	if (str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (str_comp(pGameType, "coop") == 0)
 	{
-		if (g_Config.m_SvMapGenLevel%10 == 9)
+		if (Level%10 == 9)
 		{
 			for (int y = m_Height-2; y > 2; y--)
 				for (int x = 2; x < m_Width-2; x++)
@@ -1159,10 +1160,10 @@ ivec3 CGenLayer::GetLongPlatform()
 		return ivec3(0, 0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumLongPlatforms;
+	int i = gen_rand()%m_NumLongPlatforms;
 	
 	while (m_aLongPlatform[i].x == 0 && n++ < 9999)
-		i = rand()%m_NumLongPlatforms;
+		i = gen_rand()%m_NumLongPlatforms;
 	
 	if (n >= 9999)
 		return ivec3(0, 0, 0);
@@ -1186,10 +1187,10 @@ ivec2 CGenLayer::GetMedPlatform()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumMedPlatforms;
+	int i = gen_rand()%m_NumMedPlatforms;
 	
 	while (m_aMedPlatform[i].x == 0 && n++ < 999)
-		i = rand()%m_NumMedPlatforms;
+		i = gen_rand()%m_NumMedPlatforms;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1207,10 +1208,10 @@ ivec2 CGenLayer::GetPlatform()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumPlatforms;
+	int i = gen_rand()%m_NumPlatforms;
 	
 	while (m_aPlatform[i].x == 0 && n++ < 999)
-		i = rand()%m_NumPlatforms;
+		i = gen_rand()%m_NumPlatforms;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1308,10 +1309,10 @@ ivec2 CGenLayer::GetOpenArea()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumOpenAreas;
+	int i = gen_rand()%m_NumOpenAreas;
 	
 	while (m_aOpenArea[i].x == 0 && n++ < 999)
-		i = rand()%m_NumOpenAreas;
+		i = gen_rand()%m_NumOpenAreas;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1328,10 +1329,10 @@ ivec3 CGenLayer::GetLongCeiling()
 		return ivec3(0, 0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumLongCeilings;
+	int i = gen_rand()%m_NumLongCeilings;
 	
 	while (m_aLongCeiling[i].x == 0 && n++ < 999)
-		i = rand()%m_NumLongCeilings;
+		i = gen_rand()%m_NumLongCeilings;
 	
 	if (n >= 9999)
 		return ivec3(0, 0, 0);
@@ -1356,10 +1357,10 @@ ivec2 CGenLayer::GetCeiling()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumCeilings;
+	int i = gen_rand()%m_NumCeilings;
 	
 	while (m_aCeiling[i].x == 0 && n++ < 999)
-		i = rand()%m_NumCeilings;
+		i = gen_rand()%m_NumCeilings;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1416,10 +1417,10 @@ ivec2 CGenLayer::GetWall()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumWalls;
+	int i = gen_rand()%m_NumWalls;
 	
 	while (m_aWall[i].x == 0 && n++ < 999)
-		i = rand()%m_NumWalls;
+		i = gen_rand()%m_NumWalls;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1436,11 +1437,11 @@ ivec4 CGenLayer::GetPit()
 		return ivec4(0, 0, 0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumPits;
+	int i = gen_rand()%m_NumPits;
 	
 	// try random
 	while (m_aPit[i].x == 0 && n++ < 99)
-		i = rand()%m_NumPits;
+		i = gen_rand()%m_NumPits;
 	
 	if (m_aPit[i].x == 0)
 	{
@@ -1468,10 +1469,10 @@ ivec2 CGenLayer::GetTopCorner()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumTopCorners;
+	int i = gen_rand()%m_NumTopCorners;
 	
 	while (m_aTopCorner[i].x == 0 && n++ < 999)
-		i = rand()%m_NumTopCorners;
+		i = gen_rand()%m_NumTopCorners;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
@@ -1489,10 +1490,10 @@ ivec2 CGenLayer::GetSharpCorner()
 		return ivec2(0, 0);
 	
 	int n = 0;
-	int i = rand()%m_NumCorners;
+	int i = gen_rand()%m_NumCorners;
 	
 	while (m_aTopCorner[i].x == 0 && n++ < 999)
-		i = rand()%m_NumCorners;
+		i = gen_rand()%m_NumCorners;
 	
 	if (n >= 9999)
 		return ivec2(0, 0);
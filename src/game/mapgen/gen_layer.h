@@ -1,5 +1,5 @@
-#ifndef GAME_SERVER_MAPGEN_GEN_LAYER_H
-#define GAME_SERVER_MAPGEN_GEN_LAYER_H
+#ifndef GAME_MAPGEN_GEN_LAYER_H
+#define GAME_MAPGEN_GEN_LAYER_H
 
 #include <base/vmath.h>
 
@@ -97,7 +97,7 @@ public:
 	bool AddBackgroundTile(int x, int y);
 	bool AddForegroundTile(int x, int y);
 	void GenerateAirPlatforms(int Num);
-	void Scan();
+	void Scan(int Level, const char *pGameType);
 	int Size();
 	
 	void CleanTiles();
@@ -0,0 +1,23 @@
+#include "gen_random.h"
+
+static thread_local unsigned long long gs_GenRandomState = 0x853c49e6748fea9bULL;
+
+void gen_srand(unsigned Seed)
+{
+	// spread the seed so nearby seeds give unrelated sequences
+	unsigned long long z = Seed + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	gs_GenRandomState = z ^ (z >> 31);
+}
+
+int gen_rand()
+{
+	// pcg32
+	unsigned long long OldState = gs_GenRandomState;
+	gs_GenRandomState = OldState * 6364136223846793005ULL + 1442695040888963407ULL;
+	unsigned XorShifted = (unsigned)(((OldState >> 18u) ^ OldState) >> 27u);
+	unsigned Rot = (unsigned)(OldState >> 59u);
+	unsigned Result = (XorShifted >> Rot) | (XorShifted << ((-Rot) & 31));
+	return (int)(Result & GEN_RAND_MAX);
+}
@@ -0,0 +1,16 @@
+#ifndef GAME_MAPGEN_GEN_RANDOM_H
+#define GAME_MAPGEN_GEN_RANDOM_H
+
+enum
+{
+	GEN_RAND_MAX = 0x7fffffff
+};
+
+// random numbers for the map generator, kept per thread so a level generated
+// in the background doesn't share state with the game and the same seed
+// always gives the same map
+void gen_srand(unsigned Seed);
+int gen_rand();
+inline float gen_frandom() { return gen_rand()/(float)GEN_RAND_MAX; }
+
+#endif
@@ -4,12 +4,16 @@
 
 #include <engine/shared/config.h>
 
+#include "gen_random.h"
 #include "room.h"
 #include "maze.h"
 
 
-CMaze::CMaze(int w, int h)
+CMaze::CMaze(int w, int h, int Level, const char *pGameType, bool SurvivalMode)
 {
+	m_Level = Level;
+	m_pGameType = pGameType;
+	m_SurvivalMode = SurvivalMode;
 	m_W = w;
 	m_H = h;
 	
@@ -40,18 +44,18 @@ void CMaze::Generate()
 	m_Rooms = 0;
 
 	// invasion
-	if (str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (str_comp(m_pGameType, "coop") == 0)
 	{
-		int Level = g_Config.m_SvMapGenLevel;
+		int Level = m_Level;
 		
 		int r = min(10+Level/2, 120);
 
-		m_aRoom[m_Rooms++] = vec2(m_W*0.4f, m_H*(0.05f+frandom()*0.8f));
+		m_aRoom[m_Rooms++] = vec2(m_W*0.4f, m_H*(0.05f+gen_frandom()*0.8f));
 		m_aRoom[m_Rooms++] = vec2(m_W*0.6f, m_aRoom[0].y);
 		
 		Connect(m_aRoom[0], m_aRoom[1]);
 		
-		r = min(Level + 4, 30+rand()%9);
+		r = min(Level + 4, 30+gen_rand()%9);
 			
 		for (int i = 0; i < r; i++)
 			GenerateRoom(true);
@@ -65,7 +69,7 @@ void CMaze::Generate()
 			int r = 4+min(14, Level/3);
 
 
-			float s = 0.15f+frandom()*0.15f;
+			float s = 0.15f+gen_frandom()*0.15f;
 			float sy = 0.4f;
 			
 			Connect(vec2(m_W*(0.3f-s), m_H*(0.5f+s*sy)), vec2(m_W*(0.5f+s), m_H*(0.5f+s*sy)));
@@ -83,7 +87,7 @@ void CMaze::Generate()
 			if (Level > 10)
 				Connect(vec2(m_W*(0.5f-s), m_H*(0.5f+s*sy*3)), vec2(m_W*(0.5f+s), m_H*(0.5f+s*sy*3)));
 			
-			float x = 0.5f + (frandom()-frandom())*0.2f;
+			float x = 0.5f + (gen_frandom()-gen_frandom())*0.2f;
 			
 			if (Level > 20)
 			{
@@ -91,8 +95,8 @@ void CMaze::Generate()
 				Connect(vec2(m_W*(x+0.1f), m_H*(0.5f-s*sy*3)), vec2(m_W*(x+0.15f+s), m_H*(0.5f-s*sy*3)));
 			}
 			
-			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s*(frandom()-frandom())), m_H*(0.5f+s*sy*2));
-			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s*(frandom()-frandom())), m_H*(0.5f-s*sy*2));
+			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s*(gen_frandom()-gen_frandom())), m_H*(0.5f+s*sy*2));
+			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s*(gen_frandom()-gen_frandom())), m_H*(0.5f-s*sy*2));
 
 
 			// create random rooms
@@ -112,8 +116,8 @@ void CMaze::Generate()
 		{
 			int r = min(20, Level/3);
 
-			float s = 0.12f+frandom()*0.15f;
-			float sy = 0.4f+frandom()*0.15f;
+			float s = 0.12f+gen_frandom()*0.15f;
+			float sy = 0.4f+gen_frandom()*0.15f;
 			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s), m_H*(0.5f+s*sy));
 			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f+s), m_H*(0.5f+s*sy));
 			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f+s), m_H*(0.5f));
@@ -135,8 +139,8 @@ void CMaze::Generate()
 		{
 			int r = min(14, Level/3);
 
-			float s = 0.12f+frandom()*0.15f;
-			float sy = 0.4f+frandom()*0.15f;
+			float s = 0.12f+gen_frandom()*0.15f;
+			float sy = 0.4f+gen_frandom()*0.15f;
 			
 			Connect(vec2(m_W*(0.3f-s), m_H*(0.5f+s*sy)), vec2(m_W*(0.5f+s), m_H*(0.5f+s*sy)));
 			Connect(vec2(m_W*(0.5f+s), m_H*(0.5f+s*sy)), vec2(m_W*(0.5f+s), m_H*(0.5f))); // W
@@ -157,8 +161,8 @@ void CMaze::Generate()
 		{
 			int r = min(20, Level/3);
 
-			float s = 0.12f+frandom()*0.15f;
-			float sy = 0.4f+frandom()*0.15f;
+			float s = 0.12f+gen_frandom()*0.15f;
+			float sy = 0.4f+gen_frandom()*0.15f;
 			//m_aRoom[m_Rooms++] = vec2(m_W*(0.5f), m_H*(0.5f));
 			//m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s), m_H*(0.5f));
 			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s), m_H*(0.5f+s*sy));
@@ -182,8 +186,8 @@ void CMaze::Generate()
 		{
 			int r = min(20, Level/3);
 
-			float s = 0.11f+frandom()*0.15f;
-			float sy = 0.4f+frandom()*0.15f;
+			float s = 0.11f+gen_frandom()*0.15f;
+			float sy = 0.4f+gen_frandom()*0.15f;
 			
 			
 			m_aRoom[m_Rooms++] = vec2(m_W*(0.5f-s), m_H*(0.5f-s*sy));
@@ -271,10 +275,10 @@ void CMaze::Generate()
 		*/
 		
 		
-		if (str_comp(g_Config.m_SvGametype, "dm") == 0)
+		if (str_comp(m_pGameType, "dm") == 0)
 		{
 			// battle royale
-			if (g_Config.m_SvSurvivalMode)
+			if (m_SurvivalMode)
 			{
 				m_aRoom[m_Rooms++] = vec2(m_W*0.4f, m_H*0.6f);
 				m_aRoom[m_Rooms++] = vec2(m_W*0.6f, m_H*0.6f);
@@ -294,7 +298,7 @@ void CMaze::Generate()
 				Connect(m_aRoom[0], m_aRoom[1]);
 				*/
 				
-				m_aRoom[m_Rooms++] = vec2(m_W*(0.3f+frandom()*0.4f), m_H*(0.3f+frandom()*0.4f));
+				m_aRoom[m_Rooms++] = vec2(m_W*(0.3f+gen_frandom()*0.4f), m_H*(0.3f+gen_frandom()*0.4f));
 				
 				for (int i = 0; i < (m_W*m_H)/2000; i++)
 					GenerateRoom(true);
@@ -314,7 +318,7 @@ void CMaze::Generate()
 			
 			Connect(vec2(m_W*0.4f, m_H*0.5f), vec2(m_W*0.4f, m_H*0.2f));
 			
-			if (frandom() < 0.5f)
+			if (gen_frandom() < 0.5f)
 				Connect(vec2(m_W*0.5f, m_H*0.5f), vec2(m_W*0.5f, m_H*0.8f));
 		}
 		
@@ -341,13 +345,13 @@ void CMaze::Generate()
 
 void CMaze::GenerateLinear(int Width, int Rooms)
 {
-	float y = 0.3f + frandom()*0.4f;
+	float y = 0.3f + gen_frandom()*0.4f;
 	Connect(vec2(m_W*0.5f-Width, m_H*y), vec2(m_W*0.5f+Width, m_H*y));
 	
 	if (Rooms > 0)
 	{
-		m_aRoom[m_Rooms++] = vec2(m_W*0.5f-Width*frandom(), m_H*y);
-		m_aRoom[m_Rooms++] = vec2(m_W*0.5f+Width*frandom(), m_H*y);
+		m_aRoom[m_Rooms++] = vec2(m_W*0.5f-Width*gen_frandom(), m_H*y);
+		m_aRoom[m_Rooms++] = vec2(m_W*0.5f+Width*gen_frandom(), m_H*y);
 		
 		for (int i = 0; i < Rooms; i++)
 			GenerateRoom();
@@ -368,10 +372,10 @@ void CMaze::GenerateRoom(bool AutoConnect, bool MirrorMode)
 	while (!Valid && i++ < 2000)
 	{
 		Valid = true;
-		vec2 p = vec2(2 + frandom()*(m_W-4), 2 + frandom()*(m_H-4));
+		vec2 p = vec2(2 + gen_frandom()*(m_W-4), 2 + gen_frandom()*(m_H-4));
 		
 		if (MirrorMode)
-			p = vec2(2 + frandom()*(m_W*0.5f), 2 + frandom()*(m_H-4));
+			p = vec2(2 + gen_frandom()*(m_W*0.5f), 2 + gen_frandom()*(m_H-4));
 		
 		if (m_Rooms > 0)
 		{
@@ -398,7 +402,7 @@ void CMaze::GenerateRoom(bool AutoConnect, bool MirrorMode)
 				Connect(p, GetClosestRoom(p));
 			
 			m_aRoom[m_Rooms] = p;
-			Open(m_aRoom[m_Rooms], 1 + rand()%4);
+			Open(m_aRoom[m_Rooms], 1 + gen_rand()%4);
 			
 			//	Connect(p, m_aRoom[rand()%m_Rooms]);
 			
@@ -414,8 +418,8 @@ void CMaze::ConnectRandomRooms()
 	if (m_Rooms < 2)
 		return;
 	
-	int r0 = rand()%(m_Rooms-1);
-	int r1 = rand()%(m_Rooms-1);
+	int r0 = gen_rand()%(m_Rooms-1);
+	int r1 = gen_rand()%(m_Rooms-1);
 	
 	if (r0 != r1)
 		Connect(m_aRoom[r0], m_aRoom[r1]);
@@ -485,7 +489,7 @@ ivec2 CMaze::GetUnconnected()
 	// check random spots
 	while (Looping && i++ < 1000)
 	{
-		ivec2 p = ivec2(1+rand()%(m_W-2), 1+rand()%(m_H-2));
+		ivec2 p = ivec2(1+gen_rand()%(m_W-2), 1+gen_rand()%(m_H-2));
 		if (m_aOpen[p.x + p.y*m_W] && !m_aConnected[p.x + p.y*m_W])
 			return p;
 	}
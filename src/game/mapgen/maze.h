@@ -1,10 +1,13 @@
-#ifndef GAME_SERVER_MAPGEN_MAZE_H
-#define GAME_SERVER_MAPGEN_MAZE_H
+#ifndef GAME_MAPGEN_MAZE_H
+#define GAME_MAPGEN_MAZE_H
 
 class CMaze
 {
 private:
 	int m_W, m_H;
+	int m_Level;
+	const char *m_pGameType;
+	bool m_SurvivalMode;
 	
 	vec2 m_aRoom[999];
 	int m_Rooms;
@@ -30,7 +33,7 @@ private:
 	void Connect(vec2 Pos0, vec2 Pos1);
 	
 public:
-	CMaze(int w, int h);
+	CMaze(int w, int h, int Level, const char *pGameType, bool SurvivalMode);
 	~CMaze();
 	
 	void OpenRooms(class CRoom *pRoom);
@@ -4,6 +4,7 @@
 
 #include "room.h"
 #include "gen_layer.h"
+#include "gen_random.h"
 
 // bsp map, acts as template for rooms
 CRoom::CRoom(int x, int y, int w, int h)
@@ -21,7 +22,7 @@ CRoom::CRoom(int x, int y, int w, int h)
 	int i = 0;
 	
 	//int RoomSize = 6+rand()%10;
-	int RoomSize = 6+rand()%6;
+	int RoomSize = 6+gen_rand()%6;
 	
 	if (m_H < m_W)
 	{
@@ -57,9 +58,9 @@ void CRoom::Split(bool Vertical)
 		int h2 = m_H;
 		
 		if (m_W < 32)
-			m_H = 3 + rand()%(m_H-6);
+			m_H = 3 + gen_rand()%(m_H-6);
 		else
-			m_H = m_H/(2 + rand()%2);
+			m_H = m_H/(2 + gen_rand()%2);
 		
 		if (!m_pChild1)
 			m_pChild1 = new CRoom(m_X, m_Y, m_W, m_H);
@@ -72,9 +73,9 @@ void CRoom::Split(bool Vertical)
 		int w2 = m_W;
 		
 		if (m_H < 32)
-			m_W = 3 + rand()%(m_W-6);
+			m_W = 3 + gen_rand()%(m_W-6);
 		else
-			m_W = m_W/(2 + rand()%2);
+			m_W = m_W/(2 + gen_rand()%2);
 
 		if (!m_pChild1)
 			m_pChild1 = new CRoom(m_X, m_Y, m_W, m_H);
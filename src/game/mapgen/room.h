@@ -1,5 +1,5 @@
-#ifndef GAME_SERVER_MAPGEN_ROOM_H
-#define GAME_SERVER_MAPGEN_ROOM_H
+#ifndef GAME_MAPGEN_ROOM_H
+#define GAME_MAPGEN_ROOM_H
 
 class CRoom
 {
@@ -188,6 +188,13 @@ public:
 	
 	
 	
+	// put back a connection slot as it was saved, see CCollision::LoadWaypoints
+	void SetConnection(int Slot, CWaypoint *Waypoint)
+	{
+		m_apConnection[Slot] = Waypoint;
+		m_aDistance[Slot] = Waypoint ? distance(m_Pos, Waypoint->m_Pos) : 0;
+	}
+	
 	void ClearConnections()
 	{
 		for (int i = 0; i < m_ConnectionCount; i++)
@@ -201,6 +208,25 @@ public:
 		m_ConnectionCount = 0;
 	}
 	
+	// remove a two way connection and close the gap in the slots
+	bool Disconnect(CWaypoint *Target)
+	{
+		for (int i = 0; i < m_ConnectionCount; i++)
+		{
+			if (m_apConnection[i] == Target)
+			{
+				m_ConnectionCount--;
+				m_apConnection[i] = m_apConnection[m_ConnectionCount];
+				m_aDistance[i] = m_aDistance[m_ConnectionCount];
+				m_apConnection[m_ConnectionCount] = 0;
+				
+				Target->Disconnect(this);
+				return true;
+			}
+		}
+		return false;
+	}
+	
 	void Unconnect(CWaypoint *Target)
 	{
 		if (Target == 0)
@@ -17,6 +17,7 @@ CAI::CAI(CGameContext *pGameServer, CPlayer *pPlayer)
 	
 	m_pPath = 0;
 	m_pVisible = 0;
+	m_PathGraphVersion = 0;
 	
 	m_PowerLevel = 0;
 	Reset();
@@ -35,7 +36,10 @@ void CAI::Reset()
 	m_Sleep = 0;
 	m_Stun = 0;
 	m_ReactionTime = 20;
-	m_NextReaction = m_ReactionTime;
+	// bots of a wave spawn together, spread their first thoughts
+	m_NextReaction = 1 + m_pPlayer->GetCID() % m_ReactionTime;
+	m_ThinkLOD = 0;
+	m_Priority = false;
 	m_InputChanged = true;
 	m_Move = 0;
 	m_LastMove = 0;
@@ -180,9 +184,21 @@ bool CAI::UpdateWaypoint()
 	if (m_WayPointUpdateTick + GameServer()->Server()->TickSpeed()*5 < GameServer()->Server()->Tick())
 		m_WaypointUpdateNeeded = true;
 	
+	// blocks changed the graph, replan right away if they are in our way
+	CCollision *pCollision = GameServer()->Collision();
+	if (m_pVisible && m_PathGraphVersion != pCollision->GraphVersion())
+	{
+		if (pCollision->PathAffected(m_pVisible, m_PathGraphVersion))
+		{
+			m_WaypointUpdateNeeded = true;
+			m_TargetTimer = (40 << m_ThinkLOD) + 1;
+		}
+		m_PathGraphVersion = pCollision->GraphVersion();
+	}
+	
 	
 	//if (distance(m_WaypointPos, m_LastPos) < 100) // || m_TargetTimer++ > 30)// && m_WayPointUpdateWait > 10)
-	if (m_TargetTimer++ > 40 && (!m_pVisible || m_WaypointUpdateNeeded))
+	if (m_TargetTimer++ > (40 << m_ThinkLOD) && (!m_pVisible || m_WaypointUpdateNeeded) && GameServer()->AIPathBudget(m_Priority))
 	{
 		m_TargetTimer = 0;
 		
@@ -203,6 +219,7 @@ bool CAI::UpdateWaypoint()
 			}
 			m_pPath = GameServer()->Collision()->GetPath();
 			GameServer()->Collision()->ForgetAboutThePath();
+			m_PathGraphVersion = GameServer()->Collision()->GraphVersion();
 			
 			if (!m_pPath)
 				return false;
@@ -929,6 +946,10 @@ bool CAI::SeekClosestEnemyInSight()
 	CCharacter *pClosestCharacter = NULL;
 	int ClosestDistance = 0;
 	
+	// out of budget, keep what we saw last time
+	if (!GameServer()->AIScanBudget(m_Priority))
+		return m_PlayerSpotCount > 0;
+	
 	m_EnemiesInSight = 0;
 	
 	// FIRST_BOT_ID, fix
@@ -986,6 +1007,46 @@ bool CAI::SeekClosestEnemyInSight()
 
 
 
+void CAI::UpdateLOD()
+{
+	if (!g_Config.m_SvAILodDistance)
+	{
+		m_ThinkLOD = 0;
+		m_Priority = false;
+		return;
+	}
+	
+	// twice a second is plenty, staggered by client id
+	int Interval = GameServer()->Server()->TickSpeed()/2;
+	if ((GameServer()->Server()->Tick() + m_pPlayer->GetCID()) % Interval != 0)
+		return;
+	
+	float ClosestDistance = -1.0f;
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CPlayer *pPlayer = GameServer()->m_apPlayers[i];
+		if (!pPlayer || pPlayer->m_pAI)
+			continue;
+		
+		CCharacter *pCharacter = pPlayer->GetCharacter();
+		if (!pCharacter || !pCharacter->IsAlive())
+			continue;
+		
+		float Distance = distance(pCharacter->m_Pos, m_Pos);
+		if (ClosestDistance < 0.0f || Distance < ClosestDistance)
+			ClosestDistance = Distance;
+	}
+	
+	if (ClosestDistance >= 0.0f && ClosestDistance < g_Config.m_SvAILodDistance)
+		m_ThinkLOD = 0;
+	else if (ClosestDistance >= 0.0f && ClosestDistance < g_Config.m_SvAILodDistance*2)
+		m_ThinkLOD = 1;
+	else
+		m_ThinkLOD = m_EnemiesInSight ? 1 : 2; // far away or idle
+	m_Priority = m_ThinkLOD == 0;
+}
+
+
 void CAI::Tick()
 {
 	m_NextReaction--;
@@ -995,7 +1056,8 @@ void CAI::Tick()
 		m_Pos = m_pPlayer->GetCharacter()->m_Pos;
 	else
 		return;
-		
+	
+	UpdateLOD();
 	
 	// skip if sleeping or stunned
 	if (m_Sleep > 0 || m_Stun > 0)
@@ -1020,7 +1082,7 @@ void CAI::Tick()
 	// stupid AI can't even react to events every frame
 	if (m_NextReaction <= 0)
 	{
-		m_NextReaction = m_ReactionTime;
+		m_NextReaction = m_ReactionTime << m_ThinkLOD;
 
 		m_EnemyInLine = false;
 		DoBehavior();
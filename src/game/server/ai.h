@@ -23,6 +23,7 @@ class CAI
 	
 	CWaypointPath *m_pPath;
 	CWaypointPath *m_pVisible;
+	int m_PathGraphVersion;
 	
 	bool m_HookMoveLock;
 	
@@ -86,6 +87,13 @@ protected:
 	int m_Sleep;
 	int m_Stun;
 	
+	// level of detail, 0 near humans, each step halves the think rate
+	int m_ThinkLOD;
+	void UpdateLOD();
+	// near a human, may overdraw the shared budgets. never set without lod,
+	// otherwise every bot would bypass the budgets
+	bool m_Priority;
+	
 	bool m_WayFound;
 	
 	// last spotted the enemy here
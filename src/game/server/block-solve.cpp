@@ -12,6 +12,7 @@ bool CBlockSolve::Build(int Owner, vec2 Pos)
     {
         new CBlock(&GameServer()->m_World, BLOCKTYPE_SOLID, Owner, Pos);
         GameServer()->Collision()->CreateBlock(Pos, BLOCKTYPE_SOLID);
+        GameServer()->m_World.WakeRegion(Pos, 64.0f);
     }
     else
         return false;
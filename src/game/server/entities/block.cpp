@@ -34,6 +34,11 @@ void CBlock::Reset()
         m_Connect->Delete(i);
         m_Connect->DeleteID(i);
     }
+
+    // clear the solid tile too, the waypoint graph gets repaired around it
+    GameServer()->Collision()->DestroyBlock(m_Pos);
+    GameWorld()->WakeRegion(m_Pos, 64.0f);
+    GameWorld()->DestroyEntity(this);
 }
 
 bool CBlock::Check(float x, float y)
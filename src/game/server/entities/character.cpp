@@ -13,6 +13,7 @@
 #include "superexplosion.h"
 #include "landmine.h"
 #include "electromine.h"
+#include "npc.h"
 
 #include <game/server/upgradelist.h>
 #include <game/server/classabilities.h>
@@ -495,6 +496,48 @@ void CCharacter::HandleNinja()
 				if (aCustomWeapon[m_ActiveCustomWeapon].m_ProjectileType == PROJTYPE_FLYHAMMER)
 					m_Ninja.m_CurrentMoveTime = 0;
 			}
+
+			CNpc *apNpcs[CGameWorld::MAX_NPCS];
+			Num = GameServer()->m_World.FindEntities(Center, Radius, (CEntity **)apNpcs, CGameWorld::MAX_NPCS, CGameWorld::ENTTYPE_NPC);
+
+			for (int i = 0; i < Num; ++i)
+			{
+				bool bAlreadyHit = false;
+				for (int j = 0; j < m_NumObjectsHit; j++)
+				{
+					if (m_apHitObjects[j] == apNpcs[i])
+						bAlreadyHit = true;
+				}
+				if (bAlreadyHit || distance(apNpcs[i]->m_Pos, m_Pos) > (m_ProximityRadius * 2.0f))
+					continue;
+
+				if (aCustomWeapon[m_ActiveCustomWeapon].m_ProjectileType == PROJTYPE_SWORD)
+					GameServer()->CreateSound(apNpcs[i]->m_Pos, SOUND_NINJA_HIT);
+				else
+					GameServer()->CreateSound(apNpcs[i]->m_Pos, SOUND_HAMMER_HIT);
+
+				if (m_NumObjectsHit < 10)
+					m_apHitObjects[m_NumObjectsHit++] = apNpcs[i];
+
+				vec2 Force = vec2(0, -4.0f);
+				int Parent = WEAPON_NINJA;
+				if (aCustomWeapon[m_ActiveCustomWeapon].m_ProjectileType == PROJTYPE_FLYHAMMER)
+				{
+					Force = m_Ninja.m_ActivationDir * 30.0f + vec2(0, -3);
+					Parent = WEAPON_HAMMER;
+				}
+
+				int Damage = aCustomWeapon[m_ActiveCustomWeapon].m_Damage;
+				if (GetPlayer()->GotAbility(MELEE_DAMAGE1))
+					Damage += 2;
+				if (GetPlayer()->GotAbility(MELEE_DAMAGE2))
+					Damage += 2;
+
+				apNpcs[i]->TakeDamage(Force, Damage, m_pPlayer->GetCID(), Parent);
+
+				if (aCustomWeapon[m_ActiveCustomWeapon].m_ProjectileType == PROJTYPE_FLYHAMMER)
+					m_Ninja.m_CurrentMoveTime = 0;
+			}
 		}
 
 		return;
@@ -816,6 +859,33 @@ void CCharacter::FireWeapon()
 			Hits++;
 		}
 
+		CNpc *apNpcs[CGameWorld::MAX_NPCS];
+		Num = GameServer()->m_World.FindEntities(ProjStartPos, m_ProximityRadius * 0.5f, (CEntity **)apNpcs,
+												 CGameWorld::MAX_NPCS, CGameWorld::ENTTYPE_NPC);
+
+		for (int i = 0; i < Num; ++i)
+		{
+			CNpc *pTarget = apNpcs[i];
+
+			if (GameServer()->Collision()->IntersectLine(ProjStartPos, pTarget->m_Pos, NULL, NULL))
+				continue;
+
+			if (length(pTarget->m_Pos - ProjStartPos) > 0.0f)
+				GameServer()->CreateHammerHit(pTarget->m_Pos - normalize(pTarget->m_Pos - ProjStartPos) * m_ProximityRadius * 0.5f);
+			else
+				GameServer()->CreateHammerHit(ProjStartPos);
+
+			vec2 Dir;
+			if (length(pTarget->m_Pos - m_Pos) > 0.0f)
+				Dir = normalize(pTarget->m_Pos - m_Pos);
+			else
+				Dir = vec2(0.f, -1.f);
+
+			pTarget->TakeDamage(vec2(0.f, -1.f) + normalize(Dir + vec2(0.f, -1.1f)) * 10.0f * aCustomWeapon[m_ActiveCustomWeapon].m_Knockback, Damage,
+								m_pPlayer->GetCID(), aCustomWeapon[m_ActiveCustomWeapon].m_ParentWeapon);
+			Hits++;
+		}
+
 		// if we Hit anything, we have to wait for the reload
 		// if(Hits)
 		//	m_ReloadTimer = Server()->TickSpeed()/3;
@@ -1735,7 +1805,7 @@ void CCharacter::Die(int Killer, int Weapon, bool SkipKillMessage)
 			GameServer()->m_World.InsertEntity(S);
 		}
 
-		int ModeSpecial = GameServer()->m_pController->OnCharacterDeath(this, GameServer()->m_apPlayers[Killer], Weapon);
+		int ModeSpecial = GameServer()->m_pController->OnCharacterDeath(this, Killer >= 0 ? GameServer()->m_apPlayers[Killer] : 0, Weapon);
 
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "kill killer='%d:%s' victim='%d:%s' weapon=%d special=%d",
@@ -1747,7 +1817,8 @@ void CCharacter::Die(int Killer, int Weapon, bool SkipKillMessage)
 		if (Weapon != WEAPON_GAME)
 		{
 			CNetMsg_Sv_KillMsg Msg;
-			Msg.m_Killer = Killer;
+			// npcs have no client id, clients drop kill messages with an invalid killer
+			Msg.m_Killer = Killer >= 0 ? Killer : m_pPlayer->GetCID();
 			Msg.m_Victim = m_pPlayer->GetCID();
 			Msg.m_Weapon = Weapon;
 			Msg.m_ModeSpecial = ModeSpecial;
@@ -1806,10 +1877,10 @@ bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon, bool Life
 	if (GameServer()->m_pController->IsFriendlyFire(m_pPlayer->GetCID(), From) && !g_Config.m_SvTeamdamage)
 		return false;
 
-	if (GameServer()->m_apPlayers[From] && !GetPlayer()->m_pAI && !GameServer()->m_apPlayers[From]->m_pAI && str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (From >= 0 && GameServer()->m_apPlayers[From] && !GetPlayer()->m_pAI && !GameServer()->m_apPlayers[From]->m_pAI && str_comp(g_Config.m_SvGametype, "coop") == 0)
 		return false;
 
-	if (GameServer()->m_apPlayers[From] && GetPlayer()->m_pAI && GameServer()->m_apPlayers[From]->m_pAI && str_comp(g_Config.m_SvGametype, "coop") == 0)
+	if (From >= 0 && GameServer()->m_apPlayers[From] && GetPlayer()->m_pAI && GameServer()->m_apPlayers[From]->m_pAI && str_comp(g_Config.m_SvGametype, "coop") == 0)
 		return false;
 
 	// signal AI
@@ -1838,7 +1909,7 @@ bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon, bool Life
 		m_HiddenHealth -= Dmg;
 		m_LatestHitVel = Force;
 
-		if (Lifesteal && GameServer()->m_apPlayers[From] && GameServer()->m_apPlayers[From]->GetCharacter())
+		if (Lifesteal && From >= 0 && GameServer()->m_apPlayers[From] && GameServer()->m_apPlayers[From]->GetCharacter())
 			GameServer()->m_apPlayers[From]->GetCharacter()->IncreaseHealth(Dmg * 0.33f);
 	}
 
@@ -2080,6 +2151,7 @@ void CCharacter::SaveData()
 		else
 			pData->m_aWeaponType[i] = 0;
 	}
+	GameServer()->Server()->SavePlayerData(pData);
 
 	dbg_msg("PlayerData", "Data save - ID=%s", GetPlayer()->GetTimeoutID());
 }
\ No newline at end of file
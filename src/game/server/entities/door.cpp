@@ -8,8 +8,10 @@ CDoor::CDoor(CGameWorld *pGameWorld, vec2 Pos)
 	: CEntity(pGameWorld, CGameWorld::ENTTYPE_DOOR)
 {
 	m_Pos = Pos;
+	m_Active = false;
 
 	GameWorld()->InsertEntity(this);
+	SetSensor(14.0f);
 
 	for (int i = 0; i < NUM_IDS; i++)
 	{
@@ -35,13 +37,15 @@ void CDoor::Reset()
 }
 
 void CDoor::Tick()
+{
+}
+
+void CDoor::OnSensorStay(CCharacter *pChr)
 {
 	if (!m_Active)
 		return;
 
-	CCharacter *pChr = GameServer()->m_World.ClosestCharacter(m_Pos, 14.0f, 0);
-
-	if (pChr && pChr->IsAlive() && !pChr->m_IsBot)
+	if (pChr->IsAlive() && !pChr->m_IsBot)
 	{
 		GameServer()->m_pController->NextLevel(pChr->GetPlayer()->GetCID());
 	}
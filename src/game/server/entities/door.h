@@ -19,7 +19,9 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void TickPaused();
+	virtual bool CanSleep() { return true; }
 	virtual void Snap(int SnappingClient);
+	virtual void OnSensorStay(class CCharacter *pChr);
 
 	bool m_Active;
 
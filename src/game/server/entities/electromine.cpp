@@ -18,8 +18,10 @@ CElectromine::CElectromine(CGameWorld *pGameWorld, vec2 Pos, int Owner)
 	m_FlashTimer = 0;
 
 	m_ElectroTimer = 0;
+	m_LastTick = Server()->Tick();
 
 	GameWorld()->InsertEntity(this);
+	SetSensor(20.0f);
 }
 
 void CElectromine::Reset()
@@ -29,6 +31,9 @@ void CElectromine::Reset()
 
 void CElectromine::Tick()
 {
+	int Elapsed = Server()->Tick() - m_LastTick;
+	m_LastTick = Server()->Tick();
+
 	if (m_Life <= 0)
 	{
 		GameServer()->m_World.DestroyEntity(this);
@@ -37,22 +42,16 @@ void CElectromine::Tick()
 
 	if (m_ElectroTimer == 0)
 	{
-		if (m_Life-- < 100)
+		if (m_Life < 100)
 			m_Flashing = true;
+		m_Life -= Elapsed;
 
 		// a small visual effect before disappearing
 		if (m_Flashing)
 		{
-			m_FlashTimer--;
+			m_FlashTimer -= Elapsed;
 			if (m_FlashTimer <= 0)
-				m_FlashTimer = 25;
-		}
-
-		// Check if a bot intersected us
-		CCharacter *pChr = GameServer()->m_World.ClosestCharacter(m_Pos, 20.0f, 0);
-		if (pChr && pChr->IsAlive() && pChr->GetPlayer()->m_pAI)
-		{
-			m_ElectroTimer++;
+				m_FlashTimer += 25;
 		}
 	}
 	else
@@ -73,9 +72,23 @@ void CElectromine::Tick()
 	}
 }
 
+void CElectromine::OnSensorStay(CCharacter *pChr)
+{
+	// Check if a bot intersected us
+	if (m_ElectroTimer == 0 && m_Life > 0 && pChr->IsAlive() && pChr->GetPlayer()->m_pAI)
+		m_ElectroTimer++;
+}
+
+void CElectromine::OnSensorNpc(CNpc *pNpc)
+{
+	if (m_ElectroTimer == 0 && m_Life > 0)
+		m_ElectroTimer++;
+}
+
 void CElectromine::TickPaused()
 {
 	++m_Life;
+	++m_LastTick;
 }
 
 void CElectromine::Snap(int SnappingClient)
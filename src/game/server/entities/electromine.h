@@ -13,13 +13,19 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void TickPaused();
+	virtual bool CanSleep() { return m_ElectroTimer == 0; }
 	virtual void Snap(int SnappingClient);
+	virtual void OnSensorStay(class CCharacter *pChr);
+	virtual void OnSensorNpc(class CNpc *pNpc);
 
 	int m_Life;
 	int m_Owner;
 
 	int m_ElectroTimer;
 
+	// sleeping mines tick less often, timers advance by the ticks since the last update
+	int m_LastTick;
+
 	bool m_Flashing;
 	int m_FlashTimer;
 
@@ -12,8 +12,10 @@ CLandmine::CLandmine(CGameWorld *pGameWorld, vec2 Pos, int Owner)
 
 	m_Flashing = false;
 	m_FlashTimer = 0;
+	m_LastTick = Server()->Tick();
 
 	GameWorld()->InsertEntity(this);
+	SetSensor(20.0f);
 }
 
 void CLandmine::Reset()
@@ -23,7 +25,10 @@ void CLandmine::Reset()
 
 void CLandmine::Tick()
 {
-	if (--m_Life <= 0)
+	int Elapsed = Server()->Tick() - m_LastTick;
+	m_LastTick = Server()->Tick();
+
+	if ((m_Life -= Elapsed) <= 0)
 	{
 		GameServer()->m_World.DestroyEntity(this);
 		return;
@@ -35,26 +40,40 @@ void CLandmine::Tick()
 	// a small visual effect before disappearing
 	if (m_Flashing)
 	{
-		m_FlashTimer--;
+		m_FlashTimer -= Elapsed;
 		if (m_FlashTimer <= 0)
-			m_FlashTimer = 20;
+			m_FlashTimer += 20;
 	}
+}
 
+void CLandmine::OnSensorStay(CCharacter *pChr)
+{
 	// Check if a bot intersected us
-	CCharacter *pChr = GameServer()->m_World.ClosestCharacter(m_Pos, 20.0f, 0);
-	if (pChr && pChr->IsAlive() && pChr->GetPlayer()->m_pAI)
-	{
-		m_Life = 0;
-		GameServer()->CreateExplosion(m_Pos + vec2(0, -16) + vec2(-24, -24), m_Owner, WEAPON_HAMMER, false);
-		GameServer()->CreateExplosion(m_Pos + vec2(0, -16) + vec2(24, -24), m_Owner, WEAPON_HAMMER, false);
-		GameServer()->CreateExplosion(m_Pos + vec2(0, -16) + vec2(24, 24), m_Owner, WEAPON_HAMMER, false);
-		GameServer()->CreateExplosion(m_Pos + vec2(0, -16) + vec2(-24, 24), m_Owner, WEAPON_HAMMER, false);
-	}
+	if (pChr->IsAlive() && pChr->GetPlayer()->m_pAI)
+		Trigger();
+}
+
+void CLandmine::OnSensorNpc(CNpc *pNpc)
+{
+	Trigger();
+}
+
+void CLandmine::Trigger()
+{
+	if (m_Life <= 0)
+		return;
+
+	m_Life = 0;
+	GameServer()->QueueExplosion(m_Pos + vec2(0, -16) + vec2(-24, -24), m_Owner, WEAPON_HAMMER);
+	GameServer()->QueueExplosion(m_Pos + vec2(0, -16) + vec2(24, -24), m_Owner, WEAPON_HAMMER);
+	GameServer()->QueueExplosion(m_Pos + vec2(0, -16) + vec2(24, 24), m_Owner, WEAPON_HAMMER);
+	GameServer()->QueueExplosion(m_Pos + vec2(0, -16) + vec2(-24, 24), m_Owner, WEAPON_HAMMER);
 }
 
 void CLandmine::TickPaused()
 {
 	++m_Life;
+	++m_LastTick;
 }
 
 void CLandmine::Snap(int SnappingClient)
@@ -13,7 +13,10 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void TickPaused();
+	virtual bool CanSleep() { return true; }
 	virtual void Snap(int SnappingClient);
+	virtual void OnSensorStay(class CCharacter *pChr);
+	virtual void OnSensorNpc(class CNpc *pNpc);
 
 	int m_Life;
 	int m_Owner;
@@ -21,7 +24,11 @@ public:
 	bool m_Flashing;
 	int m_FlashTimer;
 
+	// sleeping mines tick less often, timers advance by the ticks since the last update
+	int m_LastTick;
+
 private:
+	void Trigger();
 };
 
 #endif
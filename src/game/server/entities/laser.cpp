@@ -4,6 +4,7 @@
 #include <game/server/gamecontext.h>
 #include "laser.h"
 #include "superexplosion.h"
+#include "npc.h"
 
 CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Damage, int ExtraInfo)
 	: CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
@@ -28,7 +29,8 @@ bool CLaser::HitCharacter(vec2 From, vec2 To)
 	vec2 At;
 	CCharacter *pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
 	CCharacter *pHit = GameServer()->m_World.IntersectCharacter(m_Pos, To, 0.f, At, pOwnerChar);
-	if (!pHit)
+	CNpc *pHitNpc = GameServer()->m_World.IntersectNpc(m_Pos, pHit ? At : To, 0.f, At);
+	if (!pHit && !pHitNpc)
 		return false;
 
 	m_From = From;
@@ -38,7 +40,10 @@ bool CLaser::HitCharacter(vec2 From, vec2 To)
 	// vec2 Dir = normalize(m_Pos-From) * 0.1f;
 
 	// pHit->TakeDamage(Dir, m_Damage, m_Owner, WEAPON_RIFLE);
-	pHit->TakeDamage(vec2(0.f, 0.f), m_Damage, m_Owner, WEAPON_RIFLE);
+	if (pHitNpc)
+		pHitNpc->TakeDamage(vec2(0.f, 0.f), m_Damage, m_Owner, WEAPON_RIFLE);
+	else
+		pHit->TakeDamage(vec2(0.f, 0.f), m_Damage, m_Owner, WEAPON_RIFLE);
 
 	return true;
 }
@@ -0,0 +1,386 @@
+#include <engine/shared/config.h>
+#include <game/generated/protocol.h>
+#include <game/server/gamecontext.h>
+#include "npc.h"
+
+static const char *s_apNpcSkins[] = {"bluekitty", "cammo", "coala", "pinky", "redbopp", "saddo", "twintri", "warpaint"};
+static const int s_NumNpcSkins = sizeof(s_apNpcSkins) / sizeof(s_apNpcSkins[0]);
+
+CNpc::CNpc(CGameWorld *pGameWorld, vec2 Pos, int Level)
+	: CEntity(pGameWorld, CGameWorld::ENTTYPE_NPC)
+{
+	m_ProximityRadius = ms_PhysSize;
+	m_Pos = Pos;
+	m_Level = Level;
+	m_Skin = rand() % s_NumNpcSkins;
+
+	m_Alive = true;
+	m_MaxHealth = 20 + min(Level * 3, 200);
+	m_Health = m_MaxHealth;
+
+	m_Vel = vec2(0, 0);
+	m_Jumped = 0;
+	m_Angle = 0;
+	m_AttackTick = 0;
+	m_ReloadTimer = 0;
+	m_DamageTakenTick = 0;
+
+	m_EmoteType = EMOTE_NORMAL;
+	m_EmoteStop = -1;
+
+	m_TargetCID = -1;
+	m_TargetPos = Pos;
+	m_Move = 0;
+	m_Jump = false;
+	m_StuckPos = Pos;
+	m_StuckTimer = 0;
+
+	m_TriggerLevel = 5 + rand() % 6;
+	m_Triggered = false;
+
+	m_NpcID = GameWorld()->AddNpc(this);
+	dbg_assert(m_NpcID != -1, "too many npcs");
+
+	// spread the thinking over the ticks
+	m_NextThink = m_NpcID % 5;
+
+	GameWorld()->InsertEntity(this);
+	GameServer()->CreatePlayerSpawn(Pos);
+}
+
+CNpc::~CNpc()
+{
+	GameWorld()->RemoveNpc(m_NpcID);
+}
+
+void CNpc::Reset()
+{
+	GameServer()->m_World.DestroyEntity(this);
+}
+
+void CNpc::Trigger(int TriggerLevel)
+{
+	if (TriggerLevel >= m_TriggerLevel)
+		m_Triggered = true;
+}
+
+bool CNpc::IsGrounded()
+{
+	if (GameServer()->Collision()->CheckPoint(m_Pos.x + ms_PhysSize / 2, m_Pos.y + ms_PhysSize / 2 + 5))
+		return true;
+	if (GameServer()->Collision()->CheckPoint(m_Pos.x - ms_PhysSize / 2, m_Pos.y + ms_PhysSize / 2 + 5))
+		return true;
+	return false;
+}
+
+void CNpc::Think()
+{
+	// closest human, in sight unless the wave has been triggered
+	CCharacter *pTarget = 0;
+	float ClosestDist = m_Triggered ? 3000.0f : 800.0f;
+
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CPlayer *pPlayer = GameServer()->m_apPlayers[i];
+		if (!pPlayer || pPlayer->m_IsBot)
+			continue;
+
+		CCharacter *pChr = pPlayer->GetCharacter();
+		if (!pChr || !pChr->IsAlive())
+			continue;
+
+		float Dist = distance(pChr->m_Pos, m_Pos);
+		if (Dist >= ClosestDist)
+			continue;
+
+		if (!m_Triggered && GameServer()->Collision()->FastIntersectLine(pChr->m_Pos, m_Pos))
+			continue;
+
+		pTarget = pChr;
+		ClosestDist = Dist;
+	}
+
+	m_Jump = false;
+
+	if (!pTarget)
+	{
+		m_TargetCID = -1;
+		if (absolute(m_Pos.x - m_TargetPos.x) < 32)
+			m_Move = 0;
+	}
+	else
+	{
+		m_TargetCID = pTarget->GetPlayer()->GetCID();
+		m_TargetPos = pTarget->m_Pos;
+
+		if (absolute(m_Pos.x - m_TargetPos.x) < 16)
+			m_Move = 0;
+		else
+			m_Move = m_Pos.x < m_TargetPos.x ? 1 : -1;
+
+		if (m_Pos.y > m_TargetPos.y + 64 && absolute(m_Pos.x - m_TargetPos.x) < 200)
+			m_Jump = true;
+	}
+
+	if (m_Move)
+	{
+		// walls and pits
+		if (GameServer()->Collision()->IsTileSolid(m_Pos.x + m_Move * 32, m_Pos.y))
+			m_Jump = true;
+		if (!GameServer()->Collision()->IsTileSolid(m_Pos.x + m_Move * 32, m_Pos.y + 32) &&
+			GameServer()->Collision()->IsTileSolid(m_Pos.x + m_Move * 128, m_Pos.y + 32))
+			m_Jump = true;
+
+		if (absolute(m_Pos.x - m_StuckPos.x) < 10)
+		{
+			if (++m_StuckTimer > 4)
+				m_Jump = true;
+			if (m_StuckTimer > 10)
+				m_Move = -m_Move;
+		}
+		else
+		{
+			m_StuckTimer = 0;
+			m_StuckPos = m_Pos;
+		}
+	}
+}
+
+void CNpc::Move()
+{
+	CTuningParams *pTuning = GameServer()->Tuning();
+	bool Grounded = IsGrounded();
+
+	m_Vel.y += pTuning->m_Gravity;
+
+	float MaxSpeed = Grounded ? pTuning->m_GroundControlSpeed : pTuning->m_AirControlSpeed;
+	float Accel = Grounded ? pTuning->m_GroundControlAccel : pTuning->m_AirControlAccel;
+	float Friction = Grounded ? pTuning->m_GroundFriction : pTuning->m_AirFriction;
+
+	if (m_Move)
+		m_Vel.x = SaturatedAdd(-MaxSpeed, MaxSpeed, m_Vel.x, Accel * m_Move);
+	else
+		m_Vel.x *= Friction;
+
+	if (Grounded)
+		m_Jumped = 0;
+
+	if (m_Jump && !(m_Jumped & 1))
+	{
+		if (Grounded)
+		{
+			m_Vel.y = -pTuning->m_GroundJumpImpulse;
+			m_Jumped |= 1;
+		}
+		else if (!(m_Jumped & 2))
+		{
+			m_Vel.y = -pTuning->m_AirJumpImpulse;
+			m_Jumped |= 3;
+		}
+	}
+	else if (!m_Jump)
+		m_Jumped &= ~1;
+
+	GameServer()->Collision()->MoveBox(&m_Pos, &m_Vel, vec2(ms_PhysSize, ms_PhysSize), 0);
+}
+
+void CNpc::Attack()
+{
+	if (m_ReloadTimer > 0)
+	{
+		m_ReloadTimer--;
+		return;
+	}
+
+	CCharacter *pTarget = GameServer()->GetPlayerChar(m_TargetCID);
+	if (!pTarget || !pTarget->IsAlive())
+		return;
+
+	if (distance(pTarget->m_Pos, m_Pos) > ms_PhysSize * 2.0f)
+		return;
+
+	vec2 Dir = normalize(pTarget->m_Pos - m_Pos);
+	m_AttackTick = Server()->Tick();
+	m_ReloadTimer = Server()->TickSpeed() / 2;
+
+	GameServer()->CreateHammerHit(pTarget->m_Pos - Dir * ms_PhysSize * 0.5f);
+	GameServer()->CreateSound(m_Pos, SOUND_HAMMER_HIT);
+	pTarget->TakeDamage(vec2(0.f, -1.f) + Dir * 5.0f, 2 + m_Level / 3, -1, WEAPON_HAMMER);
+}
+
+void CNpc::Tick()
+{
+	if (!m_Alive)
+		return;
+
+	if (--m_NextThink <= 0)
+	{
+		m_NextThink = 5;
+		Think();
+	}
+
+	Move();
+	Attack();
+
+	if (m_Move)
+		m_Angle = m_Move > 0 ? 0 : 804; // pi * 256
+	if (m_TargetCID != -1)
+	{
+		vec2 Dir = m_TargetPos - m_Pos;
+		if (length(Dir) > 0.0f)
+			m_Angle = (int)(GetAngle(Dir) * 256.0f);
+	}
+
+	if (GameServer()->Collision()->GetCollisionAt(m_Pos.x, m_Pos.y) & (CCollision::COLFLAG_DEATH | CCollision::COLFLAG_INSTADEATH) ||
+		GameLayerClipped(m_Pos))
+		Die(-1, WEAPON_WORLD);
+}
+
+bool CNpc::CanSleep()
+{
+	// only idle npcs standing still on the ground, physics at a tenth of the rate would hover
+	return !m_Triggered && m_TargetCID < 0 && !m_Move && !m_Jump && absolute(m_Vel.x) < 0.01f && IsGrounded();
+}
+
+void CNpc::TickPaused()
+{
+	if (m_AttackTick)
+		++m_AttackTick;
+	if (m_DamageTakenTick)
+		++m_DamageTakenTick;
+	if (m_EmoteStop > -1)
+		++m_EmoteStop;
+}
+
+bool CNpc::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
+{
+	if (!m_Alive)
+		return false;
+
+	// monsters don't hurt each other
+	if (From >= 0 && From < MAX_CLIENTS && GameServer()->IsBot(From))
+		return false;
+
+	m_Vel += Force;
+	m_Triggered = true;
+
+	GameServer()->CreateDamageInd(m_Pos, GetAngle(-Force), Dmg);
+
+	if (From >= 0 && From < MAX_CLIENTS && GameServer()->m_apPlayers[From])
+		GameServer()->CreateSound(GameServer()->m_apPlayers[From]->m_ViewPos, SOUND_HIT, CmaskOne(From));
+
+	m_Health -= Dmg;
+	m_DamageTakenTick = Server()->Tick();
+
+	if (m_Health <= 0)
+	{
+		Die(From, Weapon);
+		return false;
+	}
+
+	if (Dmg > 10 || frandom() * 10 < 3)
+		GameServer()->CreateSound(m_Pos, SOUND_PLAYER_PAIN_LONG);
+	else
+		GameServer()->CreateSound(m_Pos, SOUND_PLAYER_PAIN_SHORT);
+
+	m_EmoteType = EMOTE_PAIN;
+	m_EmoteStop = Server()->Tick() + 500 * Server()->TickSpeed() / 1000;
+
+	return true;
+}
+
+void CNpc::Die(int Killer, int Weapon)
+{
+	if (!m_Alive)
+		return;
+
+	m_Alive = false;
+
+	CPlayer *pKiller = 0;
+	if (Killer >= 0 && Killer < MAX_CLIENTS)
+		pKiller = GameServer()->m_apPlayers[Killer];
+	GameServer()->m_pController->OnNpcDeath(this, pKiller, Weapon);
+
+	// the splat takes the colors of the slot each client saw the npc in,
+	// one event per slot so no client gets a real player's colors
+	GameServer()->CreateSound(m_Pos, SOUND_PLAYER_DIE);
+	// event masks are ints, clients past 31 can't be addressed and are left out
+	int aSlotMask[MAX_CLIENTS] = {0};
+	for (int c = 0; c < MAX_CLIENTS && c < 32; c++)
+	{
+		int Slot = GameServer()->m_apPlayers[c] ? GameWorld()->NpcClientSlot(m_NpcID, c) : -1;
+		if (Slot >= 0)
+			aSlotMask[Slot] |= CmaskOne(c);
+	}
+	for (int i = 0; i < MAX_CLIENTS; i++)
+		if (aSlotMask[i])
+			GameServer()->CreateDeath(m_Pos, i, aSlotMask[i]);
+
+	GameServer()->m_World.DestroyEntity(this);
+}
+
+void CNpc::Snap(int SnappingClient)
+{
+	if (!m_Alive)
+		return;
+
+	int SnapID = GameWorld()->NpcSnapID(m_NpcID);
+	if (SnapID < 0)
+		return;
+
+	CNetObj_ClientInfo *pClientInfo = static_cast<CNetObj_ClientInfo *>(Server()->SnapNewItem(NETOBJTYPE_CLIENTINFO, SnapID, sizeof(CNetObj_ClientInfo)));
+	if (!pClientInfo)
+		return;
+
+	StrToInts(&pClientInfo->m_Name0, 4, "");
+	StrToInts(&pClientInfo->m_Clan0, 3, "");
+	pClientInfo->m_Country = -1;
+	StrToInts(&pClientInfo->m_Skin0, 6, s_apNpcSkins[m_Skin]);
+	pClientInfo->m_UseCustomColor = 0;
+	pClientInfo->m_ColorBody = 0;
+	pClientInfo->m_ColorFeet = 0;
+
+	CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(Server()->SnapNewItem(NETOBJTYPE_PLAYERINFO, SnapID, sizeof(CNetObj_PlayerInfo)));
+	if (!pPlayerInfo)
+		return;
+
+	pPlayerInfo->m_Latency = 0;
+	pPlayerInfo->m_Local = 0;
+	pPlayerInfo->m_ClientID = SnapID;
+	pPlayerInfo->m_Score = 0;
+	pPlayerInfo->m_Team = GameServer()->m_pController->IsTeamplay() ? TEAM_BLUE : TEAM_RED;
+
+	CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Server()->SnapNewItem(NETOBJTYPE_CHARACTER, SnapID, sizeof(CNetObj_Character)));
+	if (!pCharacter)
+		return;
+
+	pCharacter->m_Tick = Server()->Tick();
+	pCharacter->m_X = round(m_Pos.x);
+	pCharacter->m_Y = round(m_Pos.y);
+	pCharacter->m_VelX = round(m_Vel.x * 256.0f);
+	pCharacter->m_VelY = round(m_Vel.y * 256.0f);
+	pCharacter->m_Angle = m_Angle;
+	pCharacter->m_Direction = m_Move;
+	pCharacter->m_Jumped = m_Jumped;
+	pCharacter->m_HookedPlayer = -1;
+	pCharacter->m_HookState = HOOK_IDLE;
+	pCharacter->m_HookTick = 0;
+	pCharacter->m_HookX = round(m_Pos.x);
+	pCharacter->m_HookY = round(m_Pos.y);
+	pCharacter->m_HookDx = 0;
+	pCharacter->m_HookDy = 0;
+
+	if (m_EmoteStop < Server()->Tick())
+	{
+		m_EmoteType = EMOTE_NORMAL;
+		m_EmoteStop = -1;
+	}
+
+	pCharacter->m_PlayerFlags = 0;
+	pCharacter->m_Health = 0;
+	pCharacter->m_Armor = 0;
+	pCharacter->m_AmmoCount = 0;
+	pCharacter->m_Weapon = WEAPON_HAMMER;
+	pCharacter->m_Emote = m_EmoteType;
+	pCharacter->m_AttackTick = m_AttackTick;
+}
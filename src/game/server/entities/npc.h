@@ -0,0 +1,76 @@
+#ifndef GAME_SERVER_ENTITIES_NPC_H
+#define GAME_SERVER_ENTITIES_NPC_H
+
+#include <game/server/entity.h>
+
+/*
+	Class: NPC
+		Monster that lives only on the server side of the world. It
+		doesn't take a client slot, CPlayer or CCharacter, moves with a
+		small core of its own and snaps as a character through the
+		world's npc id space.
+*/
+class CNpc : public CEntity
+{
+public:
+	// same size as a character
+	static const int ms_PhysSize = 28;
+
+	CNpc(CGameWorld *pGameWorld, vec2 Pos, int Level);
+	virtual ~CNpc();
+
+	virtual void Reset();
+	virtual void Tick();
+	virtual void TickPaused();
+	virtual bool CanSleep();
+	virtual void Snap(int SnappingClient);
+
+	bool TakeDamage(vec2 Force, int Dmg, int From, int Weapon);
+	void Die(int Killer, int Weapon);
+
+	// invasion triggers, same meaning as CAI::Trigger
+	void Trigger(int TriggerLevel);
+
+	bool IsAlive() const { return m_Alive; }
+	int GetNpcID() const { return m_NpcID; }
+	int GetLevel() const { return m_Level; }
+
+private:
+	int m_NpcID;
+	int m_Level;
+	int m_Skin;
+
+	bool m_Alive;
+	int m_Health;
+	int m_MaxHealth;
+
+	// core
+	vec2 m_Vel;
+	int m_Jumped;
+	int m_Angle;
+	int m_AttackTick;
+	int m_ReloadTimer;
+	int m_DamageTakenTick;
+
+	int m_EmoteType;
+	int m_EmoteStop;
+
+	// brain
+	int m_TargetCID;
+	vec2 m_TargetPos;
+	int m_Move;
+	bool m_Jump;
+	int m_NextThink;
+	vec2 m_StuckPos;
+	int m_StuckTimer;
+
+	int m_TriggerLevel;
+	bool m_Triggered;
+
+	bool IsGrounded();
+	void Think();
+	void Move();
+	void Attack();
+};
+
+#endif
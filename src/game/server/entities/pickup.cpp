@@ -22,6 +22,7 @@ CPickup::CPickup(CGameWorld *pGameWorld, int Type, int SubType, int Owner)
 	m_Dropable = false;
 	m_Life = 0;
 	m_Vel = vec2(0, 0);
+	m_SensorArmed = false;
 }
 
 void CPickup::Reset()
@@ -41,6 +42,7 @@ void CPickup::Reset()
 
 void CPickup::Tick()
 {
+	m_SensorArmed = false;
 
 	// wait for respawn
 	// if(m_SpawnTick > 0) - 12.5.
@@ -106,10 +108,21 @@ void CPickup::Tick()
 		GameServer()->Collision()->MoveBox(&m_Pos, &m_Vel, vec2(24.0f, 24.0f), 0.4f);
 	}
 
-	// Check if a player intersected us
-	CCharacter *pChr = GameServer()->m_World.ClosestCharacter(m_Pos, 20.0f, 0);
-	if (pChr && pChr->IsAlive()) // && !pChr->GetPlayer()->m_pAI)
+	// players touching us are reported by the world, see OnSensorStay
+	SetSensor(20.0f);
+	m_SensorArmed = true;
+}
+
+void CPickup::OnSensorStay(CCharacter *pChr)
+{
+	// only one player gets to try per tick
+	if (!m_SensorArmed)
+		return;
+
+	if (pChr->IsAlive()) // && !pChr->GetPlayer()->m_pAI)
 	{
+		m_SensorArmed = false;
+
 		// player picked us up, is someone was hooking us, let them go
 		int RespawnTime = -1;
 		switch (m_Type)
@@ -15,7 +15,10 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void TickPaused();
+	// drops fall and expire every tick, only placed pickups may sleep
+	virtual bool CanSleep() { return !m_Dropable; }
 	virtual void Snap(int SnappingClient);
+	virtual void OnSensorStay(class CCharacter *pChr);
 
 	int m_Owner;
 	
@@ -67,6 +70,9 @@ public:
 private:
 	int m_Type;
 	int m_Subtype;
+
+	// set when this tick's update reached the pickup check
+	bool m_SensorArmed;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include "electro.h"
 #include "superexplosion.h"
 #include "smokescreen.h"
+#include "npc.h"
 
 #include <game/server/classabilities.h>
 
@@ -75,6 +76,11 @@ void CProjectile::Tick()
 	CCharacter *OwnerChar = GameServer()->GetPlayerChar(m_Owner);
 	CCharacter *TargetChr = GameServer()->m_World.IntersectCharacter(PrevPos, CurPos, 6.0f, CurPos, OwnerChar);
 
+	// CurPos already stops at the character, so an npc found here is closer
+	CNpc *pTargetNpc = GameServer()->m_World.IntersectNpc(PrevPos, CurPos, 6.0f, CurPos);
+	if (pTargetNpc)
+		TargetChr = 0;
+
 	m_LifeSpan--;
 
 	// if (m_ExtraInfo == SMOKE)
@@ -127,7 +133,7 @@ void CProjectile::Tick()
 		}
 	}
 
-	if (TargetChr || Collide || m_LifeSpan < 0 || GameLayerClipped(CurPos))
+	if (TargetChr || pTargetNpc || Collide || m_LifeSpan < 0 || GameLayerClipped(CurPos))
 	{
 		if (m_LifeSpan >= 0 || m_Weapon == WEAPON_GRENADE)
 			GameServer()->CreateSound(CurPos, m_SoundImpact);
@@ -171,6 +177,8 @@ void CProjectile::Tick()
 
 			TargetChr->TakeDamage(m_Direction * max(0.001f, m_Force), m_Damage, m_Owner, m_Weapon);
 		}
+		else if (pTargetNpc)
+			pTargetNpc->TakeDamage(m_Direction * max(0.001f, m_Force), m_Damage, m_Owner, m_Weapon);
 
 		GameServer()->m_World.DestroyEntity(this);
 	}
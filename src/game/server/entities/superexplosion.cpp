@@ -35,7 +35,7 @@ void CSuperexplosion::Tick()
 			GameServer()->CreateSound(m_Pos, SOUND_GRENADE_EXPLODE);
 
 		if (m_Life == 0)
-			GameServer()->CreateExplosion(m_Pos, m_Player, m_Weapon, false, m_Superdamage);
+			GameServer()->QueueExplosion(m_Pos, m_Player, m_Weapon, m_Superdamage);
 		else
 		{
 			int Steps = m_Life * 4;
@@ -49,7 +49,7 @@ void CSuperexplosion::Tick()
 
 				if (!GameServer()->Collision()->IntersectLine(m_Pos + Dir * 48, To, NULL, NULL))
 				{
-					GameServer()->CreateExplosion(To, m_Player, m_Weapon, false, m_Superdamage);
+					GameServer()->QueueExplosion(To, m_Player, m_Weapon, m_Superdamage);
 				}
 
 				Angle += StepAngle;
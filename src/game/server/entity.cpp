@@ -17,6 +17,7 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_MarkedForDestroy = false;
 	m_ID = Server()->SnapNewID();
+	m_SensorID = -1;
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
@@ -24,10 +25,20 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 CEntity::~CEntity()
 {
+	if(m_SensorID >= 0)
+		GameWorld()->RemoveSensor(m_SensorID);
 	GameWorld()->RemoveEntity(this);
 	Server()->SnapFreeID(m_ID);
 }
 
+void CEntity::SetSensor(float Radius)
+{
+	if(m_SensorID < 0)
+		m_SensorID = GameWorld()->AddSensor(this, m_Pos, Radius);
+	else
+		GameWorld()->MoveSensor(m_SensorID, m_Pos);
+}
+
 int CEntity::NetworkClipped(int SnappingClient)
 {
 	return NetworkClipped(SnappingClient, m_Pos);
@@ -66,6 +66,7 @@ class CEntity
 protected:
 	bool m_MarkedForDestroy;
 	int m_ID;
+	int m_SensorID;
 	int m_ObjType;
 public:
 	CEntity(CGameWorld *pGameWorld, int Objtype);
@@ -113,6 +114,36 @@ public:
 	*/
 	virtual void TickPaused() {}
 
+	/*
+		Function: CanSleep
+			Entities returning true only tick every
+			CGameWorld::SLEEP_TICK_RATE ticks while their region sleeps.
+	*/
+	virtual bool CanSleep() { return false; }
+
+	/*
+		Function: OnSensorEnter, OnSensorStay, OnSensorExit
+			Called after the tick for entities with a sensor, see
+			CGameWorld::AddSensor. Stay is called every tick a
+			character overlaps the sensor, including the tick it entered.
+	*/
+	virtual void OnSensorEnter(class CCharacter *pChr) {}
+	virtual void OnSensorStay(class CCharacter *pChr) {}
+	virtual void OnSensorExit(int ClientID) {}
+
+	/*
+		Function: OnSensorNpc
+			Called every tick a living npc overlaps the sensor. Npcs
+			have no client id, so there are no enter and exit calls.
+	*/
+	virtual void OnSensorNpc(class CNpc *pNpc) {}
+
+	/*
+		Function: SetSensor
+			Registers the entity's sensor or moves it to m_Pos.
+	*/
+	void SetSensor(float Radius);
+
 	/*
 		Function: snap
 			Called when a new snapshot is being generated for a specific
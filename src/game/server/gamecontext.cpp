@@ -7,6 +7,7 @@
 #include <engine/shared/config.h>
 #include <engine/map.h>
 #include <engine/console.h>
+#include <engine/engine.h>
 #include "gamecontext.h"
 #include <game/version.h>
 #include <game/collision.h>
@@ -21,6 +22,7 @@
 
 #include <game/server/entities/arrow.h>
 #include <game/server/entities/block.h>
+#include <game/server/entities/npc.h>
 
 #include <game/server/ai_protocol.h>
 #include <game/server/ai.h>
@@ -65,6 +67,10 @@ void CGameContext::Construct(int Resetting)
 	m_ShowWaypoints = false;
 	m_FreezeCharacters = false;
 
+	m_NumQueuedExplosions = 0;
+	m_AIPathBudget = 0;
+	m_AIScanBudget = 0;
+
 	if (Resetting == NO_RESET)
 		m_pVoteOptionHeap = new CHeap();
 
@@ -96,6 +102,7 @@ void CGameContext::Clear()
 	CVoteOptionServer *pVoteOptionLast = m_pVoteOptionLast;
 	int NumVoteOptions = m_NumVoteOptions;
 	CTuningParams Tuning = m_Tuning;
+	std::shared_ptr<CMapGenJob> pMapGenJob = std::move(m_pMapGenJob);
 
 	m_Resetting = true;
 	this->~CGameContext();
@@ -107,6 +114,7 @@ void CGameContext::Clear()
 	m_pVoteOptionLast = pVoteOptionLast;
 	m_NumVoteOptions = NumVoteOptions;
 	m_Tuning = Tuning;
+	m_pMapGenJob = std::move(pMapGenJob);
 }
 
 class CCharacter *CGameContext::GetPlayerChar(int ClientID)
@@ -171,41 +179,219 @@ void CGameContext::CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamag
 		pEvent->m_Y = (int)Pos.y;
 	}
 
+	m_World.WakeRegion(Pos, 135.0f);
+
 	if (!NoDamage)
 	{
 		// deal damage
 		CCharacter *apEnts[MAX_CLIENTS];
 		float Radius = 135.0f;
-		float InnerRadius = 48.0f;
 		int Num = m_World.FindEntities(Pos, Radius, (CEntity **)apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
 		for (int i = 0; i < Num; i++)
 		{
-			vec2 Diff = apEnts[i]->m_Pos - Pos;
-			vec2 ForceDir(0, 1);
-			float l = length(Diff);
-			if (l)
-				ForceDir = normalize(Diff);
-			l = 1 - clamp((l - InnerRadius) / (Radius - InnerRadius), 0.0f, 1.0f);
-			float Dmg = 14 * l;
+			vec2 Force;
+			int Dmg = ExplosionDamage(Pos, apEnts[i], Owner, Superdamage, &Force);
+			if (Dmg)
+				apEnts[i]->TakeDamage(Force, Dmg, Owner, Weapon);
+		}
+
+		CNpc *apNpcs[CGameWorld::MAX_NPCS];
+		Num = m_World.FindEntities(Pos, Radius, (CEntity **)apNpcs, CGameWorld::MAX_NPCS, CGameWorld::ENTTYPE_NPC);
+		for (int i = 0; i < Num; i++)
+		{
+			vec2 Force;
+			int Dmg = ExplosionDamage(Pos, apNpcs[i], Owner, Superdamage, &Force);
+			if (Dmg)
+				apNpcs[i]->TakeDamage(Force, Dmg, Owner, Weapon);
+		}
+	}
+}
+
+int CGameContext::ExplosionDamage(vec2 Pos, CEntity *pEnt, int Owner, bool Superdamage, vec2 *pForce)
+{
+	float Radius = 135.0f;
+	float InnerRadius = 48.0f;
+	vec2 Diff = pEnt->m_Pos - Pos;
+	vec2 ForceDir(0, 1);
+	float l = length(Diff);
+	if (l >= Radius + pEnt->m_ProximityRadius)
+		return 0;
+	if (l)
+		ForceDir = normalize(Diff);
+	l = 1 - clamp((l - InnerRadius) / (Radius - InnerRadius), 0.0f, 1.0f);
+	float Dmg = 14 * l;
+
+	if (Superdamage)
+		Dmg *= 5;
 
-			if (Superdamage)
-				Dmg *= 5;
+	if (pEnt->GetObjType() == CGameWorld::ENTTYPE_CHARACTER && ((CCharacter *)pEnt)->GetPlayer()->GotAbility(ANTIEXPLOSIONARMOR))
+		Dmg -= 1.0f;
+
+	if (Owner > 0 && Owner < MAX_CLIENTS)
+	{
+		if (m_apPlayers[Owner] && m_apPlayers[Owner]->GotAbility(EXPLOSION_DAMAGE1))
+			Dmg += 1.0f;
+	}
+
+	if (!(int)Dmg || Dmg <= 0.0f)
+		return 0;
+
+	*pForce = ForceDir * Dmg * 0.9f;
+	return (int)Dmg;
+}
+
+void CGameContext::QueueExplosion(vec2 Pos, int Owner, int Weapon, bool Superdamage)
+{
+	m_World.WakeRegion(Pos, 135.0f);
+
+	if (m_NumQueuedExplosions == MAX_QUEUED_EXPLOSIONS)
+	{
+		CreateExplosion(Pos, Owner, Weapon, false, Superdamage);
+		return;
+	}
+
+	CQueuedExplosion *pExplosion = &m_aQueuedExplosions[m_NumQueuedExplosions++];
+	pExplosion->m_Pos = Pos;
+	pExplosion->m_Owner = Owner;
+	pExplosion->m_Weapon = Weapon;
+	pExplosion->m_Superdamage = Superdamage;
+}
+
+void CGameContext::ResolveExplosions()
+{
+	if (!m_NumQueuedExplosions)
+		return;
+
+	// copy the queue, dying characters may chain new explosions
+	CQueuedExplosion *pExplosions = m_aResolvingExplosions;
+	int NumExplosions = m_NumQueuedExplosions;
+	mem_copy(pExplosions, m_aQueuedExplosions, NumExplosions * sizeof(CQueuedExplosion));
+	m_NumQueuedExplosions = 0;
+
+	// events, blasts closer than half a tile look the same on the client
+	vec2 aEventPos[MAX_QUEUED_EXPLOSIONS];
+	int NumEvents = 0;
+	for (int i = 0; i < NumExplosions; i++)
+	{
+		vec2 Pos = pExplosions[i].m_Pos;
+		bool Duplicate = false;
+		for (int e = 0; e < NumEvents && !Duplicate; e++)
+			Duplicate = distance(aEventPos[e], Pos) < 16.0f;
+		if (Duplicate)
+			continue;
+
+		aEventPos[NumEvents++] = Pos;
+		CNetEvent_Explosion *pEvent = (CNetEvent_Explosion *)m_Events.Create(NETEVENTTYPE_EXPLOSION, sizeof(CNetEvent_Explosion));
+		if (pEvent)
+		{
+			pEvent->m_X = (int)Pos.x;
+			pEvent->m_Y = (int)Pos.y;
+		}
+	}
+
+	// group the blasts into clusters of limited extent
+	struct CCluster
+	{
+		vec2 m_Min;
+		vec2 m_Max;
+		int m_First;
+	};
+	CCluster aClusters[MAX_QUEUED_EXPLOSIONS];
+	int aNext[MAX_QUEUED_EXPLOSIONS];
+	int NumClusters = 0;
+	for (int i = 0; i < NumExplosions; i++)
+	{
+		vec2 Pos = pExplosions[i].m_Pos;
+		int c = 0;
+		for (; c < NumClusters; c++)
+		{
+			vec2 Min = vec2(minimum(aClusters[c].m_Min.x, Pos.x), minimum(aClusters[c].m_Min.y, Pos.y));
+			vec2 Max = vec2(maximum(aClusters[c].m_Max.x, Pos.x), maximum(aClusters[c].m_Max.y, Pos.y));
+			if (Max.x - Min.x <= EXPLOSION_CLUSTER_SIZE && Max.y - Min.y <= EXPLOSION_CLUSTER_SIZE)
+			{
+				aClusters[c].m_Min = Min;
+				aClusters[c].m_Max = Max;
+				break;
+			}
+		}
+		if (c == NumClusters)
+		{
+			aClusters[c].m_Min = aClusters[c].m_Max = Pos;
+			aClusters[c].m_First = -1;
+			NumClusters++;
+		}
+		aNext[i] = aClusters[c].m_First;
+		aClusters[c].m_First = i;
+	}
 
-			if (apEnts[i]->GetPlayer()->GotAbility(ANTIEXPLOSIONARMOR))
-				Dmg -= 1.0f;
+	// sum up the damage every character and npc takes from the whole batch
+	std::vector<CExplosionHit> &aHits = m_aExplosionHits;
+	aHits.clear();
+	for (int c = 0; c < NumClusters; c++)
+	{
+		vec2 Center = (aClusters[c].m_Min + aClusters[c].m_Max) * 0.5f;
+		float Radius = distance(Center, aClusters[c].m_Max) + 135.0f;
 
-			if (Owner > 0 && Owner < MAX_CLIENTS)
+		CEntity *apEnts[MAX_CLIENTS + CGameWorld::MAX_NPCS];
+		int Num = m_World.FindEntities(Center, Radius, apEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
+		Num += m_World.FindEntities(Center, Radius, apEnts + Num, CGameWorld::MAX_NPCS, CGameWorld::ENTTYPE_NPC);
+		for (int i = aClusters[c].m_First; i != -1; i = aNext[i])
+		{
+			const CQueuedExplosion *pExplosion = &pExplosions[i];
+			for (int k = 0; k < Num; k++)
 			{
-				if (m_apPlayers[Owner] && m_apPlayers[Owner]->GotAbility(EXPLOSION_DAMAGE1))
-					Dmg += 1.0f;
+				vec2 Force;
+				int Dmg = ExplosionDamage(pExplosion->m_Pos, apEnts[k], pExplosion->m_Owner, pExplosion->m_Superdamage, &Force);
+				if (!Dmg)
+					continue;
+
+				// body armor blocks a point of every blast like it did with one TakeDamage per blast
+				if (apEnts[k]->GetObjType() == CGameWorld::ENTTYPE_CHARACTER)
+					Dmg = maximum(Dmg - BodyArmor((CCharacter *)apEnts[k]), 0);
+
+				unsigned h = 0;
+				while (h < aHits.size() && (aHits[h].m_pEnt != apEnts[k] || aHits[h].m_Owner != pExplosion->m_Owner || aHits[h].m_Weapon != pExplosion->m_Weapon))
+					h++;
+				if (h == aHits.size())
+				{
+					CExplosionHit Hit;
+					Hit.m_pEnt = apEnts[k];
+					Hit.m_Owner = pExplosion->m_Owner;
+					Hit.m_Weapon = pExplosion->m_Weapon;
+					Hit.m_Damage = 0;
+					Hit.m_Force = vec2(0, 0);
+					aHits.push_back(Hit);
+				}
+				aHits[h].m_Damage += Dmg;
+				aHits[h].m_Force += Force;
 			}
+		}
+	}
 
-			if ((int)Dmg && Dmg > 0.0f)
-				apEnts[i]->TakeDamage(ForceDir * Dmg * 0.9f, (int)Dmg, Owner, Weapon);
+	for (unsigned h = 0; h < aHits.size(); h++)
+	{
+		const CExplosionHit *pHit = &aHits[h];
+		if (pHit->m_pEnt->GetObjType() == CGameWorld::ENTTYPE_NPC)
+		{
+			CNpc *pNpc = (CNpc *)pHit->m_pEnt;
+			if (pNpc->IsAlive())
+				pNpc->TakeDamage(pHit->m_Force, pHit->m_Damage, pHit->m_Owner, pHit->m_Weapon);
+		}
+		else
+		{
+			// armor was taken off per blast above, TakeDamage takes it off once more
+			CCharacter *pChr = (CCharacter *)pHit->m_pEnt;
+			if (pChr->IsAlive() && pHit->m_Damage > 0)
+				pChr->TakeDamage(pHit->m_Force, pHit->m_Damage + BodyArmor(pChr), pHit->m_Owner, pHit->m_Weapon);
 		}
 	}
 }
 
+int CGameContext::BodyArmor(CCharacter *pChr)
+{
+	return (pChr->GetPlayer()->GotAbility(BODYARMOR) ? 1 : 0) + (pChr->GetPlayer()->GotAbility(HEAVYBODYARMOR) ? 1 : 0);
+}
+
 /*
 void create_smoke(vec2 Pos)
 {
@@ -229,10 +415,10 @@ void CGameContext::CreatePlayerSpawn(vec2 Pos)
 	}
 }
 
-void CGameContext::CreateDeath(vec2 Pos, int ClientID)
+void CGameContext::CreateDeath(vec2 Pos, int ClientID, int Mask)
 {
 	// create the event
-	CNetEvent_Death *pEvent = (CNetEvent_Death *)m_Events.Create(NETEVENTTYPE_DEATH, sizeof(CNetEvent_Death));
+	CNetEvent_Death *pEvent = (CNetEvent_Death *)m_Events.Create(NETEVENTTYPE_DEATH, sizeof(CNetEvent_Death), Mask);
 	if (pEvent)
 	{
 		pEvent->m_X = (int)Pos.x;
@@ -670,6 +856,8 @@ void CGameContext::OnTick()
 	// copy tuning
 	m_World.m_Core.m_Tuning = m_Tuning;
 	m_World.Tick();
+	ResolveExplosions();
+	m_Collision.RefreshDirtyWaypoints();
 
 	// if(world.paused) // make sure that the game object always updates
 	m_pController->Tick();
@@ -787,6 +975,21 @@ void CGameContext::Format_L(const char *LanguageCode, char *Text, ...)
 	va_end(VarArgs);
 }
 
+void CGameContext::GenerateWaypoints()
+{
+	// generated levels are played once and every one has its own sha256,
+	// caching them would only fill the waypoints folder
+	bool UseCache = g_Config.m_SvWaypointCache && !m_pServer->m_MapGenerated && !m_Collision.NumDirtyRects();
+
+	SHA256_DIGEST MapSha256 = Kernel()->RequestInterface<IEngineMap>()->Sha256();
+	if (UseCache && m_Collision.LoadWaypoints(Storage(), MapSha256))
+		return;
+
+	m_Collision.GenerateWaypoints();
+	if (UseCache && !m_Collision.SaveWaypoints(Storage(), MapSha256))
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "failed to save the waypoint cache");
+}
+
 bool CGameContext::AIInputUpdateNeeded(int ClientID)
 {
 	if (m_apPlayers[ClientID])
@@ -797,10 +1000,23 @@ bool CGameContext::AIInputUpdateNeeded(int ClientID)
 
 void CGameContext::UpdateAI()
 {
-	for (int i = 0; i < MAX_CLIENTS; i++)
+	m_AIPathBudget = g_Config.m_SvAIPathBudget;
+	m_AIScanBudget = g_Config.m_SvAIScanBudget;
+
+	// rotate who gets the budget first
+	int First = Server()->Tick() % MAX_CLIENTS;
+	for (int n = 0; n < MAX_CLIENTS; n++)
 	{
-		if (m_apPlayers[i] && IsBot(i))
-			m_apPlayers[i]->AITick();
+		int i = (First + n) % MAX_CLIENTS;
+		if (!m_apPlayers[i] || !IsBot(i))
+			continue;
+
+		// bots far from everyone think at the sleeping rate
+		CCharacter *pChr = m_apPlayers[i]->GetCharacter();
+		if (pChr && m_World.SkipTick(pChr->m_Pos, i))
+			continue;
+
+		m_apPlayers[i]->AITick();
 	}
 }
 
@@ -1665,6 +1881,15 @@ void CGameContext::ConTuneReset(IConsole::IResult *pResult, void *pUserData)
 	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "tuning", "Tuning reset");
 }
 
+void CGameContext::ConMapGenBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	int Size = pResult->NumArguments() > 0 ? clamp(pResult->GetInteger(0), 16, 2000) : 500;
+	int Runs = pResult->NumArguments() > 1 ? clamp(pResult->GetInteger(1), 1, 100) : 5;
+	pSelf->m_MapGen.SetNumThreads(g_Config.m_SvMapGenThreads);
+	pSelf->m_MapGen.BenchmarkAutoMap(Size, Runs, pSelf->Console());
+}
+
 void CGameContext::ConTuneDump(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -2067,6 +2292,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("tune", "si", CFGFLAG_SERVER, ConTuneParam, this, "Tune variable to value");
 	Console()->Register("tune_reset", "", CFGFLAG_SERVER, ConTuneReset, this, "Reset tuning");
 	Console()->Register("tune_dump", "", CFGFLAG_SERVER, ConTuneDump, this, "Dump tuning");
+	Console()->Register("mapgen_benchmark", "?i?i", CFGFLAG_SERVER, ConMapGenBenchmark, this, "Time the auto-mapper on generated levels (size, runs)");
 
 	Console()->Register("pause", "", CFGFLAG_SERVER, ConPause, this, "Pause/unpause game");
 	Console()->Register("change_map", "?r", CFGFLAG_SERVER | CFGFLAG_STORE, ConChangeMap, this, "Change map");
@@ -2120,13 +2346,9 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		m_pController = new CGameControllerDM(this);
 
 	if (g_Config.m_SvMapGen && !m_pServer->m_MapGenerated)
-	{
-		m_MapGen.FillMap();
-		SaveMap("");
-
-		str_copy(g_Config.m_SvMap, "generated", sizeof(g_Config.m_SvMap));
-		m_pServer->m_MapGenerated = true;
-	}
+		GenerateMap();
+	else if (g_Config.m_SvMapGen && str_comp(g_Config.m_SvGametype, "coop") == 0)
+		PrefetchMap(g_Config.m_SvMapGenLevel + 1);
 
 	// create all entities from the game layer
 	CMapItemLayerTilemap *pTileMap = m_Layers.GameLayer();
@@ -2598,13 +2820,51 @@ void CGameContext::SaveMap(const char *path)
 
 void CGameContext::GenerateMap()
 {
-	m_MapGen.FillMap();
-	SaveMap("");
+	// the loaded map is the template, the result is handed to the server in memory
+	const char *pTemplate = g_Config.m_SvMap;
+	std::shared_ptr<CMapGenJob> pJob = std::move(m_pMapGenJob);
+	if (!pJob || !pJob->Matches(pTemplate, g_Config.m_SvMapGenSeed, g_Config.m_SvMapGenLevel, g_Config.m_SvGametype, g_Config.m_SvSurvivalMode))
+		pJob = std::make_shared<CMapGenJob>(Storage(), pTemplate, g_Config.m_SvMapGenSeed, g_Config.m_SvMapGenLevel, g_Config.m_SvGametype, g_Config.m_SvSurvivalMode, g_Config.m_SvMapGenThreads);
+	pJob->Wait();
+
+	int Size = 0;
+	unsigned char *pData = pJob->ReleaseData(&Size);
+	if (pData)
+	{
+		IServer::CMapGenInfo Info;
+		str_copy(Info.m_aTemplate, pJob->Template(), sizeof(Info.m_aTemplate));
+		Info.m_TemplateCrc = pJob->TemplateCrc();
+		Info.m_Seed = pJob->Seed();
+		Info.m_Level = pJob->Level();
+		Info.m_Version = MAPGEN_VERSION;
+		str_copy(Info.m_aGameType, pJob->GameType(), sizeof(Info.m_aGameType));
+		Info.m_SurvivalMode = pJob->SurvivalMode();
+		Server()->SetGeneratedMap(pData, Size, &Info);
+	}
+	else
+	{
+		// fall back to generating into the loaded map and writing it to disk
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapgen", "background generation failed, generating in place");
+		Server()->SetGeneratedMap(0x0, 0);
+		m_MapGen.SetNumThreads(g_Config.m_SvMapGenThreads);
+		m_MapGen.FillMap(g_Config.m_SvMapGenSeed, g_Config.m_SvMapGenLevel, g_Config.m_SvGametype, g_Config.m_SvSurvivalMode);
+		SaveMap("");
+	}
 
 	str_copy(g_Config.m_SvMap, "generated", sizeof(g_Config.m_SvMap));
 	m_pServer->m_MapGenerated = true;
 }
 
+void CGameContext::PrefetchMap(int Level)
+{
+	if (m_pMapGenJob && m_pMapGenJob->Matches(g_Config.m_SvInvMap, g_Config.m_SvMapGenSeed, Level, g_Config.m_SvGametype, g_Config.m_SvSurvivalMode))
+		return;
+
+	// an outdated job keeps running, it is dropped once it's done
+	m_pMapGenJob = std::make_shared<CMapGenJob>(Storage(), g_Config.m_SvInvMap, g_Config.m_SvMapGenSeed, Level, g_Config.m_SvGametype, g_Config.m_SvSurvivalMode, g_Config.m_SvMapGenThreads);
+	Kernel()->RequestInterface<IEngine>()->AddJob(m_pMapGenJob);
+}
+
 void CGameContext::ReloadMap()
 {
 	Console()->ExecuteLine("reload", -1);
@@ -16,7 +16,7 @@
 #include "player.h"
 
 #include <engine/storage.h> // MapGen
-#include "mapgen.h"
+#include <game/mapgen.h>
 
 #include "block-solve.h"
 
@@ -53,12 +53,14 @@ class CGameContext : public IGameServer
 	// MapGen
 	CMapGen m_MapGen;
 	IStorage *m_pStorage;
+	std::shared_ptr<CMapGenJob> m_pMapGenJob; // next level, generated in the background
 
 	class CBlockSolve *m_pBlockSolve;
 
 	static void ConTuneParam(IConsole::IResult *pResult, void *pUserData);
 	static void ConTuneReset(IConsole::IResult *pResult, void *pUserData);
 	static void ConTuneDump(IConsole::IResult *pResult, void *pUserData);
+	static void ConMapGenBenchmark(IConsole::IResult *pResult, void *pUserData);
 	static void ConPause(IConsole::IResult *pResult, void *pUserData);
 	static void ConChangeMap(IConsole::IResult *pResult, void *pUserData);
 	static void ConRestart(IConsole::IResult *pResult, void *pUserData);
@@ -142,9 +144,41 @@ public:
 	// helper functions
 	void CreateDamageInd(vec2 Pos, float AngleMod, int Amount);
 	void CreateExplosion(vec2 Pos, int Owner, int Weapon, bool NoDamage, bool Superdamage = false);
+	int ExplosionDamage(vec2 Pos, class CEntity *pEnt, int Owner, bool Superdamage, vec2 *pForce);
+
+	// chained blasts are queued during the world tick and resolved together,
+	// one spatial query per cluster and one TakeDamage per character
+	enum
+	{
+		MAX_QUEUED_EXPLOSIONS=512,
+		EXPLOSION_CLUSTER_SIZE=512,
+	};
+	struct CQueuedExplosion
+	{
+		vec2 m_Pos;
+		int m_Owner;
+		int m_Weapon;
+		bool m_Superdamage;
+	};
+	// summed damage of one batch per (target, owner, weapon)
+	struct CExplosionHit
+	{
+		CEntity *m_pEnt;
+		int m_Owner;
+		int m_Weapon;
+		int m_Damage;
+		vec2 m_Force;
+	};
+	CQueuedExplosion m_aQueuedExplosions[MAX_QUEUED_EXPLOSIONS];
+	int m_NumQueuedExplosions;
+	CQueuedExplosion m_aResolvingExplosions[MAX_QUEUED_EXPLOSIONS];
+	std::vector<CExplosionHit> m_aExplosionHits;
+	void QueueExplosion(vec2 Pos, int Owner, int Weapon, bool Superdamage = false);
+	void ResolveExplosions();
+	static int BodyArmor(class CCharacter *pChr);
 	void CreateHammerHit(vec2 Pos);
 	void CreatePlayerSpawn(vec2 Pos);
-	void CreateDeath(vec2 Pos, int Who);
+	void CreateDeath(vec2 Pos, int Who, int Mask=-1);
 	void CreateSound(vec2 Pos, int Sound, int Mask=-1);
 	void CreateSoundGlobal(int Sound, int Target=-1);
 
@@ -175,6 +209,14 @@ public:
 
 	//
 	void UpdateAI();
+
+	// bots share per tick budgets for path replans and target scans. a bot
+	// that misses out keeps its old plan and asks again next tick, bots
+	// near humans may overdraw so they never lose fidelity
+	int m_AIPathBudget;
+	int m_AIScanBudget;
+	bool AIPathBudget(bool Priority) { return m_AIPathBudget-- > 0 || Priority; }
+	bool AIScanBudget(bool Priority) { return m_AIScanBudget-- > 0 || Priority; }
 	
 	// engine events
 	virtual void OnInit();
@@ -226,6 +268,9 @@ public:
 	
 	bool m_ShowWaypoints;
 	
+	// loads the bot navigation graph from the cache or builds and caches it
+	void GenerateWaypoints();
+	
 	// custom vote stuff
 	//void SetupVotes(int ClientID = -1);
 	void ResetVotes();
@@ -236,6 +281,7 @@ public:
 	// MapGen
 	virtual void SaveMap(const char *path);
 	void GenerateMap();
+	void PrefetchMap(int Level);
 
 	const char* Localize(const char *pLanguageCode, const char *pText);
 };
@@ -9,6 +9,7 @@
 #include "entities/flag.h"
 #include "entities/pickup.h"
 #include "entities/character.h"
+#include "entities/npc.h"
 #include "gamecontroller.h"
 #include "gamecontext.h"
 
@@ -49,7 +50,7 @@ IGameController::IGameController(class CGameContext *pGameServer)
 	m_PickupDropCount = 0;
 	m_DroppablesCreated = false;
 
-	GameServer()->Collision()->GenerateWaypoints();
+	GameServer()->GenerateWaypoints();
 
 	char aBuf[128];
 	str_format(aBuf, sizeof(aBuf), "%d waypoints generated, %d connections created", GameServer()->Collision()->WaypointCount(), GameServer()->Collision()->ConnectionCount());
@@ -718,6 +719,21 @@ void IGameController::DoWarmup(int Seconds)
 		m_Warmup = Seconds * Server()->TickSpeed();
 }
 
+void IGameController::OnNpcDeath(class CNpc *pVictim, class CPlayer *pKiller, int Weapon)
+{
+	// pickup drops
+	if (g_Config.m_SvPickupDrops && frandom() * 10 < 4)
+	{
+		if (frandom() * 10 < 4)
+			DropPickup(pVictim->m_Pos, POWERUP_ARMOR, vec2(frandom() * 6.0 - frandom() * 6.0, frandom() * 6.0 - frandom() * 6.0), 0);
+		else
+			DropPickup(pVictim->m_Pos, POWERUP_HEALTH, vec2(frandom() * 6.0 - frandom() * 6.0, frandom() * 6.0 - frandom() * 6.0), 0);
+	}
+
+	if (pKiller && Weapon != WEAPON_GAME)
+		pKiller->m_Score++;
+}
+
 bool IGameController::IsFriendlyFire(int ClientID1, int ClientID2)
 {
 	if (ClientID1 == ClientID2)
@@ -725,6 +741,9 @@ bool IGameController::IsFriendlyFire(int ClientID1, int ClientID2)
 
 	if (IsTeamplay())
 	{
+		if (ClientID1 < 0 || ClientID2 < 0)
+			return false;
+
 		if (!GameServer()->m_apPlayers[ClientID1] || !GameServer()->m_apPlayers[ClientID2])
 			return false;
 
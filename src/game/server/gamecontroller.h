@@ -180,6 +180,17 @@ public:
 				weapon when switching team or player suicides.
 	*/
 	virtual int OnCharacterDeath(class CCharacter *pVictim, class CPlayer *pKiller, int Weapon);
+
+	/*
+		Function: on_npc_death
+			Called when an npc in the world dies.
+
+		Arguments:
+			victim - The npc that died.
+			killer - The player that killed it, or NULL.
+			weapon - What weapon that killed it.
+	*/
+	virtual void OnNpcDeath(class CNpc *pVictim, class CPlayer *pKiller, int Weapon);
 	
 	
 
@@ -52,7 +52,7 @@ CGameControllerCSBB::CGameControllerCSBB(class CGameContext *pGameServer) : IGam
 
 	m_BroadcastTimer = 0;
 
-	GameServer()->Collision()->GenerateWaypoints();
+	GameServer()->GenerateWaypoints();
 
 	char aBuf[128];
 	str_format(aBuf, sizeof(aBuf), "%d waypoints generated, %d connections created", GameServer()->Collision()->WaypointCount(), GameServer()->Collision()->ConnectionCount());
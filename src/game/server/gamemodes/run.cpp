@@ -3,6 +3,7 @@
 #include <game/mapitems.h>
 
 #include <game/server/entities/character.h>
+#include <game/server/entities/npc.h>
 #include <game/server/entities/radar.h>
 #include <game/server/player.h>
 #include <game/server/gamecontext.h>
@@ -194,14 +195,7 @@ void CGameControllerCoop::OnCharacterSpawn(CCharacter *pChr, bool RequestAI)
 
 			int i = ENEMY_ALIEN1;
 
-			int Level = 0;
-
-			for (int i = 0; i < 9; i++)
-				if (m_EnemiesLeft < 1 - i * 3 + g_Config.m_SvMapGenLevel / 2 - m_Group / 3)
-					Level++;
-
-			if (frandom() < 0.7f && Level > 2)
-				Level = rand() % (Level - 1);
+			int Level = EnemyLevel();
 
 			// pChr->GetPlayer()->m_pAI = new CAIbase(GameServer(), pChr->GetPlayer());
 			pChr->m_IsBot = true;
@@ -244,6 +238,20 @@ void CGameControllerCoop::OnCharacterSpawn(CCharacter *pChr, bool RequestAI)
 	}
 }
 
+int CGameControllerCoop::EnemyLevel()
+{
+	int Level = 0;
+
+	for (int i = 0; i < 9; i++)
+		if (m_EnemiesLeft < 1 - i * 3 + g_Config.m_SvMapGenLevel / 2 - m_Group / 3)
+			Level++;
+
+	if (frandom() < 0.7f && Level > 2)
+		Level = rand() % (Level - 1);
+
+	return Level;
+}
+
 void CGameControllerCoop::Trigger(bool IncreaseLevel)
 {
 	if (IncreaseLevel)
@@ -258,6 +266,30 @@ void CGameControllerCoop::Trigger(bool IncreaseLevel)
 		if (pPlayer->m_pAI)
 			pPlayer->m_pAI->Trigger(m_TriggerLevel);
 	}
+
+	for (CNpc *pNpc = (CNpc *)GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_NPC); pNpc; pNpc = (CNpc *)pNpc->TypeNext())
+		pNpc->Trigger(m_TriggerLevel);
+}
+
+void CGameControllerCoop::SpawnEnemies()
+{
+	if (!g_Config.m_SvInvNpcs)
+	{
+		for (int i = 0; i < m_EnemiesLeft && GameServer()->m_pController->CountBots() < 32; i++)
+			GameServer()->AddBot();
+		GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "engine", "Adding bots...");
+		return;
+	}
+
+	// npcs don't wait for a free slot, the whole group comes at once
+	while (m_EnemiesLeft > 0 && GameServer()->m_World.NumNpcs() < CGameWorld::MAX_NPCS)
+	{
+		m_EnemiesLeft--;
+		new CNpc(&GameServer()->m_World, GetBotSpawnPos(), EnemyLevel());
+		m_EnemyCount++;
+	}
+
+	Trigger(false);
 }
 
 void CGameControllerCoop::SpawnNewGroup(bool AddBots)
@@ -279,16 +311,14 @@ void CGameControllerCoop::SpawnNewGroup(bool AddBots)
 	if (m_Group == 0 && m_EnemiesLeft > 20)
 		m_EnemiesLeft = 20;
 
+	m_Deaths = m_EnemiesLeft;
+
 	if (AddBots)
 	{
 		RandomGroupSpawnPos();
-
-		for (int i = 0; i < m_EnemiesLeft && GameServer()->m_pController->CountBots() < 32; i++)
-			GameServer()->AddBot();
-		GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "engine", "Adding bots...");
+		SpawnEnemies();
 	}
 
-	m_Deaths = m_EnemiesLeft;
 	m_Group++;
 	m_GroupsLeft--;
 
@@ -309,27 +339,10 @@ int CGameControllerCoop::OnCharacterDeath(class CCharacter *pVictim, class CPlay
 
 	if (pVictim->m_IsBot && !pVictim->GetPlayer()->m_ToBeKicked)
 	{
-		if (--m_Deaths <= 0 && CountPlayersAlive(-1, true) > 0)
-		{
-			if (m_GroupsLeft <= 0)
-			{
-				TriggerEscape();
-				GameServer()->SendBroadcast(_("Level cleared!"), -1, true);
-				m_pExit->m_Active = true;
-			}
-			else if (!m_GroupSpawnTick)
-			{
-				m_GroupSpawnTick = Server()->Tick() + Server()->TickSpeed() * 7;
-				if (m_Group > 1)
-					GameServer()->SendBroadcast(_("Wave cleared!"), -1, true);
-			}
-		}
-
 		if (m_EnemiesLeft <= 0)
 			pVictim->GetPlayer()->m_ToBeKicked = true;
 
-		if (pKiller)
-			Trigger(true);
+		OnEnemyDeath(pKiller != 0);
 	}
 
 	if (g_Config.m_SvSurvivalMode && !pVictim->m_IsBot && CountPlayersAlive(-1, true) <= 1)
@@ -341,6 +354,35 @@ int CGameControllerCoop::OnCharacterDeath(class CCharacter *pVictim, class CPlay
 	return 0;
 }
 
+void CGameControllerCoop::OnNpcDeath(CNpc *pVictim, CPlayer *pKiller, int Weapon)
+{
+	IGameController::OnNpcDeath(pVictim, pKiller, Weapon);
+	OnEnemyDeath(pKiller != 0);
+}
+
+void CGameControllerCoop::OnEnemyDeath(bool Killed)
+{
+	if (--m_Deaths <= 0 && CountPlayersAlive(-1, true) > 0)
+	{
+		if (m_GroupsLeft <= 0)
+		{
+			TriggerEscape();
+			GameServer()->SendBroadcast(_("Level cleared!"), -1, true);
+			m_pExit->m_Active = true;
+			GameServer()->m_World.WakeRegion(m_pExit->m_Pos, 128.0f);
+		}
+		else if (!m_GroupSpawnTick)
+		{
+			m_GroupSpawnTick = Server()->Tick() + Server()->TickSpeed() * 7;
+			if (m_Group > 1)
+				GameServer()->SendBroadcast(_("Wave cleared!"), -1, true);
+		}
+	}
+
+	if (Killed)
+		Trigger(true);
+}
+
 void CGameControllerCoop::NextLevel(int CID)
 {
 	//
@@ -380,9 +422,7 @@ void CGameControllerCoop::Tick()
 			m_AutoRestart = true;
 
 			m_GameState = STATE_GAME;
-			for (int i = 0; i < m_EnemiesLeft && GameServer()->m_pController->CountBots() < 32; i++)
-				GameServer()->AddBot();
-			GameServer()->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "engine", "Adding bots...");
+			SpawnEnemies();
 		}
 		// reset to first map if there's no players for 60 seconds
 		else if ((m_AutoRestart || g_Config.m_SvMapGenLevel > 1) && Server()->Tick() > Server()->TickSpeed() * 60.0f)
@@ -46,6 +46,9 @@ private:
 	int m_Group;
 
 	void SpawnNewGroup(bool AddBots = true);
+	void SpawnEnemies();
+	int EnemyLevel();
+	void OnEnemyDeath(bool Killed);
 
 	vec2 GetBotSpawnPos();
 	void RandomGroupSpawnPos();
@@ -90,6 +93,7 @@ public:
 	virtual bool OnEntity(int Index, vec2 Pos);
 	void OnCharacterSpawn(class CCharacter *pChr, bool RequestAI = false);
 	int OnCharacterDeath(class CCharacter *pVictim, class CPlayer *pKiller, int Weapon);
+	void OnNpcDeath(class CNpc *pVictim, class CPlayer *pKiller, int Weapon);
 	bool CanSpawn(int Team, vec2 *pPos, bool IsBot = false);
 	void NextLevel(int CID = -1);
 	bool GetSpawnPos(int Team, vec2 *pOutPos);
@@ -1,9 +1,14 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 
+#include <algorithm>
+
+#include <engine/shared/config.h>
+
 #include "gameworld.h"
 #include "entity.h"
 #include "gamecontext.h"
+#include "entities/npc.h"
 
 //////////////////////////////////////////////////
 // game world
@@ -17,6 +22,24 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for (int i = 0; i < NUM_ENTTYPES; i++)
 		m_apFirstEntityTypes[i] = 0;
+
+	m_SensorGridWidth = 0;
+	m_SensorGridHeight = 0;
+	m_FirstFreeSensor = -1;
+	m_MaxSensorRadius = 0.0f;
+
+	m_RegionGridWidth = 0;
+	m_RegionGridHeight = 0;
+
+	for (int i = 0; i < MAX_NPCS; i++)
+	{
+		m_apNpcs[i] = 0;
+		m_aNpcSnapID[i] = -1;
+	}
+	m_NumNpcs = 0;
+	for (int c = 0; c < MAX_CLIENTS + 1; c++)
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			m_aaSnapSlotNpc[c][i] = -1;
 }
 
 CGameWorld::~CGameWorld()
@@ -104,6 +127,8 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	UpdateNpcSnapIDs(SnappingClient);
+
 	for (int i = 0; i < NUM_ENTTYPES; i++)
 		for (CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 		{
@@ -156,12 +181,15 @@ void CGameWorld::Tick()
 	{
 		if (GameServer()->m_pController->IsForceBalanced())
 			GameServer()->SendChatTarget(-1, _("Teams have been balanced"));
+		UpdateRegions();
+
 		// update all objects
 		for (int i = 0; i < NUM_ENTTYPES; i++)
 			for (CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->Tick();
+				if (!pEnt->CanSleep() || !SkipTick(pEnt->m_Pos, pEnt->m_ID))
+					pEnt->Tick();
 				pEnt = m_pNextTraverseEntity;
 			}
 
@@ -169,9 +197,12 @@ void CGameWorld::Tick()
 			for (CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt;)
 			{
 				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-				pEnt->TickDefered();
+				if (!pEnt->CanSleep() || !SkipTick(pEnt->m_Pos, pEnt->m_ID))
+					pEnt->TickDefered();
 				pEnt = m_pNextTraverseEntity;
 			}
+
+		UpdateSensors();
 	}
 	else
 	{
@@ -244,6 +275,405 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	return pClosest;
 }
 
+CNpc *CGameWorld::IntersectNpc(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos)
+{
+	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
+	CNpc *pClosest = 0;
+
+	CNpc *p = (CNpc *)FindFirst(ENTTYPE_NPC);
+	for (; p; p = (CNpc *)p->TypeNext())
+	{
+		if (!p->IsAlive())
+			continue;
+
+		vec2 IntersectPos = closest_point_on_line(Pos0, Pos1, p->m_Pos);
+		float Len = distance(p->m_Pos, IntersectPos);
+		if (Len < p->m_ProximityRadius + Radius)
+		{
+			Len = distance(Pos0, IntersectPos);
+			if (Len < ClosestLen)
+			{
+				NewPos = IntersectPos;
+				ClosestLen = Len;
+				pClosest = p;
+			}
+		}
+	}
+
+	return pClosest;
+}
+
+int CGameWorld::AddNpc(CNpc *pNpc)
+{
+	for (int i = 0; i < MAX_NPCS; i++)
+	{
+		if (!m_apNpcs[i])
+		{
+			m_apNpcs[i] = pNpc;
+			m_aNpcSnapID[i] = -1;
+			m_NumNpcs++;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void CGameWorld::RemoveNpc(int NpcID)
+{
+	if (NpcID < 0 || NpcID >= MAX_NPCS || !m_apNpcs[NpcID])
+		return;
+
+	m_apNpcs[NpcID] = 0;
+	m_NumNpcs--;
+
+	// don't let a new npc inherit the slot on the clients
+	for (int c = 0; c < MAX_CLIENTS + 1; c++)
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			if (m_aaSnapSlotNpc[c][i] == NpcID)
+				m_aaSnapSlotNpc[c][i] = -1;
+}
+
+void CGameWorld::UpdateNpcSnapIDs(int SnappingClient)
+{
+	int *pSlotNpc = m_aaSnapSlotNpc[SnappingClient == -1 ? MAX_CLIENTS : SnappingClient];
+
+	for (int i = 0; i < MAX_NPCS; i++)
+		m_aNpcSnapID[i] = -1;
+
+	// slots held by players are never borrowed
+	int NumFree = 0;
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if (GameServer()->m_apPlayers[i])
+			pSlotNpc[i] = -1;
+		else
+			NumFree++;
+	}
+
+	if (!m_NumNpcs || !NumFree)
+		return;
+
+	// npcs in view, closest first when there are more than free slots,
+	// keyed distance << 16 | id
+	static int64 s_aCandidates[MAX_NPCS];
+	int NumCandidates = 0;
+
+	vec2 ViewPos = SnappingClient == -1 ? vec2(0, 0) : GameServer()->m_apPlayers[SnappingClient]->m_ViewPos;
+	for (CNpc *pNpc = (CNpc *)FindFirst(ENTTYPE_NPC); pNpc; pNpc = (CNpc *)pNpc->TypeNext())
+	{
+		if (pNpc->NetworkClipped(SnappingClient))
+			continue;
+
+		s_aCandidates[NumCandidates++] = ((int64)distance(ViewPos, pNpc->m_Pos) << 16) | pNpc->GetNpcID();
+	}
+
+	if (NumCandidates > NumFree)
+	{
+		std::nth_element(s_aCandidates, s_aCandidates + NumFree, s_aCandidates + NumCandidates);
+		NumCandidates = NumFree;
+	}
+
+	const int WANTED = -2;
+	for (int c = 0; c < NumCandidates; c++)
+		m_aNpcSnapID[s_aCandidates[c] & 0xffff] = WANTED;
+
+	// an npc keeps the slot it had, otherwise the client would see it jump
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		int NpcID = pSlotNpc[i];
+		if (NpcID < 0)
+			continue;
+
+		if (m_aNpcSnapID[NpcID] == WANTED)
+			m_aNpcSnapID[NpcID] = i;
+		else
+			pSlotNpc[i] = -1;
+	}
+
+	// the rest take free slots from the top, like bots do
+	int Slot = MAX_CLIENTS - 1;
+	for (int c = 0; c < NumCandidates; c++)
+	{
+		int NpcID = s_aCandidates[c] & 0xffff;
+		if (m_aNpcSnapID[NpcID] != WANTED)
+			continue;
+
+		while (Slot >= 0 && (GameServer()->m_apPlayers[Slot] || pSlotNpc[Slot] != -1))
+			Slot--;
+		if (Slot < 0)
+		{
+			m_aNpcSnapID[NpcID] = -1;
+			continue;
+		}
+
+		pSlotNpc[Slot] = NpcID;
+		m_aNpcSnapID[NpcID] = Slot;
+	}
+}
+
+int CGameWorld::SensorCell(vec2 Pos)
+{
+	int x = clamp((int)(Pos.x / SENSOR_CELL_SIZE), 0, m_SensorGridWidth - 1);
+	int y = clamp((int)(Pos.y / SENSOR_CELL_SIZE), 0, m_SensorGridHeight - 1);
+	return y * m_SensorGridWidth + x;
+}
+
+void CGameWorld::LinkSensor(int SensorID)
+{
+	CSensor *pSensor = &m_aSensors[SensorID];
+	pSensor->m_Cell = SensorCell(pSensor->m_Pos);
+	pSensor->m_Next = m_aSensorGrid[pSensor->m_Cell];
+	m_aSensorGrid[pSensor->m_Cell] = SensorID;
+}
+
+void CGameWorld::UnlinkSensor(int SensorID)
+{
+	int *pLink = &m_aSensorGrid[m_aSensors[SensorID].m_Cell];
+	while (*pLink != SensorID)
+		pLink = &m_aSensors[*pLink].m_Next;
+	*pLink = m_aSensors[SensorID].m_Next;
+}
+
+int CGameWorld::AddSensor(CEntity *pEntity, vec2 Pos, float Radius)
+{
+	if (m_aSensorGrid.empty())
+	{
+		CCollision *pCollision = GameServer()->Collision();
+		m_SensorGridWidth = max(1, pCollision->GetWidth() * 32 / SENSOR_CELL_SIZE + 1);
+		m_SensorGridHeight = max(1, pCollision->GetHeight() * 32 / SENSOR_CELL_SIZE + 1);
+		m_aSensorGrid.assign(m_SensorGridWidth * m_SensorGridHeight, -1);
+	}
+
+	int SensorID = m_FirstFreeSensor;
+	if (SensorID >= 0)
+		m_FirstFreeSensor = m_aSensors[SensorID].m_Next;
+	else
+	{
+		SensorID = m_aSensors.size();
+		m_aSensors.push_back(CSensor());
+	}
+
+	CSensor *pSensor = &m_aSensors[SensorID];
+	pSensor->m_pEntity = pEntity;
+	pSensor->m_Pos = Pos;
+	pSensor->m_Radius = Radius;
+	pSensor->m_Overlap = 0;
+	pSensor->m_NewOverlap = 0;
+	pSensor->m_Queued = false;
+	LinkSensor(SensorID);
+
+	m_MaxSensorRadius = max(m_MaxSensorRadius, Radius);
+	return SensorID;
+}
+
+void CGameWorld::MoveSensor(int SensorID, vec2 Pos)
+{
+	CSensor *pSensor = &m_aSensors[SensorID];
+	pSensor->m_Pos = Pos;
+	if (SensorCell(Pos) != pSensor->m_Cell)
+	{
+		UnlinkSensor(SensorID);
+		LinkSensor(SensorID);
+	}
+}
+
+void CGameWorld::RemoveSensor(int SensorID)
+{
+	UnlinkSensor(SensorID);
+
+	CSensor *pSensor = &m_aSensors[SensorID];
+	pSensor->m_pEntity = 0;
+	pSensor->m_Overlap = 0;
+	pSensor->m_NewOverlap = 0;
+	pSensor->m_Next = m_FirstFreeSensor;
+	m_FirstFreeSensor = SensorID;
+}
+
+void CGameWorld::UpdateSensors()
+{
+	if (m_aSensorGrid.empty())
+		return;
+
+	// collect the overlaps of this tick, only cells around characters are visited
+	CCharacter *apCharacters[MAX_CLIENTS] = {0};
+	std::vector<int> &aTouched = m_aTouchedSensors;
+	aTouched.swap(m_aActiveSensors);
+	m_aActiveSensors.clear();
+	for (unsigned i = 0; i < aTouched.size(); i++)
+		m_aSensors[aTouched[i]].m_Queued = true;
+
+	for (CCharacter *pChr = (CCharacter *)FindFirst(ENTTYPE_CHARACTER); pChr; pChr = (CCharacter *)pChr->TypeNext())
+	{
+		if (pChr->m_MarkedForDestroy || !pChr->GetPlayer())
+			continue;
+
+		int ClientID = pChr->GetPlayer()->GetCID();
+		if (ClientID < 0 || ClientID >= MAX_CLIENTS)
+			continue;
+		apCharacters[ClientID] = pChr;
+
+		float Reach = m_MaxSensorRadius + pChr->m_ProximityRadius;
+		int x0 = clamp((int)((pChr->m_Pos.x - Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridWidth - 1);
+		int x1 = clamp((int)((pChr->m_Pos.x + Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridWidth - 1);
+		int y0 = clamp((int)((pChr->m_Pos.y - Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridHeight - 1);
+		int y1 = clamp((int)((pChr->m_Pos.y + Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridHeight - 1);
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				for (int SensorID = m_aSensorGrid[y * m_SensorGridWidth + x]; SensorID >= 0; SensorID = m_aSensors[SensorID].m_Next)
+				{
+					CSensor *pSensor = &m_aSensors[SensorID];
+					if (distance(pSensor->m_Pos, pChr->m_Pos) >= pSensor->m_Radius + pChr->m_ProximityRadius)
+						continue;
+
+					pSensor->m_NewOverlap |= (int64)1 << ClientID;
+					if (!pSensor->m_Queued)
+					{
+						pSensor->m_Queued = true;
+						aTouched.push_back(SensorID);
+					}
+				}
+	}
+
+	// notify the entities, callbacks may add sensors so don't hold on to pointers
+	for (unsigned i = 0; i < aTouched.size(); i++)
+	{
+		int SensorID = aTouched[i];
+		int64 Old = m_aSensors[SensorID].m_Overlap;
+		int64 New = m_aSensors[SensorID].m_NewOverlap;
+		m_aSensors[SensorID].m_Overlap = New;
+		m_aSensors[SensorID].m_NewOverlap = 0;
+		m_aSensors[SensorID].m_Queued = false;
+		if (New)
+			m_aActiveSensors.push_back(SensorID);
+
+		for (int c = 0; c < MAX_CLIENTS && (Old | New); c++)
+		{
+			int64 Bit = (int64)1 << c;
+			if (!((Old | New) & Bit))
+				continue;
+
+			CEntity *pEnt = m_aSensors[SensorID].m_pEntity;
+			if (!pEnt || pEnt->m_MarkedForDestroy)
+				break;
+
+			if (!(New & Bit))
+				pEnt->OnSensorExit(c);
+			else
+			{
+				if (!(Old & Bit))
+					pEnt->OnSensorEnter(apCharacters[c]);
+				pEnt->OnSensorStay(apCharacters[c]);
+			}
+		}
+	}
+	aTouched.clear();
+
+	UpdateNpcSensors();
+}
+
+void CGameWorld::UpdateNpcSensors()
+{
+	// collect first, a triggered mine removes its sensor from the grid
+	std::vector<CNpcSensorHit> &aHits = m_aNpcSensorHits;
+	for (CNpc *pNpc = (CNpc *)FindFirst(ENTTYPE_NPC); pNpc; pNpc = (CNpc *)pNpc->TypeNext())
+	{
+		if (pNpc->m_MarkedForDestroy || !pNpc->IsAlive())
+			continue;
+
+		float Reach = m_MaxSensorRadius + pNpc->m_ProximityRadius;
+		int x0 = clamp((int)((pNpc->m_Pos.x - Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridWidth - 1);
+		int x1 = clamp((int)((pNpc->m_Pos.x + Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridWidth - 1);
+		int y0 = clamp((int)((pNpc->m_Pos.y - Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridHeight - 1);
+		int y1 = clamp((int)((pNpc->m_Pos.y + Reach) / SENSOR_CELL_SIZE), 0, m_SensorGridHeight - 1);
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				for (int SensorID = m_aSensorGrid[y * m_SensorGridWidth + x]; SensorID >= 0; SensorID = m_aSensors[SensorID].m_Next)
+				{
+					const CSensor *pSensor = &m_aSensors[SensorID];
+					if (distance(pSensor->m_Pos, pNpc->m_Pos) >= pSensor->m_Radius + pNpc->m_ProximityRadius)
+						continue;
+
+					CNpcSensorHit Hit;
+					Hit.m_SensorID = SensorID;
+					Hit.m_pNpc = pNpc;
+					aHits.push_back(Hit);
+				}
+	}
+
+	for (unsigned i = 0; i < aHits.size(); i++)
+	{
+		CEntity *pEnt = m_aSensors[aHits[i].m_SensorID].m_pEntity;
+		if (pEnt && !pEnt->m_MarkedForDestroy && aHits[i].m_pNpc->IsAlive())
+			pEnt->OnSensorNpc(aHits[i].m_pNpc);
+	}
+	aHits.clear();
+}
+
+void CGameWorld::WakeRegions(vec2 Pos, float Radius, int UntilTick)
+{
+	if (m_aRegionAwakeTick.empty())
+		return;
+
+	int x0 = clamp((int)((Pos.x - Radius) / REGION_SIZE), 0, m_RegionGridWidth - 1);
+	int x1 = clamp((int)((Pos.x + Radius) / REGION_SIZE), 0, m_RegionGridWidth - 1);
+	int y0 = clamp((int)((Pos.y - Radius) / REGION_SIZE), 0, m_RegionGridHeight - 1);
+	int y1 = clamp((int)((Pos.y + Radius) / REGION_SIZE), 0, m_RegionGridHeight - 1);
+	for (int y = y0; y <= y1; y++)
+		for (int x = x0; x <= x1; x++)
+		{
+			int *pAwakeTick = &m_aRegionAwakeTick[y * m_RegionGridWidth + x];
+			*pAwakeTick = max(*pAwakeTick, UntilTick);
+		}
+}
+
+void CGameWorld::UpdateRegions()
+{
+	if (!g_Config.m_SvSleepDistance)
+		return;
+
+	if (m_aRegionAwakeTick.empty())
+	{
+		CCollision *pCollision = GameServer()->Collision();
+		m_RegionGridWidth = max(1, pCollision->GetWidth() * 32 / REGION_SIZE + 1);
+		m_RegionGridHeight = max(1, pCollision->GetHeight() * 32 / REGION_SIZE + 1);
+		m_aRegionAwakeTick.assign(m_RegionGridWidth * m_RegionGridHeight, Server()->Tick());
+	}
+
+	// humans keep everything within the sleep distance of their view awake
+	for (int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CPlayer *pPlayer = GameServer()->m_apPlayers[i];
+		if (!pPlayer || GameServer()->IsBot(i))
+			continue;
+
+		WakeRegions(pPlayer->m_ViewPos, g_Config.m_SvSleepDistance, Server()->Tick());
+	}
+}
+
+void CGameWorld::WakeRegion(vec2 Pos, float Radius)
+{
+	if (!g_Config.m_SvSleepDistance)
+		return;
+
+	WakeRegions(Pos, Radius, Server()->Tick() + Server()->TickSpeed() * REGION_WAKE_TIME);
+}
+
+bool CGameWorld::IsSleeping(vec2 Pos)
+{
+	if (!g_Config.m_SvSleepDistance || m_aRegionAwakeTick.empty())
+		return false;
+
+	int x = clamp((int)(Pos.x / REGION_SIZE), 0, m_RegionGridWidth - 1);
+	int y = clamp((int)(Pos.y / REGION_SIZE), 0, m_RegionGridHeight - 1);
+	return m_aRegionAwakeTick[y * m_RegionGridWidth + x] < Server()->Tick();
+}
+
+bool CGameWorld::SkipTick(vec2 Pos, int Stagger)
+{
+	return (Server()->Tick() + Stagger) % SLEEP_TICK_RATE != 0 && IsSleeping(Pos);
+}
+
 bool CGameWorld::CheckBlock(vec2 Pos)
 {
 	CEntity *pEnt;
@@ -5,8 +5,11 @@
 
 #include <game/gamecore.h>
 
+#include <vector>
+
 class CEntity;
 class CCharacter;
+class CNpc;
 
 /*
 	Class: Game World
@@ -31,9 +34,18 @@ public:
 		ENTTYPE_DOOR,
 		ENTTYPE_BLOCK,
 		ENTTYPE_BUILDING,
+		ENTTYPE_NPC,
 		NUM_ENTTYPES
 	};
 
+	enum
+	{
+		MAX_NPCS = 512,
+
+		// sleeping entities and bots still tick once every this many ticks
+		SLEEP_TICK_RATE = 10,
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
@@ -44,6 +56,67 @@ private:
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
+	// static trigger volumes, bucketed in a grid so only the cells around
+	// characters get visited and sensors nobody is near cost nothing
+	enum
+	{
+		SENSOR_CELL_SIZE = 128,
+	};
+	struct CSensor
+	{
+		CEntity *m_pEntity;
+		vec2 m_Pos;
+		float m_Radius;
+		int m_Cell;
+		int m_Next; // next in cell, or next free
+		int64 m_Overlap;
+		int64 m_NewOverlap;
+		bool m_Queued;
+	};
+	std::vector<CSensor> m_aSensors;
+	std::vector<int> m_aActiveSensors;
+	std::vector<int> m_aTouchedSensors;
+	std::vector<int> m_aSensorGrid;
+	struct CNpcSensorHit
+	{
+		int m_SensorID;
+		CNpc *m_pNpc;
+	};
+	std::vector<CNpcSensorHit> m_aNpcSensorHits;
+	int m_SensorGridWidth;
+	int m_SensorGridHeight;
+	int m_FirstFreeSensor;
+	float m_MaxSensorRadius;
+
+	int SensorCell(vec2 Pos);
+	void LinkSensor(int SensorID);
+	void UnlinkSensor(int SensorID);
+	void UpdateSensors();
+	void UpdateNpcSensors();
+
+	// npcs have their own id space and borrow a free client id per
+	// snapping client, so they show up as characters without a slot
+	CNpc *m_apNpcs[MAX_NPCS];
+	int m_NumNpcs;
+	int m_aNpcSnapID[MAX_NPCS];
+	int m_aaSnapSlotNpc[MAX_CLIENTS + 1][MAX_CLIENTS]; // last snapshot's slot -> npc, demo last
+
+	void UpdateNpcSnapIDs(int SnappingClient);
+
+	// regions nobody human is near fall asleep, entities that allow it
+	// tick at SLEEP_TICK_RATE there until a player or an event wakes them
+	enum
+	{
+		REGION_SIZE = 512,
+		REGION_WAKE_TIME = 3, // seconds an event keeps a region awake
+	};
+	std::vector<int> m_aRegionAwakeTick;
+	int m_RegionGridWidth;
+	int m_RegionGridHeight;
+
+	void WakeRegions(vec2 Pos, float Radius, int UntilTick);
+	void UpdateRegions();
+
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
 	class IServer *Server() { return m_pServer; }
@@ -108,6 +181,100 @@ public:
 	*/
 	class CCharacter *ClosestCharacter(vec2 Pos, float Radius, CEntity *ppNotThis);
 
+	/*
+		Function: intersect_npc
+			Finds the closest npc that intersects the line.
+
+		Arguments:
+			pos0 - Start position
+			pos2 - End position
+			radius - How for from the line the npc is allowed to be.
+			new_pos - Intersection position
+
+		Returns:
+			Returns a pointer to the closest hit or NULL of there is no intersection.
+	*/
+	class CNpc *IntersectNpc(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos);
+
+	/*
+		Function: add_npc
+			Hands out an id from the npc id space.
+
+		Arguments:
+			npc - The npc to register
+
+		Returns:
+			Returns the id, or -1 if MAX_NPCS are alive.
+	*/
+	int AddNpc(CNpc *pNpc);
+	void RemoveNpc(int NpcID);
+	int NumNpcs() const { return m_NumNpcs; }
+	CNpc *GetNpc(int NpcID) { return NpcID < 0 || NpcID >= MAX_NPCS ? 0 : m_apNpcs[NpcID]; }
+
+	/*
+		Function: npc_snap_id
+			Client id the npc uses in the snapshot being built, or -1
+			if it doesn't get one this time.
+	*/
+	int NpcSnapID(int NpcID) const { return m_aNpcSnapID[NpcID]; }
+
+	/*
+		Function: npc_client_slot
+			Client id the npc had in the last snapshot sent to
+			ClientID, or -1 if that client didn't see it.
+	*/
+	int NpcClientSlot(int NpcID, int ClientID) const
+	{
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			if (m_aaSnapSlotNpc[ClientID][i] == NpcID)
+				return i;
+		return -1;
+	}
+
+	/*
+		Function: wake_region
+			Keeps the regions around a position awake for a few seconds,
+			used for explosions, doors and block changes.
+
+		Arguments:
+			pos - The center position.
+			radius - How far the event reaches
+	*/
+	void WakeRegion(vec2 Pos, float Radius);
+
+	/*
+		Function: is_sleeping
+			Tells if no human player is within sv_sleep_distance of the
+			region at a position and no event woke it up lately.
+	*/
+	bool IsSleeping(vec2 Pos);
+
+	/*
+		Function: skip_tick
+			Tells if something at a position should skip this tick
+			because its region sleeps. Stagger spreads the remaining
+			ticks of sleepers over SLEEP_TICK_RATE ticks.
+	*/
+	bool SkipTick(vec2 Pos, int Stagger);
+
+	/*
+		Function: add_sensor
+			Registers a trigger volume for an entity. Once per tick the
+			entity gets OnSensorEnter, OnSensorStay and OnSensorExit
+			calls for the characters overlapping it.
+
+		Arguments:
+			entity - Entity to notify
+			pos - Center of the volume
+			radius - How close a character has to be
+
+		Returns:
+			Returns the id of the sensor.
+	*/
+	int AddSensor(CEntity *pEntity, vec2 Pos, float Radius);
+	void MoveSensor(int SensorID, vec2 Pos);
+	void RemoveSensor(int SensorID);
+
 	/*
 		Function: insert_entity
 			Adds an entity to the world.
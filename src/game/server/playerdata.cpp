@@ -1,13 +1,15 @@
 #include <base/system.h>
 #include <base/math.h>
+#include <base/lock_scope.h>
+
+#include <engine/storage.h>
 
 #include "playerdata.h"
 
+static const char s_aLogID[8] = "PLRDATA";
+
 CPlayerData::CPlayerData(const char *pName, const char *TimeoutID)
 {
-	m_pChild1 = 0;
-	m_pChild2 = 0;
-	
 	str_copy(m_aName, pName, 16);
 	str_copy(m_TimeoutID, TimeoutID, 256);
 	
@@ -18,95 +20,343 @@ void CPlayerData::Die()
 {
 }
 
-void CPlayerData::Add(CPlayerData *pPlayerData)
+void CPlayerData::Reset()
 {
-	const char *Color = pPlayerData->m_TimeoutID;
+	for (int i = 0; i < 99; i++)
+	{
+		m_aWeaponType[i] = 0;
+		m_aWeaponAmmo[i] = 0;
+		m_aWeaponAmmoReserved[i] = 0;
+		
+		m_aAmmo[i] = -1;
+	}
 	
-	if (str_comp(Color, m_TimeoutID) != 0)
+	m_Armor = 0;
+	m_Weapon = 0;
+	m_Kits = 0;
+	m_Score = 0;
+	m_Gold = 0;
+	m_HighestLevel = 0;
+	m_HighestLevelSeed = 0;
+}
+
+
+CPlayerDataStore::CPlayerDataStore()
+{
+	m_apEntries = 0;
+	m_Capacity = 0;
+	m_NumEntries = 0;
+	m_HighScore = 1;
+
+	m_pStorage = 0;
+	m_aFilename[0] = 0;
+	m_NumLogRecords = 0;
+
+	m_pWriter = 0;
+	m_WriterLock = lock_create();
+	semaphore_init(&m_WriterSem);
+	m_CompactionPending = false;
+	m_Shutdown = false;
+	m_LogFile = 0;
+}
+
+CPlayerDataStore::~CPlayerDataStore()
+{
+	Shutdown();
+
+	for(int i = 0; i < m_Capacity; i++)
+		delete m_apEntries[i];
+	mem_free(m_apEntries);
+
+	lock_destroy(m_WriterLock);
+	semaphore_destroy(&m_WriterSem);
+}
+
+unsigned CPlayerDataStore::Hash(const char *pName, const char *pTimeoutID)
+{
+	return str_quickhash(pTimeoutID)^(str_quickhash(pName)*0x9E3779B1u);
+}
+
+int CPlayerDataStore::FindSlot(const char *pName, const char *pTimeoutID) const
+{
+	unsigned Mask = m_Capacity-1;
+	unsigned Slot = Hash(pName, pTimeoutID)&Mask;
+	while(m_apEntries[Slot])
 	{
-		if (m_pChild1)
-			m_pChild1->Add(pPlayerData);
-		else
-			m_pChild1 = pPlayerData;
+		if(str_comp(m_apEntries[Slot]->m_TimeoutID, pTimeoutID) == 0 && str_comp(m_apEntries[Slot]->m_aName, pName) == 0)
+			break;
+		Slot = (Slot+1)&Mask;
 	}
-	else
+	return Slot;
+}
+
+void CPlayerDataStore::Grow()
+{
+	CPlayerData **apOld = m_apEntries;
+	int OldCapacity = m_Capacity;
+
+	m_Capacity = max(m_Capacity*2, (int)MIN_CAPACITY);
+	m_apEntries = (CPlayerData **)mem_alloc(m_Capacity*sizeof(CPlayerData *), 1);
+	mem_zero(m_apEntries, m_Capacity*sizeof(CPlayerData *));
+
+	for(int i = 0; i < OldCapacity; i++)
+		if(apOld[i])
+			m_apEntries[FindSlot(apOld[i]->m_aName, apOld[i]->m_TimeoutID)] = apOld[i];
+	mem_free(apOld);
+}
+
+void CPlayerDataStore::Insert(CPlayerData *pData)
+{
+	// keep the load factor below 70% so probe chains stay short
+	if((m_NumEntries+1)*10 > m_Capacity*7)
+		Grow();
+
+	m_apEntries[FindSlot(pData->m_aName, pData->m_TimeoutID)] = pData;
+	m_NumEntries++;
+}
+
+CPlayerData *CPlayerDataStore::Find(const char *pName, const char *pTimeoutID) const
+{
+	if(!m_NumEntries)
+		return 0;
+	return m_apEntries[FindSlot(pName, pTimeoutID)];
+}
+
+CPlayerData *CPlayerDataStore::FindOrCreate(const char *pName, const char *pTimeoutID)
+{
+	CPlayerData *pData = Find(pName, pTimeoutID);
+	if(!pData)
 	{
-		if (m_pChild2)
-			m_pChild2->Add(pPlayerData);
-		else
-			m_pChild2 = pPlayerData;
+		pData = new CPlayerData(pName, pTimeoutID);
+		Insert(pData);
 	}
+	return pData;
 }
 
-CPlayerData *CPlayerData::Get(const char *pName, const char *TimeoutID)
+void CPlayerDataStore::Init(IStorage *pStorage, const char *pFilename)
 {
-	if (str_comp(TimeoutID, m_TimeoutID) == 0)
+	m_pStorage = pStorage;
+	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
+	if(!m_aFilename[0])
+		return;
+
+	Load();
+
+	if(!m_LogFile)
 	{
-		if(str_comp(pName, m_aName) == 0)
-			return this;
+		dbg_msg("playerdata", "failed to open '%s', player progress won't be saved", m_aFilename);
+		return;
 	}
-	
-	if (str_comp(TimeoutID, m_TimeoutID) != 0)
+
+	m_Shutdown = false;
+	m_pWriter = thread_init(WriterThread, this);
+}
+
+void CPlayerDataStore::Load()
+{
+	IOHANDLE File = m_pStorage->OpenFile(m_aFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
 	{
-		if (m_pChild1)
-			return m_pChild1->Get(pName, TimeoutID);
-		else
-			return 0;
+		OpenLog(true);
+		return;
 	}
-	else
+
+	// map the log instead of copying it, restarts with a large log only touch each page once
+	unsigned Length = 0;
+	unsigned char *pData = (unsigned char *)io_map(File, &Length);
+	io_close(File);
+
+	const CLogHeader *pHeader = (const CLogHeader *)pData;
+	if(!pData || Length < sizeof(CLogHeader) || mem_comp(pHeader->m_aID, s_aLogID, sizeof(s_aLogID)) != 0 ||
+		pHeader->m_Version != LOG_VERSION || pHeader->m_ByteOrder != LOG_BYTEORDER || pHeader->m_RecordSize != (int)sizeof(CPlayerData))
 	{
-		if (m_pChild2)
-			return m_pChild2->Get(pName, TimeoutID);
-		else
-			return 0;
+		if(pData)
+			io_unmap(pData, Length);
+		dbg_msg("playerdata", "'%s' has an unknown format, starting over", m_aFilename);
+		OpenLog(true);
+		return;
 	}
-	
-	return 0;
+
+	// replay the log, later records override earlier ones
+	unsigned DataSize = Length-sizeof(CLogHeader);
+	int NumRecords = DataSize/sizeof(CPlayerData);
+	const CPlayerData *pRecords = (const CPlayerData *)(pData+sizeof(CLogHeader));
+	for(int i = 0; i < NumRecords; i++)
+	{
+		CPlayerData Record = pRecords[i];
+		Record.m_TimeoutID[sizeof(Record.m_TimeoutID)-1] = 0;
+		Record.m_aName[sizeof(Record.m_aName)-1] = 0;
+
+		*FindOrCreate(Record.m_aName, Record.m_TimeoutID) = Record;
+		m_HighScore = max(m_HighScore, Record.m_HighestLevel);
+	}
+	io_unmap(pData, Length);
+	m_NumLogRecords = NumRecords;
+
+	dbg_msg("playerdata", "loaded %d players from %d records", m_NumEntries, NumRecords);
+
+	OpenLog(false);
+
+	// a torn last record would misalign everything appended after it
+	if(DataSize%sizeof(CPlayerData) != 0 || NeedsCompaction())
+		RequestCompaction();
 }
 
+void CPlayerDataStore::InitHeader(CLogHeader *pHeader)
+{
+	mem_zero(pHeader, sizeof(*pHeader));
+	mem_copy(pHeader->m_aID, s_aLogID, sizeof(s_aLogID));
+	pHeader->m_Version = LOG_VERSION;
+	pHeader->m_ByteOrder = LOG_BYTEORDER;
+	pHeader->m_RecordSize = sizeof(CPlayerData);
+}
 
-int CPlayerData::GetHighScore(int Score)
+bool CPlayerDataStore::OpenLog(bool Truncate)
 {
-	int s = max(m_HighestLevel, Score);
+	if(m_LogFile)
+		io_close(m_LogFile);
 
-	if (m_pChild1)
-		s = max(s, m_pChild1->GetHighScore(s));
+	m_LogFile = m_pStorage->OpenFile(m_aFilename, Truncate ? IOFLAG_WRITE : IOFLAG_APPEND, IStorage::TYPE_SAVE);
+	if(!m_LogFile || !Truncate)
+		return m_LogFile != 0;
 
-	if (m_pChild2)
-		s = max(s, m_pChild2->GetHighScore(s));
+	CLogHeader Header;
+	InitHeader(&Header);
+	io_write(m_LogFile, &Header, sizeof(Header));
+	io_flush(m_LogFile);
+	m_NumLogRecords = 0;
+	return true;
+}
 
-	return s;
+void CPlayerDataStore::Save(const CPlayerData *pData)
+{
+	m_HighScore = max(m_HighScore, pData->m_HighestLevel);
+	if(!m_pWriter)
+		return;
+
+	{
+		CLockScope ls(m_WriterLock);
+		m_aPending.push_back(*pData);
+	}
+	semaphore_signal(&m_WriterSem);
+	m_NumLogRecords++;
+
+	if(NeedsCompaction())
+		RequestCompaction();
+}
+
+void CPlayerDataStore::RequestCompaction()
+{
+	// the snapshot contains every pending record, so those don't need to be appended anymore
+	std::vector<CPlayerData> aSnapshot;
+	aSnapshot.reserve(m_NumEntries);
+	for(int i = 0; i < m_Capacity; i++)
+		if(m_apEntries[i])
+			aSnapshot.push_back(*m_apEntries[i]);
+
+	{
+		CLockScope ls(m_WriterLock);
+		m_aPending.clear();
+		m_aCompaction.swap(aSnapshot);
+		m_CompactionPending = true;
+	}
+	semaphore_signal(&m_WriterSem);
+	m_NumLogRecords = m_NumEntries;
 }
 
-int CPlayerData::GetPlayerCount(int Score)
+bool CPlayerDataStore::WriteCompacted(const std::vector<CPlayerData> &aRecords)
 {
+	char aTempName[160];
+	str_format(aTempName, sizeof(aTempName), "%s.tmp", m_aFilename);
 
-	if (m_pChild1)
-		Score += m_pChild1->GetPlayerCount(0);
+	IOHANDLE File = m_pStorage->OpenFile(aTempName, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
 
-	if (m_pChild2)
-		Score += m_pChild2->GetPlayerCount(0);
+	CLogHeader Header;
+	InitHeader(&Header);
+	unsigned Size = aRecords.size()*sizeof(CPlayerData);
+	bool Success = io_write(File, &Header, sizeof(Header)) == sizeof(Header);
+	if(Size)
+		Success = Success && io_write(File, &aRecords[0], Size) == Size;
+	io_close(File);
+
+	io_close(m_LogFile);
+	m_LogFile = 0;
+	if(Success)
+	{
+		m_pStorage->RemoveFile(m_aFilename, IStorage::TYPE_SAVE);
+		Success = m_pStorage->RenameFile(aTempName, m_aFilename, IStorage::TYPE_SAVE);
+	}
+	else
+		m_pStorage->RemoveFile(aTempName, IStorage::TYPE_SAVE);
 
-	return Score+1;
+	m_LogFile = m_pStorage->OpenFile(m_aFilename, IOFLAG_APPEND, IStorage::TYPE_SAVE);
+	return Success;
 }
 
+void CPlayerDataStore::WriterThread(void *pUser)
+{
+	CPlayerDataStore *pSelf = (CPlayerDataStore *)pUser;
+	std::vector<CPlayerData> aRecords;
+	std::vector<CPlayerData> aCompaction;
 
-void CPlayerData::Reset()
+	while(1)
+	{
+		semaphore_wait(&pSelf->m_WriterSem);
+
+		bool Compaction;
+		bool Shutdown;
+		{
+			CLockScope ls(pSelf->m_WriterLock);
+			aRecords.swap(pSelf->m_aPending);
+			Compaction = pSelf->m_CompactionPending;
+			if(Compaction)
+				aCompaction.swap(pSelf->m_aCompaction);
+			pSelf->m_CompactionPending = false;
+			Shutdown = pSelf->m_Shutdown;
+		}
+
+		if(Compaction)
+		{
+			if(pSelf->WriteCompacted(aCompaction))
+				dbg_msg("playerdata", "compacted log to %d records", (int)aCompaction.size());
+			else if(pSelf->m_LogFile && aCompaction.size())
+			{
+				// keep the old log and append the snapshot instead, nothing gets lost
+				dbg_msg("playerdata", "failed to compact '%s'", pSelf->m_aFilename);
+				io_write(pSelf->m_LogFile, &aCompaction[0], aCompaction.size()*sizeof(CPlayerData));
+			}
+			aCompaction.clear();
+		}
+
+		if(aRecords.size() && pSelf->m_LogFile)
+			io_write(pSelf->m_LogFile, &aRecords[0], aRecords.size()*sizeof(CPlayerData));
+		if(pSelf->m_LogFile)
+			io_flush(pSelf->m_LogFile);
+		aRecords.clear();
+
+		if(Shutdown)
+			break;
+	}
+}
+
+void CPlayerDataStore::Shutdown()
 {
-	for (int i = 0; i < 99; i++)
+	if(m_pWriter)
 	{
-		m_aWeaponType[i] = 0;
-		m_aWeaponAmmo[i] = 0;
-		m_aWeaponAmmoReserved[i] = 0;
-		
-		m_aAmmo[i] = -1;
+		{
+			CLockScope ls(m_WriterLock);
+			m_Shutdown = true;
+		}
+		semaphore_signal(&m_WriterSem);
+		thread_wait(m_pWriter);
+		m_pWriter = 0;
 	}
-	
-	m_Armor = 0;
-	m_Weapon = 0;
-	m_Kits = 0;
-	m_Score = 0;
-	m_Gold = 0;
-	m_HighestLevel = 0;
-	m_HighestLevelSeed = 0;
-}
\ No newline at end of file
+
+	if(m_LogFile)
+	{
+		io_close(m_LogFile);
+		m_LogFile = 0;
+	}
+}
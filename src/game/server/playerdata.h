@@ -1,13 +1,13 @@
 #ifndef GAME_SERVER_PLAYERDATA_H
 #define GAME_SERVER_PLAYERDATA_H
 
+#include <base/system.h>
+
+#include <vector>
+
 // stored player data for switching between levels
 class CPlayerData
 {
-private:
-	CPlayerData *m_pChild1;
-	CPlayerData *m_pChild2;
-
 public:
 	CPlayerData(const char *pName, const char *TimeoutID);
 	void Die();
@@ -30,12 +30,80 @@ public:
 	char m_TimeoutID[256];
 	
 	char m_aName[16];
-	
-	void Add(CPlayerData *pPlayerData);
-	CPlayerData *Get(const char *pName, const char *TimeoutID);
-	
-	int GetHighScore(int Score);
-	int GetPlayerCount(int Score);
+};
+
+// all known players, indexed by (timeout id, name) and kept on disk as an append-only log
+class CPlayerDataStore
+{
+	enum
+	{
+		LOG_VERSION=2,
+		LOG_BYTEORDER=0x01020304,
+		MIN_CAPACITY=256,
+		COMPACT_MIN_RECORDS=4096,
+		COMPACT_RATIO=2,
+	};
+
+	// records are plain CPlayerData copies, the header pins down everything
+	// their layout depends on so a log from another build or platform gets discarded
+	struct CLogHeader
+	{
+		char m_aID[8];
+		int m_Version;
+		int m_ByteOrder;
+		int m_RecordSize;
+		int m_Reserved;
+	};
+
+	// open addressing with linear probing, capacity is a power of two
+	CPlayerData **m_apEntries;
+	int m_Capacity;
+	int m_NumEntries;
+	int m_HighScore;
+
+	class IStorage *m_pStorage;
+	char m_aFilename[128];
+	int m_NumLogRecords;
+
+	// records are written by a separate thread so saving never blocks a tick
+	void *m_pWriter;
+	LOCK m_WriterLock;
+	SEMAPHORE m_WriterSem;
+	std::vector<CPlayerData> m_aPending;
+	std::vector<CPlayerData> m_aCompaction;
+	bool m_CompactionPending;
+	bool m_Shutdown;
+	IOHANDLE m_LogFile;
+
+	static unsigned Hash(const char *pName, const char *pTimeoutID);
+	int FindSlot(const char *pName, const char *pTimeoutID) const;
+	void Grow();
+	void Insert(CPlayerData *pData);
+	void Load();
+	void RequestCompaction();
+	bool NeedsCompaction() const { return m_NumLogRecords >= COMPACT_MIN_RECORDS && m_NumLogRecords > m_NumEntries*COMPACT_RATIO; }
+	static void InitHeader(CLogHeader *pHeader);
+
+	bool OpenLog(bool Truncate);
+	bool WriteCompacted(const std::vector<CPlayerData> &aRecords);
+	static void WriterThread(void *pUser);
+
+public:
+	CPlayerDataStore();
+	~CPlayerDataStore();
+
+	// pFilename may be empty to keep the data in memory only
+	void Init(class IStorage *pStorage, const char *pFilename);
+	void Shutdown();
+
+	CPlayerData *Find(const char *pName, const char *pTimeoutID) const;
+	CPlayerData *FindOrCreate(const char *pName, const char *pTimeoutID);
+
+	// queues the current state of pData for writing, call after modifying it
+	void Save(const CPlayerData *pData);
+
+	int HighScore() const { return m_HighScore; }
+	int NumEntries() const { return m_NumEntries; }
 };
 
 #endif
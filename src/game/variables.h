@@ -19,6 +19,7 @@ MACRO_CONFIG_INT(ClShowfps, cl_showfps, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "S
 
 MACRO_CONFIG_INT(ClAirjumpindicator, cl_airjumpindicator, 1, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "")
 MACRO_CONFIG_INT(ClThreadsoundloading, cl_threadsoundloading, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Load sound files threaded")
+MACRO_CONFIG_INT(ClParallelLoading, cl_parallel_loading, 1, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Decode images and sounds on worker threads at startup")
 
 MACRO_CONFIG_INT(ClWarningTeambalance, cl_warning_teambalance, 1, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Warn about team balance")
 
@@ -54,6 +55,7 @@ MACRO_CONFIG_INT(UiColorLht, ui_color_lht, 175, 0, 255, CFGFLAG_CLIENT|CFGFLAG_S
 MACRO_CONFIG_INT(UiColorAlpha, ui_color_alpha, 228, 0, 255, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Interface alpha")
 
 MACRO_CONFIG_INT(GfxNoclip, gfx_noclip, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Disable clipping")
+MACRO_CONFIG_INT(GfxTileCache, gfx_tile_cache, 1, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SAVE, "Keep tile layer geometry on the graphics side instead of rebuilding it every frame")
 
 
 // custom engine settings
@@ -142,14 +144,22 @@ MACRO_CONFIG_INT(SvMapGen, sv_mapgen, 1, 0, 1, CFGFLAG_SERVER, "Map Generation S
 MACRO_CONFIG_INT(SvMapGenLevel, sv_mapgen_level, 1, 1, 9999, CFGFLAG_SERVER, "Map Difficulty")
 MACRO_CONFIG_INT(SvMapGenSeed, sv_mapgen_seed, 0, 0, 32767, CFGFLAG_SERVER, "Map generation seed")
 MACRO_CONFIG_INT(SvMapGenRandSeed, sv_mapgen_random_seed, 1, 0, 1, CFGFLAG_SERVER, "Random map generation seed")
+MACRO_CONFIG_INT(SvMapGenThreads, sv_mapgen_threads, 4, 1, 16, CFGFLAG_SERVER, "Threads used by the map generator's auto-mapper")
+MACRO_CONFIG_STR(SvPlayerDataFile, sv_playerdata_file, 128, "playerdata.log", CFGFLAG_SERVER, "File coop player progress is kept in across restarts (empty to keep it in memory only)")
 
 // Invasion
 MACRO_CONFIG_INT(SvInvFails, sv_inv_fails,  0, 0, 9, CFGFLAG_SERVER, "Invasion level fails")
 MACRO_CONFIG_INT(SvInvBosses, sv_inv_bosses,  0, 0, 99, CFGFLAG_SERVER, "Invasion level bosses")
+MACRO_CONFIG_INT(SvInvNpcs, sv_inv_npcs, 0, 0, 1, CFGFLAG_SERVER, "Invasion monsters are npcs that don't take client slots")
+MACRO_CONFIG_INT(SvSleepDistance, sv_sleep_distance, 0, 0, 100000, CFGFLAG_SERVER, "Pickups, idle monsters and bots further than this from any human tick at a reduced rate (0 = off)")
 MACRO_CONFIG_STR(SvInvMap, sv_dont_use_j92zjhgsabkjznbdatka9j, 128, "", CFGFLAG_SERVER, "Latest invasion map")
 MACRO_CONFIG_INT(SvInvGroupLeft, sv_dont_use_j92213gyahjbd837tka9j, 0, 0, 9999999, CFGFLAG_SERVER, "Latest invasion map")
 MACRO_CONFIG_INT(SvInvELeft, sv_dont_use_j92tka9zi8ywhsadhi87yihvxmcnzj, 0, 0, 9999999, CFGFLAG_SERVER, "Latest invasion map")
 
+MACRO_CONFIG_INT(SvWaypointCache, sv_waypoint_cache, 1, 0, 1, CFGFLAG_SERVER, "Cache the bot navigation graph of each map in the waypoints folder")
+MACRO_CONFIG_INT(SvAIPathBudget, sv_ai_path_budget, 2, 1, 64, CFGFLAG_SERVER, "Path replans bots far from humans may do per tick")
+MACRO_CONFIG_INT(SvAIScanBudget, sv_ai_scan_budget, 8, 1, 64, CFGFLAG_SERVER, "Target scans bots far from humans may do per tick")
+MACRO_CONFIG_INT(SvAILodDistance, sv_ai_lod_distance, 1200, 0, 100000, CFGFLAG_SERVER, "Bots further than this from any human think less often (0 = off)")
 MACRO_CONFIG_INT(SvBotLevel, sv_bot_level, 40, 1, 9999, CFGFLAG_SERVER, "Bot level")
 
 // debug
@@ -45,9 +45,8 @@ static int m_ConfigReorder = 0;
 void Run(int Port, NETADDR Dest)
 {
 	NETADDR Src = {NETTYPE_IPV4, {0,0,0,0}, Port};
-	NETSOCKET Socket = net_udp_create(Src);
+	NETSOCKET Socket = net_udp_create(Src, 0);
 
-	char aBuffer[1024*2];
 	int ID = 0;
 	int Delaycounter = 0;
 
@@ -67,7 +66,8 @@ void Run(int Port, NETADDR Dest)
 			// fetch data
 			int DataTrash = 0;
 			NETADDR From;
-			int Bytes = net_udp_recv(Socket, &From, aBuffer, 1024*2);
+			unsigned char *pBuffer;
+			int Bytes = net_udp_recv(Socket, &From, &pBuffer);
 			if(Bytes <= 0)
 				break;
 
@@ -105,7 +105,7 @@ void Run(int Port, NETADDR Dest)
 			p->m_Timestamp = time_get();
 			p->m_DataSize = Bytes;
 			p->m_ID = ID++;
-			mem_copy(p->m_aData, aBuffer, Bytes);
+			mem_copy(p->m_aData, pBuffer, Bytes);
 
 			if(ID > 20 && Bytes > 6 && DataTrash)
 			{
@@ -150,10 +150,12 @@ void Run(int Port, NETADDR Dest)
 			{
 				char aFlags[] = "  ";
 
+				// send the following packet first, this one goes out on a later pass
 				if(m_ConfigReorder && (rand()%2) == 0 && p->m_pNext)
 				{
 					aFlags[0] = 'R';
-					p = m_pFirst->m_pNext;
+					p = p->m_pNext;
+					pNext = p->m_pNext;
 				}
 
 				if(p->m_pNext)
@@ -208,8 +210,24 @@ void Run(int Port, NETADDR Dest)
 
 int main(int argc, char **argv) // ignore_convention
 {
-	NETADDR Addr = {NETTYPE_IPV4, {127,0,0,1},8303};
 	dbg_logger_stdout();
-	Run(8302, Addr);
+
+	// crapnet [listen port] [server port] [loss %] [latency ms], a given loss
+	// replaces the rotating configs with a single reordering lossy link
+	int Port = argc > 1 ? str_toint(argv[1]) : 8302; // ignore_convention
+	NETADDR Addr = {NETTYPE_IPV4, {127,0,0,1}, 8303};
+	if(argc > 2) // ignore_convention
+		Addr.port = str_toint(argv[2]); // ignore_convention
+	if(argc > 3) // ignore_convention
+	{
+		int Latency = argc > 4 ? str_toint(argv[4]) : 100; // ignore_convention
+		CPingConfig Lossy = {Latency, Latency/4, 0, str_toint(argv[3]), 0, 0}; // ignore_convention
+		m_aConfigPings[0] = Lossy;
+		m_ConfigNumpingconfs = 1;
+		m_ConfigReorder = 1;
+		dbg_msg("crapnet", "lossy link, %d%% loss, %dms latency", Lossy.m_Loss, Lossy.m_Base);
+	}
+
+	Run(Port, Addr);
 	return 0;
 }